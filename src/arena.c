@@ -0,0 +1,91 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <string.h>
+
+#include "arena.h"
+#include "str.h"
+
+// ========================================================================== //
+// Util
+// ========================================================================== //
+
+/* Returns offset of the first free byte in chunk that is aligned to 'align' */
+static u32
+arena_chunk_align(ArenaChunk* chunk, u32 align)
+{
+  uintptr_t cur = (uintptr_t)(chunk->data + chunk->used);
+  uintptr_t aligned = (cur + align - 1) & ~(uintptr_t)(align - 1);
+  return (u32)(aligned - (uintptr_t)chunk->data);
+}
+
+// ========================================================================== //
+// Arena
+// ========================================================================== //
+
+Arena
+make_arena(u32 chunk_size)
+{
+  return (Arena){ .chunk = NULL, .chunk_size = chunk_size };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_arena(Arena* arena)
+{
+  ArenaChunk* chunk = arena->chunk;
+  while (chunk) {
+    ArenaChunk* prev = chunk->prev;
+    release(chunk);
+    chunk = prev;
+  }
+  arena->chunk = NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+void*
+arena_alloc(Arena* arena, u32 size, u32 align)
+{
+  assrt(align > 0 && (align & (align - 1)) == 0,
+        make_str("Arena alignment must be a power of two"));
+
+  ArenaChunk* chunk = arena->chunk;
+  u32 off = chunk ? arena_chunk_align(chunk, align) : 0;
+  if (!chunk || off + size > chunk->size) {
+    // Oversized allocations get a chunk of their own
+    u32 chunk_size = size + align > arena->chunk_size ? size + align
+                                                      : arena->chunk_size;
+    chunk = alloc(sizeof(ArenaChunk) + chunk_size, kLnMinAlign);
+    chunk->prev = arena->chunk;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    arena->chunk = chunk;
+    off = arena_chunk_align(chunk, align);
+  }
+
+  void* mem = chunk->data + off;
+  chunk->used = off + size;
+  memset(mem, 0, size);
+  return mem;
+}
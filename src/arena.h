@@ -0,0 +1,75 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_ARENA_H
+#define LN_ARENA_H
+
+#include "common.h"
+
+// ========================================================================== //
+// Arena
+// ========================================================================== //
+
+/* Chunk of arena memory */
+typedef struct ArenaChunk
+{
+  /* Previous chunk */
+  struct ArenaChunk* prev;
+  /* Size of data */
+  u32 size;
+  /* Used bytes of data */
+  u32 used;
+  /* Data */
+  u8 data[];
+} ArenaChunk;
+
+// -------------------------------------------------------------------------- //
+
+/* Bump allocator. Allocations are never released individually, all memory is
+ * released together with the arena */
+typedef struct Arena
+{
+  /* Current chunk */
+  ArenaChunk* chunk;
+  /* Size of new chunks */
+  u32 chunk_size;
+} Arena;
+
+// -------------------------------------------------------------------------- //
+
+/* Make arena that allocates chunks of 'chunk_size' bytes */
+Arena
+make_arena(u32 chunk_size);
+
+// -------------------------------------------------------------------------- //
+
+/* Release arena and all memory allocated from it */
+void
+release_arena(Arena* arena);
+
+// -------------------------------------------------------------------------- //
+
+/* Allocate zero-initialized memory from arena */
+void*
+arena_alloc(Arena* arena, u32 size, u32 align);
+
+#endif // LN_ARENA_H
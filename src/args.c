@@ -22,8 +22,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "args.h"
+#include "lsp_cache.h"
 
 // ========================================================================== //
 // Args
@@ -35,6 +37,8 @@ make_args(int argc, char** argv, Args* p_args)
   *p_args = (Args){};
   Args args = {};
   args.input = make_str_list(4);
+  args.codegen_units = 1;
+  args.lsp_data.cache_mb = kLspCacheDefaultMb;
 
   for (int i = 1; i < argc; i++) {
     if (cstr_eq(argv[i], "--help") || cstr_eq(argv[i], "-h")) {
@@ -55,21 +59,79 @@ make_args(int argc, char** argv, Args* p_args)
         exit(-1);
       }
       args.target = make_str_copy(argv[++i]);
+    } else if (cstr_eq(argv[i], "-O0")) {
+      args.opt_level = kTargetOpt0;
+    } else if (cstr_eq(argv[i], "-O1")) {
+      args.opt_level = kTargetOpt1;
+    } else if (cstr_eq(argv[i], "-O2") || cstr_eq(argv[i], "-O")) {
+      args.opt_level = kTargetOpt2;
+    } else if (cstr_eq(argv[i], "-O3")) {
+      args.opt_level = kTargetOpt3;
+    } else if (cstr_eq(argv[i], "-Os")) {
+      args.opt_level = kTargetOptSize;
+    } else if (strncmp(argv[i], "-mcpu=", 6) == 0) {
+      release_str(&args.cpu);
+      args.cpu = make_str_copy(argv[i] + 6);
+    } else if (strncmp(argv[i], "-mattr=", 7) == 0) {
+      release_str(&args.features);
+      args.features = make_str_copy(argv[i] + 7);
+    } else if (cstr_eq(argv[i], "--pgo-gen")) {
+      args.pgo_gen = true;
+    } else if (strncmp(argv[i], "--pgo-use=", 10) == 0) {
+      release_str(&args.pgo_use);
+      args.pgo_use = make_str_copy(argv[i] + 10);
+    } else if (strncmp(argv[i], "--emit=", 7) == 0) {
+      const char* kind = argv[i] + 7;
+      if (cstr_eq(kind, "obj")) {
+        args.emit = kCodegenEmitObj;
+      } else if (cstr_eq(kind, "asm")) {
+        args.emit = kCodegenEmitAsm;
+      } else if (cstr_eq(kind, "bc")) {
+        args.emit = kCodegenEmitBc;
+      } else if (cstr_eq(kind, "ll")) {
+        args.emit = kCodegenEmitLl;
+      } else {
+        printf("Invalid output kind '%s', expected one of 'obj', 'asm', 'bc' "
+               "and 'll'\n",
+               kind);
+        exit(-1);
+      }
+    } else if (cstr_eq(argv[i], "--lto")) {
+      args.lto = true;
+    } else if (cstr_eq(argv[i], "--codegen-units")) {
+      if (argc < i + 2) {
+        printf("Missing arguments to '%s'. Please specify the number of "
+               "codegen units\n",
+               argv[i]);
+        exit(-1);
+      }
+      long units = strtol(argv[++i], NULL, 10);
+      if (units < 1) {
+        printf("Invalid number of codegen units '%s'\n", argv[i]);
+        exit(-1);
+      }
+      args.codegen_units = (u32)units;
+    } else if (cstr_eq(argv[i], "--run")) {
+      args.run = true;
     } else if (cstr_eq(argv[i], "--verbose") || cstr_eq(argv[i], "-v")) {
       args.verbose = true;
     } else if (cstr_eq(argv[i], "--lsp")) {
-      if (argc < i + 4) {
-        printf("Missing arguments to '--lsp'. Please specify an 'type' (tcp | "
-               "ipc), 'host' and 'port'\n");
-        exit(-2);
-      }
-      args.lsp = true;
-      if (argv[i + 1][0] == '-') {
+      if (argc < i + 2 || argv[i + 1][0] == '-') {
         printf("Missing argument 'type' to '--lsp', please specify either "
-               "'tcp' or 'ipc'\n");
+               "'stdio', 'tcp' or 'tcp-listen'\n");
         exit(-3);
       }
+      args.lsp = true;
       args.lsp_data.type = make_str_copy(argv[++i]);
+      if (cstr_eq(argv[i], "stdio")) {
+        continue;
+      }
+      if (argc < i + 3) {
+        printf("Missing arguments to '--lsp'. Please specify the 'host' and "
+               "'port' of the '%s' transport\n",
+               argv[i]);
+        exit(-2);
+      }
       if (argv[i + 1][0] == '-') {
         printf("Missing argument 'host' to '--lsp', please specify the host "
                "address\n");
@@ -81,12 +143,31 @@ make_args(int argc, char** argv, Args* p_args)
         exit(-5);
       }
       args.lsp_data.port = make_str_copy(argv[++i]);
+    } else if (cstr_eq(argv[i], "--lsp-cache")) {
+      if (argc < i + 2) {
+        printf("Missing arguments to '%s'. Please specify the memory budget "
+               "of the cache in MiB\n",
+               argv[i]);
+        exit(-1);
+      }
+      long mb = strtol(argv[++i], NULL, 10);
+      if (mb < 1) {
+        printf("Invalid LSP cache budget '%s'\n", argv[i]);
+        exit(-1);
+      }
+      args.lsp_data.cache_mb = (u32)mb;
     } else if (cstr_eq(argv[i], "--dbg-dump-tok")) {
       args.dbg_dump_tokens = true;
     } else if (cstr_eq(argv[i], "--dbg-dump-ast")) {
       args.dbg_dump_ast = true;
+    } else if (cstr_eq(argv[i], "--dbg-dump-ir")) {
+      args.dbg_dump_ir = true;
+    } else if (cstr_eq(argv[i], "--dbg-dump-ll")) {
+      args.dbg_dump_ll = true;
+    } else if (cstr_eq(argv[i], "--dbg-lsp-panic")) {
+      args.dbg_lsp_panic = true;
     } else {
-      str_list_append(&args.input, &make_str(argv[i]));
+      str_list_append(&args.input, &make_str_cstr(argv[i]));
     }
   }
 
@@ -101,6 +182,9 @@ release_args(Args* p_args)
   release_str(&p_args->lsp_data.port);
   release_str(&p_args->lsp_data.host);
   release_str(&p_args->lsp_data.type);
+  release_str(&p_args->pgo_use);
+  release_str(&p_args->features);
+  release_str(&p_args->cpu);
   release_str(&p_args->target);
   release_str(&p_args->output);
   release_str_list(&p_args->input);
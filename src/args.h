@@ -25,6 +25,8 @@
 
 #include "common.h"
 #include "str.h"
+#include "target.h"
+#include "codegen.h"
 
 // ========================================================================== //
 // Args
@@ -38,6 +40,24 @@ typedef struct Args
   StrList input;
   /* Target. Empty for native */
   Str target;
+  /* Target CPU. Empty for generic */
+  Str cpu;
+  /* Target features */
+  Str features;
+  /* Optimization level */
+  TargetOptLevel opt_level;
+  /* Instrument code to generate a profile */
+  bool pgo_gen;
+  /* Path of profile to optimize with */
+  Str pgo_use;
+  /* Output file kind */
+  CodegenEmit emit;
+  /* Link all input files into one module before optimizing */
+  bool lto;
+  /* Number of codegen units */
+  u32 codegen_units;
+  /* JIT-compile and run 'main' instead of emitting an object file */
+  bool run;
   /* Show help */
   bool help;
   /* Verbose output */
@@ -50,11 +70,20 @@ typedef struct Args
     Str type;
     Str host;
     Str port;
+    /* Memory budget of the analysis cache in MiB */
+    u32 cache_mb;
   } lsp_data;
   /* Debug: Dump tokens */
   bool dbg_dump_tokens;
   /* Debug: Dump ast */
   bool dbg_dump_ast;
+  /* Debug: Dump MIR */
+  bool dbg_dump_ir;
+  /* Debug: Dump LLVM IR */
+  bool dbg_dump_ll;
+  /* Debug: Panic in the LSP analysis of documents that contain
+   * 'dbg_lsp_panic' */
+  bool dbg_lsp_panic;
 } Args;
 
 // -------------------------------------------------------------------------- //
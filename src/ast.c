@@ -163,11 +163,15 @@ ast_prog_dump(Ast* ast, u32 indent)
 // ========================================================================== //
 
 Ast*
-make_ast_fn(StrSlice name)
+make_ast_fn(Atom name)
 {
   Ast* ast = make_ast_invalid();
   ast->kind = kAstFn;
-  ast->fn = (AstFn){ .name = name, .params = make_ast_list(2), .ret = NULL };
+  ast->fn = (AstFn){ .name = name,
+                     .params = make_ast_list(2),
+                     .ret = NULL,
+                     .body = NULL,
+                     .checked = false };
   return ast;
 }
 
@@ -178,8 +182,12 @@ release_ast_fn(Ast* ast)
 {
   LN_AST_KIND_CHECK(ast->kind == kAstFn);
   release_ast_list(&ast->fn.params);
-  release_ast(ast->fn.ret);
-  release_ast(ast->fn.body);
+  if (ast->fn.ret) {
+    release_ast(ast->fn.ret);
+  }
+  if (ast->fn.body) {
+    release_ast(ast->fn.body);
+  }
   release(ast);
 }
 
@@ -209,15 +217,20 @@ void
 ast_fn_dump(Ast* ast, u32 indent)
 {
   LN_AST_KIND_CHECK(ast->kind == kAstFn);
-  printf("%*sfun '%.*s':\n", indent, "", str_slice_print(&ast->fn.name));
+  StrSlice name = atom_str(ast->fn.name);
+  printf("%*sfun '%.*s':\n", indent, "", str_slice_print(&name));
   for (u32 i = 0; i < ast->fn.params.len; i++) {
     Ast* ast_i = ast_list_get(&ast->fn.params, i);
     ast_dump_aux(ast_i, indent + kAstIndentStep);
   }
-  printf("%*sret:\n", indent + kAstIndentStep, "");
-  ast_dump_aux(ast->fn.ret, indent + (2 * kAstIndentStep));
-  printf("%*sbody:\n", indent + kAstIndentStep, "");
-  ast_dump_aux(ast->fn.body, indent + (2 * kAstIndentStep));
+  if (ast->fn.ret) {
+    printf("%*sret:\n", indent + kAstIndentStep, "");
+    ast_dump_aux(ast->fn.ret, indent + (2 * kAstIndentStep));
+  }
+  if (ast->fn.body) {
+    printf("%*sbody:\n", indent + kAstIndentStep, "");
+    ast_dump_aux(ast->fn.body, indent + (2 * kAstIndentStep));
+  }
 }
 
 // ========================================================================== //
@@ -229,7 +242,7 @@ make_ast_param()
 {
   Ast* ast = make_ast_invalid();
   ast->kind = kAstParam;
-  ast->param = (AstParam){ .name = str_slice_null(), .type = NULL };
+  ast->param = (AstParam){ .name = kAtomNone, .type = NULL };
   return ast;
 }
 
@@ -239,17 +252,42 @@ void
 release_ast_param(Ast* ast)
 {
   LN_AST_KIND_CHECK(ast->kind == kAstParam);
+  if (ast->param.type) {
+    release_ast(ast->param.type);
+  }
   release(ast);
 }
 
 // -------------------------------------------------------------------------- //
 
+void
+ast_param_set_name(Ast* ast_param, Atom name)
+{
+  LN_AST_KIND_CHECK(ast_param->kind == kAstParam);
+  ast_param->param.name = name;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_param_set_type(Ast* ast_param, Ast* ast_type)
+{
+  LN_AST_KIND_CHECK(ast_param->kind == kAstParam);
+  LN_AST_KIND_CHECK(ast_type->kind == kAstType);
+  ast_param->param.type = ast_type;
+}
+
+// -------------------------------------------------------------------------- //
+
 void
 ast_param_dump(Ast* ast, u32 indent)
 {
   LN_AST_KIND_CHECK(ast->kind == kAstParam);
-  printf("%*sparam (%.*s):\n", indent, "", str_slice_print(&ast->param.name));
-  ast_dump_aux(ast->param.type, indent + kAstIndentStep);
+  StrSlice name = atom_str(ast->param.name);
+  printf("%*sparam (%.*s):\n", indent, "", str_slice_print(&name));
+  if (ast->param.type) {
+    ast_dump_aux(ast->param.type, indent + kAstIndentStep);
+  }
 }
 
 // ========================================================================== //
@@ -307,7 +345,7 @@ make_ast_let()
 {
   Ast* ast = make_ast_invalid();
   ast->kind = kAstLet;
-  ast->let = (AstLet){ .name = str_slice_null(), .expr = NULL };
+  ast->let = (AstLet){ .name = kAtomNone, .type = NULL, .expr = NULL };
   return ast;
 }
 
@@ -317,14 +355,19 @@ void
 release_ast_let(Ast* ast_let)
 {
   LN_AST_KIND_CHECK(ast_let->kind == kAstLet);
-  release_ast(ast_let->let.expr);
+  if (ast_let->let.type) {
+    release_ast(ast_let->let.type);
+  }
+  if (ast_let->let.expr) {
+    release_ast(ast_let->let.expr);
+  }
   release(ast_let);
 }
 
 // -------------------------------------------------------------------------- //
 
 void
-ast_let_set_name(Ast* ast_let, StrSlice name)
+ast_let_set_name(Ast* ast_let, Atom name)
 {
   LN_AST_KIND_CHECK(ast_let->kind == kAstLet);
   ast_let->let.name = name;
@@ -355,8 +398,22 @@ ast_let_set_assigned(Ast* ast_let, Ast* ast_expr)
 void
 ast_let_dump(Ast* ast, u32 indent)
 {
-  LN_UNUSED(ast);
-  LN_UNUSED(indent);
+  LN_AST_KIND_CHECK(ast->kind == kAstLet);
+  StrSlice name = atom_str(ast->let.name);
+  printf("%*slet '%.*s':\n", indent, "", str_slice_print(&name));
+  if (ast->let.type) {
+    ast_dump_aux(ast->let.type, indent + kAstIndentStep);
+  } else if (ast->res_type) {
+    Str type_str = type_to_str(ast->res_type);
+    printf("%*stype (inferred): '%s'\n",
+           indent + kAstIndentStep,
+           "",
+           str_cstr(&type_str));
+    release_str(&type_str);
+  }
+  if (ast->let.expr) {
+    ast_dump_aux(ast->let.expr, indent + kAstIndentStep);
+  }
 }
 
 // ========================================================================== //
@@ -366,7 +423,7 @@ ast_let_dump(Ast* ast, u32 indent)
 Ast*
 make_ast_ret(Ast* ast_expr)
 {
-  LN_AST_KIND_CHECK(ast_is_expr(ast_expr));
+  LN_AST_KIND_CHECK(!ast_expr || ast_is_expr(ast_expr));
   Ast* ast = make_ast_invalid();
   ast->kind = kAstRet;
   ast->ret = (AstRet){ .expr = ast_expr };
@@ -379,7 +436,9 @@ void
 release_ast_ret(Ast* ast_ret)
 {
   LN_AST_KIND_CHECK(ast_ret->kind == kAstRet);
-  release_ast(ast_ret->ret.expr);
+  if (ast_ret->ret.expr) {
+    release_ast(ast_ret->ret.expr);
+  }
   release(ast_ret);
 }
 
@@ -390,7 +449,156 @@ ast_ret_dump(Ast* ast, u32 indent)
 {
   LN_AST_KIND_CHECK(ast->kind == kAstRet);
   printf("%*sret:\n", indent, "");
-  ast_dump_aux(ast->ret.expr, indent + kAstIndentStep);
+  if (ast->ret.expr) {
+    ast_dump_aux(ast->ret.expr, indent + kAstIndentStep);
+  }
+}
+
+// ========================================================================== //
+// AstLoopAttrs
+// ========================================================================== //
+
+void
+ast_loop_attrs_dump(const AstLoopAttrs* attrs, u32 indent)
+{
+  if (attrs->vectorize == kAstLoopHintEnable) {
+    printf("%*sattr: vectorize(%u)\n", indent, "", attrs->vectorize_width);
+  } else if (attrs->vectorize == kAstLoopHintDisable) {
+    printf("%*sattr: novectorize\n", indent, "");
+  }
+  if (attrs->unroll == kAstLoopHintEnable) {
+    printf("%*sattr: unroll(%u)\n", indent, "", attrs->unroll_count);
+  } else if (attrs->unroll == kAstLoopHintDisable) {
+    printf("%*sattr: nounroll\n", indent, "");
+  }
+}
+
+// ========================================================================== //
+// AstWhile
+// ========================================================================== //
+
+Ast*
+make_ast_while(Ast* ast_cond, Ast* ast_body)
+{
+  LN_AST_KIND_CHECK(ast_is_expr(ast_cond));
+  LN_AST_KIND_CHECK(ast_body->kind == kAstBlock);
+  Ast* ast = make_ast_invalid();
+  ast->kind = kAstWhile;
+  ast->while_loop =
+    (AstWhile){ .cond = ast_cond, .body = ast_body, .attrs = { 0 } };
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_while(Ast* ast_while)
+{
+  LN_AST_KIND_CHECK(ast_while->kind == kAstWhile);
+  release_ast(ast_while->while_loop.cond);
+  release_ast(ast_while->while_loop.body);
+  release(ast_while);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_while_dump(Ast* ast, u32 indent)
+{
+  LN_AST_KIND_CHECK(ast->kind == kAstWhile);
+  printf("%*swhile:\n", indent, "");
+  ast_loop_attrs_dump(&ast->while_loop.attrs, indent + kAstIndentStep);
+  printf("%*scond:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->while_loop.cond, indent + (2 * kAstIndentStep));
+  ast_dump_aux(ast->while_loop.body, indent + kAstIndentStep);
+}
+
+// ========================================================================== //
+// AstFor
+// ========================================================================== //
+
+Ast*
+make_ast_for(Atom name, Ast* ast_from, Ast* ast_to, Ast* ast_body)
+{
+  LN_AST_KIND_CHECK(ast_is_expr(ast_from));
+  LN_AST_KIND_CHECK(ast_is_expr(ast_to));
+  LN_AST_KIND_CHECK(ast_body->kind == kAstBlock);
+  Ast* ast = make_ast_invalid();
+  ast->kind = kAstFor;
+  ast->for_loop = (AstFor){ .name = name,
+                            .from = ast_from,
+                            .to = ast_to,
+                            .body = ast_body,
+                            .attrs = { 0 } };
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_for(Ast* ast_for)
+{
+  LN_AST_KIND_CHECK(ast_for->kind == kAstFor);
+  release_ast(ast_for->for_loop.from);
+  release_ast(ast_for->for_loop.to);
+  release_ast(ast_for->for_loop.body);
+  release(ast_for);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_for_dump(Ast* ast, u32 indent)
+{
+  LN_AST_KIND_CHECK(ast->kind == kAstFor);
+  StrSlice name = atom_str(ast->for_loop.name);
+  printf("%*sfor '%.*s':\n", indent, "", str_slice_print(&name));
+  ast_loop_attrs_dump(&ast->for_loop.attrs, indent + kAstIndentStep);
+  printf("%*sfrom:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->for_loop.from, indent + (2 * kAstIndentStep));
+  printf("%*sto:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->for_loop.to, indent + (2 * kAstIndentStep));
+  ast_dump_aux(ast->for_loop.body, indent + kAstIndentStep);
+}
+
+// ========================================================================== //
+// AstAssign
+// ========================================================================== //
+
+Ast*
+make_ast_assign(Ast* ast_target, Ast* ast_expr)
+{
+  LN_AST_KIND_CHECK(ast_target->kind == kAstVar ||
+                    ast_target->kind == kAstIndex);
+  LN_AST_KIND_CHECK(ast_is_expr(ast_expr));
+  Ast* ast = make_ast_invalid();
+  ast->kind = kAstAssign;
+  ast->assign = (AstAssign){ .target = ast_target, .expr = ast_expr };
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_assign(Ast* ast_assign)
+{
+  LN_AST_KIND_CHECK(ast_assign->kind == kAstAssign);
+  release_ast(ast_assign->assign.target);
+  release_ast(ast_assign->assign.expr);
+  release(ast_assign);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_assign_dump(Ast* ast, u32 indent)
+{
+  LN_AST_KIND_CHECK(ast->kind == kAstAssign);
+  printf("%*sassign:\n", indent, "");
+  printf("%*starget:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->assign.target, indent + (2 * kAstIndentStep));
+  printf("%*sexpr:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->assign.expr, indent + (2 * kAstIndentStep));
 }
 
 // ========================================================================== //
@@ -419,6 +627,15 @@ release_ast_binop(Ast* ast_binop)
 
 // -------------------------------------------------------------------------- //
 
+bool
+ast_binop_kind_is_cmp(AstBinopKind kind)
+{
+  return kind == kAstBinopEq || kind == kAstBinopNe || kind == kAstBinopLt ||
+         kind == kAstBinopLe || kind == kAstBinopGt || kind == kAstBinopGe;
+}
+
+// -------------------------------------------------------------------------- //
+
 void
 ast_binop_set_kind(Ast* ast_binop, AstBinopKind kind)
 {
@@ -465,6 +682,18 @@ ast_binop_dump(Ast* ast, u32 indent)
     op_str = "/";
   } else if (ast->binop.kind == kAstBinopMod) {
     op_str = "%";
+  } else if (ast->binop.kind == kAstBinopEq) {
+    op_str = "==";
+  } else if (ast->binop.kind == kAstBinopNe) {
+    op_str = "!=";
+  } else if (ast->binop.kind == kAstBinopLt) {
+    op_str = "<";
+  } else if (ast->binop.kind == kAstBinopLe) {
+    op_str = "<=";
+  } else if (ast->binop.kind == kAstBinopGt) {
+    op_str = ">";
+  } else if (ast->binop.kind == kAstBinopGe) {
+    op_str = ">=";
   }
 
   // Dump binop
@@ -527,6 +756,24 @@ ast_const_to_u64(Ast* ast_const)
 
 // -------------------------------------------------------------------------- //
 
+f64
+ast_const_to_f64(Ast* ast_const)
+{
+  // Preconditions
+  LN_AST_KIND_CHECK(ast_const->kind == kAstConst);
+  assrt(ast_const->constant.kind != kAstConstStr,
+        make_str("Cannot call 'ast_const_to_f64' when const kind is 'str'"));
+
+  // Convert
+  char* end_ptr = NULL;
+  f64 value = strtod((char*)ast_const->constant.value.ptr, &end_ptr);
+  assrt(end_ptr != (char*)ast_const->constant.value.ptr,
+        make_str("Const could not be converted to it's 'f64' value"));
+  return value;
+}
+
+// -------------------------------------------------------------------------- //
+
 void
 ast_const_dump(Ast* ast, u32 indent)
 {
@@ -535,6 +782,125 @@ ast_const_dump(Ast* ast, u32 indent)
     "%*sconst: '%.*s'\n", indent, "", str_slice_print(&ast->constant.value));
 }
 
+// ========================================================================== //
+// AstVar
+// ========================================================================== //
+
+Ast*
+make_ast_var(Atom name)
+{
+  Ast* ast = make_ast_invalid();
+  ast->kind = kAstVar;
+  ast->var = (AstVar){ .name = name, .decl = NULL };
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_var(Ast* ast_var)
+{
+  LN_AST_KIND_CHECK(ast_var->kind == kAstVar);
+  release(ast_var);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_var_dump(Ast* ast, u32 indent)
+{
+  LN_AST_KIND_CHECK(ast->kind == kAstVar);
+  StrSlice name = atom_str(ast->var.name);
+  printf("%*svar: '%.*s'\n", indent, "", str_slice_print(&name));
+}
+
+// ========================================================================== //
+// AstIndex
+// ========================================================================== //
+
+Ast*
+make_ast_index(Ast* ast_base, Ast* ast_index)
+{
+  LN_AST_KIND_CHECK(ast_is_expr(ast_base));
+  LN_AST_KIND_CHECK(ast_is_expr(ast_index));
+  Ast* ast = make_ast_invalid();
+  ast->kind = kAstIndex;
+  ast->index = (AstIndex){ .base = ast_base, .index = ast_index };
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_index(Ast* ast_index)
+{
+  LN_AST_KIND_CHECK(ast_index->kind == kAstIndex);
+  release_ast(ast_index->index.base);
+  release_ast(ast_index->index.index);
+  release(ast_index);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_index_dump(Ast* ast, u32 indent)
+{
+  LN_AST_KIND_CHECK(ast->kind == kAstIndex);
+  printf("%*sindex:\n", indent, "");
+  printf("%*sbase:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->index.base, indent + (2 * kAstIndentStep));
+  printf("%*sindex:\n", indent + kAstIndentStep, "");
+  ast_dump_aux(ast->index.index, indent + (2 * kAstIndentStep));
+}
+
+// ========================================================================== //
+// AstCall
+// ========================================================================== //
+
+Ast*
+make_ast_call(Atom name)
+{
+  Ast* ast = make_ast_invalid();
+  ast->kind = kAstCall;
+  ast->call = (AstCall){ .name = name, .args = make_ast_list(2), .decl = NULL };
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_call(Ast* ast_call)
+{
+  LN_AST_KIND_CHECK(ast_call->kind == kAstCall);
+  release_ast_list(&ast_call->call.args);
+  release(ast_call);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_call_add_arg(Ast* ast_call, Ast* ast_arg)
+{
+  LN_AST_KIND_CHECK(ast_call->kind == kAstCall);
+  LN_AST_KIND_CHECK(ast_is_expr(ast_arg));
+  ast_list_append(&ast_call->call.args, ast_arg);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+ast_call_dump(Ast* ast, u32 indent)
+{
+  LN_AST_KIND_CHECK(ast->kind == kAstCall);
+  StrSlice name = atom_str(ast->call.name);
+  printf("%*scall: '%.*s'\n", indent, "", str_slice_print(&name));
+  for (u32 i = 0; i < ast->call.args.len; i++) {
+    printf("%*sarg:\n", indent + kAstIndentStep, "");
+    ast_dump_aux(ast_list_get(&ast->call.args, i),
+                 indent + (2 * kAstIndentStep));
+  }
+}
+
 // ========================================================================== //
 // AstType
 // ========================================================================== //
@@ -577,7 +943,7 @@ make_ast_invalid()
 {
   Ast* ast = alloc(sizeof(Ast), kLnMinAlign);
   assrt(ast != NULL, make_str("Allocation of AST node failed"));
-  ast->kind = kAstInvalid;
+  *ast = (Ast){ .kind = kAstInvalid, .res_type = NULL };
   return ast;
 }
 
@@ -614,6 +980,18 @@ release_ast(Ast* ast)
       release_ast_ret(ast);
       break;
     }
+    case kAstWhile: {
+      release_ast_while(ast);
+      break;
+    }
+    case kAstFor: {
+      release_ast_for(ast);
+      break;
+    }
+    case kAstAssign: {
+      release_ast_assign(ast);
+      break;
+    }
     case kAstBinop: {
       release_ast_binop(ast);
       break;
@@ -622,6 +1000,18 @@ release_ast(Ast* ast)
       release_ast_const(ast);
       break;
     }
+    case kAstVar: {
+      release_ast_var(ast);
+      break;
+    }
+    case kAstIndex: {
+      release_ast_index(ast);
+      break;
+    }
+    case kAstCall: {
+      release_ast_call(ast);
+      break;
+    }
     case kAstType: {
       release_ast_type(ast);
       break;
@@ -640,7 +1030,10 @@ ast_is_stmt(Ast* ast)
   if (!ast) {
     return false;
   }
-  return ast->kind == kAstLet || ast->kind == kAstRet;
+  return ast->kind == kAstLet || ast->kind == kAstRet ||
+         ast->kind == kAstWhile || ast->kind == kAstFor ||
+         ast->kind == kAstAssign || ast->kind == kAstBlock ||
+         ast->kind == kAstCall;
 }
 
 // -------------------------------------------------------------------------- //
@@ -652,7 +1045,9 @@ ast_is_expr(Ast* ast)
   if (!ast) {
     return false;
   }
-  return ast->kind == kAstBinop || ast->kind == kAstConst;
+  return ast->kind == kAstBinop || ast->kind == kAstConst ||
+         ast->kind == kAstVar || ast->kind == kAstIndex ||
+         ast->kind == kAstCall;
 }
 
 // -------------------------------------------------------------------------- //
@@ -697,6 +1092,18 @@ ast_dump_aux(Ast* ast, u32 indent)
       ast_ret_dump(ast, indent);
       break;
     }
+    case kAstWhile: {
+      ast_while_dump(ast, indent);
+      break;
+    }
+    case kAstFor: {
+      ast_for_dump(ast, indent);
+      break;
+    }
+    case kAstAssign: {
+      ast_assign_dump(ast, indent);
+      break;
+    }
     case kAstBinop: {
       ast_binop_dump(ast, indent);
       break;
@@ -705,6 +1112,18 @@ ast_dump_aux(Ast* ast, u32 indent)
       ast_const_dump(ast, indent);
       break;
     }
+    case kAstVar: {
+      ast_var_dump(ast, indent);
+      break;
+    }
+    case kAstIndex: {
+      ast_index_dump(ast, indent);
+      break;
+    }
+    case kAstCall: {
+      ast_call_dump(ast, indent);
+      break;
+    }
     case kAstType: {
       ast_type_dump(ast, indent);
       break;
@@ -26,6 +26,7 @@
 #include "str.h"
 #include "span.h"
 #include "type.h"
+#include "atom.h"
 
 typedef struct AstProg AstProg;
 typedef struct AstFn AstFn;
@@ -33,8 +34,14 @@ typedef struct AstParam AstParam;
 typedef struct AstBlock AstBlock;
 typedef struct AstLet AstLet;
 typedef struct AstRet AstRet;
+typedef struct AstWhile AstWhile;
+typedef struct AstFor AstFor;
+typedef struct AstAssign AstAssign;
 typedef struct AstBinop AstBinop;
 typedef struct AstConst AstConst;
+typedef struct AstVar AstVar;
+typedef struct AstIndex AstIndex;
+typedef struct AstCall AstCall;
 typedef struct AstType AstType;
 typedef struct Ast Ast;
 
@@ -59,10 +66,22 @@ typedef enum AstKind
   kAstLet,
   /* Ret node */
   kAstRet,
+  /* While loop node */
+  kAstWhile,
+  /* For loop node */
+  kAstFor,
+  /* Assignment node */
+  kAstAssign,
   /* Binop node */
   kAstBinop,
   /* Const node */
   kAstConst,
+  /* Var node */
+  kAstVar,
+  /* Index node */
+  kAstIndex,
+  /* Call node */
+  kAstCall,
   /* Tupe node */
   kAstType
 } AstKind;
@@ -158,19 +177,23 @@ ast_prog_dump(Ast* ast, u32 indent);
 typedef struct AstFn
 {
   /* Name */
-  StrSlice name;
+  Atom name;
+  /* Span of the name */
+  Span name_span;
   /* List of parameter nodes (AstParam) */
   AstList params;
   /* Return type node (AstType) */
   Ast* ret;
-  /* Body */
+  /* Body, NULL for functions that are only declared */
   Ast* body;
+  /* Set when the function has passed semantic analysis */
+  bool checked;
 } AstFn;
 
 // -------------------------------------------------------------------------- //
 
 Ast*
-make_ast_fn(StrSlice name);
+make_ast_fn(Atom name);
 
 // -------------------------------------------------------------------------- //
 
@@ -203,7 +226,9 @@ ast_fn_dump(Ast* ast, u32 indent);
 typedef struct AstParam
 {
   /* Name */
-  StrSlice name;
+  Atom name;
+  /* Span of the name */
+  Span name_span;
   /* Type (AstType) */
   Ast* type;
 } AstParam;
@@ -215,6 +240,18 @@ make_ast_param();
 
 // -------------------------------------------------------------------------- //
 
+/* Set param name */
+void
+ast_param_set_name(Ast* ast_param, Atom name);
+
+// -------------------------------------------------------------------------- //
+
+/* Set param type (AstType) */
+void
+ast_param_set_type(Ast* ast_param, Ast* ast_type);
+
+// -------------------------------------------------------------------------- //
+
 void
 release_ast_param(Ast* ast);
 
@@ -264,7 +301,9 @@ ast_block_dump(Ast* ast, u32 indent);
 typedef struct AstLet
 {
   /* Name */
-  StrSlice name;
+  Atom name;
+  /* Span of the name */
+  Span name_span;
   /* Optional type */
   Ast* type;
   /* Assigned expr */
@@ -287,7 +326,7 @@ release_ast_let(Ast* ast_let);
 
 /* Set let name */
 void
-ast_let_set_name(Ast* ast_let, StrSlice name);
+ast_let_set_name(Ast* ast_let, Atom name);
 
 // -------------------------------------------------------------------------- //
 
@@ -333,6 +372,140 @@ release_ast_ret(Ast* ast_ret);
 void
 ast_ret_dump(Ast* ast, u32 indent);
 
+// ========================================================================== //
+// AstLoopAttrs
+// ========================================================================== //
+
+/* State of a loop optimization hint */
+typedef enum AstLoopHint
+{
+  /* Not given, the optimizer decides */
+  kAstLoopHintNone,
+  /* Enabled */
+  kAstLoopHintEnable,
+  /* Disabled */
+  kAstLoopHintDisable,
+} AstLoopHint;
+
+// -------------------------------------------------------------------------- //
+
+/* Loop attributes, given as '#[vectorize, unroll(4)]' before a loop */
+typedef struct AstLoopAttrs
+{
+  /* 'vectorize' or 'novectorize' */
+  AstLoopHint vectorize;
+  /* Width from 'vectorize(width)', 0 when not given */
+  u32 vectorize_width;
+  /* 'unroll' or 'nounroll' */
+  AstLoopHint unroll;
+  /* Count from 'unroll(count)', 0 when not given */
+  u32 unroll_count;
+} AstLoopAttrs;
+
+// -------------------------------------------------------------------------- //
+
+/* Dump loop attributes, nothing is printed if none are given */
+void
+ast_loop_attrs_dump(const AstLoopAttrs* attrs, u32 indent);
+
+// ========================================================================== //
+// AstWhile
+// ========================================================================== //
+
+/* While loop node */
+typedef struct AstWhile
+{
+  /* Condition */
+  Ast* cond;
+  /* Body (AstBlock) */
+  Ast* body;
+  /* Attributes */
+  AstLoopAttrs attrs;
+} AstWhile;
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+make_ast_while(Ast* ast_cond, Ast* ast_body);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_while(Ast* ast_while);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump */
+void
+ast_while_dump(Ast* ast, u32 indent);
+
+// ========================================================================== //
+// AstFor
+// ========================================================================== //
+
+/* For loop node, 'for name in from..to'. The node is the declaration of the
+ * loop variable, which takes the values in the half-open range */
+typedef struct AstFor
+{
+  /* Name of loop variable */
+  Atom name;
+  /* Span of the name */
+  Span name_span;
+  /* First value */
+  Ast* from;
+  /* End value, not included */
+  Ast* to;
+  /* Body (AstBlock) */
+  Ast* body;
+  /* Attributes */
+  AstLoopAttrs attrs;
+} AstFor;
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+make_ast_for(Atom name, Ast* ast_from, Ast* ast_to, Ast* ast_body);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_for(Ast* ast_for);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump */
+void
+ast_for_dump(Ast* ast, u32 indent);
+
+// ========================================================================== //
+// AstAssign
+// ========================================================================== //
+
+/* Assignment node */
+typedef struct AstAssign
+{
+  /* Assigned place (AstVar or AstIndex) */
+  Ast* target;
+  /* Assigned value */
+  Ast* expr;
+} AstAssign;
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+make_ast_assign(Ast* ast_target, Ast* ast_expr);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_assign(Ast* ast_assign);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump */
+void
+ast_assign_dump(Ast* ast, u32 indent);
+
 // ========================================================================== //
 // AstBinop
 // ========================================================================== //
@@ -344,10 +517,22 @@ typedef enum AstBinopKind
   kAstBinopMul,
   kAstBinopDiv,
   kAstBinopMod,
+  kAstBinopEq,
+  kAstBinopNe,
+  kAstBinopLt,
+  kAstBinopLe,
+  kAstBinopGt,
+  kAstBinopGe,
 } AstBinopKind;
 
 // -------------------------------------------------------------------------- //
 
+/* Returns whether binop is a comparison, which results in a 'bool' */
+bool
+ast_binop_kind_is_cmp(AstBinopKind kind);
+
+// -------------------------------------------------------------------------- //
+
 typedef struct AstBinop
 {
   /* Kind */
@@ -432,10 +617,113 @@ ast_const_to_u64(Ast* ast_const);
 
 // -------------------------------------------------------------------------- //
 
+/* Convert int or float const to its 'f64' value */
+f64
+ast_const_to_f64(Ast* ast_const);
+
+// -------------------------------------------------------------------------- //
+
 /* Dump */
 void
 ast_const_dump(Ast* ast, u32 indent);
 
+// ========================================================================== //
+// AstVar
+// ========================================================================== //
+
+/* Variable reference node */
+typedef struct AstVar
+{
+  /* Name */
+  Atom name;
+  /* Declaration (AstLet, AstParam or AstFor). Set by semantic analysis */
+  Ast* decl;
+} AstVar;
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+make_ast_var(Atom name);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_var(Ast* ast_var);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump */
+void
+ast_var_dump(Ast* ast, u32 indent);
+
+// ========================================================================== //
+// AstIndex
+// ========================================================================== //
+
+/* Index node, 'base[index]' where base is a pointer */
+typedef struct AstIndex
+{
+  /* Indexed pointer */
+  Ast* base;
+  /* Index */
+  Ast* index;
+} AstIndex;
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+make_ast_index(Ast* ast_base, Ast* ast_index);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_index(Ast* ast_index);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump */
+void
+ast_index_dump(Ast* ast, u32 indent);
+
+// ========================================================================== //
+// AstCall
+// ========================================================================== //
+
+/* Call node, 'name(args)' */
+typedef struct AstCall
+{
+  /* Name of the called function */
+  Atom name;
+  /* Span of the name */
+  Span name_span;
+  /* Arguments */
+  AstList args;
+  /* Called function (AstFn). Set by semantic analysis */
+  Ast* decl;
+} AstCall;
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+make_ast_call(Atom name);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_ast_call(Ast* ast_call);
+
+// -------------------------------------------------------------------------- //
+
+/* Add argument to call */
+void
+ast_call_add_arg(Ast* ast_call, Ast* ast_arg);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump */
+void
+ast_call_dump(Ast* ast, u32 indent);
+
 // ========================================================================== //
 // AstType
 // ========================================================================== //
@@ -474,6 +762,8 @@ typedef struct Ast
   Span span;
   /* Kind */
   AstKind kind;
+  /* Resolved type of expressions and declarations. Set by semantic analysis */
+  Type* res_type;
   union
   {
     /* Program */
@@ -488,10 +778,22 @@ typedef struct Ast
     AstLet let;
     /* Ret */
     AstRet ret;
+    /* While */
+    AstWhile while_loop;
+    /* For */
+    AstFor for_loop;
+    /* Assign */
+    AstAssign assign;
     /* Binop */
     AstBinop binop;
     /* Constant */
     AstConst constant;
+    /* Var */
+    AstVar var;
+    /* Index */
+    AstIndex index;
+    /* Call */
+    AstCall call;
     /* Type */
     AstType type;
   };
@@ -0,0 +1,357 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <string.h>
+#include <pthread.h>
+
+#include "atom.h"
+
+// ========================================================================== //
+// Layout
+// ========================================================================== //
+
+/* The table is split into shards that are locked independently, the shard is
+ * selected from the hash. An atom encodes the shard in its low bits and the
+ * (one-based) index within the shard in the remaining bits. Entry blocks are
+ * never moved, so atom text can be read without taking the shard lock.
+ *
+ * Atoms are reference counted. An atom without references stays valid until
+ * 'atoms_collect' frees it and its index is reused, which the LSP server does
+ * so that the identifiers of edited documents do not accumulate */
+
+#define kAtomShardBits 4
+#define kAtomShardCount (1u << kAtomShardBits)
+#define kAtomBlockSize 1024
+#define kAtomMaxBlocks 1024
+
+/* Shards are only collected once this many of their atoms, and a quarter of
+ * them, have no references */
+#define kAtomCollectMin 256
+
+// -------------------------------------------------------------------------- //
+
+/* Atom entry */
+typedef struct AtomEntry
+{
+  /* Text, null-terminated. NULL for free entries */
+  StrSlice text;
+  /* Hash of text */
+  u32 hash;
+  /* Number of references */
+  _Atomic u32 refs;
+  /* Next free entry (one-based), for free entries */
+  u32 next_free;
+} AtomEntry;
+
+// -------------------------------------------------------------------------- //
+
+/* Hash table slot */
+typedef struct AtomSlot
+{
+  /* Hash of text */
+  u32 hash;
+  /* Atom, kAtomNone for empty slots */
+  Atom atom;
+} AtomSlot;
+
+// -------------------------------------------------------------------------- //
+
+/* Table shard */
+typedef struct AtomShard
+{
+  /* Lock */
+  pthread_mutex_t lock;
+  /* Hash table */
+  AtomSlot* slots;
+  /* Hash table capacity (power of two) */
+  u32 slot_cap;
+  /* Number of entries, including free ones */
+  u32 count;
+  /* Number of atoms without references */
+  _Atomic u32 dead;
+  /* First free entry (one-based), 0 if there is none */
+  u32 free_head;
+  /* Entries, indexed by atom index */
+  AtomEntry* blocks[kAtomMaxBlocks];
+} AtomShard;
+
+// -------------------------------------------------------------------------- //
+
+static AtomShard s_atom_shards[kAtomShardCount];
+
+// ========================================================================== //
+// Util
+// ========================================================================== //
+
+/* FNV-1a */
+static u32
+atom_hash(const StrSlice* text)
+{
+  u32 hash = 2166136261u;
+  for (u32 i = 0; i < text->count; i++) {
+    hash ^= text->ptr[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// -------------------------------------------------------------------------- //
+
+static AtomShard*
+atom_shard(Atom atom)
+{
+  return &s_atom_shards[atom & (kAtomShardCount - 1)];
+}
+
+// -------------------------------------------------------------------------- //
+
+static AtomEntry*
+atom_shard_entry(AtomShard* shard, u32 index)
+{
+  return &shard->blocks[index / kAtomBlockSize][index % kAtomBlockSize];
+}
+
+// -------------------------------------------------------------------------- //
+
+static AtomEntry*
+atom_entry(Atom atom)
+{
+  return atom_shard_entry(atom_shard(atom), (atom >> kAtomShardBits) - 1);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Insert atom into the hash table of its shard. The lock must be held */
+static void
+atom_shard_insert(AtomShard* shard, u32 hash, Atom atom)
+{
+  u32 mask = shard->slot_cap - 1;
+  u32 pos = hash & mask;
+  while (shard->slots[pos].atom != kAtomNone) {
+    pos = (pos + 1) & mask;
+  }
+  shard->slots[pos] = (AtomSlot){ .hash = hash, .atom = atom };
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Rebuild the hash table from the entries that are in use, with capacity
+ * 'cap'. The lock must be held */
+static void
+atom_shard_rehash(AtomShard* shard, u32 cap)
+{
+  if (shard->slots) {
+    release(shard->slots);
+  }
+  shard->slots = alloc(sizeof(AtomSlot) * cap, kLnMinAlign);
+  shard->slot_cap = cap;
+  memset(shard->slots, 0, sizeof(AtomSlot) * cap);
+  u32 shard_index = (u32)(shard - s_atom_shards);
+  for (u32 i = 0; i < shard->count; i++) {
+    AtomEntry* entry = atom_shard_entry(shard, i);
+    if (entry->text.ptr) {
+      Atom atom = ((i + 1) << kAtomShardBits) | shard_index;
+      atom_shard_insert(shard, entry->hash, atom);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Free the atoms of a shard that have no references. The lock must be held */
+static void
+atom_shard_collect(AtomShard* shard)
+{
+  for (u32 i = 0; i < shard->count; i++) {
+    AtomEntry* entry = atom_shard_entry(shard, i);
+    if (entry->text.ptr && entry->refs == 0) {
+      release(entry->text.ptr);
+      entry->text = str_slice_null();
+      entry->next_free = shard->free_head;
+      shard->free_head = i + 1;
+    }
+  }
+  shard->dead = 0;
+  atom_shard_rehash(shard, shard->slot_cap);
+}
+
+// ========================================================================== //
+// Atom
+// ========================================================================== //
+
+void
+atoms_init()
+{
+  for (u32 i = 0; i < kAtomShardCount; i++) {
+    AtomShard* shard = &s_atom_shards[i];
+    memset(shard, 0, sizeof(AtomShard));
+    pthread_mutex_init(&shard->lock, NULL);
+    atom_shard_rehash(shard, 256);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+atoms_cleanup()
+{
+  for (u32 i = 0; i < kAtomShardCount; i++) {
+    AtomShard* shard = &s_atom_shards[i];
+    for (u32 e = 0; e < shard->count; e++) {
+      AtomEntry* entry = atom_shard_entry(shard, e);
+      if (entry->text.ptr) {
+        release(entry->text.ptr);
+      }
+    }
+    for (u32 b = 0; b < kAtomMaxBlocks && shard->blocks[b]; b++) {
+      release(shard->blocks[b]);
+    }
+    release(shard->slots);
+    pthread_mutex_destroy(&shard->lock);
+    memset(shard, 0, sizeof(AtomShard));
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+Atom
+atom_intern(const StrSlice* text)
+{
+  u32 hash = atom_hash(text);
+  u32 shard_index = (hash >> (32 - kAtomShardBits)) & (kAtomShardCount - 1);
+  AtomShard* shard = &s_atom_shards[shard_index];
+
+  mutex_lock(&shard->lock);
+
+  // Lookup
+  u32 mask = shard->slot_cap - 1;
+  u32 pos = hash & mask;
+  while (shard->slots[pos].atom != kAtomNone) {
+    AtomSlot slot = shard->slots[pos];
+    if (slot.hash == hash) {
+      AtomEntry* entry = atom_entry(slot.atom);
+      if (str_slice_eq(&entry->text, text)) {
+        if (entry->refs++ == 0) {
+          shard->dead--;
+        }
+        mutex_unlock(&shard->lock);
+        return slot.atom;
+      }
+    }
+    pos = (pos + 1) & mask;
+  }
+
+  // Entry, reusing a free one
+  u32 index;
+  if (shard->free_head) {
+    index = shard->free_head - 1;
+    shard->free_head = atom_shard_entry(shard, index)->next_free;
+  } else {
+    if (shard->count >= kAtomBlockSize * kAtomMaxBlocks) {
+      mutex_unlock(&shard->lock);
+      panic(make_str("Too many atoms in shard"));
+    }
+    index = shard->count++;
+    if (index % kAtomBlockSize == 0) {
+      shard->blocks[index / kAtomBlockSize] =
+        alloc(sizeof(AtomEntry) * kAtomBlockSize, kLnMinAlign);
+    }
+  }
+  u8* buf = alloc(text->count + 1, kLnMinAlign);
+  memcpy(buf, text->ptr, text->count);
+  buf[text->count] = 0;
+  AtomEntry* entry = atom_shard_entry(shard, index);
+  *entry = (AtomEntry){ .text = { .ptr = buf, .count = text->count },
+                        .hash = hash,
+                        .refs = 1 };
+
+  // Insert, keeping the load factor below 1/2
+  Atom atom = ((index + 1) << kAtomShardBits) | shard_index;
+  shard->slots[pos] = (AtomSlot){ .hash = hash, .atom = atom };
+  if (shard->count * 2 > shard->slot_cap) {
+    atom_shard_rehash(shard, shard->slot_cap * 2);
+  }
+
+  mutex_unlock(&shard->lock);
+  return atom;
+}
+
+// -------------------------------------------------------------------------- //
+
+Atom
+atom_retain(Atom atom)
+{
+  if (atom != kAtomNone) {
+    AtomShard* shard = atom_shard(atom);
+    mutex_lock(&shard->lock);
+    if (atom_entry(atom)->refs++ == 0) {
+      shard->dead--;
+    }
+    mutex_unlock(&shard->lock);
+  }
+  return atom;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+atom_release(Atom atom)
+{
+  if (atom != kAtomNone && --atom_entry(atom)->refs == 0) {
+    atom_shard(atom)->dead++;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+atom_size(Atom atom)
+{
+  return atom_entry(atom)->text.count + 1 + sizeof(AtomEntry) +
+         2 * sizeof(AtomSlot);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+atoms_collect()
+{
+  for (u32 i = 0; i < kAtomShardCount; i++) {
+    AtomShard* shard = &s_atom_shards[i];
+    u32 dead = shard->dead;
+    if (dead < kAtomCollectMin || dead * 4 < shard->count) {
+      continue;
+    }
+    mutex_lock(&shard->lock);
+    atom_shard_collect(shard);
+    mutex_unlock(&shard->lock);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+StrSlice
+atom_str(Atom atom)
+{
+  assrt(atom != kAtomNone, make_str("Invalid atom"));
+  return atom_entry(atom)->text;
+}
@@ -0,0 +1,94 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_ATOM_H
+#define LN_ATOM_H
+
+#include "common.h"
+#include "str.h"
+
+// ========================================================================== //
+// Atom
+// ========================================================================== //
+
+/* Interned identifier. Two identifiers with the same text always have the
+ * same atom, which means that they can be compared as integers */
+typedef u32 Atom;
+
+// -------------------------------------------------------------------------- //
+
+/* Invalid atom */
+#define kAtomNone 0
+
+// -------------------------------------------------------------------------- //
+
+/* Initialize the global atom table */
+void
+atoms_init();
+
+// -------------------------------------------------------------------------- //
+
+/* Cleanup the global atom table. Invalidates all atoms */
+void
+atoms_cleanup();
+
+// -------------------------------------------------------------------------- //
+
+/* Intern text and return its atom, with a reference that the caller owns.
+ * Thread-safe */
+Atom
+atom_intern(const StrSlice* text);
+
+// -------------------------------------------------------------------------- //
+
+/* Take another reference to an atom that has one. Thread-safe */
+Atom
+atom_retain(Atom atom);
+
+// -------------------------------------------------------------------------- //
+
+/* Release a reference. The atom stays valid until it is collected, so code
+ * that does not collect atoms does not need its own references. Thread-safe */
+void
+atom_release(Atom atom);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the memory in bytes that an atom keeps alive */
+u32
+atom_size(Atom atom);
+
+// -------------------------------------------------------------------------- //
+
+/* Free atoms without references, once enough of them have accumulated. Every
+ * atom that is still in use must then have a reference */
+void
+atoms_collect();
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the text of an atom. The text is owned by the atom table and is
+ * null-terminated */
+StrSlice
+atom_str(Atom atom);
+
+#endif // LN_ATOM_H
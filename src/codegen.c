@@ -0,0 +1,902 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Support.h>
+#include <llvm-c/Transforms/IPO.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
+
+#include "codegen.h"
+#include "llvm_c_ext.h"
+#include "llvm_util.h"
+
+// ========================================================================== //
+// Util
+// ========================================================================== //
+
+static void
+codegen_set_name(LLVMValueRef value, Atom name)
+{
+  // Constants are uniqued and cannot be named
+  if (name == kAtomNone || LLVMIsConstant(value)) {
+    return;
+  }
+  StrSlice str = atom_str(name);
+  LLVMSetValueName2(value, (const char*)str.ptr, str.count);
+}
+
+// ========================================================================== //
+// Inst
+// ========================================================================== //
+
+static LLVMValueRef
+codegen_const(Codegen* codegen, const MirInst* inst)
+{
+  Type* type = inst->type;
+  Type* elem_type = type_is_vector(type) ? type->vector.type : type;
+
+  // Strings
+  if (!type_is_int(elem_type) && !type_is_float(elem_type) &&
+      elem_type != get_type_bool()) {
+    Str str = str_slice_to_string(&inst->constant.str_val);
+    LLVMValueRef res =
+      LLVMBuildGlobalStringPtr(codegen->builder, str_cstr(&str), "");
+    release_str(&str);
+    return res;
+  }
+
+  // Numbers
+  LLVMTypeRef llvm_elem_type =
+    to_llvm_type_in_context(codegen->ctx, elem_type);
+  LLVMValueRef value;
+  if (type_is_float(elem_type)) {
+    value = LLVMConstReal(llvm_elem_type, inst->constant.float_val);
+  } else {
+    value = LLVMConstInt(llvm_elem_type, inst->constant.int_val, false);
+  }
+  if (!type_is_vector(type)) {
+    return value;
+  }
+
+  // Splat to all lanes
+  LLVMValueRef lanes[kTypeVectorMaxLen];
+  for (u32 i = 0; i < type->vector.len; i++) {
+    lanes[i] = value;
+  }
+  return LLVMConstVector(lanes, type->vector.len);
+}
+
+// -------------------------------------------------------------------------- //
+
+static LLVMValueRef
+codegen_binop(Codegen* codegen, const MirInst* inst)
+{
+  // Comparisons have a different result type, so use the operand type
+  Type* type = inst->binop.lhs->type;
+  LLVMValueRef lhs = codegen->values[inst->binop.lhs->id];
+  LLVMValueRef rhs = codegen->values[inst->binop.rhs->id];
+  if (inst->binop.no_wrap && inst->binop.kind == kAstBinopAdd) {
+    return type_is_signed(type)
+             ? LLVMBuildNSWAdd(codegen->builder, lhs, rhs, "")
+             : LLVMBuildNUWAdd(codegen->builder, lhs, rhs, "");
+  }
+  return llvm_build_binop(codegen->builder, inst->binop.kind, type, lhs, rhs);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Address of element 'index' of pointer */
+static LLVMValueRef
+codegen_elem_ptr(Codegen* codegen, const MirInst* ptr, const MirInst* index)
+{
+  // Indices are extended to the pointer width with their own signedness
+  LLVMTypeRef index_type =
+    LLVMIntPtrTypeInContext(codegen->ctx, codegen->target->data_layout);
+  LLVMValueRef llvm_index = LLVMBuildIntCast2(codegen->builder,
+                                              codegen->values[index->id],
+                                              index_type,
+                                              type_is_signed(index->type),
+                                              "");
+  return LLVMBuildInBoundsGEP(
+    codegen->builder, codegen->values[ptr->id], &llvm_index, 1, "");
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Call of function in the module, which declares every function that the
+ * MIR module declares or defines */
+static LLVMValueRef
+codegen_call(Codegen* codegen, const MirInst* inst)
+{
+  StrSlice name = atom_str(inst->call.fn);
+  LLVMValueRef fn =
+    LLVMGetNamedFunction(codegen->module, (const char*)name.ptr);
+  assrt(fn != NULL, make_str("Called function must be declared"));
+
+  u32 arg_cap = inst->call.count > 0 ? inst->call.count : 1;
+  LLVMValueRef* args = alloc(sizeof(LLVMValueRef) * arg_cap, kLnMinAlign);
+  for (u32 i = 0; i < inst->call.count; i++) {
+    args[i] = codegen->values[inst->call.args[i]->id];
+  }
+  LLVMValueRef call =
+    LLVMBuildCall(codegen->builder, fn, args, inst->call.count, "");
+  release(args);
+  return call;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Attach the loop attributes to the back edge of a loop */
+static void
+codegen_loop_hints(const MirLoop* loop, LLVMValueRef br)
+{
+  LLVMLoopHint hints[4];
+  u32 count = 0;
+  const AstLoopAttrs* attrs = &loop->attrs;
+  if (attrs->vectorize == kAstLoopHintEnable) {
+    hints[count++] = (LLVMLoopHint){ "llvm.loop.vectorize.enable",
+                                     LLVMLoopHintBool,
+                                     1 };
+    if (attrs->vectorize_width > 0) {
+      hints[count++] = (LLVMLoopHint){ "llvm.loop.vectorize.width",
+                                       LLVMLoopHintInt,
+                                       attrs->vectorize_width };
+    }
+  } else if (attrs->vectorize == kAstLoopHintDisable) {
+    hints[count++] = (LLVMLoopHint){ "llvm.loop.vectorize.enable",
+                                     LLVMLoopHintBool,
+                                     0 };
+  }
+
+  // Loops with a known trip count are unrolled completely when no count is
+  // given, like '#pragma unroll' in C
+  if (attrs->unroll == kAstLoopHintEnable) {
+    if (attrs->unroll_count > 0) {
+      hints[count++] = (LLVMLoopHint){ "llvm.loop.unroll.count",
+                                       LLVMLoopHintInt,
+                                       attrs->unroll_count };
+    } else if (loop->trip_count > 0) {
+      hints[count++] =
+        (LLVMLoopHint){ "llvm.loop.unroll.full", LLVMLoopHintFlag, 0 };
+    } else {
+      hints[count++] =
+        (LLVMLoopHint){ "llvm.loop.unroll.enable", LLVMLoopHintFlag, 0 };
+    }
+  } else if (attrs->unroll == kAstLoopHintDisable) {
+    hints[count++] =
+      (LLVMLoopHint){ "llvm.loop.unroll.disable", LLVMLoopHintFlag, 0 };
+  }
+
+  if (count > 0) {
+    LLVMSetLoopHints(br, hints, count);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static LLVMValueRef
+codegen_inst(Codegen* codegen, const MirInst* inst)
+{
+  LLVMValueRef* values = codegen->values;
+  switch (inst->op) {
+    case kMirOpConst: {
+      return codegen_const(codegen, inst);
+    }
+    case kMirOpBinop: {
+      return codegen_binop(codegen, inst);
+    }
+    case kMirOpCopy: {
+      return values[inst->copy->id];
+    }
+    case kMirOpPhi: {
+      // Incoming values are added when all blocks are generated
+      return LLVMBuildPhi(codegen->builder,
+                          to_llvm_type_in_context(codegen->ctx, inst->type),
+                          "");
+    }
+    case kMirOpUndef: {
+      return LLVMGetUndef(to_llvm_type_in_context(codegen->ctx, inst->type));
+    }
+    case kMirOpLoad: {
+      LLVMValueRef ptr =
+        codegen_elem_ptr(codegen, inst->load.ptr, inst->load.index);
+      return LLVMBuildLoad(codegen->builder, ptr, "");
+    }
+    case kMirOpStore: {
+      LLVMValueRef ptr =
+        codegen_elem_ptr(codegen, inst->store.ptr, inst->store.index);
+      return LLVMBuildStore(
+        codegen->builder, values[inst->store.value->id], ptr);
+    }
+    case kMirOpCall: {
+      return codegen_call(codegen, inst);
+    }
+    case kMirOpBr: {
+      LLVMValueRef br =
+        LLVMBuildBr(codegen->builder, codegen->blocks[inst->br.target->id]);
+      if (inst->br.loop) {
+        codegen_loop_hints(inst->br.loop, br);
+      }
+      return br;
+    }
+    case kMirOpCondBr: {
+      return LLVMBuildCondBr(codegen->builder,
+                             values[inst->cond_br.cond->id],
+                             codegen->blocks[inst->cond_br.then_block->id],
+                             codegen->blocks[inst->cond_br.else_block->id]);
+    }
+    case kMirOpRet: {
+      return LLVMBuildRet(codegen->builder, values[inst->ret->id]);
+    }
+    case kMirOpRetVoid: {
+      return LLVMBuildRetVoid(codegen->builder);
+    }
+    case kMirOpUnreachable: {
+      return LLVMBuildUnreachable(codegen->builder);
+    }
+    default: {
+      panic(make_str("Invalid MIR op (%u)"), inst->op);
+    }
+  }
+}
+
+// ========================================================================== //
+// Fn
+// ========================================================================== //
+
+static LLVMValueRef
+codegen_fn_decl(Codegen* codegen, const MirFn* mir_fn)
+{
+  // A function that is declared before it is defined is only added once
+  StrSlice name = atom_str(mir_fn->name);
+  LLVMValueRef fn =
+    LLVMGetNamedFunction(codegen->module, (const char*)name.ptr);
+  if (fn) {
+    return fn;
+  }
+
+  u32 param_count = mir_fn->param_count;
+  u32 param_cap = param_count > 0 ? param_count : 1;
+  LLVMTypeRef* param_types =
+    alloc(sizeof(LLVMTypeRef) * param_cap, kLnMinAlign);
+  for (u32 i = 0; i < param_count; i++) {
+    param_types[i] =
+      to_llvm_type_in_context(codegen->ctx, mir_fn->params[i]->type);
+  }
+  LLVMTypeRef ret_type =
+    to_llvm_type_in_context(codegen->ctx, mir_fn->ret_type);
+  LLVMTypeRef fn_type =
+    LLVMFunctionType(ret_type, param_types, param_count, false);
+  release(param_types);
+
+  fn = LLVMAddFunction(codegen->module, (const char*)name.ptr, fn_type);
+
+  // Size optimized builds mark functions so that every pass sees it
+  if (codegen->target->opt_level == kTargetOptSize) {
+    u32 kind = LLVMGetEnumAttributeKindForName("optsize", 7);
+    LLVMAttributeRef attr =
+      LLVMCreateEnumAttribute(codegen->ctx, kind, 0);
+    LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex, attr);
+  }
+  return fn;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+codegen_fn(Codegen* codegen, const MirFn* mir_fn, LLVMValueRef fn)
+{
+  if (mir_fn->is_decl) {
+    return;
+  }
+  u32 value_cap = mir_fn->value_count > 0 ? mir_fn->value_count : 1;
+  codegen->values = alloc(sizeof(LLVMValueRef) * value_cap, kLnMinAlign);
+
+  // Params
+  for (u32 i = 0; i < mir_fn->param_count; i++) {
+    const MirInst* param = mir_fn->params[i];
+    LLVMValueRef value = LLVMGetParam(fn, param->param_index);
+    codegen_set_name(value, param->name);
+    codegen->values[param->id] = value;
+  }
+
+  // Blocks are created first so that branches can target later blocks
+  u32 block_cap = mir_fn->block_count > 0 ? mir_fn->block_count : 1;
+  codegen->blocks =
+    alloc(sizeof(LLVMBasicBlockRef) * block_cap, kLnMinAlign);
+  for (MirBlock* block = mir_fn->first_block; block; block = block->next) {
+    codegen->blocks[block->id] = LLVMAppendBasicBlockInContext(
+      codegen->ctx, fn, block->id == 0 ? "entry" : "");
+  }
+
+  // Blocks are laid out so that values are generated before they are used,
+  // except for the operands of phis
+  for (MirBlock* block = mir_fn->first_block; block; block = block->next) {
+    LLVMPositionBuilderAtEnd(codegen->builder, codegen->blocks[block->id]);
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      LLVMValueRef value = codegen_inst(codegen, inst);
+      if (inst->op != kMirOpCopy) {
+        codegen_set_name(value, inst->name);
+      }
+      codegen->values[inst->id] = value;
+    }
+  }
+
+  // Phis
+  for (MirBlock* block = mir_fn->first_block; block; block = block->next) {
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      if (inst->op != kMirOpPhi) {
+        continue;
+      }
+      for (u32 i = 0; i < inst->phi.count; i++) {
+        LLVMValueRef value = codegen->values[inst->phi.values[i]->id];
+        LLVMBasicBlockRef pred = codegen->blocks[block->preds[i]->id];
+        LLVMAddIncoming(codegen->values[inst->id], &value, &pred, 1);
+      }
+    }
+  }
+
+  release(codegen->blocks);
+  codegen->blocks = NULL;
+  release(codegen->values);
+  codegen->values = NULL;
+}
+
+// ========================================================================== //
+// CodegenEmit
+// ========================================================================== //
+
+const char*
+codegen_emit_ext(CodegenEmit emit)
+{
+  switch (emit) {
+    case kCodegenEmitAsm: {
+      return ".s";
+    }
+    case kCodegenEmitBc: {
+      return ".bc";
+    }
+    case kCodegenEmitLl: {
+      return ".ll";
+    }
+    default: {
+      return ".o";
+    }
+  }
+}
+
+// ========================================================================== //
+// Codegen
+// ========================================================================== //
+
+/* Report diagnostics instead of letting LLVM exit the process on errors,
+ * failures are then returned from the call that caused them */
+static void
+codegen_diag_handler(LLVMDiagnosticInfoRef info, void* data)
+{
+  LN_UNUSED(data);
+  LLVMDiagnosticSeverity severity = LLVMGetDiagInfoSeverity(info);
+  if (severity != LLVMDSError && severity != LLVMDSWarning) {
+    return;
+  }
+  char* desc = LLVMGetDiagInfoDescription(info);
+  printf("%s: %s\n", severity == LLVMDSError ? "Error" : "Warning", desc);
+  LLVMDisposeMessage(desc);
+}
+
+// -------------------------------------------------------------------------- //
+
+Codegen
+make_codegen(const Target* target, const Str* name)
+{
+  LLVMContextRef ctx = LLVMContextCreate();
+  LLVMContextSetDiagnosticHandler(ctx, codegen_diag_handler, NULL);
+  LLVMModuleRef module =
+    LLVMModuleCreateWithNameInContext(str_cstr(name), ctx);
+  LLVMSetTarget(module, LLVMTripleGetTriple(target->triple));
+  LLVMSetModuleDataLayout(module, target->data_layout);
+
+  return (Codegen){ .target = target,
+                    .ctx = ctx,
+                    .module = module,
+                    .builder = LLVMCreateBuilderInContext(ctx),
+                    .values = NULL,
+                    .blocks = NULL };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_codegen(Codegen* codegen)
+{
+  LLVMDisposeBuilder(codegen->builder);
+  LLVMDisposeModule(codegen->module);
+  LLVMContextDispose(codegen->ctx);
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+codegen_gen_mir(Codegen* codegen,
+                const MirModule* module,
+                const u32* fn_units,
+                u32 unit)
+{
+  // Declare all functions first so that they can be referenced in any order
+  u32 fn_cap = module->fn_count > 0 ? module->fn_count : 1;
+  LLVMValueRef* fns = alloc(sizeof(LLVMValueRef) * fn_cap, kLnMinAlign);
+  for (u32 i = 0; i < module->fn_count; i++) {
+    fns[i] = codegen_fn_decl(codegen, module->fns[i]);
+  }
+  for (u32 i = 0; i < module->fn_count; i++) {
+    if (!fn_units || fn_units[i] == unit) {
+      codegen_fn(codegen, module->fns[i], fns[i]);
+    }
+  }
+  release(fns);
+
+  // Verify
+  char* error = NULL;
+  if (LLVMVerifyModule(codegen->module, LLVMReturnStatusAction, &error)) {
+    printf("Generated module is not valid:\n%s\n", error);
+    LLVMDisposeMessage(error);
+    return kCodegenInvalidModule;
+  }
+  LLVMDisposeMessage(error);
+  return kCodegenNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+codegen_optimize(Codegen* codegen)
+{
+  TargetOptLevel opt_level = codegen->target->opt_level;
+  if (opt_level == kTargetOpt0) {
+    return;
+  }
+
+  // Pipeline, matching the inliner thresholds of clang
+  LLVMPassManagerBuilderRef builder = LLVMPassManagerBuilderCreate();
+  switch (opt_level) {
+    case kTargetOpt1: {
+      LLVMPassManagerBuilderSetOptLevel(builder, 1);
+      break;
+    }
+    case kTargetOpt2: {
+      LLVMPassManagerBuilderSetOptLevel(builder, 2);
+      LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 225);
+      break;
+    }
+    case kTargetOpt3: {
+      LLVMPassManagerBuilderSetOptLevel(builder, 3);
+      LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 275);
+      break;
+    }
+    default: {
+      LLVMPassManagerBuilderSetOptLevel(builder, 2);
+      LLVMPassManagerBuilderSetSizeLevel(builder, 1);
+      LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 75);
+      break;
+    }
+  }
+
+  // Profile-guided optimization
+  if (codegen->target->pgo_gen) {
+    LLVMPassManagerBuilderSetPGOInstrGen(builder, "");
+  }
+  if (codegen->target->pgo_use) {
+    LLVMPassManagerBuilderSetPGOInstrUse(builder, codegen->target->pgo_use);
+  }
+
+  // Function passes
+  LLVMPassManagerRef fn_passes =
+    LLVMCreateFunctionPassManagerForModule(codegen->module);
+  LLVMAddAnalysisPasses(codegen->target->machine, fn_passes);
+  LLVMPassManagerBuilderPopulateFunctionPassManager(builder, fn_passes);
+  LLVMInitializeFunctionPassManager(fn_passes);
+  for (LLVMValueRef fn = LLVMGetFirstFunction(codegen->module); fn;
+       fn = LLVMGetNextFunction(fn)) {
+    LLVMRunFunctionPassManager(fn_passes, fn);
+  }
+  LLVMFinalizeFunctionPassManager(fn_passes);
+
+  // Module passes
+  LLVMPassManagerRef module_passes = LLVMCreatePassManager();
+  LLVMAddAnalysisPasses(codegen->target->machine, module_passes);
+  if (opt_level == kTargetOpt1) {
+    LLVMAddAlwaysInlinerPass(module_passes);
+  }
+  LLVMPassManagerBuilderPopulateModulePassManager(builder, module_passes);
+  LLVMRunPassManager(module_passes, codegen->module);
+
+  LLVMDisposePassManager(module_passes);
+  LLVMDisposePassManager(fn_passes);
+  LLVMPassManagerBuilderDispose(builder);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse bitcode in buffer and link it into module of codegen. Takes
+ * ownership of the buffer */
+static CodegenErr
+codegen_link_buf(Codegen* codegen, LLVMMemoryBufferRef buf, const char* name)
+{
+  LLVMModuleRef module;
+  LLVMBool failed = LLVMParseBitcodeInContext2(codegen->ctx, buf, &module);
+  LLVMDisposeMemoryBuffer(buf);
+  if (failed) {
+    printf("Failed to read bitcode of '%s'\n", name);
+    return kCodegenLinkErr;
+  }
+
+  // Source module is destroyed by the linker
+  if (LLVMLinkModules2(codegen->module, module)) {
+    printf("Failed to link '%s'\n", name);
+    return kCodegenLinkErr;
+  }
+  return kCodegenNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+codegen_link(Codegen* codegen, Codegen* other)
+{
+  size_t name_size;
+  const char* name = LLVMGetModuleIdentifier(other->module, &name_size);
+  LLVMMemoryBufferRef buf = LLVMWriteBitcodeToMemoryBuffer(other->module);
+  return codegen_link_buf(codegen, buf, name);
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+codegen_link_bc(Codegen* codegen, const Str* path)
+{
+  LLVMMemoryBufferRef buf;
+  char* error = NULL;
+  if (LLVMCreateMemoryBufferWithContentsOfFile(str_cstr(path), &buf, &error)) {
+    printf("Failed to read '%s' (%s)\n", str_cstr(path), error);
+    LLVMDisposeMessage(error);
+    return kCodegenLinkErr;
+  }
+  return codegen_link_buf(codegen, buf, str_cstr(path));
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+codegen_emit(Codegen* codegen, CodegenEmit emit, const Str* path)
+{
+  char* cpath = (char*)str_cstr(path);
+  char* error = NULL;
+  LLVMBool failed;
+  switch (emit) {
+    case kCodegenEmitBc: {
+      failed = LLVMWriteBitcodeToFile(codegen->module, cpath) != 0;
+      break;
+    }
+    case kCodegenEmitLl: {
+      failed = LLVMPrintModuleToFile(codegen->module, cpath, &error);
+      break;
+    }
+    default: {
+      LLVMCodeGenFileType type =
+        emit == kCodegenEmitAsm ? LLVMAssemblyFile : LLVMObjectFile;
+      failed = LLVMTargetMachineEmitToFile(
+        codegen->target->machine, codegen->module, cpath, type, &error);
+      break;
+    }
+  }
+
+  if (failed) {
+    printf("Failed to emit '%s' (%s)\n",
+           cpath,
+           error ? error : "Failed to write file");
+    LLVMDisposeMessage(error);
+    return kCodegenEmitErr;
+  }
+  return kCodegenNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+codegen_run(Codegen* codegen, s32* p_result)
+{
+  LLVMValueRef main_fn = LLVMGetNamedFunction(codegen->module, "main");
+  if (!main_fn || LLVMCountBasicBlocks(main_fn) == 0) {
+    printf("Cannot run module without a 'main' function\n");
+    return kCodegenNoMain;
+  }
+  LLVMTypeRef ret_type = LLVMGetReturnType(LLVMGlobalGetValueType(main_fn));
+  if (LLVMCountParams(main_fn) != 0 ||
+      (LLVMGetTypeKind(ret_type) != LLVMVoidTypeKind &&
+       LLVMGetTypeKind(ret_type) != LLVMIntegerTypeKind)) {
+    printf("Cannot run 'main', it must not take any parameters and must "
+           "return nothing or an integer\n");
+    return kCodegenNoMain;
+  }
+
+  // Declared functions are resolved in the process, such as those of the C
+  // library. Any other function is defined in a file that was not linked
+  LLVMLoadLibraryPermanently(NULL);
+  for (LLVMValueRef fn = LLVMGetFirstFunction(codegen->module); fn;
+       fn = LLVMGetNextFunction(fn)) {
+    if (!LLVMIsDeclaration(fn) || LLVMGetIntrinsicID(fn) != 0) {
+      continue;
+    }
+    const char* name = LLVMGetValueName(fn);
+    if (!LLVMSearchForAddressOfSymbol(name)) {
+      printf("Cannot run module, function '%s' is declared but not "
+             "defined. Link the file that defines it with '--lto'\n",
+             name);
+      return kCodegenUndefFn;
+    }
+  }
+
+  // The engine owns the module while it exists
+  struct LLVMMCJITCompilerOptions options;
+  LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
+  options.OptLevel = codegen->target->opt_level == kTargetOptSize
+                       ? 2
+                       : (u32)codegen->target->opt_level;
+  LLVMExecutionEngineRef engine;
+  char* error = NULL;
+  if (LLVMCreateMCJITCompilerForModule(
+        &engine, codegen->module, &options, sizeof(options), &error)) {
+    printf("Failed to create JIT (%s)\n", error);
+    LLVMDisposeMessage(error);
+    return kCodegenJitErr;
+  }
+
+  // Run
+  u64 addr = LLVMGetFunctionAddress(engine, "main");
+  fflush(stdout);
+  s32 result = 0;
+  if (LLVMGetTypeKind(ret_type) == LLVMVoidTypeKind) {
+    ((void (*)(void))(uintptr_t)addr)();
+  } else if (LLVMGetIntTypeWidth(ret_type) <= 32) {
+    result = ((s32(*)(void))(uintptr_t)addr)();
+  } else {
+    result = (s32)((s64(*)(void))(uintptr_t)addr)();
+  }
+
+  // Take the module back so that it is released with the codegen context
+  LLVMModuleRef module;
+  LLVMRemoveModule(engine, codegen->module, &module, &error);
+  LLVMDisposeExecutionEngine(engine);
+  *p_result = result;
+  return kCodegenNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+codegen_dump(Codegen* codegen)
+{
+  char* ir = LLVMPrintModuleToString(codegen->module);
+  printf("[LLVM IR]\n%s", ir);
+  LLVMDisposeMessage(ir);
+}
+
+// ========================================================================== //
+// CodegenUnit
+// ========================================================================== //
+
+/* State of one codegen unit */
+typedef struct CodegenUnit
+{
+  /* Options */
+  const CodegenOpts* opts;
+  /* Module */
+  const MirModule* mir;
+  /* Unit of each function */
+  const u32* fn_units;
+  /* Index */
+  u32 index;
+  /* Target of all units except the first, acquired from the registry */
+  Target* target;
+  /* Output file path */
+  Str path;
+  /* Codegen context */
+  Codegen codegen;
+  /* Result */
+  CodegenErr err;
+  /* Thread */
+  pthread_t thread;
+} CodegenUnit;
+
+// -------------------------------------------------------------------------- //
+
+/* Function with its estimated codegen cost */
+typedef struct CodegenFnCost
+{
+  u32 fn;
+  u32 cost;
+} CodegenFnCost;
+
+// -------------------------------------------------------------------------- //
+
+static int
+codegen_fn_cost_cmp(const void* lhs, const void* rhs)
+{
+  const CodegenFnCost* a = lhs;
+  const CodegenFnCost* b = rhs;
+  if (a->cost != b->cost) {
+    return a->cost > b->cost ? -1 : 1;
+  }
+  return a->fn < b->fn ? -1 : (a->fn > b->fn ? 1 : 0);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Assign functions to units, largest first to the least loaded unit. The
+ * number of MIR values is used as cost */
+static void
+codegen_partition(const MirModule* module, u32 unit_count, u32* fn_units)
+{
+  CodegenFnCost* costs =
+    alloc(sizeof(CodegenFnCost) * module->fn_count, kLnMinAlign);
+  for (u32 i = 0; i < module->fn_count; i++) {
+    costs[i] =
+      (CodegenFnCost){ .fn = i, .cost = module->fns[i]->value_count + 1 };
+  }
+  qsort(costs, module->fn_count, sizeof(CodegenFnCost), codegen_fn_cost_cmp);
+
+  u64* loads = alloc(sizeof(u64) * unit_count, kLnMinAlign);
+  memset(loads, 0, sizeof(u64) * unit_count);
+  for (u32 i = 0; i < module->fn_count; i++) {
+    u32 unit = 0;
+    for (u32 j = 1; j < unit_count; j++) {
+      if (loads[j] < loads[unit]) {
+        unit = j;
+      }
+    }
+    fn_units[costs[i].fn] = unit;
+    loads[unit] += costs[i].cost;
+  }
+
+  release(loads);
+  release(costs);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Output file path of unit. With several units the index is inserted
+ * before the extension, 'a.o' becomes 'a.0.o', 'a.1.o', ... */
+static Str
+codegen_unit_path(const Str* path, u32 index, u32 unit_count)
+{
+  if (unit_count == 1) {
+    return str_copy(path);
+  }
+  const char* cstr = str_cstr(path);
+  const char* name = strrchr(cstr, '/');
+  name = name ? name + 1 : cstr;
+  const char* ext = strrchr(name, '.');
+  u32 stem_size = ext ? (u32)(ext - cstr) : path->size;
+  return str_format(make_str("%.*s.%u%s"),
+                    stem_size,
+                    cstr,
+                    index,
+                    ext ? ext : "");
+}
+
+// -------------------------------------------------------------------------- //
+
+static void*
+codegen_unit_run(void* data)
+{
+  CodegenUnit* unit = data;
+  const CodegenOpts* opts = unit->opts;
+
+  // The first unit uses the target of the caller
+  const Target* target = opts->target;
+  if (unit->index > 0) {
+    TargetErr target_err =
+      target_registry_acquire(opts->target_opts, &unit->target);
+    assrt(target_err == kTargetNoErr,
+          make_str("Target of codegen unit must be valid"));
+    target = unit->target;
+  }
+
+  unit->codegen = make_codegen(target, opts->name);
+  unit->err =
+    codegen_gen_mir(&unit->codegen, unit->mir, unit->fn_units, unit->index);
+  if (unit->err == kCodegenNoErr) {
+    codegen_optimize(&unit->codegen);
+    unit->err = codegen_emit(&unit->codegen, opts->emit, &unit->path);
+  }
+  return NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+codegen_emit_units(const MirModule* module, const CodegenOpts* opts)
+{
+  // Never more units than functions
+  u32 unit_count = opts->unit_count;
+  if (unit_count > module->fn_count) {
+    unit_count = module->fn_count;
+  }
+  if (unit_count == 0) {
+    unit_count = 1;
+  }
+
+  u32 fn_cap = module->fn_count > 0 ? module->fn_count : 1;
+  u32* fn_units = alloc(sizeof(u32) * fn_cap, kLnMinAlign);
+  codegen_partition(module, unit_count, fn_units);
+
+  // Units. The first one runs on the calling thread
+  CodegenUnit* units = alloc(sizeof(CodegenUnit) * unit_count, kLnMinAlign);
+  for (u32 i = 0; i < unit_count; i++) {
+    units[i] = (CodegenUnit){ .opts = opts,
+                              .mir = module,
+                              .fn_units = fn_units,
+                              .index = i,
+                              .path =
+                                codegen_unit_path(opts->path, i, unit_count),
+                              .err = kCodegenNoErr };
+  }
+  for (u32 i = 1; i < unit_count; i++) {
+    int res =
+      pthread_create(&units[i].thread, NULL, codegen_unit_run, &units[i]);
+    assrt(res == 0, make_str("Failed to create codegen thread"));
+  }
+  codegen_unit_run(&units[0]);
+  for (u32 i = 1; i < unit_count; i++) {
+    pthread_join(units[i].thread, NULL);
+  }
+
+  // Dump in unit order after all threads are done
+  CodegenErr err = kCodegenNoErr;
+  for (u32 i = 0; i < unit_count; i++) {
+    if (opts->dump) {
+      codegen_dump(&units[i].codegen);
+    }
+    if (units[i].err != kCodegenNoErr) {
+      err = units[i].err;
+    }
+    release_codegen(&units[i].codegen);
+    if (i > 0) {
+      target_registry_release(units[i].target);
+    }
+    release_str(&units[i].path);
+  }
+
+  release(units);
+  release(fn_units);
+  return err;
+}
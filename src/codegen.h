@@ -1,84 +1,194 @@
-/*
-
-
-#include <stdlib.h>
-#include <stdbool.h>
-#include <stdio.h>
-
-#include <llvm-c/Core.h>
-#include <llvm-c/Target.h>
-#include <llvm-c/Initialization.h>
-#include <llvm-c/TargetMachine.h>
-#include <llvm-c/Support.h>
-#include <llvm-c/Analysis.h>
-
-int
-main()
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_CODEGEN_H
+#define LN_CODEGEN_H
+
+#include "common.h"
+#include "mir.h"
+#include "target.h"
+
+// ========================================================================== //
+// CodegenErr
+// ========================================================================== //
+
+/* Code generation errors */
+typedef enum CodegenErr
+{
+  /* No error */
+  kCodegenNoErr,
+  /* Generated module failed verification */
+  kCodegenInvalidModule,
+  /* Failed to emit output file */
+  kCodegenEmitErr,
+  /* Failed to create JIT */
+  kCodegenJitErr,
+  /* Module has no 'main' function to run */
+  kCodegenNoMain,
+  /* Failed to read or link bitcode */
+  kCodegenLinkErr,
+  /* Module to run declares a function that is defined nowhere */
+  kCodegenUndefFn,
+} CodegenErr;
+
+// ========================================================================== //
+// CodegenEmit
+// ========================================================================== //
+
+/* Kinds of output files */
+typedef enum CodegenEmit
+{
+  /* Object file */
+  kCodegenEmitObj,
+  /* Assembly */
+  kCodegenEmitAsm,
+  /* LLVM bitcode */
+  kCodegenEmitBc,
+  /* LLVM IR in text form */
+  kCodegenEmitLl,
+} CodegenEmit;
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the file extension, including the dot, for output kind */
+const char*
+codegen_emit_ext(CodegenEmit emit);
+
+// ========================================================================== //
+// Codegen
+// ========================================================================== //
+
+/* Code generation context. Lowers MIR to an LLVM module in a context of its
+ * own, so several contexts can generate code in parallel */
+typedef struct Codegen
+{
+  /* Target */
+  const Target* target;
+  /* Context that owns the module */
+  LLVMContextRef ctx;
+  /* Module */
+  LLVMModuleRef module;
+  /* Builder */
+  LLVMBuilderRef builder;
+  /* Values of the function being generated, indexed by MIR value number */
+  LLVMValueRef* values;
+  /* Blocks of the function being generated, indexed by MIR block number */
+  LLVMBasicBlockRef* blocks;
+} Codegen;
+
+// -------------------------------------------------------------------------- //
+
+/* Make codegen context for module with name */
+Codegen
+make_codegen(const Target* target, const Str* name);
+
+// -------------------------------------------------------------------------- //
+
+/* Release codegen context and its module */
+void
+release_codegen(Codegen* codegen);
+
+// -------------------------------------------------------------------------- //
+
+/* Generate code for the functions of MIR module that are assigned to 'unit'
+ * in 'fn_units', all other functions are only declared. 'fn_units' can be
+ * NULL to generate code for every function */
+CodegenErr
+codegen_gen_mir(Codegen* codegen,
+                const MirModule* module,
+                const u32* fn_units,
+                u32 unit);
+
+// -------------------------------------------------------------------------- //
+
+/* Run the LLVM optimization pipeline for the optimization level of the
+ * target on module */
+void
+codegen_optimize(Codegen* codegen);
+
+// -------------------------------------------------------------------------- //
+
+/* Link the module of 'other' into the module of codegen. The modules live
+ * in different contexts so the module is moved over as bitcode, 'other' is
+ * left unchanged */
+CodegenErr
+codegen_link(Codegen* codegen, Codegen* other);
+
+// -------------------------------------------------------------------------- //
+
+/* Link the bitcode file at path into the module of codegen */
+CodegenErr
+codegen_link_bc(Codegen* codegen, const Str* path);
+
+// -------------------------------------------------------------------------- //
+
+/* Emit module as output file of kind at path */
+CodegenErr
+codegen_emit(Codegen* codegen, CodegenEmit emit, const Str* path);
+
+// -------------------------------------------------------------------------- //
+
+/* JIT-compile module and call its 'main' function in-process. The value
+ * returned by 'main', or 0 if it does not return a value, is returned in
+ * 'p_result' */
+CodegenErr
+codegen_run(Codegen* codegen, s32* p_result);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump LLVM IR of module */
+void
+codegen_dump(Codegen* codegen);
+
+// ========================================================================== //
+// CodegenUnits
+// ========================================================================== //
+
+/* Options for generating code in several units */
+typedef struct CodegenOpts
 {
-  // Init
-  LLVMInitializeAllTargets();
-  LLVMInitializeAllTargetInfos();
-  LLVMInitializeAllTargetMCs();
-  LLVMInitializeAllAsmPrinters();
-  LLVMInitializeAllAsmParsers();
-
-  // Context
-  LLVMModuleRef module = LLVMModuleCreateWithName("my_module");
-  LLVMBuilderRef builder = LLVMCreateBuilder();
-
-  const char* targetTriple = LLVMGetDefaultTargetTriple();
-  LLVMTargetRef target;
-  char* error = NULL;
-  bool success = !LLVMGetTargetFromTriple(targetTriple, &target, &error);
-  if (!success) {
-    printf("Failed to create target (%s)\n", error);
-    return -1;
-  }
-  LLVMTargetMachineRef targetMachine =
-    LLVMCreateTargetMachine(target,
-                            targetTriple,
-                            "generic",
-                            "",
-                            LLVMCodeGenLevelDefault,
-                            LLVMRelocDefault,
-                            LLVMCodeModelDefault);
-
-  // Function
-  LLVMTypeRef paramTypes[] = { LLVMInt32Type(), LLVMInt32Type() };
-  LLVMTypeRef funType = LLVMFunctionType(LLVMInt32Type(), paramTypes, 2, 0);
-  LLVMValueRef fun = LLVMAddFunction(module, "mul", funType);
-
-  // Code
-  LLVMBasicBlockRef entryBlock = LLVMAppendBasicBlock(fun, "entry");
-  LLVMPositionBuilderAtEnd(builder, entryBlock);
-
-  LLVMValueRef tmp0 =
-    LLVMBuildMul(builder, LLVMGetParam(fun, 0), LLVMGetParam(fun, 1), "tmp0");
-  LLVMBuildRet(builder, tmp0);
-
-  // Verify
-  error = NULL;
-  success = !LLVMVerifyModule(module, LLVMAbortProcessAction, &error);
-  if (!success) {
-    printf("Module is not valid\n");
-    return -2;
-  }
-
-  // Emit
-  error = NULL;
-  success = !LLVMTargetMachineEmitToFile(
-    targetMachine, module, "my_mod.o", LLVMObjectFile, &error);
-  if (!success) {
-    printf("Failed to write object file\n");
-    return -3;
-  }
-
-  // Done
-  int i = 0;
-  return 0;
-}
-
-
-
-
- */
\ No newline at end of file
+  /* Target of the first unit */
+  const Target* target;
+  /* Options that the other units create their targets from */
+  const TargetOpts* target_opts;
+  /* Module name */
+  const Str* name;
+  /* Output file path */
+  const Str* path;
+  /* Output file kind */
+  CodegenEmit emit;
+  /* Number of codegen units */
+  u32 unit_count;
+  /* Dump the LLVM IR of every unit */
+  bool dump;
+} CodegenOpts;
+
+// -------------------------------------------------------------------------- //
+
+/* Partition the functions of module into codegen units, then generate,
+ * optimize and emit each unit on its own thread. With more than one unit
+ * each unit is emitted as a separate output file, with the unit index
+ * inserted before the extension of the path */
+CodegenErr
+codegen_emit_units(const MirModule* module, const CodegenOpts* opts);
+
+#endif // LN_CODEGEN_H
@@ -21,6 +21,10 @@
 // SOFTWARE.
 
 #include <mimalloc.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "common.h"
 #include "str.h"
@@ -29,6 +33,21 @@
 // Assert
 // ========================================================================== //
 
+LN_CONST(kPanicAltStackSize, 64 * 1024)
+
+/* Recovery point of the thread, see 'panic_set_recover' */
+static _Thread_local sigjmp_buf* s_panic_recover;
+
+/* Number of locks that the thread holds, see 'mutex_lock' */
+static _Thread_local u32 s_panic_lock_depth;
+
+static _Thread_local u8 s_panic_alt_stack[kPanicAltStackSize];
+static _Thread_local bool s_panic_alt_stack_set;
+
+static _Atomic u64 s_panic_recovered;
+
+// -------------------------------------------------------------------------- //
+
 void
 assrt(bool cond, Str fmt, ...)
 {
@@ -69,22 +88,110 @@ panic_v(Str fmt, va_list args)
   Str msg = str_format_v(fmt, args);
   fprintf(stderr, "Program panicked: %s\n", str_cstr(&msg));
   fflush(stderr);
+  if (s_panic_recover && s_panic_lock_depth == 0) {
+    s_panic_recovered++;
+    siglongjmp(*s_panic_recover, 1);
+  }
   quick_exit(-1);
 }
 
+// -------------------------------------------------------------------------- //
+
+/* Jumps to the recovery point of the faulting thread. Without one, or while
+ * the thread holds a lock, the default action is restored and the faulting
+ * instruction runs again */
+static void
+panic_fault_handler(int sig)
+{
+  if (s_panic_recover && s_panic_lock_depth == 0) {
+    s_panic_recovered++;
+    siglongjmp(*s_panic_recover, 1);
+  }
+  signal(sig, SIG_DFL);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+panic_fault_install()
+{
+  const int sigs[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL };
+  struct sigaction action = { 0 };
+  action.sa_handler = panic_fault_handler;
+  action.sa_flags = SA_ONSTACK;
+  sigemptyset(&action.sa_mask);
+  for (u32 i = 0; i < sizeof(sigs) / sizeof(sigs[0]); i++) {
+    sigaction(sigs[i], &action, NULL);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+panic_set_recover(sigjmp_buf* env)
+{
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, panic_fault_install);
+
+  // Stack overflows are faults too, so the handler needs a stack of its own.
+  // A stack that the thread already has, such as one of a sanitizer, is kept
+  if (env && !s_panic_alt_stack_set) {
+    stack_t stack;
+    if (sigaltstack(NULL, &stack) == 0 && (stack.ss_flags & SS_DISABLE)) {
+      stack = (stack_t){ .ss_sp = s_panic_alt_stack,
+                         .ss_size = sizeof(s_panic_alt_stack) };
+      sigaltstack(&stack, NULL);
+    }
+    s_panic_alt_stack_set = true;
+  }
+  s_panic_recover = env;
+}
+
+// -------------------------------------------------------------------------- //
+
+u64
+panic_recovered()
+{
+  return s_panic_recovered;
+}
+
+// ========================================================================== //
+// Mutex
+// ========================================================================== //
+
+void
+mutex_lock(pthread_mutex_t* mutex)
+{
+  pthread_mutex_lock(mutex);
+  s_panic_lock_depth++;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mutex_unlock(pthread_mutex_t* mutex)
+{
+  s_panic_lock_depth--;
+  pthread_mutex_unlock(mutex);
+}
+
 // ========================================================================== //
 // Mem
 // ========================================================================== //
 
-static u64 s_mem_usage;
+/* Updated from every thread that allocates */
+static _Atomic u64 s_mem_usage;
 
 // -------------------------------------------------------------------------- //
 
+/* The allocator may hold locks of its own, so it counts as holding one */
 void*
 alloc(u64 size, u64 align)
 {
+  s_panic_lock_depth++;
   void* mem = mi_malloc_aligned(size, align);
   s_mem_usage += mi_usable_size(mem);
+  s_panic_lock_depth--;
   return mem;
 }
 
@@ -93,8 +200,10 @@ alloc(u64 size, u64 align)
 void
 release(void* mem)
 {
+  s_panic_lock_depth++;
   s_mem_usage -= mi_usable_size(mem);
   mi_free(mem);
+  s_panic_lock_depth--;
 }
 
 // -------------------------------------------------------------------------- //
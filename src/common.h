@@ -27,6 +27,8 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <setjmp.h>
+#include <pthread.h>
 
 typedef struct Str Str;
 
@@ -44,7 +46,9 @@ typedef struct Str Str;
 #define LN_CHECK_LEAK()                                                        \
   do {                                                                         \
     assrt(                                                                     \
-      mem_usage() == 0, make_str("Leaking memory (%u bytes)"), mem_usage());   \
+      mem_usage() == 0 || panic_recovered() > 0,                               \
+      make_str("Leaking memory (%u bytes)"),                                   \
+      mem_usage());                                                            \
   } while (0)
 
 // -------------------------------------------------------------------------- //
@@ -116,6 +120,36 @@ panic(Str fmt, ...);
 LN_NORET void
 panic_v(Str fmt, va_list args);
 
+// -------------------------------------------------------------------------- //
+
+/* Makes panics and faults (SIGSEGV, SIGBUS, SIGFPE, SIGILL) of the calling
+ * thread jump to 'env', set with 'sigsetjmp(env, 1)', instead of ending the
+ * program. A NULL 'env' restores the default. Whatever the interrupted code
+ * had allocated is leaked. Panics and faults while the thread holds a lock
+ * still end the program */
+void
+panic_set_recover(sigjmp_buf* env);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the number of panics and faults recovered from */
+u64
+panic_recovered();
+
+// ========================================================================== //
+// Mutex
+// ========================================================================== //
+
+/* Lock mutex. Locks are taken through this, so that a panic or fault while
+ * one is held is not recovered from with the lock left held */
+void
+mutex_lock(pthread_mutex_t* mutex);
+
+// -------------------------------------------------------------------------- //
+
+void
+mutex_unlock(pthread_mutex_t* mutex);
+
 // ========================================================================== //
 // Mem
 // ========================================================================== //
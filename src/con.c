@@ -42,7 +42,7 @@ con_cprintln(const char* fmt, ...)
 void
 con_cprintln_v(const char* fmt, va_list args)
 {
-  con_println_v(&make_str(fmt), args);
+  con_println_v(&make_str_cstr(fmt), args);
 }
 
 // -------------------------------------------------------------------------- //
@@ -64,6 +64,10 @@ make_err_list()
 void
 release_err_list(ErrList* list)
 {
+  for (u32 i = 0; i < list->len; i++) {
+    release_str(&list->buf[i].msg);
+    release_str(&list->buf[i].sugg);
+  }
   release(list->buf);
 }
 
@@ -90,6 +94,7 @@ err_list_remove(ErrList* list, u32 index)
   memmove(list->buf + index,
           list->buf + index + 1,
           sizeof(Err) * (list->len - index - 1));
+  list->len--;
   return err;
 }
 
@@ -134,6 +139,15 @@ err_num_to_str(ErrNum num)
   switch (num) {
     LN_ERR_NUM_STR_CASE(kErrNumNone)
     LN_ERR_NUM_STR_CASE(kErrNumUnexpTok)
+    LN_ERR_NUM_STR_CASE(kErrNumUndefIdent)
+    LN_ERR_NUM_STR_CASE(kErrNumTypeMismatch)
+    LN_ERR_NUM_STR_CASE(kErrNumNoTypeInfer)
+    LN_ERR_NUM_STR_CASE(kErrNumInvalidOp)
+    LN_ERR_NUM_STR_CASE(kErrNumAssignImmut)
+    LN_ERR_NUM_STR_CASE(kErrNumNonTermStr)
+    LN_ERR_NUM_STR_CASE(kErrNumRedef)
+    LN_ERR_NUM_STR_CASE(kErrNumArgCount)
+    LN_ERR_NUM_STR_CASE(kErrNumLitRange)
     default: {
       panic(make_str("Invalid ErrNum (%u)"), num);
     }
@@ -154,6 +168,7 @@ make_err_builder(const Src* src)
                        .err_msg = NULL,
                        .err_sugg = NULL,
                        .span = NULL,
+                       .sink = NULL,
                        .line_before = 0,
                        .line_after = 0,
                        .pad_line_before = 0,
@@ -201,6 +216,14 @@ err_builder_set_span(ErrBuilder* builder, const Span* span)
 
 // -------------------------------------------------------------------------- //
 
+void
+err_builder_set_sink(ErrBuilder* builder, ErrList* sink)
+{
+  builder->sink = sink;
+}
+
+// -------------------------------------------------------------------------- //
+
 void
 err_builder_set_lines_before(ErrBuilder* builder, u32 lines)
 {
@@ -236,6 +259,18 @@ err_builder_emit(const ErrBuilder* builder)
 {
   assrt(builder->span != NULL, make_str("ErrBuilder span must be set"));
 
+  // Collect error
+  if (builder->sink) {
+    const Str* msg = builder->err_msg ? builder->err_msg : builder->err_desc;
+    Err err = { .num = builder->err_num,
+                .span = *builder->span,
+                .msg = msg ? str_copy(msg) : make_str_copy(""),
+                .sugg = builder->err_sugg ? str_copy(builder->err_sugg)
+                                          : make_str_copy("") };
+    err_list_append(builder->sink, &err);
+    return;
+  }
+
   // Retrieve target line
   StrSlice trgt_line = span_line(builder->span, &builder->src->src);
   assrt(!str_slice_is_null(&trgt_line),
@@ -354,5 +389,5 @@ err_pad_str(u32 code_point, u32 count)
     unicode_encode(buf, off, code_point, &width);
     off += width;
   }
-  return make_str(buf);
+  return make_str_cstr(buf);
 }
\ No newline at end of file
@@ -27,17 +27,45 @@
 #include "span.h"
 #include "src.h"
 
+// ========================================================================== //
+// ErrNum
+// ========================================================================== //
+
+typedef enum ErrNum
+{
+  kErrNumNone = 0,
+  kErrNumUnexpTok,
+  kErrNumUndefIdent,
+  kErrNumTypeMismatch,
+  kErrNumNoTypeInfer,
+  kErrNumInvalidOp,
+  kErrNumAssignImmut,
+  kErrNumNonTermStr,
+  kErrNumRedef,
+  kErrNumArgCount,
+  kErrNumLitRange,
+} ErrNum;
+
+// -------------------------------------------------------------------------- //
+
+Str
+err_num_to_str(ErrNum num);
+
 // ========================================================================== //
 // Err
 // ========================================================================== //
 
-/* Error */
+/* Error record, for errors that are collected instead of printed */
 typedef struct Err
 {
-  /* Message */
-  Str* msg;
+  /* Error number */
+  ErrNum num;
   /* Span */
   Span span;
+  /* Message */
+  Str msg;
+  /* Suggestion */
+  Str sugg;
 } Err;
 
 // ========================================================================== //
@@ -63,7 +91,7 @@ make_err_list();
 
 // -------------------------------------------------------------------------- //
 
-/* Release err list */
+/* Release err list and the strings of its errors */
 void
 release_err_list(ErrList* list);
 
@@ -91,22 +119,6 @@ err_list_get(ErrList* list, u32 index);
 void
 err_list_reserve(ErrList* list, u32 cap);
 
-// ==========================================================================
-// // ErrNum
-// ==========================================================================
-// //
-
-typedef enum ErrNum
-{
-  kErrNumNone = 0,
-  kErrNumUnexpTok,
-} ErrNum;
-
-// -------------------------------------------------------------------------- //
-
-Str
-err_num_to_str(ErrNum num);
-
 // ========================================================================== //
 // ErrBuilder
 // ========================================================================== //
@@ -125,6 +137,8 @@ typedef struct ErrBuilder
   const Str* err_sugg;
   /* Span */
   const Span* span;
+  /* List that the error is collected in instead of printed, if set */
+  ErrList* sink;
   /* Num of lines before */
   u32 line_before;
   /* Num of lines before */
@@ -167,6 +181,12 @@ err_builder_set_span(ErrBuilder* builder, const Span* span);
 
 // -------------------------------------------------------------------------- //
 
+/* Collect the error in a list instead of printing it */
+void
+err_builder_set_sink(ErrBuilder* builder, ErrList* sink);
+
+// -------------------------------------------------------------------------- //
+
 void
 err_builder_set_lines_before(ErrBuilder* builder, u32 lines);
 
@@ -53,6 +53,6 @@ file_read_str(const Str* path, Str* p_str)
     return kFileReadErr;
   }
 
-  *p_str = (Str){ .buf = buf, .size = size, .len = cstr_len((char*)buf) };
+  *p_str = (Str){ .buf = buf, .size = size, .len = kStrLenUnknown };
   return kFileNoErr;
 }
\ No newline at end of file
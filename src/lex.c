@@ -74,6 +74,7 @@ tok_kw_kind_get(StrSlice* slice, TokKwKind* p_kind)
   LN_TOK_KW_EQ("fn", kTokKwFn)
   LN_TOK_KW_EQ("if", kTokKwIf)
   LN_TOK_KW_EQ("import", kTokKwImport)
+  LN_TOK_KW_EQ("in", kTokKwIn)
   LN_TOK_KW_EQ("let", kTokKwLet)
   LN_TOK_KW_EQ("match", kTokKwMatch)
   LN_TOK_KW_EQ("module", kTokKwModule)
@@ -88,6 +89,46 @@ tok_kw_kind_get(StrSlice* slice, TokKwKind* p_kind)
 
 #undef LN_TOK_KW_EQ
 
+// -------------------------------------------------------------------------- //
+
+static Atom s_tok_kw_atoms[kTokKwCount];
+
+// -------------------------------------------------------------------------- //
+
+void
+tok_kw_init()
+{
+  static const char* names[kTokKwCount] = {
+    [kTokKwDo] = "do",         [kTokKwElif] = "elif",
+    [kTokKwElse] = "else",     [kTokKwEnum] = "enum",
+    [kTokKwFor] = "for",       [kTokKwFn] = "fn",
+    [kTokKwIf] = "if",         [kTokKwImport] = "import",
+    [kTokKwIn] = "in",         [kTokKwLet] = "let",
+    [kTokKwMatch] = "match",   [kTokKwModule] = "module",
+    [kTokKwRet] = "ret",       [kTokKwSelf] = "self",
+    [kTokKwStruct] = "struct", [kTokKwTrait] = "trait",
+    [kTokKwType] = "type",     [kTokKwWhile] = "while",
+  };
+  for (u32 i = 0; i < kTokKwCount; i++) {
+    StrSlice name = { .ptr = (u8*)names[i], .count = (u32)strlen(names[i]) };
+    s_tok_kw_atoms[i] = atom_intern(&name);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+tok_kw_kind_get_atom(Atom atom, TokKwKind* p_kind)
+{
+  for (u32 i = 0; i < kTokKwCount; i++) {
+    if (s_tok_kw_atoms[i] == atom) {
+      *p_kind = (TokKwKind)i;
+      return true;
+    }
+  }
+  return false;
+}
+
 // ========================================================================== //
 // TokSymKind
 // ========================================================================== //
@@ -126,6 +167,7 @@ tok_sym_kind_get(StrSlice* slice, TokSymKind* p_kind)
   LN_TOK_SYM_EQ(",", kTokSymComma);
   LN_TOK_SYM_EQ("'", kTokSymApostrophe);
   LN_TOK_SYM_EQ(".", kTokSymPeriod);
+  LN_TOK_SYM_EQ("#", kTokSymHash);
   return false;
 }
 
@@ -138,7 +180,7 @@ tok_sym_kind_get(StrSlice* slice, TokSymKind* p_kind)
 Tok
 make_tok(TokKind kind, StrSlice value, Span span)
 {
-  return (Tok){ .kind = kind, .value = value, .span = span };
+  return (Tok){ .kind = kind, .value = value, .span = span, .atom = kAtomNone };
 }
 
 // -------------------------------------------------------------------------- //
@@ -146,7 +188,7 @@ make_tok(TokKind kind, StrSlice value, Span span)
 bool
 tok_is_kw(const Tok* tok, TokKwKind kind)
 {
-  return tok->kind == kTokKeyword && tok->data.kw_kind == kind;
+  return tok && tok->kind == kTokKeyword && tok->data.kw_kind == kind;
 }
 
 // -------------------------------------------------------------------------- //
@@ -154,7 +196,7 @@ tok_is_kw(const Tok* tok, TokKwKind kind)
 bool
 tok_is_sym(const Tok* tok, TokSymKind kind)
 {
-  return tok->kind == kTokSym && tok->data.sym_kind == kind;
+  return tok && tok->kind == kTokSym && tok->data.sym_kind == kind;
 }
 
 // ========================================================================== //
@@ -170,6 +212,8 @@ typedef struct Lex
   const Src* src;
   /* Src iter */
   StrIter iter;
+  /* Sink for errors, NULL to print them */
+  ErrList* errs;
 
   /* Current line */
   u32 line;
@@ -286,7 +330,7 @@ lex_is_special(u32 code_point)
          code_point == '?' || code_point == '(' || code_point == ')' ||
          code_point == '[' || code_point == ']' || code_point == '{' ||
          code_point == '}' || code_point == ':' || code_point == ';' ||
-         code_point == ',' || code_point == '.';
+         code_point == ',' || code_point == '.' || code_point == '#';
 }
 
 // -------------------------------------------------------------------------- //
@@ -349,9 +393,11 @@ lex_handle_ident(Lex* lex)
 
   Span span = make_span(beg, end);
   StrSlice value = lex_span_slice(lex, &span);
+  Atom atom = atom_intern(&value);
   TokKwKind kw_kind;
-  bool is_kw = tok_kw_kind_get(&value, &kw_kind);
+  bool is_kw = tok_kw_kind_get_atom(atom, &kw_kind);
   Tok tok = make_tok(is_kw ? kTokKeyword : kTokIdent, value, span);
+  tok.atom = atom;
   if (is_kw) {
     tok.data.kw_kind = kw_kind;
   }
@@ -374,15 +420,24 @@ lex_handle_num(Lex* lex)
     if (!lex_is_num_sym(code_point)) {
       break;
     }
+
+    // '..' after a number is a range, as in '0..n'
+    if (code_point == '.') {
+      StrIter ahead = lex->iter;
+      str_iter_next(&ahead);
+      if (str_iter_peek(&ahead) == '.') {
+        break;
+      }
+    }
     lex_next(lex);
   }
   Pos end = lex_pos_cur(lex);
 
-  // TODO(Filip Björklund): Handle float + int
-
+  // Numbers with a decimal point are floats
   Span span = make_span(beg, end);
   StrSlice value = lex_span_slice(lex, &span);
-  Tok tok = make_tok(kTokInt, value, span);
+  bool is_float = memchr(value.ptr, '.', value.count) != NULL;
+  Tok tok = make_tok(is_float ? kTokFloat : kTokInt, value, span);
   tok_list_push(lex->list, &tok);
   return kLexNoErr;
 }
@@ -406,7 +461,7 @@ lex_handle_str(Lex* lex)
       found_end = true;
       break;
     }
-    escaped = code_point == '\\';
+    escaped = !escaped && code_point == '\\';
   }
   Pos end = lex_pos_cur(lex);
 
@@ -465,52 +520,90 @@ make_tok_list()
 void
 release_tok_list(TokList* list)
 {
+  for (u32 i = 0; i < list->len; i++) {
+    atom_release(list->buf[i].atom);
+  }
   release(list->buf);
 }
 
 // -------------------------------------------------------------------------- //
 
-#define TOK_LIST_CHECK_ERR()                                                   \
+/* Report lexer error for the token that starts at 'beg' */
+static void
+lex_err(Lex* lex, Pos beg, LexErr err)
+{
+  // Errors that consumed nothing cover the offending character, strings
+  // that run to the end of the source only their opening quote
+  if (lex_pos_cur(lex).off == beg.off) {
+    lex_next(lex);
+  }
+  Span span = make_span(beg, lex_pos_cur(lex));
+  if (err == kLexNonTermStr) {
+    span.end = make_pos(beg.off + 1, beg.line, beg.col + 1);
+  }
+
+  // The builder keeps pointers to the strings until it is emitted
+  bool non_term = err == kLexNonTermStr;
+  const Str expl = non_term ? make_str("String is not terminated")
+                            : make_str("Unexpected symbol");
+  const Str sugg =
+    non_term ? make_str("Add a closing '\"'") : make_str("Remove the symbol");
+
+  ErrBuilder builder = make_err_builder(lex->src);
+  err_builder_set_desc(&builder, &expl);
+  err_builder_set_msg(&builder, &expl);
+  err_builder_set_sugg(&builder, &sugg);
+  err_builder_set_err_num(&builder,
+                          non_term ? kErrNumNonTermStr : kErrNumUnexpTok);
+  err_builder_set_span(&builder, &span);
+  err_builder_set_sink(&builder, lex->errs);
+  err_builder_set_lines_after(&builder, 1);
+  err_builder_set_pad_lines_before(&builder, 1);
+  err_builder_set_pad_lines_after(&builder, 1);
+  err_builder_emit(&builder);
+}
+
+// -------------------------------------------------------------------------- //
+
+#define TOK_LIST_HANDLE(handler)                                               \
   do {                                                                         \
+    Pos handler_beg = lex_pos_cur(&lex);                                       \
+    LexErr err = handler(&lex);                                                \
     if (err != kLexNoErr) {                                                    \
+      lex_err(&lex, handler_beg, err);                                         \
       release_tok_list(&list);                                                 \
       return err;                                                              \
     }                                                                          \
   } while (0)
 
 LexErr
-tok_list_lex(const Src* src, TokList* p_list)
+tok_list_lex(const Src* src, ErrList* errs, TokList* p_list)
 {
   *p_list = (TokList){ .buf = NULL, .len = 0, .cap = 0 };
 
   TokList list = make_tok_list();
   Lex lex = make_lex(&list, src);
+  lex.errs = errs;
 
   u32 code_point;
   while ((code_point = lex_peek(&lex)) != kInvalidCodepoint) {
     Pos beg = lex_pos_cur(&lex);
 
-    LexErr err = lex_handle_whitespace(&lex);
-    TOK_LIST_CHECK_ERR();
-
-    err = lex_handle_newline(&lex);
-    TOK_LIST_CHECK_ERR();
-
-    err = lex_handle_ident(&lex);
-    TOK_LIST_CHECK_ERR();
-
-    err = lex_handle_num(&lex);
-    TOK_LIST_CHECK_ERR();
-
-    err = lex_handle_str(&lex);
-    TOK_LIST_CHECK_ERR();
-
-    err = lex_handle_special(&lex);
-    TOK_LIST_CHECK_ERR();
+    // Errors start where the handler that reports them started, after any
+    // tokens that the previous handlers lexed
+    TOK_LIST_HANDLE(lex_handle_whitespace);
+    TOK_LIST_HANDLE(lex_handle_newline);
+    TOK_LIST_HANDLE(lex_handle_ident);
+    TOK_LIST_HANDLE(lex_handle_num);
+    TOK_LIST_HANDLE(lex_handle_str);
+    TOK_LIST_HANDLE(lex_handle_special);
 
     Pos end = lex_pos_cur(&lex);
-    err = (beg.off == end.off) ? kLexUnexpectedSym : kLexNoErr;
-    TOK_LIST_CHECK_ERR();
+    if (beg.off == end.off) {
+      lex_err(&lex, beg, kLexUnexpectedSym);
+      release_tok_list(&list);
+      return kLexUnexpectedSym;
+    }
   }
 
   *p_list = list;
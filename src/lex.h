@@ -27,6 +27,8 @@
 #include "str.h"
 #include "span.h"
 #include "src.h"
+#include "atom.h"
+#include "err.h"
 
 // ========================================================================== //
 // LexErr
@@ -78,6 +80,7 @@ typedef enum TokKwKind
   kTokKwFn,
   kTokKwIf,
   kTokKwImport,
+  kTokKwIn,
   kTokKwLet,
   kTokKwMatch,
   kTokKwModule,
@@ -91,9 +94,27 @@ typedef enum TokKwKind
 
 // -------------------------------------------------------------------------- //
 
+/* Number of keywords */
+#define kTokKwCount (kTokKwWhile + 1)
+
+// -------------------------------------------------------------------------- //
+
 bool
 tok_kw_kind_get(StrSlice* slice, TokKwKind* p_kind);
 
+// -------------------------------------------------------------------------- //
+
+/* Intern the keyword atoms. Must be called after 'atoms_init' and before
+ * any source is lexed */
+void
+tok_kw_init();
+
+// -------------------------------------------------------------------------- //
+
+/* Get keyword kind from atom, compares integers only */
+bool
+tok_kw_kind_get_atom(Atom atom, TokKwKind* p_kind);
+
 // ========================================================================== //
 // TokSymKind
 // ========================================================================== //
@@ -150,6 +171,8 @@ typedef enum TokSymKind
   kTokSymApostrophe,
   /* '.' */
   kTokSymPeriod,
+  /* '#' */
+  kTokSymHash,
 } TokSymKind;
 
 // -------------------------------------------------------------------------- //
@@ -170,6 +193,9 @@ typedef struct Tok
   StrSlice value;
   /* Span */
   Span span;
+  /* Interned value for identifiers and keywords, referenced by the token
+   * list, otherwise kAtomNone */
+  Atom atom;
   /* Extra data */
   union
   {
@@ -186,13 +212,15 @@ make_tok(TokKind kind, StrSlice value, Span span);
 
 // -------------------------------------------------------------------------- //
 
-/* Check if token is of specified keyword type */
+/* Check if token is of specified keyword type. False for NULL, the end of
+ * the token list */
 bool
 tok_is_kw(const Tok* tok, TokKwKind kind);
 
 // -------------------------------------------------------------------------- //
 
-/* Check if token is of specified keyword type */
+/* Check if token is of specified symbol type. False for NULL, the end of
+ * the token list */
 bool
 tok_is_sym(const Tok* tok, TokSymKind kind);
 
@@ -215,15 +243,16 @@ make_tok_list();
 
 // -------------------------------------------------------------------------- //
 
-/* Release token list */
+/* Release token list and the references of its tokens to their atoms */
 void
 release_tok_list(TokList* list);
 
 // -------------------------------------------------------------------------- //
 
-/* Lexical analysis */
+/* Lexical analysis. Errors are collected in 'errs' if it is set, otherwise
+ * they are printed */
 LexErr
-tok_list_lex(const Src* src, TokList* p_list);
+tok_list_lex(const Src* src, ErrList* errs, TokList* p_list);
 
 // -------------------------------------------------------------------------- //
 
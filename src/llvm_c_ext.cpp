@@ -20,7 +20,13 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/Support/TargetRegistry.h>
 #include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
 extern "C"
 {
@@ -436,12 +442,94 @@ LLVMCreateTargetMachineFromTriple(LLVMTargetRef T,
                                   LLVMTripleRef Triple,
                                   const char* CPU,
                                   const char* Features,
+                                  const char* ABI,
                                   LLVMCodeGenOptLevel Level,
                                   LLVMRelocMode Reloc,
                                   LLVMCodeModel CodeModel)
 {
-  return LLVMCreateTargetMachine(
-    T, LLVMTripleGetTriple(Triple), CPU, Features, Level, Reloc, CodeModel);
+  if (!ABI || ABI[0] == 0) {
+    return LLVMCreateTargetMachine(
+      T, LLVMTripleGetTriple(Triple), CPU, Features, Level, Reloc, CodeModel);
+  }
+
+  // The C API has no way of passing the ABI, so do what it does with it set
+  llvm::Optional<llvm::Reloc::Model> reloc;
+  switch (Reloc) {
+    case LLVMRelocStatic: {
+      reloc = llvm::Reloc::Static;
+      break;
+    }
+    case LLVMRelocPIC: {
+      reloc = llvm::Reloc::PIC_;
+      break;
+    }
+    case LLVMRelocDynamicNoPic: {
+      reloc = llvm::Reloc::DynamicNoPIC;
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+  llvm::Optional<llvm::CodeModel::Model> code_model;
+  bool jit = false;
+  switch (CodeModel) {
+    case LLVMCodeModelJITDefault: {
+      jit = true;
+      break;
+    }
+    case LLVMCodeModelSmall: {
+      code_model = llvm::CodeModel::Small;
+      break;
+    }
+    case LLVMCodeModelKernel: {
+      code_model = llvm::CodeModel::Kernel;
+      break;
+    }
+    case LLVMCodeModelMedium: {
+      code_model = llvm::CodeModel::Medium;
+      break;
+    }
+    case LLVMCodeModelLarge: {
+      code_model = llvm::CodeModel::Large;
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+  llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default;
+  switch (Level) {
+    case LLVMCodeGenLevelNone: {
+      level = llvm::CodeGenOpt::None;
+      break;
+    }
+    case LLVMCodeGenLevelLess: {
+      level = llvm::CodeGenOpt::Less;
+      break;
+    }
+    case LLVMCodeGenLevelAggressive: {
+      level = llvm::CodeGenOpt::Aggressive;
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+
+  llvm::TargetOptions options;
+  options.MCOptions.ABIName = ABI;
+  llvm::Target* target = reinterpret_cast<llvm::Target*>(T);
+  llvm::TargetMachine* machine =
+    target->createTargetMachine(LLVMTripleGetTriple(Triple),
+                                CPU,
+                                Features,
+                                options,
+                                reloc,
+                                code_model,
+                                level,
+                                jit);
+  return reinterpret_cast<LLVMTargetMachineRef>(machine);
 }
 
 // -------------------------------------------------------------------------- //
@@ -490,4 +578,67 @@ bool
 LLVMTripleIsArch16Bit(LLVMTripleRef Triple)
 {
   return Triple->handle.isArch16Bit();
-}
\ No newline at end of file
+}
+
+// ========================================================================== //
+// LLVMPassManagerBuilder
+// ========================================================================== //
+
+/* The C API does not export its unwrap function for the builder */
+static llvm::PassManagerBuilder*
+llvm_unwrap_pmb(LLVMPassManagerBuilderRef PMB)
+{
+  return reinterpret_cast<llvm::PassManagerBuilder*>(PMB);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+LLVMPassManagerBuilderSetPGOInstrGen(LLVMPassManagerBuilderRef PMB,
+                                     const char* Path)
+{
+  llvm::PassManagerBuilder* builder = llvm_unwrap_pmb(PMB);
+  builder->EnablePGOInstrGen = true;
+  builder->PGOInstrGen = Path;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+LLVMPassManagerBuilderSetPGOInstrUse(LLVMPassManagerBuilderRef PMB,
+                                     const char* Path)
+{
+  llvm_unwrap_pmb(PMB)->PGOInstrUse = Path;
+}
+
+// ========================================================================== //
+// LLVMLoopHint
+// ========================================================================== //
+
+void
+LLVMSetLoopHints(LLVMValueRef Branch,
+                 const LLVMLoopHint* Hints,
+                 unsigned Count)
+{
+  llvm::Instruction* inst = llvm::unwrap<llvm::Instruction>(Branch);
+  llvm::LLVMContext& ctx = inst->getContext();
+
+  // The first operand is the node itself, which keeps it unique per loop
+  llvm::SmallVector<llvm::Metadata*, 4> ops;
+  ops.push_back(nullptr);
+  for (unsigned i = 0; i < Count; i++) {
+    llvm::SmallVector<llvm::Metadata*, 2> hint;
+    hint.push_back(llvm::MDString::get(ctx, Hints[i].Name));
+    if (Hints[i].Kind != LLVMLoopHintFlag) {
+      llvm::Type* type = Hints[i].Kind == LLVMLoopHintBool
+                           ? llvm::Type::getInt1Ty(ctx)
+                           : llvm::Type::getInt32Ty(ctx);
+      hint.push_back(llvm::ConstantAsMetadata::get(
+        llvm::ConstantInt::get(type, Hints[i].Value)));
+    }
+    ops.push_back(llvm::MDNode::get(ctx, hint));
+  }
+  llvm::MDNode* loop_id = llvm::MDNode::getDistinct(ctx, ops);
+  loop_id->replaceOperandWith(0, loop_id);
+  inst->setMetadata(llvm::LLVMContext::MD_loop, loop_id);
+}
@@ -27,6 +27,7 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/TargetMachine.h>
 #include <llvm-c/Target.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
 
 #include "type.h"
 
@@ -156,6 +157,7 @@ LLVMCreateTargetMachineFromTriple(LLVMTargetRef T,
                                   LLVMTripleRef Triple,
                                   const char* CPU,
                                   const char* Features,
+                                  const char* ABI,
                                   LLVMCodeGenOptLevel Level,
                                   LLVMRelocMode Reloc,
                                   LLVMCodeModel CodeModel);
@@ -192,4 +194,58 @@ LLVMTripleIsArch32Bit(LLVMTripleRef Triple);
 bool
 LLVMTripleIsArch16Bit(LLVMTripleRef Triple);
 
+// ========================================================================== //
+// LLVMPassManagerBuilder
+// ========================================================================== //
+
+/* Instrument code to write a raw profile (LLVM instrprof) when the program
+ * exits. An empty path uses the default path of the profile runtime */
+void
+LLVMPassManagerBuilderSetPGOInstrGen(LLVMPassManagerBuilderRef PMB,
+                                     const char* Path);
+
+// -------------------------------------------------------------------------- //
+
+/* Use the indexed profile (.profdata) at path during optimization */
+void
+LLVMPassManagerBuilderSetPGOInstrUse(LLVMPassManagerBuilderRef PMB,
+                                     const char* Path);
+
+// ========================================================================== //
+// LLVMLoopHint
+// ========================================================================== //
+
+/* Kind of value of a loop hint */
+typedef enum LLVMLoopHintKind
+{
+  /* No value, the hint applies by being present */
+  LLVMLoopHintFlag,
+  /* Boolean (i1) value */
+  LLVMLoopHintBool,
+  /* Integer (i32) value */
+  LLVMLoopHintInt
+} LLVMLoopHintKind;
+
+// -------------------------------------------------------------------------- //
+
+/* Loop hint, such as 'llvm.loop.vectorize.width' */
+typedef struct LLVMLoopHint
+{
+  /* Name of metadata property */
+  const char* Name;
+  /* Kind of value */
+  LLVMLoopHintKind Kind;
+  /* Value, unused for flags */
+  unsigned Value;
+} LLVMLoopHint;
+
+// -------------------------------------------------------------------------- //
+
+/* Attach hints to the back edge (branch in the latch) of a loop. The hints
+ * are stored in a distinct 'llvm.loop' node, as the loop passes expect */
+void
+LLVMSetLoopHints(LLVMValueRef Branch,
+                 const LLVMLoopHint* Hints,
+                 unsigned Count);
+
 #endif // LN_LLVM_LN_H
\ No newline at end of file
@@ -20,6 +20,8 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <llvm-c/ExecutionEngine.h>
+
 #include "llvm_util.h"
 
 // ========================================================================== //
@@ -36,6 +38,9 @@ llvm_init()
   LLVMInitializeAllAsmPrinters();
   LLVMInitializeAllAsmParsers();
   LLVMInitializeAllDisassemblers();
+
+  // JIT for '--run'
+  LLVMLinkInMCJIT();
 }
 
 // -------------------------------------------------------------------------- //
@@ -53,63 +58,149 @@ llvm_cleanup()
 LLVMTypeRef
 to_llvm_type(Type* type)
 {
-  switch (type->kind) {
-    case kTypeChar: {
-      return LLVMInt8Type();
-    }
-    case kTypeBool: {
-      return LLVMInt8Type();
-    }
-    case kTypeU8: {
-      return LLVMInt8Type();
-    }
-    case kTypeS8: {
-      return LLVMInt8Type();
-    }
-    case kTypeU16: {
-      return LLVMInt16Type();
-    }
-    case kTypeS16: {
-      return LLVMInt16Type();
-    }
-    case kTypeU32: {
-      return LLVMInt32Type();
-    }
-    case kTypeS32: {
-      return LLVMInt32Type();
-    }
-    case kTypeU64: {
-      return LLVMInt64Type();
-    }
-    case kTypeS64: {
-      return LLVMInt64Type();
-    }
-    case kTypeF32: {
-      return LLVMFloatType();
-    }
-    case kTypeF64: {
-      return LLVMDoubleType();
+  return to_llvm_type_in_context(LLVMGetGlobalContext(), type);
+}
+
+// -------------------------------------------------------------------------- //
+
+LLVMTypeRef
+to_llvm_type_in_context(LLVMContextRef ctx, Type* type)
+{
+  // Booleans are the result of comparisons and used directly as conditions
+  if (type->kind == kTypeBool) {
+    return LLVMInt1TypeInContext(ctx);
+  }
+
+  // Primitives
+  if (type_is_primitive(type)) {
+    const TypePrim* prim = type_prim(type);
+    switch (prim->llvm_class) {
+      case kTypePrimClassVoid: {
+        return LLVMVoidTypeInContext(ctx);
+      }
+      case kTypePrimClassInt: {
+        return LLVMIntTypeInContext(ctx, prim->size * 8);
+      }
+      case kTypePrimClassFloat: {
+        return prim->size == 4 ? LLVMFloatTypeInContext(ctx)
+                               : LLVMDoubleTypeInContext(ctx);
+      }
     }
+  }
+
+  // Derived types
+  switch (type->kind) {
     case kTypeArray: {
-      return LLVMArrayType(to_llvm_type(type->array.type), type->array.len);
+      return LLVMArrayType(to_llvm_type_in_context(ctx, type->array.type),
+                           type->array.len);
     }
     case kTypePtr: {
-      return LLVMPointerType(to_llvm_type(type->pointer.type), 0);
+      return LLVMPointerType(to_llvm_type_in_context(ctx, type->pointer.type),
+                             0);
+    }
+    case kTypeVector: {
+      return LLVMVectorType(to_llvm_type_in_context(ctx, type->vector.type),
+                            type->vector.len);
     }
     case kTypeStruct: {
       panic(make_str("Not supported yet"));
-      return LLVMInt32Type();
+      return LLVMInt32TypeInContext(ctx);
     }
     case kTypeEnum: {
       panic(make_str("Not supported yet"));
-      return LLVMInt32Type();
+      return LLVMInt32TypeInContext(ctx);
     }
     case kTypeTrait: {
       panic(make_str("Not supported yet"));
-      return LLVMInt32Type();
+      return LLVMInt32TypeInContext(ctx);
     }
     default: {
       panic(make_str("Invalid"));
     }
   }
-}
\ No newline at end of file
+}
+
+// -------------------------------------------------------------------------- //
+
+LLVMValueRef
+llvm_build_binop(LLVMBuilderRef builder,
+                 AstBinopKind kind,
+                 Type* type,
+                 LLVMValueRef lhs,
+                 LLVMValueRef rhs)
+{
+  // Vector types select the instruction from their element type, LLVM then
+  // applies the operation lane-wise
+  bool is_float = type_is_float(type);
+  bool is_signed = type_is_signed(type);
+  assrt(is_float || type_is_int(type),
+        make_str("Binary operations require integer or float operands"));
+
+  switch (kind) {
+    case kAstBinopAdd: {
+      return is_float ? LLVMBuildFAdd(builder, lhs, rhs, "")
+                      : LLVMBuildAdd(builder, lhs, rhs, "");
+    }
+    case kAstBinopSub: {
+      return is_float ? LLVMBuildFSub(builder, lhs, rhs, "")
+                      : LLVMBuildSub(builder, lhs, rhs, "");
+    }
+    case kAstBinopMul: {
+      return is_float ? LLVMBuildFMul(builder, lhs, rhs, "")
+                      : LLVMBuildMul(builder, lhs, rhs, "");
+    }
+    case kAstBinopDiv: {
+      if (is_float) {
+        return LLVMBuildFDiv(builder, lhs, rhs, "");
+      }
+      return is_signed ? LLVMBuildSDiv(builder, lhs, rhs, "")
+                       : LLVMBuildUDiv(builder, lhs, rhs, "");
+    }
+    case kAstBinopMod: {
+      if (is_float) {
+        return LLVMBuildFRem(builder, lhs, rhs, "");
+      }
+      return is_signed ? LLVMBuildSRem(builder, lhs, rhs, "")
+                       : LLVMBuildURem(builder, lhs, rhs, "");
+    }
+    case kAstBinopEq: {
+      return is_float ? LLVMBuildFCmp(builder, LLVMRealOEQ, lhs, rhs, "")
+                      : LLVMBuildICmp(builder, LLVMIntEQ, lhs, rhs, "");
+    }
+    case kAstBinopNe: {
+      return is_float ? LLVMBuildFCmp(builder, LLVMRealUNE, lhs, rhs, "")
+                      : LLVMBuildICmp(builder, LLVMIntNE, lhs, rhs, "");
+    }
+    case kAstBinopLt: {
+      if (is_float) {
+        return LLVMBuildFCmp(builder, LLVMRealOLT, lhs, rhs, "");
+      }
+      return LLVMBuildICmp(
+        builder, is_signed ? LLVMIntSLT : LLVMIntULT, lhs, rhs, "");
+    }
+    case kAstBinopLe: {
+      if (is_float) {
+        return LLVMBuildFCmp(builder, LLVMRealOLE, lhs, rhs, "");
+      }
+      return LLVMBuildICmp(
+        builder, is_signed ? LLVMIntSLE : LLVMIntULE, lhs, rhs, "");
+    }
+    case kAstBinopGt: {
+      if (is_float) {
+        return LLVMBuildFCmp(builder, LLVMRealOGT, lhs, rhs, "");
+      }
+      return LLVMBuildICmp(
+        builder, is_signed ? LLVMIntSGT : LLVMIntUGT, lhs, rhs, "");
+    }
+    case kAstBinopGe: {
+      if (is_float) {
+        return LLVMBuildFCmp(builder, LLVMRealOGE, lhs, rhs, "");
+      }
+      return LLVMBuildICmp(
+        builder, is_signed ? LLVMIntSGE : LLVMIntUGE, lhs, rhs, "");
+    }
+    default: {
+      panic(make_str("Invalid binop kind"));
+    }
+  }
+}
@@ -24,6 +24,7 @@
 #define LN_LLVM_UTIL_H
 
 #include "type.h"
+#include "ast.h"
 #include "llvm_c_ext.h"
 
 // ========================================================================== //
@@ -44,8 +45,26 @@ llvm_cleanup();
 // LLVMUtil
 // ========================================================================== //
 
-/* Get LLVM type from type */
+/* Get LLVM type from type in the global context */
 LLVMTypeRef
 to_llvm_type(Type* type);
 
+// -------------------------------------------------------------------------- //
+
+/* Get LLVM type from type in context */
+LLVMTypeRef
+to_llvm_type_in_context(LLVMContextRef ctx, Type* type);
+
+// -------------------------------------------------------------------------- //
+
+/* Build the instruction for a binary operation on operands of 'type'. Vector
+ * operands produce the corresponding vector instruction and comparisons of
+ * scalars produce an 'i1' */
+LLVMValueRef
+llvm_build_binop(LLVMBuilderRef builder,
+                 AstBinopKind kind,
+                 Type* type,
+                 LLVMValueRef lhs,
+                 LLVMValueRef rhs);
+
 #endif // LN_LLVM_UTIL_H
\ No newline at end of file
@@ -20,14 +20,22 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <stdlib.h>
 #include <string.h>
-
-#include <cJSON.h>
+#include <strings.h>
+#include <time.h>
 
 #include "lsp.h"
+#include "lex.h"
+#include "parser.h"
+#include "sema.h"
 
 #define LN_LSP_PROP_ERR(e)                                                     \
   if (e != kLspNoErr) {                                                        \
@@ -35,7 +43,7 @@
   }
 
 static LspErr
-lsp_sock_write(Lsp* lsp, u8* buf, u32 buf_size);
+lsp_send(Lsp* lsp, LspClient* client, const u8* buf, u32 buf_size);
 
 // ========================================================================== //
 // LspErr
@@ -56,6 +64,8 @@ lsp_err_str(LspErr err)
     LN_LSP_ERR_STR_CASE(kLspConnFailed)
     LN_LSP_ERR_STR_CASE(kLspConnLost)
     LN_LSP_ERR_STR_CASE(kLspRecvFail)
+    LN_LSP_ERR_STR_CASE(kLspFrameErr)
+    LN_LSP_ERR_STR_CASE(kLspExit)
     default: {
       panic(make_str("Invalid LspErr value"));
     }
@@ -96,409 +106,2107 @@ lsp_err_from_chif_result(chif_net_result result)
 // JRPC
 // ========================================================================== //
 
-LspErr
-jrpc_send_json(Lsp* lsp, const cJSON* json)
-{
-  // Generate json string
-  char* json_str = cJSON_PrintUnformatted(json);
+/* JSON-RPC error code of requests for methods that the server lacks */
+#define kJrpcMethodNotFound -32601
+
+/* JSON-RPC error code of requests that failed inside the server */
+#define kJrpcInternalError -32603
 
-  // Format response
-  Str msg = str_format(make_str("Content-Length: %u\r\n"
-                                "\r\n"
-                                "%s"),
-                       cstr_size(json_str),
-                       json_str);
-  cJSON_free(json_str);
+/* JSON-RPC error code of cancelled requests */
+#define kJrpcRequestCancelled -32800
 
-  // Debug
-#if 0
-  char* dbg_str = cJSON_Print(json);
-  printf("Sending JSON:\n%s\n", dbg_str);
-  cJSON_free(dbg_str);
-#endif
+// -------------------------------------------------------------------------- //
 
-  // Write response
-  return lsp_sock_write(lsp, str_buf(&msg), msg.size);
+/* Begin response to the request with id 'id' (JSON text) */
+static void
+jrpc_resp_begin(LspJsonWriter* w, const char* id)
+{
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "jsonrpc");
+  lsp_jw_str(w, "2.0");
+  lsp_jw_key(w, "id");
+  lsp_jw_raw(w, id, (u32)cstr_size(id));
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-jrpc_handle_init(Lsp* lsp, cJSON* json)
-{
-  // Determine id
-  cJSON* req_id_json = cJSON_GetObjectItemCaseSensitive(json, "id");
-  assrt(cJSON_IsNumber(req_id_json), make_str("request id must be a number"));
-  const f64 req_id = req_id_json->valuedouble;
-
-  // Build response
-  cJSON* j_resp = cJSON_CreateObject();
-  cJSON_AddStringToObject(j_resp, "jsonrpc", "2.0");
-  cJSON_AddNumberToObject(j_resp, "id", req_id);
-
-  cJSON* j_cap = cJSON_CreateObject();
-  cJSON_AddNumberToObject(j_cap, "textDocumentSync", 1.0);
-  cJSON* j_comp = cJSON_CreateObject();
-  cJSON_AddBoolToObject(j_comp, "resolveProvider", false);
-  cJSON* j_trig_char = cJSON_AddArrayToObject(j_comp, "triggerCharacters");
-  cJSON* j_trig_char0 = cJSON_CreateString("/");
-  cJSON_AddItemToArray(j_trig_char, j_trig_char0);
-  cJSON_AddItemToObject(j_cap, "completionProvider", j_comp);
-
-  cJSON* j_res = cJSON_CreateObject();
-  cJSON_AddItemToObject(j_resp, "result", j_res);
-  cJSON_AddBoolToObject(j_cap, "hoverProvider", true);
-  cJSON_AddBoolToObject(j_cap, "documentSymbolProvider", false);
-  cJSON_AddBoolToObject(j_cap, "referencesProvider", false);
-  cJSON_AddBoolToObject(j_cap, "definitionProvider", false);
-  cJSON_AddBoolToObject(j_cap, "documentHighlightProvider", false);
-  cJSON_AddBoolToObject(j_cap, "codeActionProvider", false);
-  cJSON_AddBoolToObject(j_cap, "renameProvider", false);
-  cJSON_AddItemToObject(j_cap, "colorProvider", cJSON_CreateObject());
-  cJSON_AddBoolToObject(j_cap, "foldingRangeProvider", false);
-  cJSON_AddItemToObject(j_res, "capabilities", j_cap);
-
-  // Send response
-  LspErr err = jrpc_send_json(lsp, j_resp);
-  cJSON_Delete(j_resp);
-  return err;
+/* Begin notification */
+static void
+jrpc_note_begin(LspJsonWriter* w, const char* method)
+{
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "jsonrpc");
+  lsp_jw_str(w, "2.0");
+  lsp_jw_key(w, "method");
+  lsp_jw_str(w, method);
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-jrpc_handle_hover(Lsp* lsp, cJSON* json)
-{
-  LN_UNUSED(json);
-
-  // Hover message
-  // Str hover = make_str("No information available");
-  Str hover = make_str("Hej Christoffer");
-
-  // Determine id
-  cJSON* req_id_json = cJSON_GetObjectItemCaseSensitive(json, "id");
-  assrt(cJSON_IsNumber(req_id_json), make_str("request id must be a number"));
-  const f64 req_id = req_id_json->valuedouble;
-
-  // Build response
-  cJSON* j_resp = cJSON_CreateObject();
-  cJSON_AddStringToObject(j_resp, "jsonrpc", "2.0");
-  cJSON_AddNumberToObject(j_resp, "id", req_id);
-  cJSON* j_res = cJSON_CreateObject();
-  cJSON_AddItemToObject(j_resp, "result", j_res);
-  cJSON_AddStringToObject(j_res, "contents", str_cstr(&hover));
-
-  // Send response
-  LspErr err = jrpc_send_json(lsp, j_resp);
-  cJSON_Delete(j_resp);
+/* Frame and send the message in the writer of the I/O thread */
+static LspErr
+jrpc_send(Lsp* lsp, LspClient* client)
+{
+  u32 size;
+  const char* msg = lsp_jw_finish(&lsp->out, &size);
+  LspErr err = lsp_send(lsp, client, (const u8*)msg, size);
+  lsp_jw_reset(&lsp->out);
   return err;
 }
 
-// ========================================================================== //
-// Net
-// ========================================================================== //
-
-#define s_recv_buf_size 32768
-
 // -------------------------------------------------------------------------- //
 
-static u8 s_recv_buf[s_recv_buf_size + 1];
+/* Write error response to the request with id 'id' */
+static void
+jrpc_write_err(LspJsonWriter* w, const char* id, s64 code, const char* msg)
+{
+  jrpc_resp_begin(w, id);
+  lsp_jw_key(w, "error");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "code");
+  lsp_jw_int(w, code);
+  lsp_jw_key(w, "message");
+  lsp_jw_str(w, msg);
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+}
 
 // -------------------------------------------------------------------------- //
 
-/* Get offset to right after '\r\n\r\n' */
-u32
-lsp_cont_off(u8* buf, u32 buf_size)
+LspErr
+jrpc_handle_init(Lsp* lsp, LspClient* client, const char* id)
 {
-  u32 crlf_off = 0;
-  for (u32 o = 0; o < buf_size - 3; o++) {
-    if (buf[o + 0] == '\r' && buf[o + 1] == '\n' && buf[o + 2] == '\r' &&
-        buf[o + 3] == '\n') {
-      crlf_off = o + 4;
-      break;
-    }
+  LspJsonWriter* w = &lsp->out;
+  jrpc_resp_begin(w, id);
+  lsp_jw_key(w, "result");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "capabilities");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "textDocumentSync");
+  lsp_jw_int(w, 2);
+  lsp_jw_key(w, "completionProvider");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "resolveProvider");
+  lsp_jw_bool(w, false);
+  lsp_jw_key(w, "triggerCharacters");
+  lsp_jw_arr_begin(w);
+  lsp_jw_str(w, "/");
+  lsp_jw_arr_end(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_key(w, "hoverProvider");
+  lsp_jw_bool(w, true);
+  lsp_jw_key(w, "documentSymbolProvider");
+  lsp_jw_bool(w, true);
+  lsp_jw_key(w, "referencesProvider");
+  lsp_jw_bool(w, false);
+  lsp_jw_key(w, "definitionProvider");
+  lsp_jw_bool(w, true);
+  lsp_jw_key(w, "documentHighlightProvider");
+  lsp_jw_bool(w, false);
+  lsp_jw_key(w, "codeActionProvider");
+  lsp_jw_bool(w, false);
+  lsp_jw_key(w, "renameProvider");
+  lsp_jw_bool(w, false);
+  lsp_jw_key(w, "colorProvider");
+  lsp_jw_obj_begin(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_key(w, "foldingRangeProvider");
+  lsp_jw_bool(w, false);
+  lsp_jw_key(w, "semanticTokensProvider");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "legend");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "tokenTypes");
+  lsp_jw_arr_begin(w);
+  for (u32 i = 0; i < kLspSemTypeCount; i++) {
+    lsp_jw_str(w, lsp_sem_type_name(i));
   }
-  assrt(
-    crlf_off != 0,
-    make_str("Could not find any occurance of '\\r\\n\\r\\n' in the buffer"));
-  return crlf_off;
+  lsp_jw_arr_end(w);
+  lsp_jw_key(w, "tokenModifiers");
+  lsp_jw_arr_begin(w);
+  lsp_jw_arr_end(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_key(w, "full");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "delta");
+  lsp_jw_bool(w, true);
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+  return jrpc_send(lsp, client);
 }
 
 // -------------------------------------------------------------------------- //
 
-u32
-lsp_cont_len(u8* buf, u32 buf_size)
+/* Returns whether tokens contain the identifier 'dbg_lsp_panic' */
+static bool
+jrpc_dbg_panics(const TokList* tokens)
 {
-  u32 beg = 16, count = 0;
-  for (u32 i = beg; i < buf_size; i++) {
-    if (buf[i] == '\r') {
-      break;
+  for (u32 i = 0; i < tokens->len; i++) {
+    const Tok* tok = tok_list_get(tokens, i);
+    if (tok->kind == kTokIdent &&
+        str_slice_eq_str(&tok->value, &make_str("dbg_lsp_panic"))) {
+      return true;
     }
-    count++;
   }
-  char str_buf[32];
-  assrt(count < 32, make_str("Invalid 'Content-Length'"));
-  str_buf[count] = 0;
-  memcpy(str_buf, buf + beg, buf_size);
-  return strtoul((char*)(buf + beg), NULL, 10);
+  return false;
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_handle_msg(Lsp* lsp, char* str_buf)
+/* Analyze a snapshot, collecting the errors. Returns NULL if the job is
+ * cancelled between the phases. Snapshots with the same text as one that was
+ * analyzed before, by any client, reuse that analysis */
+static LspUnit*
+jrpc_analyze(LspJob* job)
 {
-  // printf("START_MESSAGE:\n%s\nEND_MESSAGE\n\n", str_buf);
+  const Src* src = &job->snap->src;
+  LspUnit* unit = lsp_cache_get(job->cache, &src->src);
+  if (unit) {
+    return unit;
+  }
 
-  // Determine method
-  cJSON* json = cJSON_Parse(str_buf);
-  cJSON* method = cJSON_GetObjectItem(json, "method");
-  assrt(cJSON_IsString(method), make_str("method tag must be a string"));
-  const Str method_str = make_str(cJSON_GetStringValue(method));
+  ErrList errs = make_err_list();
+  TokList tokens;
+  LexErr lex_err = tok_list_lex(src, &errs, &tokens);
+  if (lex_err != kLexNoErr) {
+    unit = make_lsp_unit(job->snap, NULL, (LspAtoms){ 0 }, NULL, errs);
+    lsp_cache_put(job->cache, unit);
+    return unit;
+  }
+  if (lsp_job_is_cancelled(job)) {
+    release_tok_list(&tokens);
+    release_err_list(&errs);
+    return NULL;
+  }
 
-  // Delegate control
-  if (str_eq(&method_str, &make_str("initialize"))) {
-    jrpc_handle_init(lsp, json);
-  } else if (str_eq(&method_str, &make_str("textDocument/hover"))) {
-    jrpc_handle_hover(lsp, json);
+  LspSemToks* toks = make_lsp_sem_toks(&tokens, &src->src);
+  Parser parser = make_parser(src, &tokens);
+  parser.errs = &errs;
+  Ast* ast = parser_parse(&parser);
+  if (job->dbg_panic && jrpc_dbg_panics(&tokens)) {
+    panic(make_str("Analysis panicked on request ('--dbg-lsp-panic')"));
+  }
+  LspAtoms atoms = make_lsp_atoms(&tokens);
+  release_tok_list(&tokens);
+  if (lsp_job_is_cancelled(job)) {
+    release_ast(ast);
+    release_lsp_atoms(&atoms);
+    lsp_sem_toks_release(toks);
+    release_err_list(&errs);
+    return NULL;
   }
 
-  return kLspNoErr;
+  // Sema expects a complete tree, so half-typed code only gets the errors of
+  // the parser until it parses
+  if (errs.len == 0) {
+    Sema sema = make_sema(src);
+    sema.errs = &errs;
+    sema_check_prog(&sema, ast);
+    release_sema(&sema);
+  }
+  unit = make_lsp_unit(job->snap, ast, atoms, toks, errs);
+  lsp_cache_put(job->cache, unit);
+
+  // The names of analyses that are no longer used, such as the partial
+  // identifiers of edited documents, are freed as the cache evicts them
+  atoms_collect();
+  return unit;
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_sock_can_read(Lsp* lsp, bool* p_can_read)
+/* Returns the analysis that a query runs against. Documents that have not
+ * been analyzed at the version of the query are analyzed here, instead of
+ * waiting for the analysis job */
+static const LspUnit*
+jrpc_job_unit(LspJob* job)
 {
-  int can_read;
-  chif_net_result result = chif_net_can_read(lsp->sock, &can_read, 100);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    *p_can_read = false;
-    return lsp_err_from_chif_result(result);
+  if (!job->unit && job->snap) {
+    job->unit = jrpc_analyze(job);
   }
-  *p_can_read = (bool)can_read;
-  return kLspNoErr;
+  return job->unit;
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_sock_read(Lsp* lsp, u8* buf, u32 buf_size, u32* read)
+/* Write LSP position of a byte offset */
+static void
+jrpc_write_pos(LspJsonWriter* w, const LspIndex* index, u32 off)
 {
-  int _read = 0;
-  chif_net_result result = chif_net_read(lsp->sock, buf, buf_size, &_read);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    *read = 0;
-    return lsp_err_from_chif_result(result);
+  u32 line, character;
+  lsp_index_pos(index, off, &line, &character);
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "line");
+  lsp_jw_int(w, line);
+  lsp_jw_key(w, "character");
+  lsp_jw_int(w, character);
+  lsp_jw_obj_end(w);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Write LSP range of byte offsets */
+static void
+jrpc_write_range(LspJsonWriter* w, const LspIndex* index, u32 beg, u32 end)
+{
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "start");
+  jrpc_write_pos(w, index, beg);
+  lsp_jw_key(w, "end");
+  jrpc_write_pos(w, index, end);
+  lsp_jw_obj_end(w);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Append 'name: type' to a buffer, or only the name or the type if the other
+ * is missing. Returns the new size, truncated to the buffer */
+static u32
+jrpc_put_typed(char* buf, u32 cap, u32 size, Atom name, Type* type)
+{
+  const char* name_str = name != kAtomNone ? (char*)atom_str(name).ptr : "";
+  Str type_str = type ? type_to_str(type) : make_str("");
+  const char* sep = name != kAtomNone && type ? ": " : "";
+  int n = snprintf(buf + size,
+                   cap - size,
+                   "%s%s%s",
+                   name_str,
+                   sep,
+                   type ? str_cstr(&type_str) : "");
+  if (type) {
+    release_str(&type_str);
   }
-  *read = (u32)_read;
-  return kLspNoErr;
+  return n < 0 ? size : LN_MIN(size + (u32)n, cap - 1);
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_sock_write(Lsp* lsp, u8* buf, u32 buf_size)
+/* Write the hover text of a node. Returns false for nodes without any */
+static bool
+jrpc_hover_text(Ast* ast, char* buf, u32 cap)
 {
-  int sent;
-  chif_net_result result = chif_net_write(lsp->sock, buf, buf_size, &sent);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    return kLspErrOther;
+  u32 size = 0;
+  switch (ast->kind) {
+    case kAstFn: {
+      size = (u32)snprintf(buf, cap, "fn ");
+      size = jrpc_put_typed(buf, cap, size, ast->fn.name, NULL);
+      size += (u32)snprintf(buf + size, cap - size, "(");
+      for (u32 i = 0; i < ast->fn.params.len && size < cap - 1; i++) {
+        Ast* param = ast_list_get(&ast->fn.params, i);
+        if (i > 0) {
+          size += (u32)snprintf(buf + size, cap - size, ", ");
+        }
+        size = jrpc_put_typed(
+          buf, cap, size, param->param.name, param->res_type);
+      }
+      size += (u32)snprintf(buf + size, cap - size, ")");
+      if (ast->res_type && size < cap - 1) {
+        size += (u32)snprintf(buf + size, cap - size, " -> ");
+        jrpc_put_typed(buf, cap, size, kAtomNone, ast->res_type);
+      }
+      return true;
+    }
+    case kAstParam: {
+      jrpc_put_typed(buf, cap, 0, ast->param.name, ast->res_type);
+      return true;
+    }
+    case kAstLet: {
+      size = (u32)snprintf(buf, cap, "let ");
+      jrpc_put_typed(buf, cap, size, ast->let.name, ast->res_type);
+      return true;
+    }
+    case kAstFor: {
+      size = (u32)snprintf(buf, cap, "for ");
+      jrpc_put_typed(buf, cap, size, ast->for_loop.name, ast->res_type);
+      return true;
+    }
+    case kAstVar: {
+      jrpc_put_typed(buf, cap, 0, ast->var.name, ast->res_type);
+      return true;
+    }
+    case kAstBinop:
+    case kAstConst:
+    case kAstIndex:
+    case kAstCall: {
+      if (!ast->res_type) {
+        return false;
+      }
+      jrpc_put_typed(buf, cap, 0, kAtomNone, ast->res_type);
+      return true;
+    }
+    case kAstType: {
+      jrpc_put_typed(buf, cap, 0, kAtomNone, ast->type.type);
+      return true;
+    }
+    default: {
+      return false;
+    }
   }
-  return kLspNoErr;
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_sock_avail(Lsp* lsp, u32* p_avail)
+/* Runs on a worker */
+static void
+jrpc_run_hover(LspJob* job)
 {
-  unsigned long _avail = 0;
-  chif_net_result result = chif_net_get_bytes_available(lsp->sock, &_avail);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    *p_avail = 0;
-    return lsp_err_from_chif_result(result);
+  LspJsonWriter* w = &job->resp;
+  jrpc_resp_begin(w, job->id);
+  lsp_jw_key(w, "result");
+  const LspUnit* unit = jrpc_job_unit(job);
+  Ast* ast = unit ? lsp_index_at(&unit->index, job->off) : NULL;
+  char text[512];
+  if (!ast || !jrpc_hover_text(ast, text, sizeof(text))) {
+    lsp_jw_null(w);
+  } else {
+    lsp_jw_obj_begin(w);
+    lsp_jw_key(w, "contents");
+    lsp_jw_obj_begin(w);
+    lsp_jw_key(w, "kind");
+    lsp_jw_str(w, "plaintext");
+    lsp_jw_key(w, "value");
+    lsp_jw_str(w, text);
+    lsp_jw_obj_end(w);
+    lsp_jw_key(w, "range");
+    jrpc_write_range(
+      w, &unit->index, ast->span.beg.off, ast->span.end.off);
+    lsp_jw_obj_end(w);
   }
-  *p_avail = _avail;
-  return kLspNoErr;
+  lsp_jw_obj_end(w);
 }
 
 // -------------------------------------------------------------------------- //
 
-/* Read 'size' bytes from socket. Buffer is guaranteed to be large enough */
-LspErr
-lsp_sock_read_size(Lsp* lsp, u8* buf, u32 size)
+/* Runs on a worker. Variables resolve to their declaration and calls to the
+ * called function */
+static void
+jrpc_run_definition(LspJob* job)
 {
-  u32 off = 0;
-  while (size > 0) {
-    u32 read;
-    LspErr err = lsp_sock_read(lsp, buf + off, size, &read);
-    LN_LSP_PROP_ERR(err);
-    off += read;
-    size -= read;
+  LspJsonWriter* w = &job->resp;
+  jrpc_resp_begin(w, job->id);
+  lsp_jw_key(w, "result");
+  const LspUnit* unit = jrpc_job_unit(job);
+  Ast* ast = unit ? lsp_index_at(&unit->index, job->off) : NULL;
+  const Ast* decl = NULL;
+  if (ast && ast->kind == kAstVar) {
+    decl = ast->var.decl;
+  } else if (ast && ast->kind == kAstCall) {
+    decl = ast->call.decl;
   }
+  if (!decl) {
+    lsp_jw_null(w);
+  } else {
+    lsp_jw_obj_begin(w);
+    lsp_jw_key(w, "uri");
+    lsp_jw_str_n(w,
+                 (const char*)job->snap->src.name.buf,
+                 job->snap->src.name.size);
+    lsp_jw_key(w, "range");
+    jrpc_write_range(
+      w, &unit->index, decl->span.beg.off, decl->span.end.off);
+    lsp_jw_obj_end(w);
+  }
+  lsp_jw_obj_end(w);
+}
 
-  return kLspNoErr;
+// -------------------------------------------------------------------------- //
+
+/* Returns the name of a declaration (AstFn, AstParam, AstLet or AstFor), or
+ * kAtomNone for other nodes */
+static Atom
+jrpc_decl_name(const Ast* ast)
+{
+  switch (ast->kind) {
+    case kAstFn: {
+      return ast->fn.name;
+    }
+    case kAstParam: {
+      return ast->param.name;
+    }
+    case kAstLet: {
+      return ast->let.name;
+    }
+    case kAstFor: {
+      return ast->for_loop.name;
+    }
+    default: {
+      return kAtomNone;
+    }
+  }
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_recv(Lsp* lsp)
+/* Returns the span of the name of a declaration (AstFn, AstParam, AstLet or
+ * AstFor), or the span of the node for other nodes */
+static Span
+jrpc_decl_name_span(const Ast* ast)
 {
-  // Do we have something to read?
-  bool can_read;
-  LspErr err = lsp_sock_can_read(lsp, &can_read);
-  LN_LSP_PROP_ERR(err);
-  if (!can_read) {
-    return kLspNoErr;
+  switch (ast->kind) {
+    case kAstFn: {
+      return ast->fn.name_span;
+    }
+    case kAstParam: {
+      return ast->param.name_span;
+    }
+    case kAstLet: {
+      return ast->let.name_span;
+    }
+    case kAstFor: {
+      return ast->for_loop.name_span;
+    }
+    default: {
+      return ast->span;
+    }
   }
+}
 
-  // How much?
-  u32 avail;
-  err = lsp_sock_avail(lsp, &avail);
-  LN_LSP_PROP_ERR(err);
+// -------------------------------------------------------------------------- //
+
+/* Begin document symbol, the caller ends it */
+static void
+jrpc_symbol_begin(LspJsonWriter* w, const LspIndex* index, const Ast* ast)
+{
+  // SymbolKind of the LSP
+  const s64 kind_fn = 12;
+  const s64 kind_var = 13;
+
+  Span name_span = jrpc_decl_name_span(ast);
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "name");
+  lsp_jw_str(w, (const char*)atom_str(jrpc_decl_name(ast)).ptr);
+  lsp_jw_key(w, "kind");
+  lsp_jw_int(w, ast->kind == kAstFn ? kind_fn : kind_var);
+  lsp_jw_key(w, "range");
+  jrpc_write_range(w, index, ast->span.beg.off, ast->span.end.off);
+  lsp_jw_key(w, "selectionRange");
+  jrpc_write_range(w, index, name_span.beg.off, name_span.end.off);
+}
+
+// -------------------------------------------------------------------------- //
 
-  // Get a buffer
-  bool heap_buf = false;
-  u8* buf = s_recv_buf;
-  u32 buf_size = s_recv_buf_size;
-  if (avail > buf_size) {
-    buf_size = avail;
-    buf = (u8*)alloc(buf_size + 1, kLnMinAlign);
-    heap_buf = true;
+/* Runs on a worker. Functions with their parameters and variables as
+ * children, read from the index in source order */
+static void
+jrpc_run_symbols(LspJob* job)
+{
+  LspJsonWriter* w = &job->resp;
+  jrpc_resp_begin(w, job->id);
+  lsp_jw_key(w, "result");
+  const LspUnit* unit = jrpc_job_unit(job);
+  if (!unit) {
+    lsp_jw_null(w);
+    lsp_jw_obj_end(w);
+    return;
   }
-  assrt(buf != NULL, make_str("Invalid read buffer"));
 
-  // Read
-  u32 read;
-  err = lsp_sock_read(lsp, buf, avail, &read);
-  LN_LSP_PROP_ERR(err);
-  assrt(read == avail, make_str("Failed to read entire message from client"));
-
-  // Check the content size
-  u32 cont_len = lsp_cont_len(buf, avail);
-  u32 cont_off = lsp_cont_off(buf, avail);
-  u32 pack_size = cont_len + cont_off;
-  u32 size_left = pack_size - avail;
-
-  // Wait for entire message
-  if (size_left > 0) {
-    // Do we need to resize buffer again?
-    if (buf_size < pack_size) {
-      u32 _buf_size = pack_size;
-      u8* _buf = (u8*)alloc(buf_size + 1, kLnMinAlign);
-      memcpy(_buf, buf, buf_size);
-      if (heap_buf) {
-        release(buf);
+  const LspIndex* index = &unit->index;
+  lsp_jw_arr_begin(w);
+  bool in_fn = false;
+  for (u32 i = 0; i < index->entry_count; i++) {
+    const Ast* ast = index->entries[i].ast;
+    if (ast->kind == kAstFn) {
+      if (in_fn) {
+        lsp_jw_arr_end(w);
+        lsp_jw_obj_end(w);
       }
-      buf_size = _buf_size;
-      buf = _buf;
-      heap_buf = true;
+      jrpc_symbol_begin(w, index, ast);
+      lsp_jw_key(w, "children");
+      lsp_jw_arr_begin(w);
+      in_fn = true;
+    } else if (jrpc_decl_name(ast) != kAtomNone) {
+      jrpc_symbol_begin(w, index, ast);
+      lsp_jw_obj_end(w);
     }
+  }
+  if (in_fn) {
+    lsp_jw_arr_end(w);
+    lsp_jw_obj_end(w);
+  }
+  lsp_jw_arr_end(w);
+  lsp_jw_obj_end(w);
+}
+
+// -------------------------------------------------------------------------- //
 
-    // Read entire packet
-    lsp_sock_read_size(lsp, buf + avail, size_left);
+/* Write completion item for a declaration */
+static void
+jrpc_write_completion(LspJsonWriter* w, const Ast* ast)
+{
+  // CompletionItemKind of the LSP
+  const s64 kind_fn = 3;
+  const s64 kind_var = 6;
+
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "label");
+  lsp_jw_str(w, (const char*)atom_str(jrpc_decl_name(ast)).ptr);
+  lsp_jw_key(w, "kind");
+  lsp_jw_int(w, ast->kind == kAstFn ? kind_fn : kind_var);
+  if (ast->res_type) {
+    Str type_str = type_to_str(ast->res_type);
+    lsp_jw_key(w, "detail");
+    lsp_jw_str(w, str_cstr(&type_str));
+    release_str(&type_str);
   }
+  lsp_jw_obj_end(w);
+}
+
+// -------------------------------------------------------------------------- //
 
-  // Send of the content
-  buf[pack_size] = 0;
-  lsp_handle_msg(lsp, (char*)(buf + cont_off));
+/* Runs on a worker. Offers the functions and the declarations of the
+ * enclosing function that come before the position */
+static void
+jrpc_run_completion(LspJob* job)
+{
+  LspJsonWriter* w = &job->resp;
+  jrpc_resp_begin(w, job->id);
+  lsp_jw_key(w, "result");
+  lsp_jw_arr_begin(w);
+  const LspUnit* unit = jrpc_job_unit(job);
+  const LspIndex* index = unit ? &unit->index : NULL;
+  u32 count = index ? index->entry_count : 0;
+  for (u32 i = 0; i < count; i++) {
+    const LspIndexEntry* entry = &index->entries[i];
+    if (entry->ast->kind == kAstFn) {
+      jrpc_write_completion(w, entry->ast);
+      continue;
+    }
+    if (entry->beg >= job->off || jrpc_decl_name(entry->ast) == kAtomNone) {
+      continue;
+    }
 
-  // Free buf
-  if (heap_buf) {
-    release(buf);
+    // Declarations are inside a function, find it through the parents
+    u32 fn = entry->parent;
+    while (fn != kLspIndexNone && index->entries[fn].ast->kind != kAstFn) {
+      fn = index->entries[fn].parent;
+    }
+    if (fn != kLspIndexNone && index->entries[fn].beg <= job->off &&
+        job->off <= index->entries[fn].end) {
+      jrpc_write_completion(w, entry->ast);
+    }
   }
-  return kLspNoErr;
-};
+  lsp_jw_arr_end(w);
+  lsp_jw_obj_end(w);
+}
 
-// ========================================================================== //
-// Lsp
-// ========================================================================== //
+// -------------------------------------------------------------------------- //
 
-Lsp
-make_lsp(void)
+/* Write range of packed semantic tokens */
+static void
+jrpc_write_sem_data(LspJsonWriter* w, const LspSemToks* toks, u32 beg, u32 n)
 {
-  setvbuf(stdout, NULL, _IONBF, 0);
-  chif_net_startup();
-  return (Lsp){ .sock = CHIF_NET_INVALID_SOCKET };
+  lsp_jw_arr_begin(w);
+  for (u32 i = beg; i < beg + n; i++) {
+    lsp_jw_int(w, toks->data[i]);
+  }
+  lsp_jw_arr_end(w);
 }
 
 // -------------------------------------------------------------------------- //
 
-void
-release_lsp(Lsp* lsp)
+/* Runs on a worker. Deltas are a single edit between the common prefix and
+ * suffix of the tokens that the client has and the current ones */
+static void
+jrpc_run_sem_toks(LspJob* job)
 {
-  lsp_disconnect(lsp);
-  chif_net_shutdown();
+  LspJsonWriter* w = &job->resp;
+  jrpc_resp_begin(w, job->id);
+  lsp_jw_key(w, "result");
+  const LspUnit* unit = jrpc_job_unit(job);
+  if (!unit) {
+    lsp_jw_null(w);
+    lsp_jw_obj_end(w);
+    return;
+  }
+
+  // Documents that do not lex keep the tokens that the client has, so that
+  // the highlighting does not flicker while typing
+  LspSemToks* toks = unit->toks ? unit->toks : job->sem;
+  char result_id[16];
+  snprintf(result_id, sizeof(result_id), "%u", job->sem_id);
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "resultId");
+  lsp_jw_str(w, result_id);
+  if (job->kind == kLspJobSemToksDelta) {
+    LspSemEdit edit = lsp_sem_diff(job->sem, toks);
+    lsp_jw_key(w, "edits");
+    lsp_jw_arr_begin(w);
+    if (!lsp_sem_edit_is_empty(&edit)) {
+      lsp_jw_obj_begin(w);
+      lsp_jw_key(w, "start");
+      lsp_jw_int(w, edit.start);
+      lsp_jw_key(w, "deleteCount");
+      lsp_jw_int(w, edit.delete_count);
+      lsp_jw_key(w, "data");
+      jrpc_write_sem_data(w, toks, edit.data_beg, edit.data_count);
+      lsp_jw_obj_end(w);
+    }
+    lsp_jw_arr_end(w);
+  } else {
+    lsp_jw_key(w, "data");
+    jrpc_write_sem_data(w, toks, 0, toks ? toks->count : 0);
+  }
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+
+  lsp_sem_toks_retain(toks);
+  lsp_sem_toks_release(job->sem);
+  job->sem = toks;
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_connect(Lsp* lsp, Str type, Str host, Str port)
+/* Write 'textDocument/publishDiagnostics' notification with the errors of a
+ * unit of a version, or without any errors if there is no unit */
+static void
+jrpc_write_diags(LspJsonWriter* w,
+                 const Str* uri,
+                 s64 version,
+                 const LspUnit* unit)
 {
-  assrt(lsp->sock == CHIF_NET_INVALID_SOCKET,
-        make_str("LSP is already connected"));
-  assrt(str_eq(&type, &make_str("tcp")),
-        make_str("Only tcp servers are implemented at the moment"));
+  // DiagnosticSeverity of the LSP
+  const s64 severity_err = 1;
+
+  jrpc_note_begin(w, "textDocument/publishDiagnostics");
+  lsp_jw_key(w, "params");
+  lsp_jw_obj_begin(w);
+  lsp_jw_key(w, "uri");
+  lsp_jw_str_n(w, (const char*)uri->buf, uri->size);
+  if (unit) {
+    lsp_jw_key(w, "version");
+    lsp_jw_int(w, version);
+  }
+  lsp_jw_key(w, "diagnostics");
+  lsp_jw_arr_begin(w);
+  u32 count = unit ? unit->errs.len : 0;
+  for (u32 i = 0; i < count; i++) {
+    const Err* err = &unit->errs.buf[i];
+    lsp_jw_obj_begin(w);
+    lsp_jw_key(w, "range");
+    jrpc_write_range(w, &unit->index, err->span.beg.off, err->span.end.off);
+    lsp_jw_key(w, "severity");
+    lsp_jw_int(w, severity_err);
+    lsp_jw_key(w, "code");
+    lsp_jw_int(w, err->num);
+    lsp_jw_key(w, "source");
+    lsp_jw_str(w, "lnc");
+    Str msg = str_format(make_str("%s\nSuggestion: %s"),
+                         str_cstr(&err->msg),
+                         str_cstr(&err->sugg));
+    lsp_jw_key(w, "message");
+    lsp_jw_str_n(w, (const char*)msg.buf, msg.size);
+    release_str(&msg);
+    lsp_jw_obj_end(w);
+  }
+  lsp_jw_arr_end(w);
+  lsp_jw_obj_end(w);
+  lsp_jw_obj_end(w);
+}
 
-  printf("LNC: Started LSP server. Type: '%s', Host: '%s', Port: '%s'\n",
-         str_cstr(&type),
-         str_cstr(&host),
-         str_cstr(&port));
+// -------------------------------------------------------------------------- //
 
-  // Create socket
-  chif_net_startup();
-  chif_net_address_family af = CHIF_NET_ADDRESS_FAMILY_IPV4;
-  chif_net_transport_protocol tp = CHIF_NET_TRANSPORT_PROTOCOL_TCP;
-  chif_net_result result = chif_net_open_socket(&lsp->sock, tp, af);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    fprintf(stderr, "Failed to open socket\n");
-    return kLspErrOther;
+/* Runs on a worker. The response is the diagnostics of the document */
+static void
+jrpc_run_analyze(LspJob* job)
+{
+  job->unit = jrpc_analyze(job);
+  if (job->unit) {
+    jrpc_write_diags(
+      &job->resp, &job->snap->src.name, job->snap->version, job->unit);
   }
+}
 
-  // Connect
-  chif_net_address addr;
-  result =
-    chif_net_create_address(&addr, str_cstr(&host), str_cstr(&port), af, tp);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    fprintf(stderr, "Failed to create address\n");
-    return kLspErrOther;
+// -------------------------------------------------------------------------- //
+
+static void
+jrpc_run_job_kind(LspJob* job)
+{
+  switch (job->kind) {
+    case kLspJobAnalyze: {
+      jrpc_run_analyze(job);
+      break;
+    }
+    case kLspJobHover: {
+      jrpc_run_hover(job);
+      break;
+    }
+    case kLspJobDefinition: {
+      jrpc_run_definition(job);
+      break;
+    }
+    case kLspJobSymbols: {
+      jrpc_run_symbols(job);
+      break;
+    }
+    case kLspJobCompletion: {
+      jrpc_run_completion(job);
+      break;
+    }
+    case kLspJobSemToks:
+    case kLspJobSemToksDelta: {
+      jrpc_run_sem_toks(job);
+      break;
+    }
+    default: {
+      panic(make_str("Invalid LspJobKind (%u)"), job->kind);
+    }
   }
-  result = chif_net_connect(lsp->sock, &addr);
-  if (result != CHIF_NET_RESULT_SUCCESS) {
-    fprintf(stderr, "Failed to connect to LSP client\n");
-    return kLspConnFailed;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Replace the analysis of a job, that panicked or faulted, with one that only
+ * reports the failure. The document keeps it until its next change instead of
+ * failing again on every request. It is not cached, the job may have died
+ * inside the cache */
+static void
+jrpc_fail_unit(LspJob* job)
+{
+  lsp_unit_release(job->unit);
+  job->unit = NULL;
+  if (!job->snap) {
+    return;
   }
 
-  return kLspNoErr;
+  ErrList errs = make_err_list();
+  Pos pos = make_pos(0, 0, 0);
+  Err err = {
+    .num = kErrNumNone,
+    .span = make_span(pos, pos),
+    .msg = make_str_copy("Internal compiler error while analyzing this"),
+    .sugg = make_str_copy("Please report the document as a bug"),
+  };
+  err_list_append(&errs, &err);
+  job->unit = make_lsp_unit(job->snap, NULL, (LspAtoms){ 0 }, NULL, errs);
 }
 
 // -------------------------------------------------------------------------- //
 
-void
-lsp_disconnect(Lsp* lsp)
+/* Runs on a worker. A panic or fault of the analysis ends only the job: its
+ * document gets a failed analysis and requests an internal error */
+static void
+jrpc_run_job(LspJob* job)
+{
+  // Cancelled requests are still answered
+  if (lsp_job_is_cancelled(job)) {
+    if (job->id) {
+      jrpc_write_err(
+        &job->resp, job->id, kJrpcRequestCancelled, "Request cancelled");
+    }
+    return;
+  }
+
+  sigjmp_buf env;
+  if (sigsetjmp(env, 1) == 0) {
+    panic_set_recover(&env);
+    jrpc_run_job_kind(job);
+    panic_set_recover(NULL);
+    return;
+  }
+  panic_set_recover(NULL);
+
+  lsp_jw_reset(&job->resp);
+  jrpc_fail_unit(job);
+  if (job->kind == kLspJobAnalyze) {
+    if (job->unit) {
+      jrpc_write_diags(
+        &job->resp, &job->snap->src.name, job->snap->version, job->unit);
+    }
+  } else if (job->id) {
+    jrpc_write_err(
+      &job->resp, job->id, kJrpcInternalError, "Internal compiler error");
+  }
+}
+
+// ========================================================================== //
+// LspRing
+// ========================================================================== //
+
+/* Initial capacity of the ring buffer */
+#define kLspRingMinCap 16384
+
+// -------------------------------------------------------------------------- //
+
+/* Copy the first 'size' bytes of the ring to 'dst' */
+static void
+lsp_ring_peek(const LspRing* ring, u8* dst, u32 size)
+{
+  u32 first = LN_MIN(size, ring->cap - ring->head);
+  memcpy(dst, ring->buf + ring->head, first);
+  memcpy(dst + first, ring->buf, size - first);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_ring_consume(LspRing* ring, u32 size)
+{
+  ring->head = (ring->head + size) & (ring->cap - 1);
+  ring->size -= size;
+  if (ring->size == 0) {
+    ring->head = 0;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Make sure that there is room for at least 'size' more bytes. Growing the
+ * buffer moves the content to the front */
+static void
+lsp_ring_reserve(LspRing* ring, u32 size)
 {
-  if (lsp->sock == CHIF_NET_INVALID_SOCKET) {
+  if (ring->cap - ring->size >= size) {
     return;
   }
-  chif_net_close_socket(&lsp->sock);
-  lsp->sock = CHIF_NET_INVALID_SOCKET;
+  u32 cap = ring->cap ? ring->cap : kLspRingMinCap;
+  while (cap - ring->size < size) {
+    assrt(cap < 0x80000000u, make_str("LSP receive buffer is too large"));
+    cap *= 2;
+  }
+  u8* buf = (u8*)alloc(cap, kLnMinAlign);
+  assrt(buf != NULL, make_str("Failed to grow LSP receive buffer"));
+  if (ring->buf) {
+    lsp_ring_peek(ring, buf, ring->size);
+    release(ring->buf);
+  }
+  ring->buf = buf;
+  ring->cap = cap;
+  ring->head = 0;
 }
 
 // -------------------------------------------------------------------------- //
 
-LspErr
-lsp_run(Lsp* lsp)
+/* Returns the contiguous free space after the last byte */
+static u8*
+lsp_ring_tail(LspRing* ring, u32* p_space)
 {
-  while (1) {
-    LspErr err = lsp_recv(lsp);
-    if (err != kLspNoErr) {
-      return err;
+  u32 tail = (ring->head + ring->size) & (ring->cap - 1);
+  bool wrapped = tail < ring->head || ring->size == ring->cap;
+  *p_space = (wrapped ? ring->head : ring->cap) - tail;
+  return ring->buf + tail;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_ring_push(LspRing* ring, const u8* buf, u32 size)
+{
+  lsp_ring_reserve(ring, size);
+  while (size > 0) {
+    u32 space;
+    u8* tail = lsp_ring_tail(ring, &space);
+    u32 count = LN_MIN(space, size);
+    memcpy(tail, buf, count);
+    ring->size += count;
+    buf += count;
+    size -= count;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+release_lsp_ring(LspRing* ring)
+{
+  if (ring->buf) {
+    release(ring->buf);
+  }
+  *ring = (LspRing){ 0 };
+}
+
+// ========================================================================== //
+// LspFrame
+// ========================================================================== //
+
+/* Upper limit for 'Content-Length' */
+#define kLspContentMax (256u * 1024u * 1024u)
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_frame_reset(LspFrame* frame)
+{
+  frame->state = kLspFrameHeader;
+  frame->has_len = false;
+  frame->cont_len = 0;
+  frame->line_len = 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Handle a complete header line, without the line ending. Fields other than
+ * 'Content-Length' (i.e. 'Content-Type') are ignored */
+static LspErr
+lsp_frame_header_line(LspFrame* frame)
+{
+  // An empty line ends the header
+  if (frame->line_len == 0) {
+    if (!frame->has_len) {
+      return kLspFrameErr;
     }
+    frame->state = kLspFrameContent;
+    return kLspNoErr;
   }
 
-  return kLspNoErr;
-}
\ No newline at end of file
+  const char* line = frame->line;
+  const char* end = line + frame->line_len;
+  const char* colon = memchr(line, ':', frame->line_len);
+  if (!colon) {
+    return kLspFrameErr;
+  }
+  const char kName[] = "Content-Length";
+  if ((u32)(colon - line) != sizeof(kName) - 1 ||
+      strncasecmp(line, kName, sizeof(kName) - 1) != 0) {
+    return kLspNoErr;
+  }
+
+  // Parse value
+  const char* cur = colon + 1;
+  while (cur < end && (*cur == ' ' || *cur == '\t')) {
+    cur++;
+  }
+  if (cur == end) {
+    return kLspFrameErr;
+  }
+  u64 len = 0;
+  for (; cur < end && *cur >= '0' && *cur <= '9'; cur++) {
+    len = len * 10 + (u64)(*cur - '0');
+    if (len > kLspContentMax) {
+      return kLspFrameErr;
+    }
+  }
+  while (cur < end && (*cur == ' ' || *cur == '\t')) {
+    cur++;
+  }
+  if (cur != end) {
+    return kLspFrameErr;
+  }
+  frame->has_len = true;
+  frame->cont_len = (u32)len;
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Feed one header byte to the state machine */
+static LspErr
+lsp_frame_feed(LspFrame* frame, u8 c)
+{
+  if (c == '\n') {
+    if (frame->line_len > 0 && frame->line[frame->line_len - 1] == '\r') {
+      frame->line_len--;
+    }
+    LspErr err = lsp_frame_header_line(frame);
+    frame->line_len = 0;
+    return err;
+  }
+  if (frame->line_len == kLspHeaderLineMax) {
+    return kLspFrameErr;
+  }
+  frame->line[frame->line_len++] = (char)c;
+  return kLspNoErr;
+}
+
+// ========================================================================== //
+// Jobs
+// ========================================================================== //
+
+/* Submit a job that answers a client */
+static void
+lsp_job_submit(Lsp* lsp, LspClient* client, LspJob* job)
+{
+  job->client = client;
+  job->cache = &lsp->cache;
+  job->dbg_panic = lsp->dbg_panic;
+  job->prev_flight = NULL;
+  job->next_flight = lsp->flight;
+  if (lsp->flight) {
+    lsp->flight->prev_flight = job;
+  }
+  lsp->flight = job;
+  lsp_pool_submit(&lsp->pool, job);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_job_unlink(Lsp* lsp, LspJob* job)
+{
+  if (job->prev_flight) {
+    job->prev_flight->next_flight = job->next_flight;
+  } else {
+    lsp->flight = job->next_flight;
+  }
+  if (job->next_flight) {
+    job->next_flight->prev_flight = job->prev_flight;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Cancel the request of a client with id 'id' (JSON text), if it is still in
+ * flight */
+static void
+lsp_job_cancel(Lsp* lsp, LspClient* client, const char* id)
+{
+  for (LspJob* job = lsp->flight; job; job = job->next_flight) {
+    if (job->client == client && job->id && cstr_eq(job->id, id)) {
+      atomic_store_explicit(&job->cancelled, true, memory_order_relaxed);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Cancel the analysis of older versions of a document of a client */
+static void
+lsp_job_supersede(Lsp* lsp, LspClient* client, const Str* uri)
+{
+  for (LspJob* job = lsp->flight; job; job = job->next_flight) {
+    if (job->client == client && job->kind == kLspJobAnalyze &&
+        str_eq(&job->snap->src.name, uri)) {
+      atomic_store_explicit(&job->cancelled, true, memory_order_relaxed);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Cancel the jobs of a client that disconnects. They finish without it */
+static void
+lsp_job_orphan(Lsp* lsp, LspClient* client)
+{
+  for (LspJob* job = lsp->flight; job; job = job->next_flight) {
+    if (job->client == client) {
+      atomic_store_explicit(&job->cancelled, true, memory_order_relaxed);
+      job->client = NULL;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Keep the analysis of a finished job in its document, unless the document
+ * already has one of a later version */
+static void
+lsp_job_adopt_unit(LspClient* client, LspJob* job)
+{
+  if (!job->unit) {
+    return;
+  }
+  LspDoc* doc = lsp_doc_store_get(&client->docs, &job->snap->src.name);
+  if (!doc || doc->unit_snap == job->snap) {
+    return;
+  }
+  if (doc->unit_snap && doc->unit_snap->version > job->snap->version) {
+    return;
+  }
+  lsp_unit_release(doc->unit);
+  lsp_snap_release(doc->unit_snap);
+  doc->unit = lsp_unit_retain(job->unit);
+  doc->unit_snap = lsp_snap_retain(job->snap);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Remember the semantic tokens that a finished job sent to the client, the
+ * next delta is computed against them */
+static void
+lsp_job_adopt_sem(LspClient* client, LspJob* job)
+{
+  if (job->kind != kLspJobSemToks && job->kind != kLspJobSemToksDelta) {
+    return;
+  }
+  if (!job->snap || lsp_job_is_cancelled(job)) {
+    return;
+  }
+  LspDoc* doc = lsp_doc_store_get(&client->docs, &job->snap->src.name);
+  if (!doc || doc->sem_id > job->sem_id) {
+    return;
+  }
+  lsp_sem_toks_release(doc->sem_toks);
+  doc->sem_toks = lsp_sem_toks_retain(job->sem);
+  doc->sem_id = job->sem_id;
+}
+
+// -------------------------------------------------------------------------- //
+
+static LspErr
+lsp_client_fail(Lsp* lsp, LspClient* client, LspErr err);
+
+// -------------------------------------------------------------------------- //
+
+/* Send the responses of the jobs that the workers have finished. The
+ * notifications of jobs that were superseded while finishing are dropped, as
+ * are the responses to clients that have disconnected */
+static LspErr
+lsp_job_finish(Lsp* lsp)
+{
+  LspErr result = kLspNoErr;
+  LspJob* job = lsp_pool_take_done(&lsp->pool);
+  while (job) {
+    LspJob* next = job->next_done;
+    LspClient* client = job->client;
+    bool stale = !job->id && lsp_job_is_cancelled(job);
+    LspErr err = kLspNoErr;
+    if (client && job->resp.buf && !stale && result == kLspNoErr) {
+      u32 size;
+      const char* msg = lsp_jw_finish(&job->resp, &size);
+      err = lsp_send(lsp, client, (const u8*)msg, size);
+    }
+    if (client) {
+      lsp_job_adopt_unit(client, job);
+      lsp_job_adopt_sem(client, job);
+    }
+    lsp_job_unlink(lsp, job);
+    release_lsp_job(job);
+    if (err != kLspNoErr) {
+      result = lsp_client_fail(lsp, client, err);
+    }
+    job = next;
+  }
+  return result;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Release the jobs in flight. The pool must be stopped */
+static void
+lsp_job_clear(Lsp* lsp)
+{
+  while (lsp->flight) {
+    LspJob* job = lsp->flight;
+    lsp_job_unlink(lsp, job);
+    release_lsp_job(job);
+  }
+}
+
+// ========================================================================== //
+// Net
+// ========================================================================== //
+
+/* Minimum number of free bytes in the receive buffer before each read */
+#define kLspRecvChunk 4096
+
+/* Maximum number of events handled per wakeup of the reactor */
+#define kLspMaxEvents 8
+
+/* Time without changes to a document before it is analyzed */
+#define kLspDebounceMs 150
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the text of a string member, or NULL */
+static const char*
+lsp_get_str(LspJson* json, u32 obj, const char* key, u32* p_size)
+{
+  return lsp_json_str(json, lsp_json_get(json, obj, key), p_size);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the value of a number member, or 0 */
+static f64
+lsp_get_num(const LspJson* json, u32 obj, const char* key)
+{
+  return lsp_json_num(json, lsp_json_get(json, obj, key));
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the byte offset of an LSP position (object) in a document */
+static u32
+lsp_get_pos_off(const LspJson* json, u32 pos, const LspDoc* doc)
+{
+  return lsp_doc_pos_off(doc,
+                         (u32)lsp_get_num(json, pos, "line"),
+                         (u32)lsp_get_num(json, pos, "character"));
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Analyze the new version of a document, any analysis of older versions is
+ * superseded */
+static void
+lsp_analyze_doc(Lsp* lsp, LspClient* client, LspDoc* doc)
+{
+  lsp_job_supersede(lsp, client, &doc->uri);
+  doc->analyze_at = 0;
+  LspSnap* snap = lsp_doc_snap(doc);
+  lsp_job_submit(lsp, client, make_lsp_job(kLspJobAnalyze, NULL, snap));
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the monotonic time in nanoseconds */
+static u64
+lsp_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Arm the debounce timer to fire at the monotonic time 'at' */
+static void
+lsp_debounce_arm(Lsp* lsp, u64 at)
+{
+  struct itimerspec spec = { .it_value = { .tv_sec = at / 1000000000ull,
+                                           .tv_nsec = at % 1000000000ull } };
+  timerfd_settime(lsp->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+  lsp->timer_at = at;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Analyze a changed document once the client stops editing it for the length
+ * of the debounce window. Each change restarts the window, so a burst of
+ * changes is analyzed once. Analysis of the older versions is superseded
+ * right away as its diagnostics would be stale */
+static void
+lsp_debounce_doc(Lsp* lsp, LspClient* client, LspDoc* doc)
+{
+  lsp_job_supersede(lsp, client, &doc->uri);
+  doc->analyze_at = lsp_now() + kLspDebounceMs * 1000000ull;
+
+  // Deadlines only move forward, an armed timer fires first
+  if (lsp->timer_at == 0) {
+    lsp_debounce_arm(lsp, doc->analyze_at);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Analyze the documents whose debounce window has passed, of all clients, and
+ * re-arm the timer for the rest */
+static void
+lsp_debounce_fire(Lsp* lsp)
+{
+  u64 expirations;
+  if (read(lsp->timer_fd, &expirations, sizeof(expirations)) == -1) {
+    return;
+  }
+
+  u64 now = lsp_now();
+  u64 next = 0;
+  for (LspClient* client = lsp->clients; client; client = client->next) {
+    for (u32 i = 0; i < client->docs.cap; i++) {
+      LspDoc* doc = client->docs.slots[i];
+      if (!doc || doc->analyze_at == 0) {
+        continue;
+      }
+      if (doc->analyze_at <= now) {
+        lsp_analyze_doc(lsp, client, doc);
+      } else if (next == 0 || doc->analyze_at < next) {
+        next = doc->analyze_at;
+      }
+    }
+  }
+
+  lsp->timer_at = 0;
+  if (next != 0) {
+    lsp_debounce_arm(lsp, next);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Apply the changes of 'textDocument/didChange' in order. A change with a
+ * range replaces that range, one without replaces the entire document. The
+ * text is decoded in place in the message */
+static void
+lsp_apply_changes(LspJson* json, u32 changes, LspDoc* doc)
+{
+  for (u32 change = lsp_json_first(json, changes); change != kLspJsonNone;
+       change = lsp_json_next(json, changes, change)) {
+    u32 text_size;
+    const char* text = lsp_get_str(json, change, "text", &text_size);
+    if (!text) {
+      continue;
+    }
+    u32 range = lsp_json_get(json, change, "range");
+    if (range == kLspJsonNone) {
+      lsp_doc_edit(doc, 0, lsp_doc_size(doc), (const u8*)text, text_size);
+      continue;
+    }
+    u32 beg = lsp_json_get(json, range, "start");
+    u32 end = lsp_json_get(json, range, "end");
+    u32 beg_off = lsp_get_pos_off(json, beg, doc);
+    u32 end_off = lsp_get_pos_off(json, end, doc);
+    end_off = LN_MAX(beg_off, end_off);
+    lsp_doc_edit(
+      doc, beg_off, end_off - beg_off, (const u8*)text, text_size);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Make job for a query about the current version of a document. The
+ * analysis of the document is reused if it is up to date */
+static LspJob*
+lsp_make_query(LspJobKind kind, const char* id, LspDoc* doc)
+{
+  LspJob* job = make_lsp_job(kind, id, doc ? lsp_doc_snap(doc) : NULL);
+  if (doc && doc->unit && doc->unit_snap == job->snap) {
+    job->unit = lsp_unit_retain(doc->unit);
+  }
+  return job;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Submit a query about a document. The position of the request is resolved
+ * here, against the same version that the query sees */
+static void
+lsp_submit_query(Lsp* lsp,
+                 LspClient* client,
+                 LspJobKind kind,
+                 const char* id,
+                 LspDoc* doc,
+                 u32 params)
+{
+  LspJob* job = lsp_make_query(kind, id, doc);
+  if (doc) {
+    u32 pos = lsp_json_get(&lsp->in, params, "position");
+    job->off = lsp_get_pos_off(&lsp->in, pos, doc);
+  }
+  lsp_job_submit(lsp, client, job);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Submit a semantic tokens request. A delta is only possible against the
+ * tokens that the client has, all tokens are sent otherwise */
+static void
+lsp_submit_sem(Lsp* lsp,
+               LspClient* client,
+               bool delta,
+               const char* id,
+               LspDoc* doc,
+               u32 params)
+{
+  if (delta && doc && doc->sem_id != 0) {
+    const char* prev_id =
+      lsp_get_str(&lsp->in, params, "previousResultId", NULL);
+    delta = prev_id && strtoul(prev_id, NULL, 10) == doc->sem_id;
+  } else {
+    delta = false;
+  }
+
+  LspJob* job =
+    lsp_make_query(delta ? kLspJobSemToksDelta : kLspJobSemToks, id, doc);
+  if (doc) {
+    job->sem = lsp_sem_toks_retain(doc->sem_toks);
+    job->sem_id = ++lsp->sem_id;
+  }
+  lsp_job_submit(lsp, client, job);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Handle a message from a client on the I/O thread. Only cheap requests are
+ * answered here, the others are submitted to the workers. The message is read
+ * in place, it must be followed by one byte that can be overwritten */
+LspErr
+lsp_handle_msg(Lsp* lsp, LspClient* client, char* buf, u32 size)
+{
+  // Determine method. Responses to our own requests have none
+  LspJson* json = &lsp->in;
+  if (!lsp_json_parse(json, buf, size)) {
+    return kLspNoErr;
+  }
+  u32 root = 0;
+  u32 params = lsp_json_get(json, root, "params");
+  u32 doc_json = lsp_json_get(json, params, "textDocument");
+  const char* id = lsp_json_raw(json, lsp_json_get(json, root, "id"), NULL);
+  u32 uri_size;
+  const char* uri = lsp_get_str(json, doc_json, "uri", &uri_size);
+  Str uri_str = uri ? make_str_cstr(uri) : str_null();
+  LspDoc* doc = uri ? lsp_doc_store_get(&client->docs, &uri_str) : NULL;
+  const char* method = lsp_get_str(json, root, "method", NULL);
+  if (!method) {
+    return kLspNoErr;
+  }
+  const Str method_str = make_str_cstr(method);
+
+  // Delegate control
+  LspErr err = kLspNoErr;
+  if (str_eq(&method_str, &make_str("textDocument/didChange"))) {
+    if (doc) {
+      lsp_apply_changes(
+        json, lsp_json_get(json, params, "contentChanges"), doc);
+      doc->version = (s64)lsp_get_num(json, doc_json, "version");
+      lsp_debounce_doc(lsp, client, doc);
+    }
+  } else if (str_eq(&method_str, &make_str("textDocument/completion")) && id) {
+    lsp_submit_query(lsp, client, kLspJobCompletion, id, doc, params);
+  } else if (str_eq(&method_str,
+                    &make_str("textDocument/semanticTokens/full")) &&
+             id) {
+    lsp_submit_sem(lsp, client, false, id, doc, params);
+  } else if (str_eq(&method_str,
+                    &make_str("textDocument/semanticTokens/full/delta")) &&
+             id) {
+    lsp_submit_sem(lsp, client, true, id, doc, params);
+  } else if (str_eq(&method_str, &make_str("textDocument/hover")) && id) {
+    lsp_submit_query(lsp, client, kLspJobHover, id, doc, params);
+  } else if (str_eq(&method_str, &make_str("textDocument/definition")) &&
+             id) {
+    lsp_submit_query(lsp, client, kLspJobDefinition, id, doc, params);
+  } else if (str_eq(&method_str, &make_str("textDocument/documentSymbol")) &&
+             id) {
+    lsp_submit_query(lsp, client, kLspJobSymbols, id, doc, params);
+  } else if (str_eq(&method_str, &make_str("textDocument/didOpen")) && uri) {
+    u32 text_size;
+    const char* text = lsp_get_str(json, doc_json, "text", &text_size);
+    if (text) {
+      doc = make_lsp_doc(&uri_str,
+                         (s64)lsp_get_num(json, doc_json, "version"),
+                         (const u8*)text,
+                         text_size);
+      lsp_doc_store_put(&client->docs, doc);
+      lsp_analyze_doc(lsp, client, doc);
+    }
+  } else if (str_eq(&method_str, &make_str("textDocument/didClose")) && uri) {
+    lsp_job_supersede(lsp, client, &uri_str);
+    lsp_doc_store_remove(&client->docs, &uri_str);
+
+    // Clear the diagnostics of the document
+    jrpc_write_diags(&lsp->out, &uri_str, 0, NULL);
+    err = jrpc_send(lsp, client);
+  } else if (str_eq(&method_str, &make_str("$/cancelRequest"))) {
+    const char* cancel_id =
+      lsp_json_raw(json, lsp_json_get(json, params, "id"), NULL);
+    if (cancel_id) {
+      lsp_job_cancel(lsp, client, cancel_id);
+    }
+  } else if (str_eq(&method_str, &make_str("initialize")) && id) {
+    err = jrpc_handle_init(lsp, client, id);
+  } else if (str_eq(&method_str, &make_str("shutdown")) && id) {
+    jrpc_resp_begin(&lsp->out, id);
+    lsp_jw_key(&lsp->out, "result");
+    lsp_jw_null(&lsp->out);
+    lsp_jw_obj_end(&lsp->out);
+    err = jrpc_send(lsp, client);
+  } else if (str_eq(&method_str, &make_str("exit"))) {
+    // Stops the reactor, or disconnects the client of a server that listens
+    err = kLspExit;
+  } else if (id) {
+    jrpc_write_err(&lsp->out, id, kJrpcMethodNotFound, "Method not found");
+    err = jrpc_send(lsp, client);
+  }
+  return err;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Read from the input. Reads 0 bytes if no data is available yet */
+static LspErr
+lsp_io_read(LspClient* client, u8* buf, u32 buf_size, u32* p_read)
+{
+  *p_read = 0;
+  ssize_t result = read(client->in_fd, buf, buf_size);
+  if (result > 0) {
+    *p_read = (u32)result;
+    return kLspNoErr;
+  }
+  if (result == 0) {
+    return kLspConnLost;
+  }
+  if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+    return kLspNoErr;
+  }
+  return kLspRecvFail;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Write to the output. Writes 0 bytes if the output is full */
+static LspErr
+lsp_io_write(LspClient* client, const u8* buf, u32 buf_size, u32* p_written)
+{
+  *p_written = 0;
+  ssize_t result = write(client->out_fd, buf, buf_size);
+  if (result >= 0) {
+    *p_written = (u32)result;
+    return kLspNoErr;
+  }
+  if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+    return kLspNoErr;
+  }
+  return errno == EPIPE || errno == ECONNRESET ? kLspConnLost : kLspErrOther;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Set the events that the reactor waits for on the output of a client */
+static LspErr
+lsp_poll_output(Lsp* lsp, LspClient* client, bool writable)
+{
+  u32 events = writable ? EPOLLOUT : 0;
+  if (client->out_fd == client->in_fd) {
+    events |= EPOLLIN | EPOLLRDHUP;
+  }
+  struct epoll_event event = { .events = events, .data.fd = client->out_fd };
+  if (epoll_ctl(lsp->poll_fd, EPOLL_CTL_MOD, client->out_fd, &event) == -1) {
+    return kLspErrOther;
+  }
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Write as much of the queued output as possible without blocking */
+static LspErr
+lsp_flush(Lsp* lsp, LspClient* client)
+{
+  LspRing* ring = &client->send;
+  while (ring->size > 0) {
+    u32 size = LN_MIN(ring->size, ring->cap - ring->head);
+    u32 written;
+    LspErr err = lsp_io_write(client, ring->buf + ring->head, size, &written);
+    LN_LSP_PROP_ERR(err);
+    if (written == 0) {
+      return kLspNoErr;
+    }
+    lsp_ring_consume(ring, written);
+  }
+  return lsp_poll_output(lsp, client, false);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Send bytes to a client. Whatever can not be written right away is queued
+ * and written once the reactor reports that the output is writable */
+static LspErr
+lsp_send(Lsp* lsp, LspClient* client, const u8* buf, u32 buf_size)
+{
+  if (client->send.size == 0) {
+    while (buf_size > 0) {
+      u32 written;
+      LspErr err = lsp_io_write(client, buf, buf_size, &written);
+      LN_LSP_PROP_ERR(err);
+      if (written == 0) {
+        break;
+      }
+      buf += written;
+      buf_size -= written;
+    }
+    if (buf_size == 0) {
+      return kLspNoErr;
+    }
+    LspErr err = lsp_poll_output(lsp, client, true);
+    LN_LSP_PROP_ERR(err);
+  }
+  lsp_ring_push(&client->send, buf, buf_size);
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Dispatch all complete messages that have been received. A trailing partial
+ * message is kept in the ring buffer until more data arrives */
+static LspErr
+lsp_recv_dispatch(Lsp* lsp, LspClient* client)
+{
+  LspRing* ring = &client->recv;
+  LspFrame* frame = &client->frame;
+  while (1) {
+    // Feed header bytes to the state machine
+    while (frame->state == kLspFrameHeader && ring->size > 0) {
+      u8 c = ring->buf[ring->head];
+      lsp_ring_consume(ring, 1);
+      LspErr err = lsp_frame_feed(frame, c);
+      LN_LSP_PROP_ERR(err);
+    }
+    if (frame->state == kLspFrameHeader) {
+      return kLspNoErr;
+    }
+
+    // Wait for the entire content, making sure that it fits
+    u32 cont_len = frame->cont_len;
+    if (ring->size < cont_len) {
+      lsp_ring_reserve(ring, cont_len - ring->size);
+      return kLspNoErr;
+    }
+
+    // The content is terminated in place unless it wraps around or ends at
+    // the end of the buffer, the byte after it belongs to the next message
+    LspErr err;
+    if (ring->head + cont_len < ring->cap) {
+      u8* cont = ring->buf + ring->head;
+      u8 next = cont[cont_len];
+      err = lsp_handle_msg(lsp, client, (char*)cont, cont_len);
+      cont[cont_len] = next;
+    } else {
+      u8* cont = (u8*)alloc(cont_len + 1, kLnMinAlign);
+      lsp_ring_peek(ring, cont, cont_len);
+      err = lsp_handle_msg(lsp, client, (char*)cont, cont_len);
+      release(cont);
+    }
+    lsp_ring_consume(ring, cont_len);
+    lsp_frame_reset(frame);
+    LN_LSP_PROP_ERR(err);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Called by the reactor when the input of a client is readable */
+LspErr
+lsp_recv(Lsp* lsp, LspClient* client)
+{
+  lsp_ring_reserve(&client->recv, kLspRecvChunk);
+  u32 space;
+  u8* tail = lsp_ring_tail(&client->recv, &space);
+  u32 read;
+  LspErr err = lsp_io_read(client, tail, space, &read);
+  LN_LSP_PROP_ERR(err);
+  if (read == 0) {
+    return kLspNoErr;
+  }
+  client->recv.size += read;
+  return lsp_recv_dispatch(lsp, client);
+}
+
+// ========================================================================== //
+// LspClient
+// ========================================================================== //
+
+static LspClient*
+make_lsp_client(chif_net_socket sock, int in_fd, int out_fd)
+{
+  LspClient* client = alloc(sizeof(LspClient), kLnMinAlign);
+  assrt(client != NULL, make_str("Failed to allocate LSP client"));
+  *client = (LspClient){ .sock = sock,
+                         .in_fd = in_fd,
+                         .out_fd = out_fd,
+                         .docs = make_lsp_doc_store() };
+  lsp_frame_reset(&client->frame);
+  return client;
+}
+
+// -------------------------------------------------------------------------- //
+
+static LspErr
+lsp_set_nonblock(int fd, bool nonblock)
+{
+  int flags = fcntl(fd, F_GETFL);
+  if (flags == -1) {
+    return kLspErrOther;
+  }
+  flags = nonblock ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+  if (fcntl(fd, F_SETFL, flags) == -1) {
+    return kLspErrOther;
+  }
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Add a client, making its descriptors non-blocking and registering them with
+ * the reactor. The client is added even if this fails */
+static LspErr
+lsp_client_open(Lsp* lsp, LspClient* client)
+{
+  client->next = lsp->clients;
+  lsp->clients = client;
+
+  LspErr err = lsp_set_nonblock(client->in_fd, true);
+  LN_LSP_PROP_ERR(err);
+  err = lsp_set_nonblock(client->out_fd, true);
+  LN_LSP_PROP_ERR(err);
+  struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP,
+                               .data.fd = client->in_fd };
+  if (epoll_ctl(lsp->poll_fd, EPOLL_CTL_ADD, client->in_fd, &event) == -1) {
+    fprintf(stderr, "Failed to register LSP input with reactor\n");
+    return kLspErrOther;
+  }
+  if (client->out_fd != client->in_fd) {
+    event = (struct epoll_event){ .events = 0, .data.fd = client->out_fd };
+    if (epoll_ctl(lsp->poll_fd, EPOLL_CTL_ADD, client->out_fd, &event) == -1) {
+      fprintf(stderr, "Failed to register LSP output with reactor\n");
+      return kLspErrOther;
+    }
+  }
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Remove and release a client. Its jobs in flight finish without it */
+static void
+lsp_client_drop(Lsp* lsp, LspClient* client)
+{
+  LspClient** link = &lsp->clients;
+  while (*link != client) {
+    link = &(*link)->next;
+  }
+  *link = client->next;
+  lsp_job_orphan(lsp, client);
+
+  epoll_ctl(lsp->poll_fd, EPOLL_CTL_DEL, client->in_fd, NULL);
+  if (client->out_fd != client->in_fd) {
+    epoll_ctl(lsp->poll_fd, EPOLL_CTL_DEL, client->out_fd, NULL);
+  }
+
+  // The standard streams are shared with the parent process, restore them
+  if (lsp->transport == kLspTransportStdio) {
+    lsp_set_nonblock(client->in_fd, false);
+    if (client->out_fd != -1) {
+      lsp_set_nonblock(client->out_fd, false);
+      dup2(client->out_fd, STDOUT_FILENO);
+      close(client->out_fd);
+    }
+  }
+  if (client->sock != CHIF_NET_INVALID_SOCKET) {
+    chif_net_close_socket(&client->sock);
+  }
+
+  release_lsp_doc_store(&client->docs);
+  release_lsp_ring(&client->send);
+  release_lsp_ring(&client->recv);
+  release(client);
+}
+
+// -------------------------------------------------------------------------- //
+
+static LspErr
+lsp_client_fail(Lsp* lsp, LspClient* client, LspErr err)
+{
+  // Only a server that listens outlives its clients
+  if (err == kLspNoErr || lsp->transport != kLspTransportTcpListen) {
+    return err;
+  }
+  Str err_str = lsp_err_str(err);
+  fprintf(stderr, "LNC: LSP client disconnected (%s)\n", str_cstr(&err_str));
+  lsp_client_drop(lsp, client);
+  lsp_cache_log(&lsp->cache);
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the client that a descriptor belongs to, or NULL */
+static LspClient*
+lsp_client_of_fd(const Lsp* lsp, int fd)
+{
+  for (LspClient* client = lsp->clients; client; client = client->next) {
+    if (client->in_fd == fd || client->out_fd == fd) {
+      return client;
+    }
+  }
+  return NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Handle the events of a descriptor of a client. Input is read before a
+ * hang-up is reported so that no trailing message is dropped */
+static LspErr
+lsp_client_event(Lsp* lsp, LspClient* client, int fd, u32 flags)
+{
+  if (fd == client->in_fd && (flags & EPOLLIN)) {
+    LspErr err = lsp_recv(lsp, client);
+    LN_LSP_PROP_ERR(err);
+  } else if (flags & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+    return kLspConnLost;
+  }
+  if (fd == client->out_fd && (flags & EPOLLOUT)) {
+    return lsp_flush(lsp, client);
+  }
+  return kLspNoErr;
+}
+
+// ========================================================================== //
+// Lsp
+// ========================================================================== //
+
+/* Maximum number of connections that wait to be accepted */
+#define kLspListenBacklog 16
+
+// -------------------------------------------------------------------------- //
+
+Lsp
+make_lsp(u64 cache_budget)
+{
+  setvbuf(stdout, NULL, _IONBF, 0);
+  chif_net_startup();
+  return (Lsp){ .listen_sock = CHIF_NET_INVALID_SOCKET,
+                .poll_fd = -1,
+                .timer_fd = -1,
+                .pool = { .wake_fd = -1 },
+                .cache = make_lsp_cache(cache_budget),
+                .in = make_lsp_json(),
+                .out = make_lsp_json_writer() };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp(Lsp* lsp)
+{
+  lsp_disconnect(lsp);
+  release_lsp_json_writer(&lsp->out);
+  release_lsp_json(&lsp->in);
+  release_lsp_cache(&lsp->cache);
+  chif_net_shutdown();
+}
+
+// -------------------------------------------------------------------------- //
+
+static LspErr
+lsp_open_tcp(Lsp* lsp, Str host, Str port, bool listen)
+{
+  // Create socket
+  chif_net_address_family af = CHIF_NET_ADDRESS_FAMILY_IPV4;
+  chif_net_transport_protocol tp = CHIF_NET_TRANSPORT_PROTOCOL_TCP;
+  chif_net_socket sock;
+  chif_net_result result = chif_net_open_socket(&sock, tp, af);
+  if (result != CHIF_NET_RESULT_SUCCESS) {
+    fprintf(stderr, "Failed to open socket\n");
+    return kLspErrOther;
+  }
+  chif_net_address addr;
+  result =
+    chif_net_create_address(&addr, str_cstr(&host), str_cstr(&port), af, tp);
+  if (result != CHIF_NET_RESULT_SUCCESS) {
+    fprintf(stderr, "Failed to create address\n");
+    chif_net_close_socket(&sock);
+    return kLspErrOther;
+  }
+
+  // Connect to the client
+  if (!listen) {
+    result = chif_net_connect(sock, &addr);
+    if (result != CHIF_NET_RESULT_SUCCESS) {
+      fprintf(stderr, "Failed to connect to LSP client\n");
+      chif_net_close_socket(&sock);
+      return kLspConnFailed;
+    }
+    return lsp_client_open(lsp, make_lsp_client(sock, (int)sock, (int)sock));
+  }
+
+  // Or listen for clients, which the reactor accepts
+  chif_net_set_reuse_addr(sock, true);
+  result = chif_net_bind(sock, &addr);
+  if (result == CHIF_NET_RESULT_SUCCESS) {
+    result = chif_net_listen(sock, kLspListenBacklog);
+  }
+  if (result != CHIF_NET_RESULT_SUCCESS) {
+    fprintf(stderr, "Failed to listen for LSP clients\n");
+    chif_net_close_socket(&sock);
+    return kLspConnFailed;
+  }
+  lsp->listen_sock = sock;
+  LspErr err = lsp_set_nonblock((int)sock, true);
+  LN_LSP_PROP_ERR(err);
+  struct epoll_event event = { .events = EPOLLIN, .data.fd = (int)sock };
+  if (epoll_ctl(lsp->poll_fd, EPOLL_CTL_ADD, (int)sock, &event) == -1) {
+    fprintf(stderr, "Failed to register LSP listener with reactor\n");
+    return kLspErrOther;
+  }
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Accept a client that connects to the listening socket */
+static void
+lsp_accept(Lsp* lsp)
+{
+  chif_net_address addr = { .address_family = CHIF_NET_ADDRESS_FAMILY_IPV4 };
+  chif_net_socket sock;
+  chif_net_result result = chif_net_accept(lsp->listen_sock, &addr, &sock);
+  if (result != CHIF_NET_RESULT_SUCCESS) {
+    return;
+  }
+  LspClient* client = make_lsp_client(sock, (int)sock, (int)sock);
+  LspErr err = lsp_client_open(lsp, client);
+  if (err != kLspNoErr) {
+    lsp_client_drop(lsp, client);
+    return;
+  }
+  fprintf(stderr, "LNC: LSP client connected\n");
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Create the reactor and the debounce timer */
+static LspErr
+lsp_open_poll(Lsp* lsp)
+{
+  lsp->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (lsp->poll_fd == -1) {
+    fprintf(stderr, "Failed to create LSP reactor\n");
+    return kLspErrOther;
+  }
+
+  // Debounce timer for the analysis of changed documents
+  lsp->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  struct epoll_event event = { .events = EPOLLIN, .data.fd = lsp->timer_fd };
+  if (lsp->timer_fd == -1 ||
+      epoll_ctl(lsp->poll_fd, EPOLL_CTL_ADD, lsp->timer_fd, &event) == -1) {
+    fprintf(stderr, "Failed to register LSP debounce timer with reactor\n");
+    return kLspErrOther;
+  }
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspErr
+lsp_connect(Lsp* lsp, Str type, Str host, Str port)
+{
+  assrt(lsp->transport == kLspTransportNone,
+        make_str("LSP is already connected"));
+  LspErr err = lsp_open_poll(lsp);
+  LN_LSP_PROP_ERR(err);
+
+  // Open transport. Diagnostics go to 'stderr' as 'stdout' may be the
+  // transport
+  if (str_eq(&type, &make_str("stdio"))) {
+    fprintf(stderr, "LNC: Started LSP server. Type: 'stdio'\n");
+    lsp->transport = kLspTransportStdio;
+
+    // Messages are written to a private copy of 'stdout', which is then
+    // redirected to 'stderr'. Anything that the compiler prints while
+    // analyzing documents can then not corrupt the message stream
+    int out_fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (out_fd == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+      fprintf(stderr, "Failed to redirect standard output\n");
+      if (out_fd != -1) {
+        close(out_fd);
+      }
+      return kLspErrOther;
+    }
+    err = lsp_client_open(
+      lsp, make_lsp_client(CHIF_NET_INVALID_SOCKET, STDIN_FILENO, out_fd));
+    LN_LSP_PROP_ERR(err);
+  } else if (str_eq(&type, &make_str("tcp")) ||
+             str_eq(&type, &make_str("tcp-listen"))) {
+    fprintf(stderr,
+            "LNC: Started LSP server. Type: '%s', Host: '%s', Port: '%s'\n",
+            str_cstr(&type),
+            str_cstr(&host),
+            str_cstr(&port));
+    bool listen = str_eq(&type, &make_str("tcp-listen"));
+    lsp->transport = listen ? kLspTransportTcpListen : kLspTransportTcp;
+    err = lsp_open_tcp(lsp, host, port, listen);
+    LN_LSP_PROP_ERR(err);
+  } else {
+    fprintf(stderr,
+            "Invalid LSP transport '%s', expected one of 'tcp', 'tcp-listen' "
+            "and 'stdio'\n",
+            str_cstr(&type));
+    return kLspErrOther;
+  }
+
+  // A client that goes away shows up as an error from 'write', not a signal
+  signal(SIGPIPE, SIG_IGN);
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_disconnect(Lsp* lsp)
+{
+  while (lsp->clients) {
+    lsp_client_drop(lsp, lsp->clients);
+  }
+  if (lsp->listen_sock != CHIF_NET_INVALID_SOCKET) {
+    chif_net_close_socket(&lsp->listen_sock);
+    lsp->listen_sock = CHIF_NET_INVALID_SOCKET;
+  }
+  if (lsp->poll_fd != -1) {
+    close(lsp->poll_fd);
+    lsp->poll_fd = -1;
+  }
+  if (lsp->timer_fd != -1) {
+    close(lsp->timer_fd);
+    lsp->timer_fd = -1;
+    lsp->timer_at = 0;
+  }
+  lsp->transport = kLspTransportNone;
+}
+
+// -------------------------------------------------------------------------- //
+
+static LspErr
+lsp_run_reactor(Lsp* lsp)
+{
+  // Block until a client sends something, connects or queued output can be
+  // written. Errors of a client stop the server unless it listens for clients
+  struct epoll_event events[kLspMaxEvents];
+  while (1) {
+    int count = epoll_wait(lsp->poll_fd, events, kLspMaxEvents, -1);
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return kLspErrOther;
+    }
+
+    for (int i = 0; i < count; i++) {
+      int fd = events[i].data.fd;
+      if (fd == lsp->pool.wake_fd) {
+        LspErr err = lsp_job_finish(lsp);
+        LN_LSP_PROP_ERR(err);
+        continue;
+      }
+      if (fd == lsp->timer_fd) {
+        lsp_debounce_fire(lsp);
+        continue;
+      }
+      if (lsp->listen_sock != CHIF_NET_INVALID_SOCKET &&
+          fd == (int)lsp->listen_sock) {
+        lsp_accept(lsp);
+        continue;
+      }
+
+      // Clients that were dropped earlier in the batch have no client
+      LspClient* client = lsp_client_of_fd(lsp, fd);
+      if (!client) {
+        continue;
+      }
+      LspErr err = lsp_client_event(lsp, client, fd, events[i].events);
+      err = lsp_client_fail(lsp, client, err);
+      LN_LSP_PROP_ERR(err);
+    }
+  }
+
+  return kLspNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspErr
+lsp_run(Lsp* lsp)
+{
+  assrt(lsp->poll_fd != -1, make_str("LSP must be connected before running"));
+
+  // Start workers, they wake the reactor when a job is done
+  if (!lsp_pool_start(&lsp->pool, 0, jrpc_run_job)) {
+    fprintf(stderr, "Failed to start LSP workers\n");
+    return kLspErrOther;
+  }
+  struct epoll_event wake = { .events = EPOLLIN,
+                              .data.fd = lsp->pool.wake_fd };
+  if (epoll_ctl(lsp->poll_fd, EPOLL_CTL_ADD, lsp->pool.wake_fd, &wake) == -1) {
+    lsp_pool_stop(&lsp->pool);
+    return kLspErrOther;
+  }
+  LspErr err = lsp_run_reactor(lsp);
+
+  // Jobs that are still queued are dropped
+  epoll_ctl(lsp->poll_fd, EPOLL_CTL_DEL, lsp->pool.wake_fd, NULL);
+  lsp_pool_stop(&lsp->pool);
+  lsp_job_clear(lsp);
+  return err == kLspExit ? kLspNoErr : err;
+}
@@ -27,6 +27,9 @@
 
 #include "common.h"
 #include "str.h"
+#include "lsp_doc.h"
+#include "lsp_pool.h"
+#include "lsp_cache.h"
 
 // ========================================================================== //
 // LspErr
@@ -46,7 +49,11 @@ typedef enum LspErr
   /* Connection lost */
   kLspConnLost,
   /* Failed to read */
-  kLspRecvFail
+  kLspRecvFail,
+  /* Malformed message header */
+  kLspFrameErr,
+  /* Client asked the server to exit */
+  kLspExit
 } LspErr;
 
 // -------------------------------------------------------------------------- //
@@ -54,27 +61,137 @@ typedef enum LspErr
 Str
 lsp_err_str(LspErr err);
 
+// ========================================================================== //
+// LspRing
+// ========================================================================== //
+
+/* Ring buffer of received bytes. The capacity is always a power of two */
+typedef struct LspRing
+{
+  /* Buffer */
+  u8* buf;
+  /* Capacity */
+  u32 cap;
+  /* Offset of the first byte */
+  u32 head;
+  /* Number of bytes in the buffer */
+  u32 size;
+} LspRing;
+
+// ========================================================================== //
+// LspFrame
+// ========================================================================== //
+
+/* Maximum length of a single header line */
+#define kLspHeaderLineMax 256
+
+// -------------------------------------------------------------------------- //
+
+/* Framing states */
+typedef enum LspFrameState
+{
+  /* Reading header lines until an empty line */
+  kLspFrameHeader,
+  /* Reading 'Content-Length' bytes of content */
+  kLspFrameContent
+} LspFrameState;
+
+// -------------------------------------------------------------------------- //
+
+/* Streaming state of the JSON-RPC message framing */
+typedef struct LspFrame
+{
+  /* State */
+  LspFrameState state;
+  /* Whether the current header has a 'Content-Length' field */
+  bool has_len;
+  /* Content-Length */
+  u32 cont_len;
+  /* Length of the partial header line */
+  u32 line_len;
+  /* Partial header line */
+  char line[kLspHeaderLineMax];
+} LspFrame;
+
 // ========================================================================== //
 // Lsp
 // ========================================================================== //
 
+/* Transports */
+typedef enum LspTransport
+{
+  /* Not connected */
+  kLspTransportNone,
+  /* TCP socket connected to the client */
+  kLspTransportTcp,
+  /* TCP socket that any number of clients connect to */
+  kLspTransportTcpListen,
+  /* Standard input and output */
+  kLspTransportStdio
+} LspTransport;
+
+// -------------------------------------------------------------------------- //
+
+/* Connection to a client. Every client has its own documents, the analyses of
+ * the documents are shared between the clients through the cache */
+typedef struct LspClient
+{
+  /* Socket, for the TCP transports */
+  chif_net_socket sock;
+  /* Non-blocking descriptors that messages are read from and written to */
+  int in_fd;
+  int out_fd;
+  /* Received bytes that are not yet dispatched */
+  LspRing recv;
+  /* Bytes that could not be written without blocking */
+  LspRing send;
+  /* Framing of the received bytes */
+  LspFrame frame;
+  /* Open documents */
+  LspDocStore docs;
+  /* Next client */
+  struct LspClient* next;
+} LspClient;
+
+// -------------------------------------------------------------------------- //
+
 /* Lsp */
 typedef struct Lsp
 {
-  /* Socket */
-  chif_net_socket sock;
-  /* Data for split packets */
-  struct
-  {
-    /* Content-Length */
-    u32 size;
-  } header;
+  /* Transport */
+  LspTransport transport;
+  /* Listening socket, for the 'tcp-listen' transport */
+  chif_net_socket listen_sock;
+  /* Reactor (epoll instance) that the server blocks on until input arrives */
+  int poll_fd;
+  /* Timer that fires when the debounce window of a changed document ends */
+  int timer_fd;
+  /* Monotonic time in nanoseconds that the timer is armed for, 0 if unarmed */
+  u64 timer_at;
+  /* Connected clients */
+  LspClient* clients;
+  /* Workers that requests are handled on */
+  LspPool pool;
+  /* Jobs that have been submitted but not yet answered */
+  LspJob* flight;
+  /* Analyses shared between the clients */
+  LspCache cache;
+  /* Last result id of semantic tokens */
+  u32 sem_id;
+  /* Debug: Panic in the analysis of documents that contain 'dbg_lsp_panic',
+   * to test that workers recover */
+  bool dbg_panic;
+  /* Reader of received messages, reused between messages */
+  LspJson in;
+  /* Writer of the messages sent by the I/O thread */
+  LspJsonWriter out;
 } Lsp;
 
 // -------------------------------------------------------------------------- //
 
+/* Make server whose analysis cache has a budget of 'cache_budget' bytes */
 Lsp
-make_lsp(void);
+make_lsp(u64 cache_budget);
 
 // -------------------------------------------------------------------------- //
 
@@ -83,6 +200,11 @@ release_lsp(Lsp* lsp);
 
 // -------------------------------------------------------------------------- //
 
+/* Connect to clients over the transport 'type'. Either 'tcp' to connect to a
+ * client at 'host' and 'port', 'tcp-listen' to serve every client that
+ * connects to 'host' and 'port' or 'stdio' to use the standard input and
+ * output. The server stops when the client of 'tcp' or 'stdio' disconnects,
+ * a 'tcp-listen' server keeps running */
 LspErr
 lsp_connect(Lsp* lsp, Str type, Str host, Str port);
 
@@ -0,0 +1,297 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lsp_cache.h"
+
+// ========================================================================== //
+// LspCache
+// ========================================================================== //
+
+/* Initial number of buckets */
+#define kLspCacheBuckets 64
+
+// -------------------------------------------------------------------------- //
+
+static u64
+lsp_cache_hash(const Str* text)
+{
+  u64 hash = 14695981039346656037ull;
+  for (u32 i = 0; i < text->size; i++) {
+    hash = (hash ^ text->buf[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the text that a unit is the analysis of */
+static const Str*
+lsp_cache_text(const LspUnit* unit)
+{
+  return &unit->snap->src.src;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Estimate the memory that a unit keeps alive. Every entry of the index is
+ * a node of the AST. Atoms that units share are counted for each of them */
+static u64
+lsp_cache_size(const LspUnit* unit)
+{
+  const LspIndex* index = &unit->index;
+  u64 size = sizeof(LspUnit) + sizeof(LspSnap) + lsp_cache_text(unit)->size;
+  size += (u64)index->entry_count * (sizeof(LspIndexEntry) + sizeof(Ast));
+  size += (u64)index->line_count * sizeof(u32);
+  size += (u64)unit->errs.len * sizeof(Err);
+  size += unit->atoms.size;
+  if (unit->toks) {
+    size += (u64)unit->toks->count * sizeof(u32);
+  }
+  return size;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_cache_lru_unlink(LspCache* cache, LspCacheEntry* entry)
+{
+  if (entry->prev_lru) {
+    entry->prev_lru->next_lru = entry->next_lru;
+  } else {
+    cache->lru_first = entry->next_lru;
+  }
+  if (entry->next_lru) {
+    entry->next_lru->prev_lru = entry->prev_lru;
+  } else {
+    cache->lru_last = entry->prev_lru;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_cache_lru_push(LspCache* cache, LspCacheEntry* entry)
+{
+  entry->prev_lru = NULL;
+  entry->next_lru = cache->lru_first;
+  if (cache->lru_first) {
+    cache->lru_first->prev_lru = entry;
+  } else {
+    cache->lru_last = entry;
+  }
+  cache->lru_first = entry;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the entry of a text, or NULL. The lock must be held */
+static LspCacheEntry*
+lsp_cache_find(const LspCache* cache, const Str* text, u64 hash)
+{
+  LspCacheEntry* entry = cache->buckets[hash & (cache->bucket_count - 1)];
+  for (; entry; entry = entry->next_bucket) {
+    const Str* other = lsp_cache_text(entry->unit);
+    if (entry->hash == hash && other->size == text->size &&
+        memcmp(other->buf, text->buf, text->size) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Double the number of buckets. The lock must be held, so the buckets are
+ * kept if they cannot be allocated instead of panicking */
+static void
+lsp_cache_grow(LspCache* cache)
+{
+  u32 count = cache->bucket_count * 2;
+  LspCacheEntry** buckets = alloc(sizeof(LspCacheEntry*) * count, kLnMinAlign);
+  if (!buckets) {
+    return;
+  }
+  memset(buckets, 0, sizeof(LspCacheEntry*) * count);
+  for (u32 i = 0; i < cache->bucket_count; i++) {
+    LspCacheEntry* entry = cache->buckets[i];
+    while (entry) {
+      LspCacheEntry* next = entry->next_bucket;
+      LspCacheEntry** bucket = &buckets[entry->hash & (count - 1)];
+      entry->next_bucket = *bucket;
+      *bucket = entry;
+      entry = next;
+    }
+  }
+  release(cache->buckets);
+  cache->buckets = buckets;
+  cache->bucket_count = count;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Remove an entry. The lock must be held. The caller releases the entry and
+ * its unit, once the lock is not held */
+static void
+lsp_cache_remove(LspCache* cache, LspCacheEntry* entry)
+{
+  u32 mask = cache->bucket_count - 1;
+  LspCacheEntry** link = &cache->buckets[entry->hash & mask];
+  while (*link != entry) {
+    link = &(*link)->next_bucket;
+  }
+  *link = entry->next_bucket;
+  lsp_cache_lru_unlink(cache, entry);
+  cache->entry_count--;
+  cache->size -= entry->size;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Release entries that are chained through 'next_bucket' and their units */
+static void
+lsp_cache_release_entries(LspCacheEntry* entry)
+{
+  while (entry) {
+    LspCacheEntry* next = entry->next_bucket;
+    lsp_unit_release(entry->unit);
+    release(entry);
+    entry = next;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+LspCache
+make_lsp_cache(u64 budget)
+{
+  LspCache cache = { .lock = PTHREAD_MUTEX_INITIALIZER,
+                     .bucket_count = kLspCacheBuckets,
+                     .budget = budget };
+  cache.buckets =
+    alloc(sizeof(LspCacheEntry*) * cache.bucket_count, kLnMinAlign);
+  assrt(cache.buckets != NULL, make_str("Failed to allocate LSP cache"));
+  memset(cache.buckets, 0, sizeof(LspCacheEntry*) * cache.bucket_count);
+  return cache;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_cache(LspCache* cache)
+{
+  while (cache->lru_last) {
+    LspCacheEntry* entry = cache->lru_last;
+    lsp_cache_remove(cache, entry);
+    entry->next_bucket = NULL;
+    lsp_cache_release_entries(entry);
+  }
+  release(cache->buckets);
+  pthread_mutex_destroy(&cache->lock);
+}
+
+// -------------------------------------------------------------------------- //
+
+LspUnit*
+lsp_cache_get(LspCache* cache, const Str* text)
+{
+  u64 hash = lsp_cache_hash(text);
+  mutex_lock(&cache->lock);
+  LspCacheEntry* entry = lsp_cache_find(cache, text, hash);
+  LspUnit* unit = NULL;
+  if (entry) {
+    lsp_cache_lru_unlink(cache, entry);
+    lsp_cache_lru_push(cache, entry);
+    unit = lsp_unit_retain(entry->unit);
+    cache->hits++;
+  } else {
+    cache->misses++;
+  }
+  mutex_unlock(&cache->lock);
+  return unit;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_cache_put(LspCache* cache, LspUnit* unit)
+{
+  const Str* text = lsp_cache_text(unit);
+  u64 hash = lsp_cache_hash(text);
+  u64 size = lsp_cache_size(unit);
+  if (size > cache->budget) {
+    return;
+  }
+
+  LspCacheEntry* entry = alloc(sizeof(LspCacheEntry), kLnMinAlign);
+  assrt(entry != NULL, make_str("Failed to allocate LSP cache entry"));
+  *entry = (LspCacheEntry){ .hash = hash, .size = size, .unit = unit };
+
+  // Another worker may have analyzed the same text in the meantime. Evicted
+  // units are chained through 'next_bucket' and released after unlocking
+  mutex_lock(&cache->lock);
+  if (lsp_cache_find(cache, text, hash)) {
+    mutex_unlock(&cache->lock);
+    release(entry);
+    return;
+  }
+  LspCacheEntry* evicted = NULL;
+  while (cache->size + size > cache->budget) {
+    LspCacheEntry* last = cache->lru_last;
+    lsp_cache_remove(cache, last);
+    last->next_bucket = evicted;
+    evicted = last;
+    cache->evictions++;
+  }
+  lsp_unit_retain(unit);
+  if (cache->entry_count >= cache->bucket_count) {
+    lsp_cache_grow(cache);
+  }
+  LspCacheEntry** bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+  entry->next_bucket = *bucket;
+  *bucket = entry;
+  lsp_cache_lru_push(cache, entry);
+  cache->entry_count++;
+  cache->size += size;
+  mutex_unlock(&cache->lock);
+  lsp_cache_release_entries(evicted);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_cache_log(LspCache* cache)
+{
+  mutex_lock(&cache->lock);
+  fprintf(stderr,
+          "LNC: LSP cache: %u analyses, %llu of %llu KiB, %llu hits, "
+          "%llu misses, %llu evictions\n",
+          cache->entry_count,
+          (unsigned long long)(cache->size >> 10),
+          (unsigned long long)(cache->budget >> 10),
+          (unsigned long long)cache->hits,
+          (unsigned long long)cache->misses,
+          (unsigned long long)cache->evictions);
+  mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,117 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_LSP_CACHE_H
+#define LN_LSP_CACHE_H
+
+#include <pthread.h>
+
+#include "common.h"
+#include "str.h"
+#include "lsp_index.h"
+
+// ========================================================================== //
+// LspCache
+// ========================================================================== //
+
+/* Default memory budget of the cache in MiB */
+#define kLspCacheDefaultMb 256
+
+// -------------------------------------------------------------------------- //
+
+/* Cached analysis */
+typedef struct LspCacheEntry
+{
+  /* Hash of the text */
+  u64 hash;
+  /* Estimated size in bytes */
+  u64 size;
+  /* Analysis */
+  LspUnit* unit;
+  /* Next entry in the same bucket */
+  struct LspCacheEntry* next_bucket;
+  /* Neighbours in the LRU list */
+  struct LspCacheEntry* prev_lru;
+  struct LspCacheEntry* next_lru;
+} LspCacheEntry;
+
+// -------------------------------------------------------------------------- //
+
+/* Analyses of source texts, shared between all clients of the server. The
+ * analysis of a file does not depend on its URI or on other files, so files
+ * with the same text share one analysis whichever client opened them. The
+ * cache keeps a reference to every unit and evicts the least recently used
+ * ones when the estimated size exceeds the budget. Evicted units stay alive
+ * for as long as documents or jobs use them. The cache is used by the
+ * workers and is guarded by a mutex */
+typedef struct LspCache
+{
+  /* Lock */
+  pthread_mutex_t lock;
+  /* Hash table of the entries. The bucket count is a power of two */
+  LspCacheEntry** buckets;
+  u32 bucket_count;
+  u32 entry_count;
+  /* Entries from the most to the least recently used */
+  LspCacheEntry* lru_first;
+  LspCacheEntry* lru_last;
+  /* Estimated size of the entries and the budget, in bytes */
+  u64 size;
+  u64 budget;
+  /* Statistics */
+  u64 hits;
+  u64 misses;
+  u64 evictions;
+} LspCache;
+
+// -------------------------------------------------------------------------- //
+
+/* Make empty cache with a budget in bytes */
+LspCache
+make_lsp_cache(u64 budget);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_cache(LspCache* cache);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns a new reference to the analysis of a text, or NULL if the text is
+ * not cached */
+LspUnit*
+lsp_cache_get(LspCache* cache, const Str* text);
+
+// -------------------------------------------------------------------------- //
+
+/* Add the analysis of the text of its snapshot. Nothing is added if the text
+ * is already cached, or if the analysis alone exceeds the budget */
+void
+lsp_cache_put(LspCache* cache, LspUnit* unit);
+
+// -------------------------------------------------------------------------- //
+
+/* Print the size and the statistics of the cache to 'stderr' */
+void
+lsp_cache_log(LspCache* cache);
+
+#endif // LN_LSP_CACHE_H
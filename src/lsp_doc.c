@@ -0,0 +1,578 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <string.h>
+
+#include "lsp_doc.h"
+
+// ========================================================================== //
+// LspPiece
+// ========================================================================== //
+
+static u32
+lsp_piece_sub_size(const LspPiece* piece)
+{
+  return piece ? piece->sub_size : 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+static u32
+lsp_piece_sub_lines(const LspPiece* piece)
+{
+  return piece ? piece->sub_lines : 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_piece_update(LspPiece* piece)
+{
+  piece->sub_size = lsp_piece_sub_size(piece->left) + piece->size +
+                    lsp_piece_sub_size(piece->right);
+  piece->sub_lines = lsp_piece_sub_lines(piece->left) + piece->lines +
+                     lsp_piece_sub_lines(piece->right);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+release_lsp_piece(LspPiece* piece)
+{
+  if (piece) {
+    release_lsp_piece(piece->left);
+    release_lsp_piece(piece->right);
+    release(piece);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Join two trees where all pieces of 'a' come before those of 'b' */
+static LspPiece*
+lsp_piece_merge(LspPiece* a, LspPiece* b)
+{
+  if (!a) {
+    return b;
+  }
+  if (!b) {
+    return a;
+  }
+  if (a->prio > b->prio) {
+    a->right = lsp_piece_merge(a->right, b);
+    lsp_piece_update(a);
+    return a;
+  }
+  b->left = lsp_piece_merge(a, b->left);
+  lsp_piece_update(b);
+  return b;
+}
+
+// ========================================================================== //
+// LspDoc
+// ========================================================================== //
+
+/* Pieces are compacted into one when the buffer is this much larger than the
+ * document */
+#define kLspDocCompactSlack (64u * 1024u)
+
+// -------------------------------------------------------------------------- //
+
+/* Index of the first line break at or after 'off' in the buffer */
+static u32
+lsp_doc_break_index(const LspDoc* doc, u32 off)
+{
+  u32 lo = 0, hi = doc->break_count;
+  while (lo < hi) {
+    u32 mid = lo + (hi - lo) / 2;
+    if (doc->breaks[mid] < off) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// -------------------------------------------------------------------------- //
+
+static LspPiece*
+make_lsp_piece(LspDoc* doc, u32 off, u32 size)
+{
+  // Xorshift
+  doc->rng ^= doc->rng << 13;
+  doc->rng ^= doc->rng >> 17;
+  doc->rng ^= doc->rng << 5;
+
+  LspPiece* piece = alloc(sizeof(LspPiece), kLnMinAlign);
+  assrt(piece != NULL, make_str("Failed to allocate document piece"));
+  *piece = (LspPiece){ .prio = doc->rng,
+                       .off = off,
+                       .size = size,
+                       .lines = lsp_doc_break_index(doc, off + size) -
+                                lsp_doc_break_index(doc, off) };
+  lsp_piece_update(piece);
+  return piece;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Append text to the buffer and returns its offset */
+static u32
+lsp_doc_append(LspDoc* doc, const u8* text, u32 size)
+{
+  if (doc->buf_size + size > doc->buf_cap) {
+    u32 cap = LN_MAX(doc->buf_cap * 2, doc->buf_size + size);
+    u8* buf = alloc(cap, kLnMinAlign);
+    assrt(buf != NULL, make_str("Failed to grow document buffer"));
+    if (doc->buf) {
+      memcpy(buf, doc->buf, doc->buf_size);
+      release(doc->buf);
+    }
+    doc->buf = buf;
+    doc->buf_cap = cap;
+  }
+
+  u32 off = doc->buf_size;
+  memcpy(doc->buf + off, text, size);
+  doc->buf_size += size;
+  for (u32 i = 0; i < size; i++) {
+    if (text[i] != '\n') {
+      continue;
+    }
+    if (doc->break_count == doc->break_cap) {
+      u32 cap = doc->break_cap ? doc->break_cap * 2 : 64;
+      u32* breaks = alloc(sizeof(u32) * cap, kLnMinAlign);
+      assrt(breaks != NULL, make_str("Failed to grow document line index"));
+      if (doc->breaks) {
+        memcpy(breaks, doc->breaks, sizeof(u32) * doc->break_count);
+        release(doc->breaks);
+      }
+      doc->breaks = breaks;
+      doc->break_cap = cap;
+    }
+    doc->breaks[doc->break_count++] = off + i;
+  }
+  return off;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Split the tree at byte offset 'off' of the document. A piece that spans the
+ * offset is split in two */
+static void
+lsp_doc_split(LspDoc* doc,
+              LspPiece* piece,
+              u32 off,
+              LspPiece** p_left,
+              LspPiece** p_right)
+{
+  if (!piece) {
+    *p_left = *p_right = NULL;
+    return;
+  }
+
+  u32 left_size = lsp_piece_sub_size(piece->left);
+  if (off <= left_size) {
+    lsp_doc_split(doc, piece->left, off, p_left, &piece->left);
+    lsp_piece_update(piece);
+    *p_right = piece;
+  } else if (off >= left_size + piece->size) {
+    lsp_doc_split(
+      doc, piece->right, off - left_size - piece->size, &piece->right, p_right);
+    lsp_piece_update(piece);
+    *p_left = piece;
+  } else {
+    u32 inner = off - left_size;
+    LspPiece* tail =
+      make_lsp_piece(doc, piece->off + inner, piece->size - inner);
+    piece->size = inner;
+    piece->lines -= tail->lines;
+    *p_right = lsp_piece_merge(tail, piece->right);
+    piece->right = NULL;
+    lsp_piece_update(piece);
+    *p_left = piece;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Extend the last piece of the tree if the text was appended right after it
+ * in the buffer. Returns false if it was not */
+static bool
+lsp_doc_extend_last(LspDoc* doc, LspPiece* piece, u32 off, u32 size)
+{
+  if (!piece) {
+    return false;
+  }
+  if (piece->right) {
+    if (!lsp_doc_extend_last(doc, piece->right, off, size)) {
+      return false;
+    }
+  } else {
+    if (piece->off + piece->size != off) {
+      return false;
+    }
+    piece->size += size;
+    piece->lines = lsp_doc_break_index(doc, piece->off + piece->size) -
+                   lsp_doc_break_index(doc, piece->off);
+  }
+  lsp_piece_update(piece);
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Replace the pieces with a single one when the buffer holds mostly text that
+ * has been removed */
+static void
+lsp_doc_compact(LspDoc* doc)
+{
+  u32 size = lsp_doc_size(doc);
+  if (doc->buf_size - size < size + kLspDocCompactSlack) {
+    return;
+  }
+
+  u8* text = alloc(size + 1, kLnMinAlign);
+  lsp_doc_copy(doc, 0, size, text);
+  release_lsp_piece(doc->root);
+  release(doc->buf);
+  release(doc->breaks);
+  doc->buf = NULL;
+  doc->buf_size = doc->buf_cap = 0;
+  doc->breaks = NULL;
+  doc->break_count = doc->break_cap = 0;
+  doc->root = NULL;
+  if (size > 0) {
+    u32 off = lsp_doc_append(doc, text, size);
+    doc->root = make_lsp_piece(doc, off, size);
+  }
+  release(text);
+}
+
+// -------------------------------------------------------------------------- //
+
+LspDoc*
+make_lsp_doc(const Str* uri, s64 version, const u8* text, u32 size)
+{
+  LspDoc* doc = alloc(sizeof(LspDoc), kLnMinAlign);
+  assrt(doc != NULL, make_str("Failed to allocate document"));
+  *doc = (LspDoc){ .uri = str_copy(uri),
+                   .version = version,
+                   .rng = 2463534242u };
+  if (size > 0) {
+    u32 off = lsp_doc_append(doc, text, size);
+    doc->root = make_lsp_piece(doc, off, size);
+  }
+  return doc;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_doc(LspDoc* doc)
+{
+  lsp_sem_toks_release(doc->sem_toks);
+  lsp_snap_release(doc->unit_snap);
+  lsp_unit_release(doc->unit);
+  lsp_snap_release(doc->snap);
+  release_lsp_piece(doc->root);
+  if (doc->breaks) {
+    release(doc->breaks);
+  }
+  if (doc->buf) {
+    release(doc->buf);
+  }
+  release_str(&doc->uri);
+  release(doc);
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+lsp_doc_size(const LspDoc* doc)
+{
+  return lsp_piece_sub_size(doc->root);
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+lsp_doc_line_off(const LspDoc* doc, u32 line)
+{
+  // Line 'n' starts right after the n:th line break
+  u32 base = 0;
+  const LspPiece* piece = doc->root;
+  while (piece && line > 0) {
+    u32 left_lines = lsp_piece_sub_lines(piece->left);
+    if (line <= left_lines) {
+      piece = piece->left;
+      continue;
+    }
+    line -= left_lines;
+    base += lsp_piece_sub_size(piece->left);
+    if (line <= piece->lines) {
+      u32 index = lsp_doc_break_index(doc, piece->off) + line - 1;
+      return base + doc->breaks[index] - piece->off + 1;
+    }
+    line -= piece->lines;
+    base += piece->size;
+    piece = piece->right;
+  }
+  return line == 0 ? base : lsp_doc_size(doc);
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+lsp_doc_pos_off(const LspDoc* doc, u32 line, u32 character)
+{
+  u32 beg = lsp_doc_line_off(doc, line);
+  u32 end = lsp_doc_line_off(doc, line + 1);
+  if (character == 0 || beg == end) {
+    return beg;
+  }
+
+  // Count UTF-16 code units of the line, stopping before the first character
+  // that starts at or after 'character'
+  u8 stack_buf[256];
+  u32 size = end - beg;
+  u8* text = size <= sizeof(stack_buf) ? stack_buf : alloc(size, kLnMinAlign);
+  lsp_doc_copy(doc, beg, size, text);
+  u32 off = 0, units = 0;
+  while (off < size && text[off] != '\n' && text[off] != '\r') {
+    u32 byte_units = unicode_utf16_units(text[off]);
+    if (byte_units > 0 && units >= character) {
+      break;
+    }
+    units += byte_units;
+    off++;
+  }
+  if (text != stack_buf) {
+    release(text);
+  }
+  return beg + off;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_doc_copy_piece(const LspDoc* doc,
+                   const LspPiece* piece,
+                   u32 off,
+                   u32 size,
+                   u8* dst)
+{
+  while (piece && size > 0) {
+    u32 left_size = lsp_piece_sub_size(piece->left);
+    if (off < left_size) {
+      u32 count = LN_MIN(size, left_size - off);
+      lsp_doc_copy_piece(doc, piece->left, off, count, dst);
+      dst += count;
+      off += count;
+      size -= count;
+    }
+    u32 inner = off - left_size;
+    if (size > 0 && inner < piece->size) {
+      u32 count = LN_MIN(size, piece->size - inner);
+      memcpy(dst, doc->buf + piece->off + inner, count);
+      dst += count;
+      off += count;
+      size -= count;
+    }
+    off -= left_size + piece->size;
+    piece = piece->right;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_doc_copy(const LspDoc* doc, u32 off, u32 size, u8* dst)
+{
+  assrt(off + size <= lsp_doc_size(doc),
+        make_str("Document range out of bounds"));
+  lsp_doc_copy_piece(doc, doc->root, off, size, dst);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_doc_edit(LspDoc* doc, u32 off, u32 size, const u8* text, u32 text_size)
+{
+  u32 doc_size = lsp_doc_size(doc);
+  off = LN_MIN(off, doc_size);
+  size = LN_MIN(size, doc_size - off);
+
+  // Cut out the replaced range
+  LspPiece *left, *mid, *right;
+  lsp_doc_split(doc, doc->root, off, &left, &right);
+  lsp_doc_split(doc, right, size, &mid, &right);
+  release_lsp_piece(mid);
+
+  // Typing appends to the buffer right after the previous insertion, which
+  // then only grows the piece before it
+  if (text_size > 0) {
+    u32 text_off = lsp_doc_append(doc, text, text_size);
+    if (!lsp_doc_extend_last(doc, left, text_off, text_size)) {
+      left = lsp_piece_merge(left, make_lsp_piece(doc, text_off, text_size));
+    }
+  }
+  doc->root = lsp_piece_merge(left, right);
+
+  lsp_snap_release(doc->snap);
+  doc->snap = NULL;
+  lsp_doc_compact(doc);
+}
+
+// -------------------------------------------------------------------------- //
+
+LspSnap*
+lsp_doc_snap(LspDoc* doc)
+{
+  if (!doc->snap) {
+    u32 size = lsp_doc_size(doc);
+    u8* text = alloc(size + 1, kLnMinAlign);
+    assrt(text != NULL, make_str("Failed to allocate document snapshot"));
+    lsp_doc_copy(doc, 0, size, text);
+    text[size] = 0;
+    Str text_str = { .buf = text, .size = size, .len = kStrLenUnknown };
+    doc->snap = make_lsp_snap(&doc->uri, doc->version, text_str);
+  }
+  return doc->snap;
+}
+
+// ========================================================================== //
+// LspDocStore
+// ========================================================================== //
+
+static u32
+lsp_doc_store_hash(const Str* uri)
+{
+  u32 hash = 2166136261u;
+  for (u32 i = 0; i < uri->size; i++) {
+    hash ^= uri->buf[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// -------------------------------------------------------------------------- //
+
+static u32
+lsp_doc_store_find(const LspDocStore* store, const Str* uri)
+{
+  u32 mask = store->cap - 1;
+  u32 pos = lsp_doc_store_hash(uri) & mask;
+  while (store->slots[pos] && !str_eq(&store->slots[pos]->uri, uri)) {
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspDocStore
+make_lsp_doc_store()
+{
+  u32 cap = 16;
+  LspDoc** slots = alloc(sizeof(LspDoc*) * cap, kLnMinAlign);
+  assrt(slots != NULL, make_str("Failed to allocate document store"));
+  memset(slots, 0, sizeof(LspDoc*) * cap);
+  return (LspDocStore){ .slots = slots, .cap = cap, .count = 0 };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_doc_store(LspDocStore* store)
+{
+  for (u32 i = 0; i < store->cap; i++) {
+    if (store->slots[i]) {
+      release_lsp_doc(store->slots[i]);
+    }
+  }
+  release(store->slots);
+  *store = (LspDocStore){ 0 };
+}
+
+// -------------------------------------------------------------------------- //
+
+LspDoc*
+lsp_doc_store_get(const LspDocStore* store, const Str* uri)
+{
+  return store->slots[lsp_doc_store_find(store, uri)];
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_doc_store_put(LspDocStore* store, LspDoc* doc)
+{
+  // Grow at 50% load
+  if ((store->count + 1) * 2 > store->cap) {
+    LspDoc** old_slots = store->slots;
+    u32 old_cap = store->cap;
+    store->cap *= 2;
+    store->slots = alloc(sizeof(LspDoc*) * store->cap, kLnMinAlign);
+    assrt(store->slots != NULL, make_str("Failed to grow document store"));
+    memset(store->slots, 0, sizeof(LspDoc*) * store->cap);
+    for (u32 i = 0; i < old_cap; i++) {
+      if (old_slots[i]) {
+        store->slots[lsp_doc_store_find(store, &old_slots[i]->uri)] =
+          old_slots[i];
+      }
+    }
+    release(old_slots);
+  }
+
+  u32 pos = lsp_doc_store_find(store, &doc->uri);
+  if (store->slots[pos]) {
+    release_lsp_doc(store->slots[pos]);
+  } else {
+    store->count++;
+  }
+  store->slots[pos] = doc;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_doc_store_remove(LspDocStore* store, const Str* uri)
+{
+  u32 pos = lsp_doc_store_find(store, uri);
+  if (!store->slots[pos]) {
+    return;
+  }
+  release_lsp_doc(store->slots[pos]);
+  store->slots[pos] = NULL;
+  store->count--;
+
+  // Move back the documents after it in the probe sequence
+  u32 mask = store->cap - 1;
+  for (u32 next = (pos + 1) & mask; store->slots[next];
+       next = (next + 1) & mask) {
+    LspDoc* doc = store->slots[next];
+    store->slots[next] = NULL;
+    store->slots[lsp_doc_store_find(store, &doc->uri)] = doc;
+  }
+}
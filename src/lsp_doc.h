@@ -0,0 +1,192 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_LSP_DOC_H
+#define LN_LSP_DOC_H
+
+#include "common.h"
+#include "str.h"
+#include "lsp_index.h"
+
+// ========================================================================== //
+// LspPiece
+// ========================================================================== //
+
+/* Piece of a document, referring to a range of the document buffer. Pieces
+ * are nodes in a treap ordered by their position in the document, and every
+ * node knows the size and number of line breaks of its subtree. This makes
+ * edits and line lookups O(log n) */
+typedef struct LspPiece
+{
+  /* Children */
+  struct LspPiece* left;
+  struct LspPiece* right;
+  /* Heap priority */
+  u32 prio;
+  /* Offset of the piece in the buffer */
+  u32 off;
+  /* Size of the piece */
+  u32 size;
+  /* Number of line breaks in the piece */
+  u32 lines;
+  /* Size of the subtree */
+  u32 sub_size;
+  /* Number of line breaks in the subtree */
+  u32 sub_lines;
+} LspPiece;
+
+// ========================================================================== //
+// LspDoc
+// ========================================================================== //
+
+/* Text document that is open in the client, stored as a piece table. All
+ * text, the initial and the inserted, is appended to one buffer that is
+ * compacted when it grows much larger than the document */
+typedef struct LspDoc
+{
+  /* URI */
+  Str uri;
+  /* Version from the client */
+  s64 version;
+  /* Append-only buffer that the pieces refer to */
+  u8* buf;
+  u32 buf_size;
+  u32 buf_cap;
+  /* Offsets of the line breaks in the buffer, in order */
+  u32* breaks;
+  u32 break_count;
+  u32 break_cap;
+  /* Root piece */
+  LspPiece* root;
+  /* State for the piece priorities */
+  u32 rng;
+  /* Snapshot of the current version, created on demand */
+  LspSnap* snap;
+  /* Latest analysis and the snapshot that it was made for, which may be of
+   * an older version. Analyses are shared between documents with the same
+   * text, the snapshot of the analysis itself may be of another document */
+  LspUnit* unit;
+  LspSnap* unit_snap;
+  /* Semantic tokens that were last sent to the client and their result id,
+   * 0 if none were sent */
+  LspSemToks* sem_toks;
+  u32 sem_id;
+  /* Monotonic time in nanoseconds to analyze the document at after a change,
+   * 0 if no analysis is pending */
+  u64 analyze_at;
+} LspDoc;
+
+// -------------------------------------------------------------------------- //
+
+/* Make document with the given text */
+LspDoc*
+make_lsp_doc(const Str* uri, s64 version, const u8* text, u32 size);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_doc(LspDoc* doc);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the size of the document in bytes */
+u32
+lsp_doc_size(const LspDoc* doc);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the byte offset of the start of a line. Lines past the end of the
+ * document start at the end */
+u32
+lsp_doc_line_off(const LspDoc* doc, u32 line);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the byte offset of an LSP position. The character is counted in
+ * UTF-16 code units and clamped to the line */
+u32
+lsp_doc_pos_off(const LspDoc* doc, u32 line, u32 character);
+
+// -------------------------------------------------------------------------- //
+
+/* Copy 'size' bytes starting at 'off' to 'dst' */
+void
+lsp_doc_copy(const LspDoc* doc, u32 off, u32 size, u8* dst);
+
+// -------------------------------------------------------------------------- //
+
+/* Replace 'size' bytes starting at 'off' with 'text' */
+void
+lsp_doc_edit(LspDoc* doc, u32 off, u32 size, const u8* text, u32 text_size);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the snapshot of the current version. The snapshot is owned by the
+ * document, retain it to keep it */
+LspSnap*
+lsp_doc_snap(LspDoc* doc);
+
+// ========================================================================== //
+// LspDocStore
+// ========================================================================== //
+
+/* Open documents keyed by URI */
+typedef struct LspDocStore
+{
+  /* Hash map with linear probing (power of two capacity) */
+  LspDoc** slots;
+  /* Capacity */
+  u32 cap;
+  /* Number of documents */
+  u32 count;
+} LspDocStore;
+
+// -------------------------------------------------------------------------- //
+
+LspDocStore
+make_lsp_doc_store();
+
+// -------------------------------------------------------------------------- //
+
+/* Release the store and all documents in it */
+void
+release_lsp_doc_store(LspDocStore* store);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the document with the URI, or NULL */
+LspDoc*
+lsp_doc_store_get(const LspDocStore* store, const Str* uri);
+
+// -------------------------------------------------------------------------- //
+
+/* Add a document, replacing any document with the same URI */
+void
+lsp_doc_store_put(LspDocStore* store, LspDoc* doc);
+
+// -------------------------------------------------------------------------- //
+
+/* Remove and release the document with the URI */
+void
+lsp_doc_store_remove(LspDocStore* store, const Str* uri);
+
+#endif // LN_LSP_DOC_H
@@ -0,0 +1,384 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdlib.h>
+
+#include "lsp_index.h"
+
+// ========================================================================== //
+// LspIndex
+// ========================================================================== //
+
+/* Add a node and its children. Only counts the nodes if there are no entries
+ * to fill yet */
+static void
+lsp_index_add(LspIndex* index, Ast* ast, u32 depth)
+{
+  if (!ast) {
+    return;
+  }
+  if (index->entries) {
+    index->entries[index->entry_count] =
+      (LspIndexEntry){ .beg = ast->span.beg.off,
+                       .end = ast->span.end.off,
+                       .parent = kLspIndexNone,
+                       .depth = depth,
+                       .ast = ast };
+  }
+  index->entry_count++;
+
+  depth++;
+  switch (ast->kind) {
+    case kAstProg: {
+      for (u32 i = 0; i < ast->prog.funs.len; i++) {
+        lsp_index_add(index, ast_list_get(&ast->prog.funs, i), depth);
+      }
+      break;
+    }
+    case kAstFn: {
+      for (u32 i = 0; i < ast->fn.params.len; i++) {
+        lsp_index_add(index, ast_list_get(&ast->fn.params, i), depth);
+      }
+      lsp_index_add(index, ast->fn.ret, depth);
+      lsp_index_add(index, ast->fn.body, depth);
+      break;
+    }
+    case kAstParam: {
+      lsp_index_add(index, ast->param.type, depth);
+      break;
+    }
+    case kAstBlock: {
+      for (u32 i = 0; i < ast->block.stmts.len; i++) {
+        lsp_index_add(index, ast_list_get(&ast->block.stmts, i), depth);
+      }
+      lsp_index_add(index, ast->block.ret_expr, depth);
+      break;
+    }
+    case kAstLet: {
+      lsp_index_add(index, ast->let.type, depth);
+      lsp_index_add(index, ast->let.expr, depth);
+      break;
+    }
+    case kAstRet: {
+      lsp_index_add(index, ast->ret.expr, depth);
+      break;
+    }
+    case kAstWhile: {
+      lsp_index_add(index, ast->while_loop.cond, depth);
+      lsp_index_add(index, ast->while_loop.body, depth);
+      break;
+    }
+    case kAstFor: {
+      lsp_index_add(index, ast->for_loop.from, depth);
+      lsp_index_add(index, ast->for_loop.to, depth);
+      lsp_index_add(index, ast->for_loop.body, depth);
+      break;
+    }
+    case kAstAssign: {
+      lsp_index_add(index, ast->assign.target, depth);
+      lsp_index_add(index, ast->assign.expr, depth);
+      break;
+    }
+    case kAstBinop: {
+      lsp_index_add(index, ast->binop.lhs, depth);
+      lsp_index_add(index, ast->binop.rhs, depth);
+      break;
+    }
+    case kAstIndex: {
+      lsp_index_add(index, ast->index.base, depth);
+      lsp_index_add(index, ast->index.index, depth);
+      break;
+    }
+    case kAstCall: {
+      for (u32 i = 0; i < ast->call.args.len; i++) {
+        lsp_index_add(index, ast_list_get(&ast->call.args, i), depth);
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Order by start, then outer before inner */
+static int
+lsp_index_cmp(const void* a, const void* b)
+{
+  const LspIndexEntry* e0 = a;
+  const LspIndexEntry* e1 = b;
+  if (e0->beg != e1->beg) {
+    return e0->beg < e1->beg ? -1 : 1;
+  }
+  if (e0->end != e1->end) {
+    return e0->end > e1->end ? -1 : 1;
+  }
+  if (e0->depth != e1->depth) {
+    return e0->depth < e1->depth ? -1 : 1;
+  }
+  return 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Link every entry to the innermost earlier entry that is still open at its
+ * start */
+static void
+lsp_index_link(LspIndex* index)
+{
+  u32* stack = alloc(sizeof(u32) * index->entry_count, kLnMinAlign);
+  assrt(stack != NULL, make_str("Failed to allocate span index"));
+  u32 top = 0;
+  for (u32 i = 0; i < index->entry_count; i++) {
+    LspIndexEntry* entry = &index->entries[i];
+    while (top > 0 && index->entries[stack[top - 1]].end <= entry->beg) {
+      top--;
+    }
+    entry->parent = top > 0 ? stack[top - 1] : kLspIndexNone;
+    stack[top++] = i;
+  }
+  release(stack);
+}
+
+// -------------------------------------------------------------------------- //
+
+LspIndex
+make_lsp_index(Ast* ast, const Str* text)
+{
+  LspIndex index = { .text = text };
+
+  // Nodes
+  lsp_index_add(&index, ast, 0);
+  if (index.entry_count > 0) {
+    index.entries =
+      alloc(sizeof(LspIndexEntry) * index.entry_count, kLnMinAlign);
+    assrt(index.entries != NULL, make_str("Failed to allocate span index"));
+    index.entry_count = 0;
+    lsp_index_add(&index, ast, 0);
+    qsort(index.entries,
+          index.entry_count,
+          sizeof(LspIndexEntry),
+          lsp_index_cmp);
+    lsp_index_link(&index);
+  }
+
+  // Lines
+  u32 line_count = 1;
+  for (u32 i = 0; i < text->size; i++) {
+    line_count += text->buf[i] == '\n';
+  }
+  index.lines = alloc(sizeof(u32) * line_count, kLnMinAlign);
+  assrt(index.lines != NULL, make_str("Failed to allocate line index"));
+  index.lines[index.line_count++] = 0;
+  for (u32 i = 0; i < text->size; i++) {
+    if (text->buf[i] == '\n') {
+      index.lines[index.line_count++] = i + 1;
+    }
+  }
+
+  return index;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_index(LspIndex* index)
+{
+  if (index->entries) {
+    release(index->entries);
+  }
+  if (index->lines) {
+    release(index->lines);
+  }
+  *index = (LspIndex){};
+}
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+lsp_index_at(const LspIndex* index, u32 off)
+{
+  // Last entry that starts at or before the offset
+  u32 lo = 0;
+  u32 hi = index->entry_count;
+  while (lo < hi) {
+    u32 mid = lo + (hi - lo) / 2;
+    if (index->entries[mid].beg <= off) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return NULL;
+  }
+
+  // Its innermost ancestor that also ends after the offset
+  u32 i = lo - 1;
+  while (i != kLspIndexNone && index->entries[i].end <= off) {
+    i = index->entries[i].parent;
+  }
+  return i != kLspIndexNone ? index->entries[i].ast : NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_index_pos(const LspIndex* index, u32 off, u32* p_line, u32* p_character)
+{
+  off = LN_MIN(off, index->text->size);
+
+  // Last line that starts at or before the offset
+  u32 lo = 1;
+  u32 hi = index->line_count;
+  while (lo < hi) {
+    u32 mid = lo + (hi - lo) / 2;
+    if (index->lines[mid] <= off) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  u32 line = lo - 1;
+
+  u32 character = 0;
+  for (u32 i = index->lines[line]; i < off; i++) {
+    character += unicode_utf16_units(index->text->buf[i]);
+  }
+
+  *p_line = line;
+  *p_character = character;
+}
+
+// ========================================================================== //
+// LspAtoms
+// ========================================================================== //
+
+static int
+lsp_atoms_cmp(const void* a, const void* b)
+{
+  Atom atom_a = *(const Atom*)a;
+  Atom atom_b = *(const Atom*)b;
+  return atom_a < atom_b ? -1 : atom_a > atom_b;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspAtoms
+make_lsp_atoms(const TokList* tokens)
+{
+  LspAtoms atoms = { 0 };
+  if (tokens->len == 0) {
+    return atoms;
+  }
+  atoms.buf = alloc(sizeof(Atom) * tokens->len, kLnMinAlign);
+  assrt(atoms.buf != NULL, make_str("Failed to allocate atoms"));
+  for (u32 i = 0; i < tokens->len; i++) {
+    if (tokens->buf[i].atom != kAtomNone) {
+      atoms.buf[atoms.count++] = tokens->buf[i].atom;
+    }
+  }
+  qsort(atoms.buf, atoms.count, sizeof(Atom), lsp_atoms_cmp);
+
+  // Keep one reference to each
+  u32 count = 0;
+  for (u32 i = 0; i < atoms.count; i++) {
+    if (count == 0 || atoms.buf[count - 1] != atoms.buf[i]) {
+      atoms.buf[count++] = atom_retain(atoms.buf[i]);
+      atoms.size += atom_size(atoms.buf[i]);
+    }
+  }
+  atoms.count = count;
+  atoms.size += sizeof(Atom) * tokens->len;
+  return atoms;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_atoms(LspAtoms* atoms)
+{
+  for (u32 i = 0; i < atoms->count; i++) {
+    atom_release(atoms->buf[i]);
+  }
+  if (atoms->buf) {
+    release(atoms->buf);
+  }
+  *atoms = (LspAtoms){ 0 };
+}
+
+// ========================================================================== //
+// LspUnit
+// ========================================================================== //
+
+LspUnit*
+make_lsp_unit(LspSnap* snap,
+              Ast* ast,
+              LspAtoms atoms,
+              LspSemToks* toks,
+              ErrList errs)
+{
+  LspUnit* unit = alloc(sizeof(LspUnit), kLnMinAlign);
+  assrt(unit != NULL, make_str("Failed to allocate analyzed document"));
+  *unit = (LspUnit){ .snap = lsp_snap_retain(snap),
+                     .ast = ast,
+                     .atoms = atoms,
+                     .toks = toks,
+                     .errs = errs };
+  unit->index = make_lsp_index(ast, &snap->src.src);
+  atomic_init(&unit->refs, 1);
+  return unit;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspUnit*
+lsp_unit_retain(LspUnit* unit)
+{
+  if (unit) {
+    atomic_fetch_add_explicit(&unit->refs, 1, memory_order_relaxed);
+  }
+  return unit;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_unit_release(LspUnit* unit)
+{
+  if (!unit) {
+    return;
+  }
+  if (atomic_fetch_sub_explicit(&unit->refs, 1, memory_order_acq_rel) == 1) {
+    release_lsp_index(&unit->index);
+    lsp_sem_toks_release(unit->toks);
+    release_err_list(&unit->errs);
+    if (unit->ast) {
+      release_ast(unit->ast);
+    }
+    release_lsp_atoms(&unit->atoms);
+    lsp_snap_release(unit->snap);
+    release(unit);
+  }
+}
@@ -0,0 +1,168 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_LSP_INDEX_H
+#define LN_LSP_INDEX_H
+
+#include "common.h"
+#include "ast.h"
+#include "atom.h"
+#include "err.h"
+#include "lsp_pool.h"
+#include "lsp_sem.h"
+
+// ========================================================================== //
+// LspIndex
+// ========================================================================== //
+
+/* Sentinel for entries without a parent */
+#define kLspIndexNone 0xFFFFFFFFu
+
+// -------------------------------------------------------------------------- //
+
+/* Node in the span index */
+typedef struct LspIndexEntry
+{
+  /* Byte offsets of the span, the end is not included */
+  u32 beg;
+  u32 end;
+  /* Innermost entry that contains this one, or kLspIndexNone */
+  u32 parent;
+  /* Depth of the node in the AST */
+  u32 depth;
+  /* Node */
+  Ast* ast;
+} LspIndexEntry;
+
+// -------------------------------------------------------------------------- //
+
+/* Span index over the nodes of an AST. The entries are sorted by the start of
+ * their spans, outer nodes before the inner, which makes finding the node at
+ * an offset a binary search followed by a walk up the parents. The index also
+ * keeps the line starts of the source to convert offsets to LSP positions */
+typedef struct LspIndex
+{
+  /* Entries */
+  LspIndexEntry* entries;
+  u32 entry_count;
+  /* Byte offsets of the starts of the lines */
+  u32* lines;
+  u32 line_count;
+  /* Source text */
+  const Str* text;
+} LspIndex;
+
+// -------------------------------------------------------------------------- //
+
+/* Build index over an AST. The AST and the text must outlive the index */
+LspIndex
+make_lsp_index(Ast* ast, const Str* text);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_index(LspIndex* index);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the innermost node whose span contains the byte offset, or NULL */
+Ast*
+lsp_index_at(const LspIndex* index, u32 off);
+
+// -------------------------------------------------------------------------- //
+
+/* Convert a byte offset to a line and a column in UTF-16 code units */
+void
+lsp_index_pos(const LspIndex* index, u32 off, u32* p_line, u32* p_character);
+
+// ========================================================================== //
+// LspAtoms
+// ========================================================================== //
+
+/* References to the distinct atoms of an analysis, which keep the names in
+ * its AST alive while the analysis is */
+typedef struct LspAtoms
+{
+  /* Atoms, sorted */
+  Atom* buf;
+  u32 count;
+  /* Memory that the atoms keep alive in bytes */
+  u64 size;
+} LspAtoms;
+
+// -------------------------------------------------------------------------- //
+
+/* Take references to the distinct atoms of tokens */
+LspAtoms
+make_lsp_atoms(const TokList* tokens);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_atoms(LspAtoms* atoms);
+
+// ========================================================================== //
+// LspUnit
+// ========================================================================== //
+
+/* Analyzed snapshot of a document. Units are immutable once made and shared
+ * between the documents and the jobs that query them */
+typedef struct LspUnit
+{
+  /* Number of references */
+  _Atomic u32 refs;
+  /* Snapshot that was analyzed */
+  LspSnap* snap;
+  /* Checked AST, NULL if the document did not lex */
+  Ast* ast;
+  /* Atoms of the AST */
+  LspAtoms atoms;
+  /* Index over the AST */
+  LspIndex index;
+  /* Semantic tokens, NULL if the document did not lex */
+  LspSemToks* toks;
+  /* Errors from the lexer, the parser and the semantic analysis */
+  ErrList errs;
+} LspUnit;
+
+// -------------------------------------------------------------------------- //
+
+/* Make unit with one reference. Ownership is taken of the AST, its atoms, the
+ * tokens and the errors and a reference to the snapshot is taken */
+LspUnit*
+make_lsp_unit(LspSnap* snap,
+              Ast* ast,
+              LspAtoms atoms,
+              LspSemToks* toks,
+              ErrList errs);
+
+// -------------------------------------------------------------------------- //
+
+LspUnit*
+lsp_unit_retain(LspUnit* unit);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_unit_release(LspUnit* unit);
+
+#endif // LN_LSP_INDEX_H
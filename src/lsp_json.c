@@ -0,0 +1,763 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsp_json.h"
+#include "str.h"
+
+// ========================================================================== //
+// LspJson
+// ========================================================================== //
+
+/* Maximum nesting of read values */
+#define kLspJsonMaxDepth 128
+
+// -------------------------------------------------------------------------- //
+
+/* Add token and returns its index */
+static u32
+lsp_json_push(LspJson* json, LspJsonKind kind, u32 beg)
+{
+  if (json->tok_count == json->tok_cap) {
+    u32 cap = json->tok_cap ? json->tok_cap * 2 : 256;
+    LspJsonTok* toks = alloc(sizeof(LspJsonTok) * cap, kLnMinAlign);
+    assrt(toks != NULL, make_str("Failed to grow JSON tokens"));
+    if (json->toks) {
+      memcpy(toks, json->toks, sizeof(LspJsonTok) * json->tok_count);
+      release(json->toks);
+    }
+    json->toks = toks;
+    json->tok_cap = cap;
+  }
+  u32 tok = json->tok_count++;
+  json->toks[tok] = (LspJsonTok){ .kind = kind, .beg = beg, .end = beg };
+  return tok;
+}
+
+// -------------------------------------------------------------------------- //
+
+static bool
+lsp_json_is_ws(char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// -------------------------------------------------------------------------- //
+
+static bool
+lsp_json_is_num(char c)
+{
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+         c == 'e' || c == 'E';
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_json_skip_ws(const LspJson* json, u32* p_off)
+{
+  u32 off = *p_off;
+  while (off < json->size && lsp_json_is_ws(json->buf[off])) {
+    off++;
+  }
+  *p_off = off;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse string at the opening quote */
+static bool
+lsp_json_parse_str(LspJson* json, u32* p_off)
+{
+  u32 tok = lsp_json_push(json, kLspJsonStr, *p_off + 1);
+  bool escaped = false;
+  for (u32 off = *p_off + 1; off < json->size; off++) {
+    char c = json->buf[off];
+    if (c == '\\') {
+      escaped = true;
+      off++;
+    } else if (c == '"') {
+      json->toks[tok].escaped = escaped;
+      json->toks[tok].end = off;
+      json->toks[tok].next = json->tok_count;
+      *p_off = off + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse literal 'true', 'false' or 'null' */
+static bool
+lsp_json_parse_lit(LspJson* json, u32* p_off, const char* lit, LspJsonKind kind)
+{
+  u32 size = (u32)strlen(lit);
+  if (json->size - *p_off < size ||
+      memcmp(json->buf + *p_off, lit, size) != 0) {
+    return false;
+  }
+  u32 tok = lsp_json_push(json, kind, *p_off);
+  *p_off += size;
+  json->toks[tok].end = *p_off;
+  json->toks[tok].next = json->tok_count;
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+static bool
+lsp_json_parse_num(LspJson* json, u32* p_off)
+{
+  u32 off = *p_off;
+  while (off < json->size && lsp_json_is_num(json->buf[off])) {
+    off++;
+  }
+  if (off == *p_off) {
+    return false;
+  }
+  u32 tok = lsp_json_push(json, kLspJsonNum, *p_off);
+  json->toks[tok].end = off;
+  json->toks[tok].next = json->tok_count;
+  *p_off = off;
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+static bool
+lsp_json_parse_value(LspJson* json, u32* p_off, u32 depth);
+
+// -------------------------------------------------------------------------- //
+
+/* Parse array or object at the opening bracket */
+static bool
+lsp_json_parse_container(LspJson* json, u32* p_off, u32 depth)
+{
+  bool is_obj = json->buf[*p_off] == '{';
+  char close = is_obj ? '}' : ']';
+  u32 tok = lsp_json_push(json, is_obj ? kLspJsonObj : kLspJsonArr, *p_off);
+  u32 off = *p_off + 1;
+
+  lsp_json_skip_ws(json, &off);
+  if (off < json->size && json->buf[off] == close) {
+    off++;
+  } else {
+    while (1) {
+      if (is_obj) {
+        lsp_json_skip_ws(json, &off);
+        if (off >= json->size || json->buf[off] != '"' ||
+            !lsp_json_parse_str(json, &off)) {
+          return false;
+        }
+        lsp_json_skip_ws(json, &off);
+        if (off >= json->size || json->buf[off] != ':') {
+          return false;
+        }
+        off++;
+      }
+      if (!lsp_json_parse_value(json, &off, depth + 1)) {
+        return false;
+      }
+      lsp_json_skip_ws(json, &off);
+      if (off < json->size && json->buf[off] == ',') {
+        off++;
+      } else if (off < json->size && json->buf[off] == close) {
+        off++;
+        break;
+      } else {
+        return false;
+      }
+    }
+  }
+
+  json->toks[tok].end = off;
+  json->toks[tok].next = json->tok_count;
+  *p_off = off;
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+static bool
+lsp_json_parse_value(LspJson* json, u32* p_off, u32 depth)
+{
+  if (depth > kLspJsonMaxDepth) {
+    return false;
+  }
+  lsp_json_skip_ws(json, p_off);
+  if (*p_off >= json->size) {
+    return false;
+  }
+  switch (json->buf[*p_off]) {
+    case '{':
+    case '[': {
+      return lsp_json_parse_container(json, p_off, depth);
+    }
+    case '"': {
+      return lsp_json_parse_str(json, p_off);
+    }
+    case 't': {
+      return lsp_json_parse_lit(json, p_off, "true", kLspJsonTrue);
+    }
+    case 'f': {
+      return lsp_json_parse_lit(json, p_off, "false", kLspJsonFalse);
+    }
+    case 'n': {
+      return lsp_json_parse_lit(json, p_off, "null", kLspJsonNull);
+    }
+    default: {
+      return lsp_json_parse_num(json, p_off);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+LspJson
+make_lsp_json(void)
+{
+  return (LspJson){ .buf = NULL };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_json(LspJson* json)
+{
+  if (json->toks) {
+    release(json->toks);
+  }
+  *json = (LspJson){ .buf = NULL };
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+lsp_json_parse(LspJson* json, char* buf, u32 size)
+{
+  json->buf = buf;
+  json->size = size;
+  json->tok_count = 0;
+
+  u32 off = 0;
+  if (!lsp_json_parse_value(json, &off, 0)) {
+    json->tok_count = 0;
+    return false;
+  }
+  lsp_json_skip_ws(json, &off);
+  if (off != size) {
+    json->tok_count = 0;
+    return false;
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspJsonKind
+lsp_json_kind(const LspJson* json, u32 tok)
+{
+  return tok < json->tok_count ? json->toks[tok].kind : kLspJsonNull;
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+lsp_json_get(const LspJson* json, u32 obj, const char* key)
+{
+  if (lsp_json_kind(json, obj) != kLspJsonObj) {
+    return kLspJsonNone;
+  }
+  u32 key_size = (u32)strlen(key);
+  for (u32 tok = obj + 1; tok < json->toks[obj].next;) {
+    const LspJsonTok* key_tok = &json->toks[tok];
+    u32 val = tok + 1;
+    if (key_tok->end - key_tok->beg == key_size &&
+        memcmp(json->buf + key_tok->beg, key, key_size) == 0) {
+      return val;
+    }
+    tok = json->toks[val].next;
+  }
+  return kLspJsonNone;
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+lsp_json_first(const LspJson* json, u32 arr)
+{
+  if (lsp_json_kind(json, arr) != kLspJsonArr ||
+      json->toks[arr].next == arr + 1) {
+    return kLspJsonNone;
+  }
+  return arr + 1;
+}
+
+// -------------------------------------------------------------------------- //
+
+u32
+lsp_json_next(const LspJson* json, u32 arr, u32 tok)
+{
+  if (lsp_json_kind(json, arr) != kLspJsonArr || tok >= json->tok_count) {
+    return kLspJsonNone;
+  }
+  u32 next = json->toks[tok].next;
+  return next < json->toks[arr].next ? next : kLspJsonNone;
+}
+
+// -------------------------------------------------------------------------- //
+
+f64
+lsp_json_num(const LspJson* json, u32 tok)
+{
+  if (lsp_json_kind(json, tok) != kLspJsonNum) {
+    return 0.0;
+  }
+
+  // Integers are the common case, others go through 'strtod'. Numbers are
+  // always followed by a delimiter, which stops it
+  const LspJsonTok* num = &json->toks[tok];
+  const char* text = json->buf + num->beg;
+  u32 size = num->end - num->beg;
+  bool neg = text[0] == '-';
+  f64 val = 0.0;
+  for (u32 i = neg ? 1 : 0; i < size; i++) {
+    if (text[i] < '0' || text[i] > '9') {
+      return strtod(text, NULL);
+    }
+    val = val * 10.0 + (f64)(text[i] - '0');
+  }
+  return neg ? -val : val;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse 4 hex digits */
+static bool
+lsp_json_hex4(const char* text, u32* p_val)
+{
+  u32 val = 0;
+  for (u32 i = 0; i < 4; i++) {
+    char c = text[i];
+    u32 digit;
+    if (c >= '0' && c <= '9') {
+      digit = (u32)(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      digit = (u32)(c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+      digit = (u32)(c - 'A' + 10);
+    } else {
+      return false;
+    }
+    val = (val << 4) | digit;
+  }
+  *p_val = val;
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Decode the escapes of a string in place. Decoded text is never longer than
+ * the escaped */
+static void
+lsp_json_decode(LspJson* json, LspJsonTok* str)
+{
+  char* buf = json->buf;
+  u32 w = str->beg;
+  for (u32 r = str->beg; r < str->end; r++) {
+    if (buf[r] != '\\' || r + 1 >= str->end) {
+      buf[w++] = buf[r];
+      continue;
+    }
+    char c = buf[++r];
+    switch (c) {
+      case 'b': {
+        buf[w++] = '\b';
+        break;
+      }
+      case 'f': {
+        buf[w++] = '\f';
+        break;
+      }
+      case 'n': {
+        buf[w++] = '\n';
+        break;
+      }
+      case 'r': {
+        buf[w++] = '\r';
+        break;
+      }
+      case 't': {
+        buf[w++] = '\t';
+        break;
+      }
+      case 'u': {
+        u32 cp;
+        if (r + 4 >= str->end || !lsp_json_hex4(buf + r + 1, &cp)) {
+          buf[w++] = c;
+          break;
+        }
+        r += 4;
+
+        // Surrogate pairs encode the code points outside of the BMP
+        u32 low;
+        if (cp >= 0xD800 && cp < 0xDC00 && r + 6 < str->end &&
+            buf[r + 1] == '\\' && buf[r + 2] == 'u' &&
+            lsp_json_hex4(buf + r + 3, &low) && low >= 0xDC00 &&
+            low < 0xE000) {
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          r += 6;
+        }
+        u32 width = 0;
+        unicode_encode(buf, w, cp, &width);
+        w += width;
+        break;
+      }
+      default: {
+        buf[w++] = c;
+        break;
+      }
+    }
+  }
+  str->end = w;
+  str->escaped = false;
+}
+
+// -------------------------------------------------------------------------- //
+
+const char*
+lsp_json_str(LspJson* json, u32 tok, u32* p_size)
+{
+  if (lsp_json_kind(json, tok) != kLspJsonStr) {
+    return NULL;
+  }
+  LspJsonTok* str = &json->toks[tok];
+  if (str->escaped) {
+    lsp_json_decode(json, str);
+  }
+  json->buf[str->end] = 0;
+  if (p_size) {
+    *p_size = str->end - str->beg;
+  }
+  return json->buf + str->beg;
+}
+
+// -------------------------------------------------------------------------- //
+
+const char*
+lsp_json_raw(LspJson* json, u32 tok, u32* p_size)
+{
+  if (tok >= json->tok_count) {
+    return NULL;
+  }
+  const LspJsonTok* val = &json->toks[tok];
+  u32 quote = val->kind == kLspJsonStr ? 1 : 0;
+  json->buf[val->end + quote] = 0;
+  if (p_size) {
+    *p_size = val->end - val->beg + 2 * quote;
+  }
+  return json->buf + val->beg - quote;
+}
+
+// ========================================================================== //
+// LspJsonWriter
+// ========================================================================== //
+
+/* Room for the header in front of the content */
+#define kLspJsonHeaderRoom 32
+
+// -------------------------------------------------------------------------- //
+
+/* Make sure that 'size' more bytes fit */
+static void
+lsp_jw_reserve(LspJsonWriter* writer, u32 size)
+{
+  if (writer->size + size <= writer->cap) {
+    return;
+  }
+  u32 cap = LN_MAX(writer->cap * 2, writer->size + size);
+  cap = LN_MAX(cap, 4096);
+  char* buf = alloc(cap, kLnMinAlign);
+  assrt(buf != NULL, make_str("Failed to grow JSON writer"));
+  if (writer->buf) {
+    memcpy(buf, writer->buf, writer->size);
+    release(writer->buf);
+  }
+  writer->buf = buf;
+  writer->cap = cap;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Write the separator before a value */
+static void
+lsp_jw_sep(LspJsonWriter* writer)
+{
+  if (writer->after_key) {
+    writer->after_key = false;
+    return;
+  }
+  if (writer->depth > 0) {
+    if (writer->has_elem[writer->depth - 1]) {
+      lsp_jw_reserve(writer, 1);
+      writer->buf[writer->size++] = ',';
+    }
+    writer->has_elem[writer->depth - 1] = true;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+lsp_jw_put(LspJsonWriter* writer, const char* text, u32 size)
+{
+  lsp_jw_reserve(writer, size);
+  memcpy(writer->buf + writer->size, text, size);
+  writer->size += size;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Write escaped string with quotes */
+static void
+lsp_jw_put_str(LspJsonWriter* writer, const char* str, u32 size)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  // Worst case is every byte written as '\u00XX'
+  lsp_jw_reserve(writer, size * 6 + 2);
+  char* out = writer->buf + writer->size;
+  *out++ = '"';
+  for (u32 i = 0; i < size; i++) {
+    u8 c = (u8)str[i];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      *out++ = (char)c;
+      continue;
+    }
+    *out++ = '\\';
+    switch (c) {
+      case '"':
+      case '\\': {
+        *out++ = (char)c;
+        break;
+      }
+      case '\n': {
+        *out++ = 'n';
+        break;
+      }
+      case '\r': {
+        *out++ = 'r';
+        break;
+      }
+      case '\t': {
+        *out++ = 't';
+        break;
+      }
+      default: {
+        *out++ = 'u';
+        *out++ = '0';
+        *out++ = '0';
+        *out++ = hex[c >> 4];
+        *out++ = hex[c & 0xF];
+        break;
+      }
+    }
+  }
+  *out++ = '"';
+  writer->size = (u32)(out - writer->buf);
+}
+
+// -------------------------------------------------------------------------- //
+
+LspJsonWriter
+make_lsp_json_writer(void)
+{
+  return (LspJsonWriter){ .size = kLspJsonHeaderRoom };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_json_writer(LspJsonWriter* writer)
+{
+  if (writer->buf) {
+    release(writer->buf);
+  }
+  *writer = (LspJsonWriter){ .size = kLspJsonHeaderRoom };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_reset(LspJsonWriter* writer)
+{
+  writer->size = kLspJsonHeaderRoom;
+  writer->msg_off = 0;
+  writer->depth = 0;
+  writer->after_key = false;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_obj_begin(LspJsonWriter* writer)
+{
+  assrt(writer->depth < kLspJsonWriterMaxDepth,
+        make_str("JSON writer nested too deep"));
+  lsp_jw_sep(writer);
+  lsp_jw_put(writer, "{", 1);
+  writer->has_elem[writer->depth++] = false;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_obj_end(LspJsonWriter* writer)
+{
+  lsp_jw_put(writer, "}", 1);
+  writer->depth--;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_arr_begin(LspJsonWriter* writer)
+{
+  assrt(writer->depth < kLspJsonWriterMaxDepth,
+        make_str("JSON writer nested too deep"));
+  lsp_jw_sep(writer);
+  lsp_jw_put(writer, "[", 1);
+  writer->has_elem[writer->depth++] = false;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_arr_end(LspJsonWriter* writer)
+{
+  lsp_jw_put(writer, "]", 1);
+  writer->depth--;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_key(LspJsonWriter* writer, const char* key)
+{
+  lsp_jw_sep(writer);
+  lsp_jw_put_str(writer, key, (u32)strlen(key));
+  lsp_jw_put(writer, ":", 1);
+  writer->after_key = true;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_str(LspJsonWriter* writer, const char* str)
+{
+  lsp_jw_str_n(writer, str, (u32)strlen(str));
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_str_n(LspJsonWriter* writer, const char* str, u32 size)
+{
+  lsp_jw_sep(writer);
+  lsp_jw_put_str(writer, str, size);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_int(LspJsonWriter* writer, s64 val)
+{
+  lsp_jw_sep(writer);
+
+  // Digits are produced backwards
+  char digits[24];
+  u32 count = 0;
+  u64 mag = val < 0 ? (u64)0 - (u64)val : (u64)val;
+  do {
+    digits[sizeof(digits) - ++count] = (char)('0' + mag % 10);
+    mag /= 10;
+  } while (mag > 0);
+  if (val < 0) {
+    digits[sizeof(digits) - ++count] = '-';
+  }
+  lsp_jw_put(writer, digits + sizeof(digits) - count, count);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_bool(LspJsonWriter* writer, bool val)
+{
+  lsp_jw_sep(writer);
+  if (val) {
+    lsp_jw_put(writer, "true", 4);
+  } else {
+    lsp_jw_put(writer, "false", 5);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_null(LspJsonWriter* writer)
+{
+  lsp_jw_sep(writer);
+  lsp_jw_put(writer, "null", 4);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_raw(LspJsonWriter* writer, const char* raw, u32 size)
+{
+  lsp_jw_sep(writer);
+  lsp_jw_put(writer, raw, size);
+}
+
+// -------------------------------------------------------------------------- //
+
+const char*
+lsp_jw_finish(LspJsonWriter* writer, u32* p_size)
+{
+  assrt(writer->depth == 0, make_str("JSON writer finished inside a value"));
+  lsp_jw_reserve(writer, 0);
+
+  // The header is written right before the content
+  u32 content_size = writer->size - kLspJsonHeaderRoom;
+  char header[kLspJsonHeaderRoom];
+  int header_size = snprintf(
+    header, sizeof(header), "Content-Length: %u\r\n\r\n", content_size);
+  writer->msg_off = kLspJsonHeaderRoom - (u32)header_size;
+  memcpy(writer->buf + writer->msg_off, header, (u32)header_size);
+  *p_size = writer->size - writer->msg_off;
+  return writer->buf + writer->msg_off;
+}
@@ -0,0 +1,254 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_LSP_JSON_H
+#define LN_LSP_JSON_H
+
+#include "common.h"
+
+// ========================================================================== //
+// LspJson
+// ========================================================================== //
+
+/* Sentinel for missing tokens. Every accessor accepts it, which allows
+ * lookups to be chained without checks in between */
+#define kLspJsonNone 0xFFFFFFFFu
+
+// -------------------------------------------------------------------------- //
+
+/* Kinds of JSON values */
+typedef enum LspJsonKind
+{
+  kLspJsonNull,
+  kLspJsonFalse,
+  kLspJsonTrue,
+  kLspJsonNum,
+  kLspJsonStr,
+  kLspJsonArr,
+  kLspJsonObj
+} LspJsonKind;
+
+// -------------------------------------------------------------------------- //
+
+/* Value in a message, referring to its text in the message buffer */
+typedef struct LspJsonTok
+{
+  /* Kind */
+  LspJsonKind kind;
+  /* Whether the string has escapes that are not yet decoded */
+  bool escaped;
+  /* Byte range of the value. Strings exclude their quotes */
+  u32 beg;
+  u32 end;
+  /* Token after the value and its children */
+  u32 next;
+} LspJsonTok;
+
+// -------------------------------------------------------------------------- //
+
+/* Zero-copy JSON reader. A message is tokenized in one pass into a flat array
+ * of tokens that refer to the message buffer, objects and arrays are followed
+ * by their children. The members of an object alternate between keys and
+ * values. The token array is reused between messages, so reading a message
+ * does not allocate once the array has grown to fit */
+typedef struct LspJson
+{
+  /* Message buffer */
+  char* buf;
+  u32 size;
+  /* Tokens, the first is the root */
+  LspJsonTok* toks;
+  u32 tok_count;
+  u32 tok_cap;
+} LspJson;
+
+// -------------------------------------------------------------------------- //
+
+LspJson
+make_lsp_json(void);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_json(LspJson* json);
+
+// -------------------------------------------------------------------------- //
+
+/* Tokenize a message. Returns false if it is not valid JSON. The buffer is
+ * borrowed until the next message and strings are decoded into it */
+bool
+lsp_json_parse(LspJson* json, char* buf, u32 size);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the kind of a token, kLspJsonNull for kLspJsonNone */
+LspJsonKind
+lsp_json_kind(const LspJson* json, u32 tok);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the value of the member 'key' of an object, or kLspJsonNone. Keys
+ * are compared without decoding them */
+u32
+lsp_json_get(const LspJson* json, u32 obj, const char* key);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the first element of an array, or kLspJsonNone */
+u32
+lsp_json_first(const LspJson* json, u32 arr);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the element after 'tok' in an array, or kLspJsonNone */
+u32
+lsp_json_next(const LspJson* json, u32 arr, u32 tok);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the value of a number, or 0 */
+f64
+lsp_json_num(const LspJson* json, u32 tok);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns a string, or NULL. The string is decoded and null-terminated in
+ * place, which means that the raw text of the values around it must not be
+ * used afterwards */
+const char*
+lsp_json_str(LspJson* json, u32 tok, u32* p_size);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the raw JSON text of a value, or NULL. The text is null-terminated
+ * in place like strings are */
+const char*
+lsp_json_raw(LspJson* json, u32 tok, u32* p_size);
+
+// ========================================================================== //
+// LspJsonWriter
+// ========================================================================== //
+
+/* Maximum nesting of written values */
+#define kLspJsonWriterMaxDepth 64
+
+// -------------------------------------------------------------------------- //
+
+/* Streaming JSON writer. Values are written straight into a buffer that has
+ * room for the message header in front of them, so a finished message is
+ * framed without copying the content. Separators are inserted automatically */
+typedef struct LspJsonWriter
+{
+  /* Buffer, starting with the room for the header */
+  char* buf;
+  u32 size;
+  u32 cap;
+  /* Start of the framed message, once finished */
+  u32 msg_off;
+  /* Depth of the current array or object */
+  u32 depth;
+  /* Whether a key was just written */
+  bool after_key;
+  /* Whether the array or object at each depth has an element */
+  bool has_elem[kLspJsonWriterMaxDepth];
+} LspJsonWriter;
+
+// -------------------------------------------------------------------------- //
+
+LspJsonWriter
+make_lsp_json_writer(void);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_json_writer(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+/* Start a new message, keeping the buffer */
+void
+lsp_jw_reset(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_obj_begin(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_obj_end(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_arr_begin(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_arr_end(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+/* Write the key of the next member */
+void
+lsp_jw_key(LspJsonWriter* writer, const char* key);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_str(LspJsonWriter* writer, const char* str);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_str_n(LspJsonWriter* writer, const char* str, u32 size);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_int(LspJsonWriter* writer, s64 val);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_bool(LspJsonWriter* writer, bool val);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_jw_null(LspJsonWriter* writer);
+
+// -------------------------------------------------------------------------- //
+
+/* Write JSON text as is */
+void
+lsp_jw_raw(LspJsonWriter* writer, const char* raw, u32 size);
+
+// -------------------------------------------------------------------------- //
+
+/* Frame the message with its header. Returns the message and its size */
+const char*
+lsp_jw_finish(LspJsonWriter* writer, u32* p_size);
+
+#endif // LN_LSP_JSON_H
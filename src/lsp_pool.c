@@ -0,0 +1,263 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "lsp_pool.h"
+#include "lsp_index.h"
+
+// ========================================================================== //
+// LspSnap
+// ========================================================================== //
+
+LspSnap*
+make_lsp_snap(const Str* uri, s64 version, Str text)
+{
+  LspSnap* snap = alloc(sizeof(LspSnap), kLnMinAlign);
+  assrt(snap != NULL, make_str("Failed to allocate document snapshot"));
+  snap->version = version;
+  snap->src = make_src_str(uri, text);
+  atomic_init(&snap->refs, 1);
+  return snap;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspSnap*
+lsp_snap_retain(LspSnap* snap)
+{
+  if (snap) {
+    atomic_fetch_add_explicit(&snap->refs, 1, memory_order_relaxed);
+  }
+  return snap;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_snap_release(LspSnap* snap)
+{
+  if (!snap) {
+    return;
+  }
+  if (atomic_fetch_sub_explicit(&snap->refs, 1, memory_order_acq_rel) == 1) {
+    release_src(&snap->src);
+    release(snap);
+  }
+}
+
+// ========================================================================== //
+// LspJob
+// ========================================================================== //
+
+LspJob*
+make_lsp_job(LspJobKind kind, const char* id, LspSnap* snap)
+{
+  LspJob* job = alloc(sizeof(LspJob), kLnMinAlign);
+  assrt(job != NULL, make_str("Failed to allocate LSP job"));
+  *job = (LspJob){ .kind = kind,
+                   .snap = lsp_snap_retain(snap),
+                   .resp = make_lsp_json_writer() };
+  if (id) {
+    u32 size = (u32)strlen(id);
+    job->id = alloc(size + 1, kLnMinAlign);
+    memcpy(job->id, id, size + 1);
+  }
+  atomic_init(&job->cancelled, false);
+  return job;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_job(LspJob* job)
+{
+  if (job->id) {
+    release(job->id);
+  }
+  release_lsp_json_writer(&job->resp);
+  lsp_sem_toks_release(job->sem);
+  lsp_unit_release(job->unit);
+  lsp_snap_release(job->snap);
+  release(job);
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+lsp_job_is_cancelled(const LspJob* job)
+{
+  return atomic_load_explicit(&job->cancelled, memory_order_relaxed);
+}
+
+// ========================================================================== //
+// LspPool
+// ========================================================================== //
+
+/* Push a finished job. Lock-free, the stack is reversed by the consumer */
+static void
+lsp_pool_push_done(LspPool* pool, LspJob* job)
+{
+  LspJob* head = atomic_load_explicit(&pool->done, memory_order_relaxed);
+  do {
+    job->next_done = head;
+  } while (!atomic_compare_exchange_weak_explicit(
+    &pool->done, &head, job, memory_order_release, memory_order_relaxed));
+
+  // Wake the I/O thread. The counter only saturates if the I/O thread is gone
+  u64 one = 1;
+  ssize_t res;
+  do {
+    res = write(pool->wake_fd, &one, sizeof(one));
+  } while (res == -1 && errno == EINTR);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void*
+lsp_pool_worker(void* arg)
+{
+  LspPool* pool = arg;
+  while (1) {
+    mutex_lock(&pool->lock);
+    while (!pool->stop && !pool->queue_head) {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    if (pool->stop) {
+      mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    LspJob* job = pool->queue_head;
+    pool->queue_head = job->next_queued;
+    if (!pool->queue_head) {
+      pool->queue_tail = NULL;
+    }
+    mutex_unlock(&pool->lock);
+
+    pool->run(job);
+    lsp_pool_push_done(pool, job);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+lsp_pool_start(LspPool* pool, u32 count, LspJobFn run)
+{
+  // Leave one core to the I/O thread
+  if (count == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    count = cores > 2 ? (u32)cores - 1 : 1;
+  }
+
+  *pool = (LspPool){ .run = run, .wake_fd = -1 };
+  atomic_init(&pool->done, NULL);
+  pool->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (pool->wake_fd == -1) {
+    return false;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+
+  pool->threads = alloc(sizeof(pthread_t) * count, kLnMinAlign);
+  for (u32 i = 0; i < count; i++) {
+    if (pthread_create(&pool->threads[i], NULL, lsp_pool_worker, pool) != 0) {
+      break;
+    }
+    pool->thread_count++;
+  }
+  if (pool->thread_count == 0) {
+    lsp_pool_stop(pool);
+    return false;
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_pool_stop(LspPool* pool)
+{
+  if (pool->wake_fd == -1) {
+    return;
+  }
+
+  mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->cond);
+  mutex_unlock(&pool->lock);
+  for (u32 i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  release(pool->threads);
+  pthread_cond_destroy(&pool->cond);
+  pthread_mutex_destroy(&pool->lock);
+  close(pool->wake_fd);
+  *pool = (LspPool){ .wake_fd = -1 };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_pool_submit(LspPool* pool, LspJob* job)
+{
+  job->next_queued = NULL;
+  mutex_lock(&pool->lock);
+  if (pool->queue_tail) {
+    pool->queue_tail->next_queued = job;
+  } else {
+    pool->queue_head = job;
+  }
+  pool->queue_tail = job;
+  pthread_cond_signal(&pool->cond);
+  mutex_unlock(&pool->lock);
+}
+
+// -------------------------------------------------------------------------- //
+
+LspJob*
+lsp_pool_take_done(LspPool* pool)
+{
+  // Reset the wake-up counter before taking the jobs, so that a job finished
+  // after this still wakes the I/O thread
+  u64 count;
+  ssize_t res;
+  do {
+    res = read(pool->wake_fd, &count, sizeof(count));
+  } while (res == -1 && errno == EINTR);
+
+  // Reverse to the order that the jobs finished in
+  LspJob* job =
+    atomic_exchange_explicit(&pool->done, NULL, memory_order_acquire);
+  LspJob* ordered = NULL;
+  while (job) {
+    LspJob* next = job->next_done;
+    job->next_done = ordered;
+    ordered = job;
+    job = next;
+  }
+  return ordered;
+}
@@ -0,0 +1,214 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_LSP_POOL_H
+#define LN_LSP_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "str.h"
+#include "src.h"
+#include "lsp_json.h"
+#include "lsp_sem.h"
+
+typedef struct LspUnit LspUnit;
+typedef struct LspCache LspCache;
+typedef struct LspClient LspClient;
+
+// ========================================================================== //
+// LspSnap
+// ========================================================================== //
+
+/* Immutable snapshot of a document. Snapshots are shared between the I/O
+ * thread and the workers and are released when the last reference goes */
+typedef struct LspSnap
+{
+  /* Number of references */
+  _Atomic u32 refs;
+  /* Version from the client */
+  s64 version;
+  /* Source, named after the document URI */
+  Src src;
+} LspSnap;
+
+// -------------------------------------------------------------------------- //
+
+/* Make snapshot with one reference. Ownership is taken of the text */
+LspSnap*
+make_lsp_snap(const Str* uri, s64 version, Str text);
+
+// -------------------------------------------------------------------------- //
+
+LspSnap*
+lsp_snap_retain(LspSnap* snap);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_snap_release(LspSnap* snap);
+
+// ========================================================================== //
+// LspJob
+// ========================================================================== //
+
+/* Kinds of jobs */
+typedef enum LspJobKind
+{
+  /* Lex, parse and check a document */
+  kLspJobAnalyze,
+  /* Answer 'textDocument/hover' */
+  kLspJobHover,
+  /* Answer 'textDocument/definition' */
+  kLspJobDefinition,
+  /* Answer 'textDocument/documentSymbol' */
+  kLspJobSymbols,
+  /* Answer 'textDocument/completion' */
+  kLspJobCompletion,
+  /* Answer 'textDocument/semanticTokens/full' */
+  kLspJobSemToks,
+  /* Answer 'textDocument/semanticTokens/full/delta' */
+  kLspJobSemToksDelta
+} LspJobKind;
+
+// -------------------------------------------------------------------------- //
+
+/* Unit of work for the pool. Jobs are created and released by the I/O thread,
+ * which also keeps track of the jobs that are in flight */
+typedef struct LspJob
+{
+  /* Kind */
+  LspJobKind kind;
+  /* Client that the job answers, NULL once it disconnects. Only used by the
+   * I/O thread */
+  LspClient* client;
+  /* Cache that analyses are looked up in and added to */
+  LspCache* cache;
+  /* Request id as JSON text, NULL for notifications */
+  char* id;
+  /* Document snapshot, may be NULL */
+  LspSnap* snap;
+  /* Analysis of the snapshot. Set by the analysis, or by the I/O thread if
+   * the document already has one. Queries analyze the snapshot themselves
+   * otherwise */
+  LspUnit* unit;
+  /* Byte offset of the position of the request */
+  u32 off;
+  /* Semantic tokens that the client has. Deltas are computed against them,
+   * and they are kept if the snapshot does not lex. Replaced by the tokens
+   * of the response */
+  LspSemToks* sem;
+  /* Result id of the semantic tokens of the response */
+  u32 sem_id;
+  /* Debug: Panic in the analysis, see 'Lsp.dbg_panic' */
+  bool dbg_panic;
+  /* Set by the I/O thread when the job is cancelled or superseded */
+  _Atomic bool cancelled;
+  /* Response, empty if there is nothing to send */
+  LspJsonWriter resp;
+  /* Next job in the work queue */
+  struct LspJob* next_queued;
+  /* Next job in the completion queue */
+  struct LspJob* next_done;
+  /* Neighbours in the list of jobs in flight */
+  struct LspJob* prev_flight;
+  struct LspJob* next_flight;
+} LspJob;
+
+// -------------------------------------------------------------------------- //
+
+/* Make job. The id is copied and a reference to the snapshot is taken */
+LspJob*
+make_lsp_job(LspJobKind kind, const char* id, LspSnap* snap);
+
+// -------------------------------------------------------------------------- //
+
+void
+release_lsp_job(LspJob* job);
+
+// -------------------------------------------------------------------------- //
+
+bool
+lsp_job_is_cancelled(const LspJob* job);
+
+// ========================================================================== //
+// LspPool
+// ========================================================================== //
+
+/* Function that runs a job on a worker and sets its response */
+typedef void (*LspJobFn)(LspJob* job);
+
+// -------------------------------------------------------------------------- //
+
+/* Worker pool. The I/O thread submits jobs to a work queue and the workers
+ * hand finished jobs back through a lock-free multi-producer single-consumer
+ * queue, waking the I/O thread through 'wake_fd' */
+typedef struct LspPool
+{
+  /* Workers */
+  pthread_t* threads;
+  /* Number of workers */
+  u32 thread_count;
+  /* Function that runs the jobs */
+  LspJobFn run;
+  /* Guards the work queue and 'stop' */
+  pthread_mutex_t lock;
+  /* Signalled when a job is queued or the pool stops */
+  pthread_cond_t cond;
+  /* Work queue */
+  LspJob* queue_head;
+  LspJob* queue_tail;
+  /* Whether the workers should exit */
+  bool stop;
+  /* Finished jobs, most recently finished first */
+  _Atomic(LspJob*) done;
+  /* Event file descriptor that is signalled when a job finishes */
+  int wake_fd;
+} LspPool;
+
+// -------------------------------------------------------------------------- //
+
+/* Start pool with 'count' workers, or one per spare core if 'count' is 0 */
+bool
+lsp_pool_start(LspPool* pool, u32 count, LspJobFn run);
+
+// -------------------------------------------------------------------------- //
+
+/* Stop the pool after the workers finish their current jobs. Jobs that are
+ * still queued are not run, they are owned by the I/O thread like all jobs */
+void
+lsp_pool_stop(LspPool* pool);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_pool_submit(LspPool* pool, LspJob* job);
+
+// -------------------------------------------------------------------------- //
+
+/* Take all finished jobs in the order that they finished. Must only be called
+ * from the I/O thread */
+LspJob*
+lsp_pool_take_done(LspPool* pool);
+
+#endif // LN_LSP_POOL_H
@@ -0,0 +1,260 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <string.h>
+
+#include "lsp_sem.h"
+
+// ========================================================================== //
+// LspSemType
+// ========================================================================== //
+
+const char*
+lsp_sem_type_name(LspSemType type)
+{
+  switch (type) {
+    case kLspSemKeyword:
+      return "keyword";
+    case kLspSemVariable:
+      return "variable";
+    case kLspSemNumber:
+      return "number";
+    case kLspSemString:
+      return "string";
+    case kLspSemOperator:
+      return "operator";
+    default:
+      panic(make_str("Invalid LspSemType (%u)"), type);
+  }
+}
+
+// ========================================================================== //
+// LspSemToks
+// ========================================================================== //
+
+/* State while packing the tokens of a text */
+typedef struct LspSemPacker
+{
+  /* Tokens that are packed */
+  LspSemToks* toks;
+  u32 cap;
+  /* Byte offset, line and column of the cursor in the text */
+  u32 off;
+  u32 line;
+  u32 col;
+  /* Line and column of the previous token */
+  u32 prev_line;
+  u32 prev_col;
+} LspSemPacker;
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the semantic type of a token, false if it is not highlighted */
+static bool
+lsp_sem_type_get(const Tok* tok, LspSemType* p_type)
+{
+  switch (tok->kind) {
+    case kTokKeyword:
+      *p_type = kLspSemKeyword;
+      return true;
+    case kTokIdent:
+      *p_type = kLspSemVariable;
+      return true;
+    case kTokInt:
+    case kTokFloat:
+      *p_type = kLspSemNumber;
+      return true;
+    case kTokStr:
+      *p_type = kLspSemString;
+      return true;
+    case kTokSym:
+      // Brackets and separators are punctuation
+      *p_type = kLspSemOperator;
+      return tok->data.sym_kind <= kTokSymQmark;
+    default:
+      return false;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Append a token that starts at the given line and column */
+static void
+lsp_sem_pack(LspSemPacker* packer,
+             u32 line,
+             u32 col,
+             u32 length,
+             LspSemType type)
+{
+  LspSemToks* toks = packer->toks;
+  if (toks->count + kLspSemStride > packer->cap) {
+    u32 cap = packer->cap ? packer->cap * 2 : kLspSemStride * 64;
+    u32* data = alloc(sizeof(u32) * cap, kLnMinAlign);
+    assrt(data != NULL, make_str("Failed to allocate semantic tokens"));
+    if (toks->data) {
+      memcpy(data, toks->data, sizeof(u32) * toks->count);
+      release(toks->data);
+    }
+    toks->data = data;
+    packer->cap = cap;
+  }
+
+  u32* tok = toks->data + toks->count;
+  tok[0] = line - packer->prev_line;
+  tok[1] = line == packer->prev_line ? col - packer->prev_col : col;
+  tok[2] = length;
+  tok[3] = type;
+  tok[4] = 0;
+  toks->count += kLspSemStride;
+  packer->prev_line = line;
+  packer->prev_col = col;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Advance the cursor over a byte */
+static void
+lsp_sem_advance(LspSemPacker* packer, u8 c)
+{
+  packer->off++;
+  if (c == '\n') {
+    packer->line++;
+    packer->col = 0;
+  } else {
+    packer->col += unicode_utf16_units(c);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+LspSemToks*
+make_lsp_sem_toks(const TokList* tokens, const Str* text)
+{
+  LspSemToks* toks = alloc(sizeof(LspSemToks), kLnMinAlign);
+  assrt(toks != NULL, make_str("Failed to allocate semantic tokens"));
+  *toks = (LspSemToks){ .data = NULL, .count = 0 };
+  atomic_init(&toks->refs, 1);
+
+  // The tokens are in order, which lets the cursor walk the text once
+  LspSemPacker packer = { .toks = toks };
+  for (u32 i = 0; i < tokens->len; i++) {
+    const Tok* tok = &tokens->buf[i];
+    LspSemType type;
+    if (!lsp_sem_type_get(tok, &type)) {
+      continue;
+    }
+    u32 end = LN_MIN(tok->span.end.off, text->size);
+    while (packer.off < tok->span.beg.off && packer.off < end) {
+      lsp_sem_advance(&packer, text->buf[packer.off]);
+    }
+
+    // Pieces of the token end at the line breaks
+    u32 line = packer.line;
+    u32 col = packer.col;
+    while (packer.off < end) {
+      u8 c = text->buf[packer.off];
+      if (c == '\n' || c == '\r') {
+        if (packer.col > col) {
+          lsp_sem_pack(&packer, line, col, packer.col - col, type);
+        }
+        lsp_sem_advance(&packer, c);
+        line = packer.line;
+        col = packer.col;
+        continue;
+      }
+      lsp_sem_advance(&packer, c);
+    }
+    if (packer.col > col) {
+      lsp_sem_pack(&packer, line, col, packer.col - col, type);
+    }
+  }
+  return toks;
+}
+
+// -------------------------------------------------------------------------- //
+
+LspSemToks*
+lsp_sem_toks_retain(LspSemToks* toks)
+{
+  if (toks) {
+    atomic_fetch_add_explicit(&toks->refs, 1, memory_order_relaxed);
+  }
+  return toks;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_sem_toks_release(LspSemToks* toks)
+{
+  if (!toks) {
+    return;
+  }
+  if (atomic_fetch_sub_explicit(&toks->refs, 1, memory_order_acq_rel) == 1) {
+    if (toks->data) {
+      release(toks->data);
+    }
+    release(toks);
+  }
+}
+
+// ========================================================================== //
+// LspSemEdit
+// ========================================================================== //
+
+LspSemEdit
+lsp_sem_diff(const LspSemToks* prev, const LspSemToks* cur)
+{
+  const u32* prev_data = prev ? prev->data : NULL;
+  const u32* cur_data = cur ? cur->data : NULL;
+  u32 prev_count = prev ? prev->count : 0;
+  u32 cur_count = cur ? cur->count : 0;
+  u32 max = LN_MIN(prev_count, cur_count);
+
+  // Whole tokens are compared, which keeps the edits aligned to them
+  const u32 tok_size = sizeof(u32) * kLspSemStride;
+  u32 prefix = 0;
+  while (prefix < max &&
+         memcmp(prev_data + prefix, cur_data + prefix, tok_size) == 0) {
+    prefix += kLspSemStride;
+  }
+  u32 suffix = 0;
+  while (suffix < max - prefix &&
+         memcmp(prev_data + prev_count - suffix - kLspSemStride,
+                cur_data + cur_count - suffix - kLspSemStride,
+                tok_size) == 0) {
+    suffix += kLspSemStride;
+  }
+
+  return (LspSemEdit){ .start = prefix,
+                       .delete_count = prev_count - prefix - suffix,
+                       .data_beg = prefix,
+                       .data_count = cur_count - prefix - suffix };
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+lsp_sem_edit_is_empty(const LspSemEdit* edit)
+{
+  return edit->delete_count == 0 && edit->data_count == 0;
+}
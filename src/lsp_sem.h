@@ -0,0 +1,131 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_LSP_SEM_H
+#define LN_LSP_SEM_H
+
+#include <stdatomic.h>
+
+#include "common.h"
+#include "str.h"
+#include "lex.h"
+
+// ========================================================================== //
+// LspSemType
+// ========================================================================== //
+
+/* Semantic token types, in the order of the legend sent to the client */
+typedef enum LspSemType
+{
+  kLspSemKeyword,
+  kLspSemVariable,
+  kLspSemNumber,
+  kLspSemString,
+  kLspSemOperator,
+} LspSemType;
+
+// -------------------------------------------------------------------------- //
+
+/* Number of semantic token types */
+#define kLspSemTypeCount (kLspSemOperator + 1)
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the LSP name of a semantic token type */
+const char*
+lsp_sem_type_name(LspSemType type);
+
+// ========================================================================== //
+// LspSemToks
+// ========================================================================== //
+
+/* Number of integers per token in the packed format */
+#define kLspSemStride 5
+
+// -------------------------------------------------------------------------- //
+
+/* Semantic tokens of a snapshot in the packed format of the LSP. Every token
+ * is five integers: the line relative to the previous token, the column
+ * relative to the previous token if on the same line, the length, the type
+ * and the modifiers. Columns and lengths are in UTF-16 code units. Tokens are
+ * shared between the unit they were made for and the documents that last
+ * sent them */
+typedef struct LspSemToks
+{
+  /* Number of references */
+  _Atomic u32 refs;
+  /* Packed tokens */
+  u32* data;
+  /* Number of integers */
+  u32 count;
+} LspSemToks;
+
+// -------------------------------------------------------------------------- //
+
+/* Make semantic tokens with one reference from the tokens of a lexed text.
+ * Whitespace and punctuation are not highlighted, tokens that span several
+ * lines are split at the line breaks */
+LspSemToks*
+make_lsp_sem_toks(const TokList* tokens, const Str* text);
+
+// -------------------------------------------------------------------------- //
+
+LspSemToks*
+lsp_sem_toks_retain(LspSemToks* toks);
+
+// -------------------------------------------------------------------------- //
+
+void
+lsp_sem_toks_release(LspSemToks* toks);
+
+// ========================================================================== //
+// LspSemEdit
+// ========================================================================== //
+
+/* Edit that turns one set of packed tokens into another */
+typedef struct LspSemEdit
+{
+  /* Index of the first integer to replace in the old tokens */
+  u32 start;
+  /* Number of integers to remove from the old tokens */
+  u32 delete_count;
+  /* Range of the new tokens to insert */
+  u32 data_beg;
+  u32 data_count;
+} LspSemEdit;
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the single edit from 'prev' to 'cur', which covers the tokens
+ * between their common prefix and suffix. Positions are relative, so a
+ * small change of the text only changes the tokens around it. Either may be
+ * NULL, which is the same as no tokens */
+LspSemEdit
+lsp_sem_diff(const LspSemToks* prev, const LspSemToks* cur);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns true if the edit changes nothing */
+bool
+lsp_sem_edit_is_empty(const LspSemEdit* edit);
+
+#endif // LN_LSP_SEM_H
@@ -22,12 +22,14 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "common.h"
 #include "str.h"
 #include "lex.h"
 #include "file.h"
 #include "parser.h"
+#include "sema.h"
 #include "lsp.h"
 #include "type.h"
 #include "args.h"
@@ -35,6 +37,8 @@
 #include "src.h"
 #include "target.h"
 #include "llvm_util.h"
+#include "mir.h"
+#include "codegen.h"
 
 // ========================================================================== //
 // Main
@@ -45,19 +49,55 @@ print_help()
 {
   printf(
     "--help, -h                 | Print this help message\n"
-    "--output, -o <path>        | Specify the output file\n"
+    "--output, -o <path>        | Specify the output file. Defaults to the\n"
+    "                           | name of the input file with the extension\n"
+    "                           | of the output kind\n"
+    "--pgo-gen                  | Instrument code to write a profile to\n"
+    "                           | 'default.profraw' when run. Link with the\n"
+    "                           | LLVM profile runtime and merge the profile\n"
+    "                           | with 'llvm-profdata merge'\n"
+    "--pgo-use=<profdata>       | Optimize with a merged profile\n"
+    "--emit=<kind>              | Output kind, one of 'obj', 'asm', 'bc' and\n"
+    "                           | 'll'. Defaults to 'obj'\n"
+    "--lto                      | Link all input files, including '.bc'\n"
+    "                           | files, into one module before optimizing\n"
+    "                           | it. Emits a single output file\n"
     "--target, -t <arch>        | Specify target architecture for\n"
     "                           | compilation. Only specify this if you are\n"
-    "                           | doing cross-compilation\n"
+    "                           | doing cross-compilation. Either a preset,\n"
+    "                           | 'x86_64-linux', 'x86-win32',\n"
+    "                           | 'x86_64-win32', 'aarch64-linux',\n"
+    "                           | 'aarch64-ios', 'riscv64' or 'wasm32', or a\n"
+    "                           | triple such as 'armv7-unknown-linux-gnu'\n"
+    "-O0, -O1, -O2, -O3, -Os    | Optimization level. Defaults to -O0\n"
+    "-mcpu=<cpu>                | Target CPU, 'native' selects the CPU of\n"
+    "                           | the host\n"
+    "-mattr=<features>          | Comma-separated target features to enable\n"
+    "                           | or disable, for example '+avx2,-fma'\n"
+    "--codegen-units <n>        | Split each file into at most <n> units\n"
+    "                           | that are generated in parallel and emitted\n"
+    "                           | as separate object files. Defaults to 1\n"
+    "--run                      | JIT-compile the input file and run its\n"
+    "                           | 'main' function without writing an object\n"
+    "                           | file. Exits with the value from 'main'\n"
     "--verbose, -v              | Verbose output\n"
     "--lsp <type> <host> <port> | Start the compiler in LSP server mode. This\n"
     "                           | will let the compiler start serving request\n"
-    "                           | from an LSP client\n"
+    "                           | from an LSP client. The type is 'tcp' to\n"
+    "                           | connect to the client, 'tcp-listen' to\n"
+    "                           | serve every client that connects or\n"
+    "                           | 'stdio', which takes no host and port\n"
+    "--lsp-cache <MiB>          | Memory budget of the analyses that the\n"
+    "                           | clients of the LSP server share. Defaults\n"
+    "                           | to 256\n"
     "--dbg-dump-tok             | Dump the tokens after lexical analysis\n"
     "--dbg-dump-ast             | Dump ast after syntax analysis\n"
     "--dbg-dump-ir              | Dump IR after conversion to first stage IR,\n"
     "                           | 'MIR' (Mid-level IR).\n"
     "--dbg-dump-ll              | Dump LLVM IR after conversion from the\n"
+    "                           | MIR and optimization\n"
+    "--dbg-lsp-panic            | Panic in the LSP analysis of documents\n"
+    "                           | that contain 'dbg_lsp_panic'\n"
     "\n");
 }
 
@@ -66,16 +106,19 @@ print_help()
 int
 main_lsp(const Args* args)
 {
-  Lsp lsp = make_lsp();
-  lsp_connect(
+  Lsp lsp = make_lsp((u64)args->lsp_data.cache_mb << 20);
+  lsp.dbg_panic = args->dbg_lsp_panic;
+  LspErr err = lsp_connect(
     &lsp, args->lsp_data.type, args->lsp_data.host, args->lsp_data.port);
-  LspErr err = lsp_run(&lsp);
-  Str err_str = lsp_err_str(err);
+  if (err == kLspNoErr) {
+    err = lsp_run(&lsp);
+  }
+  release_lsp(&lsp);
   if (err != kLspNoErr) {
-    printf("LSP error (%s)\n", str_cstr(&err_str));
+    Str err_str = lsp_err_str(err);
+    fprintf(stderr, "LSP error (%s)\n", str_cstr(&err_str));
     return -1;
   }
-  lsp_disconnect(&lsp);
   return 0;
 }
 
@@ -86,6 +129,8 @@ main_init()
 {
   llvm_init();
   types_init();
+  atoms_init();
+  tok_kw_init();
 }
 
 // -------------------------------------------------------------------------- //
@@ -93,69 +138,361 @@ main_init()
 void
 main_cleanup()
 {
+  atoms_cleanup();
   types_cleanup();
+  target_registry_cleanup();
   llvm_cleanup();
   LN_CHECK_LEAK();
 }
 
 // -------------------------------------------------------------------------- //
 
+/* Returns the output file path for input. Without '--output' this is the
+ * name of the input file, in the working directory, with the extension of
+ * the output kind */
+Str
+main_output_path(const Args* args, const Str* in)
+{
+  if (args->output.size > 0) {
+    return str_copy(&args->output);
+  }
+  const char* path = str_cstr(in);
+  const char* name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+  const char* ext = strrchr(name, '.');
+  u32 name_size = ext && ext != name ? (u32)(ext - name) : (u32)strlen(name);
+  return str_format(
+    make_str("%.*s%s"), name_size, name, codegen_emit_ext(args->emit));
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns whether the input is an LLVM bitcode file */
+bool
+main_is_bc(const Str* in)
+{
+  return in->size > 3 && strcmp(str_cstr(in) + in->size - 3, ".bc") == 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Check that the profile-guided optimization arguments can be used
+ * together with the other arguments */
+bool
+main_check_pgo(const Args* args)
+{
+  if (!args->pgo_gen && args->pgo_use.size == 0) {
+    return true;
+  }
+  if (args->pgo_gen && args->pgo_use.size > 0) {
+    printf("Fatal: '--pgo-gen' and '--pgo-use' cannot be used together\n");
+    return false;
+  }
+  if (args->opt_level == kTargetOpt0) {
+    printf("Fatal: Profile-guided optimization requires '-O1' or higher\n");
+    return false;
+  }
+  if (args->pgo_gen && args->run) {
+    printf("Fatal: '--pgo-gen' cannot be used with '--run' since the JIT "
+           "does not link the profile runtime\n");
+    return false;
+  }
+  if (args->pgo_use.size > 0) {
+    FILE* file = fopen(str_cstr(&args->pgo_use), "rb");
+    if (!file) {
+      printf("Fatal: Failed to open profile '%s'\n",
+             str_cstr(&args->pgo_use));
+      return false;
+    }
+    fclose(file);
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Acquire target machine for the arguments, exits on failure */
+Target*
+main_make_target(const Args* args, TargetOpts* p_opts)
+{
+  *p_opts = (TargetOpts){ .name = args->target,
+                          .cpu = args->cpu,
+                          .features = args->features,
+                          .opt_level = args->opt_level,
+                          .pgo_gen = args->pgo_gen,
+                          .pgo_use = args->pgo_use };
+  Target* target;
+  TargetErr target_err = target_registry_acquire(p_opts, &target);
+  if (target_err == kTargetInvCpu) {
+    printf("Fatal: '-mcpu=native' can only be used when compiling for "
+           "the host\n");
+    exit(-1);
+  } else if (target_err == kTargetInvTarget) {
+    printf("Fatal: Unknown target '%s'. Specify a preset or a triple\n",
+           str_cstr(&args->target));
+    exit(-1);
+  } else if (target_err != kTargetNoErr) {
+    printf("Fatal: Failed to create target machine\n");
+    exit(-1);
+  }
+  return target;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Front-end state of a source file. The MIR refers to the source and the
+ * ast, so all of it is kept until code has been generated */
+typedef struct MainFile
+{
+  Src src;
+  TokList tokens;
+  Ast* ast;
+  MirModule mir;
+} MainFile;
+
+// -------------------------------------------------------------------------- //
+
+/* Load, check and lower source file to MIR. Returns false if the file
+ * failed to compile */
+bool
+main_load_file(const Args* args, const Str* in, MainFile* p_file)
+{
+  // Load source
+  SrcErr src_err = make_src(in, &p_file->src);
+  if (src_err != kSrcNoErr) {
+    printf("Fatal: Failed to create source '%s'\n", str_cstr(in));
+    exit(-1);
+  }
+
+  // Lexical analysis
+  LexErr lex_err = tok_list_lex(&p_file->src, NULL, &p_file->tokens);
+  if (lex_err != kLexNoErr) {
+    printf("Lexical analysis failed\n");
+    release_src(&p_file->src);
+    return false;
+  }
+  if (args->dbg_dump_tokens) {
+    tok_list_dump(&p_file->tokens);
+  }
+
+  // Syntax analysis
+  Parser parser = make_parser(&p_file->src, &p_file->tokens);
+  p_file->ast = parser_parse(&parser);
+  u32 parse_err_count = parser.err_count;
+  release_parser(&parser);
+  if (parse_err_count > 0) {
+    printf("Syntax analysis failed\n");
+    release_ast(p_file->ast);
+    release_tok_list(&p_file->tokens);
+    release_src(&p_file->src);
+    return false;
+  }
+
+  // Semantic analysis
+  Sema sema = make_sema(&p_file->src);
+  SemaErr sema_err = sema_check_prog(&sema, p_file->ast);
+  release_sema(&sema);
+  if (args->dbg_dump_ast) {
+    ast_dump(p_file->ast);
+  }
+  if (sema_err != kSemaNoErr) {
+    printf("Semantic analysis failed\n");
+    release_ast(p_file->ast);
+    release_tok_list(&p_file->tokens);
+    release_src(&p_file->src);
+    return false;
+  }
+
+  // MIR gen
+  p_file->mir = make_mir_module(p_file->ast);
+  if (args->opt_level != kTargetOpt0) {
+    mir_module_opt(&p_file->mir);
+  }
+  if (args->dbg_dump_ir) {
+    mir_module_dump(&p_file->mir);
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+main_release_file(MainFile* file)
+{
+  release_mir_module(&file->mir);
+  release_ast(file->ast);
+  release_tok_list(&file->tokens);
+  release_src(&file->src);
+}
+
+// -------------------------------------------------------------------------- //
+
+CodegenErr
+main_run(const Args* args,
+         const Target* target,
+         const Str* in,
+         const MirModule* mir,
+         int* p_result)
+{
+  Codegen codegen = make_codegen(target, in);
+  CodegenErr err = codegen_gen_mir(&codegen, mir, NULL, 0);
+  if (err == kCodegenNoErr) {
+    codegen_optimize(&codegen);
+    if (args->dbg_dump_ll) {
+      codegen_dump(&codegen);
+    }
+    s32 result;
+    err = codegen_run(&codegen, &result);
+    *p_result = result;
+  }
+  release_codegen(&codegen);
+  return err;
+}
+
+// -------------------------------------------------------------------------- //
+
 int
 main_compile_files(const Args* args)
 {
+  if (args->output.size > 0 && args->input.len > 1) {
+    printf("Fatal: '--output' can only be used with a single input file\n");
+    return -1;
+  }
+  if (args->run && args->input.len != 1) {
+    printf("Fatal: '--run' requires exactly one input file\n");
+    return -1;
+  }
+  if (args->run && args->target.size > 0) {
+    printf("Fatal: '--run' can only be used when compiling for the host\n");
+    return -1;
+  }
+
   // Compile each file
+  int res = 0;
   for (u32 i = 0; i < args->input.len; i++) {
     const Str* in = str_list_get(&args->input, i);
-    printf(con_col256(105) "Compiling:" con_col_reset " %s\n", str_cstr(in));
+    if (main_is_bc(in)) {
+      printf("Fatal: Bitcode input '%s' requires '--lto'\n", str_cstr(in));
+      return -1;
+    }
+    if (!args->run) {
+      printf(con_col256(105) "Compiling:" con_col_reset " %s\n",
+             str_cstr(in));
+    }
 
     // Create target machine
-    Target target;
-    TargetErr target_err = make_target(&args->target, &target);
-    if (target_err != kTargetNoErr) {
-      printf("Fatal: Failed to create target machine\n");
-      exit(-1);
+    TargetOpts target_opts;
+    Target* target = main_make_target(args, &target_opts);
+
+    // Front-end
+    MainFile file;
+    if (!main_load_file(args, in, &file)) {
+      target_registry_release(target);
+      return -1;
     }
 
-    // Load source
-    Src src;
-    SrcErr src_err = make_src(in, &src);
-    if (src_err != kSrcNoErr) {
-      printf("Fatal: Failed to create source '%s'\n", str_cstr(in));
-      exit(-1);
+    // LLVM IR gen
+    CodegenErr codegen_err;
+    if (args->run) {
+      codegen_err = main_run(args, target, in, &file.mir, &res);
+    } else {
+      Str out = main_output_path(args, in);
+      CodegenOpts codegen_opts = { .target = target,
+                                   .target_opts = &target_opts,
+                                   .name = in,
+                                   .path = &out,
+                                   .emit = args->emit,
+                                   .unit_count = args->codegen_units,
+                                   .dump = args->dbg_dump_ll };
+      codegen_err = codegen_emit_units(&file.mir, &codegen_opts);
+      release_str(&out);
     }
 
-    // Lexical analysis
-    TokList tokens;
-    LexErr lex_err = tok_list_lex(&src, &tokens);
-    if (lex_err != kLexNoErr) {
-      printf("Lexical analysis failed\n");
+    // Release
+    main_release_file(&file);
+    target_registry_release(target);
+    if (codegen_err != kCodegenNoErr) {
+      printf("Code generation failed\n");
       return -1;
     }
-    if (args->dbg_dump_tokens) {
-      tok_list_dump(&tokens);
-    }
+  }
+
+  return res;
+}
 
-    // Syntax analysis
-    Parser parser = make_parser(&src, &tokens);
-    Ast* ast = parser_parse(&parser);
-    if (args->dbg_dump_ast) {
-      LN_UNUSED(ast);
+// -------------------------------------------------------------------------- //
+
+/* Compile all input files, and link all bitcode inputs, into one module
+ * that is then optimized as a whole. This lets functions be inlined across
+ * files */
+int
+main_compile_lto(const Args* args)
+{
+  if (args->run && args->target.size > 0) {
+    printf("Fatal: '--run' can only be used when compiling for the host\n");
+    return -1;
+  }
+
+  // Create target machine
+  TargetOpts target_opts;
+  Target* target = main_make_target(args, &target_opts);
+
+  // Generate each file in a module of its own and link it into the result
+  const Str* first = str_list_get(&args->input, 0);
+  Codegen codegen = make_codegen(target, first);
+  CodegenErr codegen_err = kCodegenNoErr;
+  for (u32 i = 0; i < args->input.len && codegen_err == kCodegenNoErr; i++) {
+    const Str* in = str_list_get(&args->input, i);
+    if (!args->run) {
+      printf(con_col256(105) "Compiling:" con_col_reset " %s\n",
+             str_cstr(in));
     }
-    if (args->dbg_dump_ast) {
-      ast_dump(ast);
+    if (main_is_bc(in)) {
+      codegen_err = codegen_link_bc(&codegen, in);
+      continue;
     }
 
-    // MIR gen
-
-    // LLVM IR gen
+    MainFile file;
+    if (!main_load_file(args, in, &file)) {
+      release_codegen(&codegen);
+      target_registry_release(target);
+      return -1;
+    }
+    Codegen unit = make_codegen(target, in);
+    codegen_err = codegen_gen_mir(&unit, &file.mir, NULL, 0);
+    if (codegen_err == kCodegenNoErr) {
+      codegen_err = codegen_link(&codegen, &unit);
+    }
+    release_codegen(&unit);
+    main_release_file(&file);
+  }
 
-    // Release
-    release_ast(ast);
-    release_tok_list(&tokens);
-    release_src(&src);
+  // Optimize and emit, or run, the linked module
+  int res = 0;
+  if (codegen_err == kCodegenNoErr) {
+    codegen_optimize(&codegen);
+    if (args->dbg_dump_ll) {
+      codegen_dump(&codegen);
+    }
+    if (args->run) {
+      s32 result;
+      codegen_err = codegen_run(&codegen, &result);
+      res = result;
+    } else {
+      Str out = main_output_path(args, first);
+      codegen_err = codegen_emit(&codegen, args->emit, &out);
+      release_str(&out);
+    }
   }
 
-  return 0;
+  // Release
+  release_codegen(&codegen);
+  target_registry_release(target);
+  if (codegen_err != kCodegenNoErr) {
+    printf("Code generation failed\n");
+    return -1;
+  }
+  return res;
 }
 
 // -------------------------------------------------------------------------- //
@@ -181,17 +518,24 @@ main(int argc, char** argv)
 
   // LSP
   if (args.lsp) {
-    printf("Starting the compiler in LSP mode");
+    fprintf(stderr, "Starting the compiler in LSP mode\n");
     int res = main_lsp(&args);
     release_args(&args);
     return res;
   }
 
+  // Profile-guided optimization
+  if (!main_check_pgo(&args)) {
+    release_args(&args);
+    main_cleanup();
+    return -1;
+  }
+
   // Compile files
-  main_compile_files(&args);
+  int res = args.lto ? main_compile_lto(&args) : main_compile_files(&args);
 
   // Cleanup
   release_args(&args);
   main_cleanup();
-  return 0;
+  return res;
 }
\ No newline at end of file
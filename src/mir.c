@@ -0,0 +1,1649 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "mir.h"
+
+// ========================================================================== //
+// Util
+// ========================================================================== //
+
+#define kMirArenaChunkSize 16384
+
+// -------------------------------------------------------------------------- //
+
+static Type*
+mir_elem_type(Type* type)
+{
+  return type_is_vector(type) ? type->vector.type : type;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Truncate integer value to the width of type */
+static u64
+mir_int_trunc(Type* type, u64 val)
+{
+  u32 bits = type_prim(mir_elem_type(type))->size * 8;
+  return bits >= 64 ? val : val & ((1ull << bits) - 1);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Sign-extend integer value from the width of type */
+static s64
+mir_int_sext(Type* type, u64 val)
+{
+  u32 bits = type_prim(mir_elem_type(type))->size * 8;
+  if (bits >= 64) {
+    return (s64)val;
+  }
+  u64 sign = 1ull << (bits - 1);
+  return (s64)((mir_int_trunc(type, val) ^ sign) - sign);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Round float value to the precision of type */
+static f64
+mir_float_round(Type* type, f64 val)
+{
+  return type_prim(mir_elem_type(type))->size == 4 ? (f64)(f32)val : val;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the number of operands of instruction */
+static u32
+mir_inst_operand_count(const MirInst* inst)
+{
+  switch (inst->op) {
+    case kMirOpBinop:
+    case kMirOpLoad: {
+      return 2;
+    }
+    case kMirOpStore: {
+      return 3;
+    }
+    case kMirOpCopy:
+    case kMirOpRet:
+    case kMirOpCondBr: {
+      return 1;
+    }
+    case kMirOpPhi: {
+      return inst->phi.count;
+    }
+    case kMirOpCall: {
+      return inst->call.count;
+    }
+    default: {
+      return 0;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the slot of operand 'i' of instruction */
+static MirInst**
+mir_inst_operand(MirInst* inst, u32 i)
+{
+  switch (inst->op) {
+    case kMirOpBinop: {
+      return i == 0 ? &inst->binop.lhs : &inst->binop.rhs;
+    }
+    case kMirOpLoad: {
+      return i == 0 ? &inst->load.ptr : &inst->load.index;
+    }
+    case kMirOpStore: {
+      if (i == 0) {
+        return &inst->store.ptr;
+      }
+      return i == 1 ? &inst->store.index : &inst->store.value;
+    }
+    case kMirOpCopy: {
+      return &inst->copy;
+    }
+    case kMirOpRet: {
+      return &inst->ret;
+    }
+    case kMirOpCondBr: {
+      return &inst->cond_br.cond;
+    }
+    case kMirOpPhi: {
+      return &inst->phi.values[i];
+    }
+    case kMirOpCall: {
+      return &inst->call.args[i];
+    }
+    default: {
+      panic(make_str("Instruction has no operands"));
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the value at the end of a chain of copies */
+static MirInst*
+mir_resolve_copy(MirInst* inst)
+{
+  while (inst->op == kMirOpCopy) {
+    inst = inst->copy;
+  }
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_block_remove(MirBlock* block, MirInst* inst)
+{
+  if (inst->prev) {
+    inst->prev->next = inst->next;
+  } else {
+    block->first = inst->next;
+  }
+  if (inst->next) {
+    inst->next->prev = inst->prev;
+  } else {
+    block->last = inst->prev;
+  }
+  inst->prev = NULL;
+  inst->next = NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_block_push_front(MirBlock* block, MirInst* inst)
+{
+  inst->prev = NULL;
+  inst->next = block->first;
+  if (block->first) {
+    block->first->prev = inst;
+  } else {
+    block->last = inst;
+  }
+  block->first = inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_block_add_pred(MirFn* fn, MirBlock* block, MirBlock* pred)
+{
+  // The old array stays in the arena until the function is released
+  if (block->pred_count == block->pred_cap) {
+    u32 cap = block->pred_cap ? block->pred_cap * 2 : 2;
+    MirBlock** preds = arena_alloc(&fn->arena, sizeof(MirBlock*) * cap, 8);
+    if (block->pred_count > 0) {
+      memcpy(preds, block->preds, sizeof(MirBlock*) * block->pred_count);
+    }
+    block->preds = preds;
+    block->pred_cap = cap;
+  }
+  block->preds[block->pred_count++] = pred;
+}
+
+// ========================================================================== //
+// MirInst
+// ========================================================================== //
+
+bool
+mir_inst_is_term(const MirInst* inst)
+{
+  return inst->op == kMirOpRet || inst->op == kMirOpRetVoid ||
+         inst->op == kMirOpUnreachable || inst->op == kMirOpBr ||
+         inst->op == kMirOpCondBr;
+}
+
+// ========================================================================== //
+// MirBuilder
+// ========================================================================== //
+
+/* Slot in the map from declaration and block to value */
+typedef struct MirSlot
+{
+  /* Block */
+  MirBlock* block;
+  /* Declaration (AstLet, AstParam or AstFor) */
+  Ast* decl;
+  /* Value */
+  MirInst* value;
+} MirSlot;
+
+// -------------------------------------------------------------------------- //
+
+/* Phi that gets its operands when its block is sealed */
+typedef struct MirIncompletePhi
+{
+  /* Phi */
+  MirInst* phi;
+  /* Declaration */
+  Ast* decl;
+} MirIncompletePhi;
+
+// -------------------------------------------------------------------------- //
+
+/* State while lowering a function. Values are constructed directly in SSA
+ * form, following "Simple and Efficient Construction of Static Single
+ * Assignment Form" (Braun et al.). The value of a declaration is tracked per
+ * block and phis are only created where control flow joins */
+typedef struct MirBuilder
+{
+  /* Function */
+  MirFn* fn;
+  /* Block that instructions are appended to */
+  MirBlock* block;
+  /* Map from declaration and block to value */
+  MirSlot* values;
+  /* Value map capacity (power of two) */
+  u32 value_cap;
+  /* Number of values in map */
+  u32 value_count;
+  /* Phis of blocks that are not sealed yet */
+  MirIncompletePhi* incomplete;
+  /* Number of incomplete phis */
+  u32 incomplete_count;
+  /* Incomplete phi capacity */
+  u32 incomplete_cap;
+  /* All phis, used to find the phis that use a removed phi */
+  MirInst** phis;
+  /* Number of phis */
+  u32 phi_count;
+  /* Phi capacity */
+  u32 phi_cap;
+} MirBuilder;
+
+// -------------------------------------------------------------------------- //
+
+static u32
+mir_builder_hash(MirBlock* block, Ast* decl)
+{
+  u64 key = (u64)(uintptr_t)decl ^ ((u64)(uintptr_t)block << 7);
+  return (u32)((key >> 4) * 2654435761u);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_builder_grow(MirBuilder* builder)
+{
+  u32 old_cap = builder->value_cap;
+  MirSlot* old_values = builder->values;
+
+  builder->value_cap = old_cap ? old_cap * 2 : 64;
+  builder->values = alloc(sizeof(MirSlot) * builder->value_cap, kLnMinAlign);
+  memset(builder->values, 0, sizeof(MirSlot) * builder->value_cap);
+  u32 mask = builder->value_cap - 1;
+  for (u32 i = 0; i < old_cap; i++) {
+    if (!old_values[i].decl) {
+      continue;
+    }
+    u32 pos = mir_builder_hash(old_values[i].block, old_values[i].decl) & mask;
+    while (builder->values[pos].decl) {
+      pos = (pos + 1) & mask;
+    }
+    builder->values[pos] = old_values[i];
+  }
+  if (old_values) {
+    release(old_values);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Grow list owned by the builder */
+static void*
+mir_builder_grow_list(void* list, u32 count, u32* p_cap, u32 elem_size)
+{
+  if (count < *p_cap) {
+    return list;
+  }
+  *p_cap = *p_cap ? *p_cap * 2 : 16;
+  void* grown = alloc((u64)elem_size * *p_cap, kLnMinAlign);
+  if (list) {
+    memcpy(grown, list, (u64)elem_size * count);
+    release(list);
+  }
+  return grown;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Set the value of declaration at the end of block */
+static void
+mir_builder_set(MirBuilder* builder,
+                MirBlock* block,
+                Ast* decl,
+                MirInst* value)
+{
+  if ((builder->value_count + 1) * 2 > builder->value_cap) {
+    mir_builder_grow(builder);
+  }
+  u32 mask = builder->value_cap - 1;
+  u32 pos = mir_builder_hash(block, decl) & mask;
+  while (builder->values[pos].decl &&
+         (builder->values[pos].decl != decl ||
+          builder->values[pos].block != block)) {
+    pos = (pos + 1) & mask;
+  }
+  if (!builder->values[pos].decl) {
+    builder->value_count++;
+  }
+  builder->values[pos] =
+    (MirSlot){ .block = block, .decl = decl, .value = value };
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the value of declaration set in block, or NULL */
+static MirInst*
+mir_builder_get(MirBuilder* builder, MirBlock* block, Ast* decl)
+{
+  u32 mask = builder->value_cap - 1;
+  u32 pos = mir_builder_hash(block, decl) & mask;
+  while (builder->values[pos].decl) {
+    if (builder->values[pos].decl == decl &&
+        builder->values[pos].block == block) {
+      return builder->values[pos].value;
+    }
+    pos = (pos + 1) & mask;
+  }
+  return NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_builder_make_inst(MirBuilder* builder, MirOp op, Type* type)
+{
+  MirInst* inst = arena_alloc(&builder->fn->arena, sizeof(MirInst), 8);
+  inst->op = op;
+  inst->id = builder->fn->value_count++;
+  inst->type = type;
+  inst->name = kAtomNone;
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Append new instruction to the current block */
+static MirInst*
+mir_builder_push(MirBuilder* builder, MirOp op, Type* type)
+{
+  MirInst* inst = mir_builder_make_inst(builder, op, type);
+  MirBlock* block = builder->block;
+  inst->prev = block->last;
+  if (block->last) {
+    block->last->next = inst;
+  } else {
+    block->first = inst;
+  }
+  block->last = inst;
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirBlock*
+mir_builder_make_block(MirBuilder* builder)
+{
+  return arena_alloc(&builder->fn->arena, sizeof(MirBlock), 8);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Append block to function. Blocks are numbered in the order they are placed,
+ * which keeps the numbering in layout order */
+static void
+mir_builder_place_block(MirBuilder* builder, MirBlock* block)
+{
+  MirFn* fn = builder->fn;
+  block->id = fn->block_count++;
+  if (fn->last_block) {
+    fn->last_block->next = block;
+  } else {
+    fn->first_block = block;
+  }
+  fn->last_block = block;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_builder_br(MirBuilder* builder, MirBlock* target)
+{
+  MirInst* inst = mir_builder_push(builder, kMirOpBr, NULL);
+  inst->br.target = target;
+  mir_block_add_pred(builder->fn, target, builder->block);
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_builder_cond_br(MirBuilder* builder,
+                    MirInst* cond,
+                    MirBlock* then_block,
+                    MirBlock* else_block)
+{
+  MirInst* inst = mir_builder_push(builder, kMirOpCondBr, NULL);
+  inst->cond_br.cond = cond;
+  inst->cond_br.then_block = then_block;
+  inst->cond_br.else_block = else_block;
+  mir_block_add_pred(builder->fn, then_block, builder->block);
+  mir_block_add_pred(builder->fn, else_block, builder->block);
+}
+
+// -------------------------------------------------------------------------- //
+
+static bool
+mir_builder_is_terminated(MirBuilder* builder)
+{
+  MirInst* last = builder->block->last;
+  return last && mir_inst_is_term(last);
+}
+
+// ========================================================================== //
+// SSA construction
+// ========================================================================== //
+
+static MirInst*
+mir_builder_read(MirBuilder* builder, MirBlock* block, Ast* decl);
+
+// -------------------------------------------------------------------------- //
+
+static Atom
+mir_decl_name(Ast* decl)
+{
+  switch (decl->kind) {
+    case kAstLet: {
+      return decl->let.name;
+    }
+    case kAstParam: {
+      return decl->param.name;
+    }
+    case kAstFor: {
+      return decl->for_loop.name;
+    }
+    default: {
+      panic(make_str("Invalid declaration kind (%u)"), decl->kind);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Make phi for declaration at the start of block, without operands */
+static MirInst*
+mir_builder_make_phi(MirBuilder* builder, MirBlock* block, Ast* decl)
+{
+  MirInst* phi = mir_builder_make_inst(builder, kMirOpPhi, decl->res_type);
+  phi->name = mir_decl_name(decl);
+  phi->phi.block = block;
+  mir_block_push_front(block, phi);
+  builder->phis = mir_builder_grow_list(
+    builder->phis, builder->phi_count, &builder->phi_cap, sizeof(MirInst*));
+  builder->phis[builder->phi_count++] = phi;
+  return phi;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Make undefined value. It is placed in the entry block so that it dominates
+ * every use */
+static MirInst*
+mir_builder_make_undef(MirBuilder* builder, Type* type)
+{
+  MirInst* undef = mir_builder_make_inst(builder, kMirOpUndef, type);
+  mir_block_push_front(builder->fn->first_block, undef);
+  return undef;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns whether any operand of phi is 'value' or a copy of it */
+static bool
+mir_phi_uses(const MirInst* phi, const MirInst* value)
+{
+  for (u32 i = 0; i < phi->phi.count; i++) {
+    for (MirInst* op = phi->phi.values[i];; op = op->copy) {
+      if (op == value) {
+        return true;
+      }
+      if (op->op != kMirOpCopy) {
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* A phi whose operands are all the same value, or the phi itself, is
+ * replaced by that value. The phi becomes a copy that is removed by copy
+ * propagation. Returns the value that replaces the phi */
+static MirInst*
+mir_builder_remove_trivial_phi(MirBuilder* builder, MirInst* phi)
+{
+  MirInst* same = NULL;
+  for (u32 i = 0; i < phi->phi.count; i++) {
+    MirInst* value = mir_resolve_copy(phi->phi.values[i]);
+    if (value == same || value == phi) {
+      continue;
+    }
+    if (same) {
+      return phi;
+    }
+    same = value;
+  }
+
+  // Only reachable from itself
+  if (!same) {
+    same = mir_builder_make_undef(builder, phi->type);
+  }
+  phi->op = kMirOpCopy;
+  phi->copy = same;
+
+  // Removing the phi can make the phis that used it trivial
+  for (u32 i = 0; i < builder->phi_count; i++) {
+    MirInst* user = builder->phis[i];
+    if (user->op == kMirOpPhi && mir_phi_uses(user, phi)) {
+      mir_builder_remove_trivial_phi(builder, user);
+    }
+  }
+  return same;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Read the operands of phi from the predecessors of its block */
+static MirInst*
+mir_builder_add_phi_operands(MirBuilder* builder, MirInst* phi, Ast* decl)
+{
+  // The count is only set when all operands are read, so that the phi is not
+  // considered while it is partially filled
+  MirBlock* block = phi->phi.block;
+  MirInst** values =
+    arena_alloc(&builder->fn->arena, sizeof(MirInst*) * block->pred_count, 8);
+  for (u32 i = 0; i < block->pred_count; i++) {
+    values[i] = mir_builder_read(builder, block->preds[i], decl);
+  }
+  phi->phi.values = values;
+  phi->phi.count = block->pred_count;
+  return mir_builder_remove_trivial_phi(builder, phi);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Read the value of declaration at the end of block */
+static MirInst*
+mir_builder_read(MirBuilder* builder, MirBlock* block, Ast* decl)
+{
+  MirInst* value = mir_builder_get(builder, block, decl);
+  if (value) {
+    return value;
+  }
+
+  if (!block->sealed) {
+    // More predecessors can be added, so operands are read when sealed
+    value = mir_builder_make_phi(builder, block, decl);
+    builder->incomplete = mir_builder_grow_list(builder->incomplete,
+                                                builder->incomplete_count,
+                                                &builder->incomplete_cap,
+                                                sizeof(MirIncompletePhi));
+    builder->incomplete[builder->incomplete_count++] =
+      (MirIncompletePhi){ .phi = value, .decl = decl };
+  } else if (block->pred_count == 1) {
+    value = mir_builder_read(builder, block->preds[0], decl);
+  } else if (block->pred_count == 0) {
+    value = mir_builder_make_undef(builder, decl->res_type);
+  } else {
+    // Set before reading the operands to break cycles through loops
+    value = mir_builder_make_phi(builder, block, decl);
+    mir_builder_set(builder, block, decl, value);
+    value = mir_builder_add_phi_operands(builder, value, decl);
+  }
+  mir_builder_set(builder, block, decl, value);
+  return value;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Seal block once all of its predecessors are known */
+static void
+mir_builder_seal(MirBuilder* builder, MirBlock* block)
+{
+  // Reading operands can add incomplete phis for other declarations
+  u32 i = 0;
+  while (i < builder->incomplete_count) {
+    MirIncompletePhi entry = builder->incomplete[i];
+    if (entry.phi->phi.block != block) {
+      i++;
+      continue;
+    }
+    builder->incomplete[i] = builder->incomplete[--builder->incomplete_count];
+    mir_builder_add_phi_operands(builder, entry.phi, entry.decl);
+  }
+  block->sealed = true;
+}
+
+// ========================================================================== //
+// Lowering
+// ========================================================================== //
+
+static MirInst*
+mir_lower_expr(MirBuilder* builder, Ast* ast);
+
+static void
+mir_lower_stmt(MirBuilder* builder, Ast* ast);
+
+static void
+mir_lower_block(MirBuilder* builder, Ast* ast);
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_lower_const(MirBuilder* builder, Ast* ast)
+{
+  Type* type = ast->res_type;
+  MirInst* inst = mir_builder_push(builder, kMirOpConst, type);
+  if (ast->constant.kind == kAstConstStr) {
+    StrSlice value = ast->constant.value;
+    inst->constant.str_val =
+      (StrSlice){ .ptr = value.ptr + 1, .count = value.count - 2 };
+  } else if (type_is_float(type)) {
+    inst->constant.float_val = mir_float_round(type, ast_const_to_f64(ast));
+  } else {
+    inst->constant.int_val = mir_int_trunc(type, ast_const_to_u64(ast));
+  }
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_lower_binop(MirBuilder* builder, Ast* ast)
+{
+  MirInst* lhs = mir_lower_expr(builder, ast->binop.lhs);
+  MirInst* rhs = mir_lower_expr(builder, ast->binop.rhs);
+  MirInst* inst = mir_builder_push(builder, kMirOpBinop, ast->res_type);
+  inst->binop.kind = ast->binop.kind;
+  inst->binop.lhs = lhs;
+  inst->binop.rhs = rhs;
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_lower_index(MirBuilder* builder, Ast* ast)
+{
+  MirInst* ptr = mir_lower_expr(builder, ast->index.base);
+  MirInst* index = mir_lower_expr(builder, ast->index.index);
+  MirInst* inst = mir_builder_push(builder, kMirOpLoad, ast->res_type);
+  inst->load.ptr = ptr;
+  inst->load.index = index;
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_lower_call(MirBuilder* builder, Ast* ast)
+{
+  AstList* ast_args = &ast->call.args;
+  MirInst** args =
+    arena_alloc(&builder->fn->arena, sizeof(MirInst*) * ast_args->len, 8);
+  for (u32 i = 0; i < ast_args->len; i++) {
+    args[i] = mir_lower_expr(builder, ast_list_get(ast_args, i));
+  }
+  Type* type = ast->res_type == get_type_void() ? NULL : ast->res_type;
+  MirInst* inst = mir_builder_push(builder, kMirOpCall, type);
+  inst->call.fn = ast->call.name;
+  inst->call.args = args;
+  inst->call.count = ast_args->len;
+  return inst;
+}
+
+// -------------------------------------------------------------------------- //
+
+static MirInst*
+mir_lower_expr(MirBuilder* builder, Ast* ast)
+{
+  switch (ast->kind) {
+    case kAstConst: {
+      return mir_lower_const(builder, ast);
+    }
+    case kAstVar: {
+      return mir_builder_read(builder, builder->block, ast->var.decl);
+    }
+    case kAstBinop: {
+      return mir_lower_binop(builder, ast);
+    }
+    case kAstIndex: {
+      return mir_lower_index(builder, ast);
+    }
+    case kAstCall: {
+      return mir_lower_call(builder, ast);
+    }
+    default: {
+      panic(make_str("Invalid expression kind (%u)"), ast->kind);
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Lower value that is bound to the name of a declaration */
+static MirInst*
+mir_lower_named(MirBuilder* builder, Ast* ast_expr, Atom name)
+{
+  // Binding an existing value produces a copy, which is what gives the
+  // new name its own value
+  MirInst* value = mir_lower_expr(builder, ast_expr);
+  if (ast_expr->kind == kAstVar) {
+    MirInst* copy = mir_builder_push(builder, kMirOpCopy, value->type);
+    copy->copy = value;
+    value = copy;
+  }
+  value->name = name;
+  return value;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_lower_let(MirBuilder* builder, Ast* ast)
+{
+  // A let without value is undefined until it is assigned
+  if (!ast->let.expr) {
+    return;
+  }
+
+  MirInst* value = mir_lower_named(builder, ast->let.expr, ast->let.name);
+  mir_builder_set(builder, builder->block, ast, value);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_lower_assign(MirBuilder* builder, Ast* ast)
+{
+  Ast* ast_target = ast->assign.target;
+
+  // Store through pointer
+  if (ast_target->kind == kAstIndex) {
+    MirInst* ptr = mir_lower_expr(builder, ast_target->index.base);
+    MirInst* index = mir_lower_expr(builder, ast_target->index.index);
+    MirInst* value = mir_lower_expr(builder, ast->assign.expr);
+    MirInst* inst = mir_builder_push(builder, kMirOpStore, NULL);
+    inst->store.ptr = ptr;
+    inst->store.index = index;
+    inst->store.value = value;
+    return;
+  }
+
+  // Variables get a new value from here on
+  Ast* decl = ast_target->var.decl;
+  MirInst* value =
+    mir_lower_named(builder, ast->assign.expr, mir_decl_name(decl));
+  mir_builder_set(builder, builder->block, decl, value);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Lower the body of a loop and continue in its latch */
+static void
+mir_lower_loop_body(MirBuilder* builder,
+                    Ast* ast_body,
+                    MirBlock* body,
+                    MirBlock* latch)
+{
+  // Only entered from the header
+  mir_builder_place_block(builder, body);
+  mir_builder_seal(builder, body);
+  builder->block = body;
+  mir_lower_block(builder, ast_body);
+  if (!mir_builder_is_terminated(builder)) {
+    mir_builder_br(builder, latch);
+  }
+
+  mir_builder_place_block(builder, latch);
+  mir_builder_seal(builder, latch);
+  builder->block = latch;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* End loop with the back edge from the latch and continue in the exit */
+static void
+mir_lower_loop_end(MirBuilder* builder,
+                   const AstLoopAttrs* attrs,
+                   u64 trip_count,
+                   MirBlock* header,
+                   MirBlock* exit)
+{
+  // A body that always returns leaves the latch unreachable, so the loop
+  // has no back edge
+  if (builder->block->pred_count == 0) {
+    mir_builder_push(builder, kMirOpUnreachable, NULL);
+  } else {
+    MirLoop* loop = arena_alloc(&builder->fn->arena, sizeof(MirLoop), 8);
+    *loop = (MirLoop){ .header = header,
+                       .latch = builder->block,
+                       .trip_count = trip_count,
+                       .attrs = *attrs };
+    MirInst* back_edge = mir_builder_br(builder, header);
+    back_edge->br.loop = loop;
+  }
+  mir_builder_seal(builder, header);
+
+  // Only entered from the header
+  mir_builder_place_block(builder, exit);
+  mir_builder_seal(builder, exit);
+  builder->block = exit;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_lower_while(MirBuilder* builder, Ast* ast)
+{
+  MirBlock* header = mir_builder_make_block(builder);
+  MirBlock* body = mir_builder_make_block(builder);
+  MirBlock* latch = mir_builder_make_block(builder);
+  MirBlock* exit = mir_builder_make_block(builder);
+
+  // The current block is the preheader
+  mir_builder_br(builder, header);
+  mir_builder_place_block(builder, header);
+  builder->block = header;
+  MirInst* cond = mir_lower_expr(builder, ast->while_loop.cond);
+  mir_builder_cond_br(builder, cond, body, exit);
+
+  mir_lower_loop_body(builder, ast->while_loop.body, body, latch);
+  mir_lower_loop_end(builder, &ast->while_loop.attrs, 0, header, exit);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Number of iterations of 'from..to' */
+static u64
+mir_trip_count(Type* type, u64 from, u64 to)
+{
+  if (type_is_signed(type)) {
+    s64 sfrom = mir_int_sext(type, from);
+    s64 sto = mir_int_sext(type, to);
+    return sto > sfrom ? (u64)sto - (u64)sfrom : 0;
+  }
+  return to > from ? to - from : 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_lower_for(MirBuilder* builder, Ast* ast)
+{
+  AstFor* ast_for = &ast->for_loop;
+  Type* type = ast->res_type;
+  MirInst* from = mir_lower_expr(builder, ast_for->from);
+  MirInst* to = mir_lower_expr(builder, ast_for->to);
+  u64 trip_count = 0;
+  if (from->op == kMirOpConst && to->op == kMirOpConst) {
+    trip_count =
+      mir_trip_count(type, from->constant.int_val, to->constant.int_val);
+  }
+
+  MirBlock* header = mir_builder_make_block(builder);
+  MirBlock* body = mir_builder_make_block(builder);
+  MirBlock* latch = mir_builder_make_block(builder);
+  MirBlock* exit = mir_builder_make_block(builder);
+
+  // The current block is the preheader
+  MirBlock* preheader = builder->block;
+  mir_builder_br(builder, header);
+  mir_builder_place_block(builder, header);
+  builder->block = header;
+
+  // Induction variable, its operands are known once the latch is lowered
+  MirInst* iv = mir_builder_make_phi(builder, header, ast);
+  mir_builder_set(builder, header, ast, iv);
+  MirInst* cmp = mir_builder_push(builder, kMirOpBinop, get_type_bool());
+  cmp->binop.kind = kAstBinopLt;
+  cmp->binop.lhs = iv;
+  cmp->binop.rhs = to;
+  mir_builder_cond_br(builder, cmp, body, exit);
+
+  // The loop variable cannot be assigned, so the latch increments 'iv'. As
+  // 'iv' is less than 'to' the increment cannot overflow
+  mir_lower_loop_body(builder, ast_for->body, body, latch);
+  MirInst* one = mir_builder_push(builder, kMirOpConst, type);
+  one->constant.int_val = 1;
+  MirInst* next = mir_builder_push(builder, kMirOpBinop, type);
+  next->name = ast_for->name;
+  next->binop.kind = kAstBinopAdd;
+  next->binop.lhs = iv;
+  next->binop.rhs = one;
+  next->binop.no_wrap = true;
+  mir_lower_loop_end(builder, &ast_for->attrs, trip_count, header, exit);
+
+  assrt(header->pred_count > 0 && header->preds[0] == preheader,
+        make_str("Loop header must be entered from the preheader"));
+  MirInst** values = arena_alloc(&builder->fn->arena, sizeof(MirInst*) * 2, 8);
+  values[0] = from;
+  values[1] = next;
+  iv->phi.values = values;
+  iv->phi.count = header->pred_count;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_lower_block(MirBuilder* builder, Ast* ast)
+{
+  for (u32 i = 0; i < ast->block.stmts.len; i++) {
+    // Statements after a return are dead
+    if (mir_builder_is_terminated(builder)) {
+      break;
+    }
+    mir_lower_stmt(builder, ast_list_get(&ast->block.stmts, i));
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_lower_stmt(MirBuilder* builder, Ast* ast)
+{
+  switch (ast->kind) {
+    case kAstLet: {
+      mir_lower_let(builder, ast);
+      break;
+    }
+    case kAstRet: {
+      if (!ast->ret.expr) {
+        mir_builder_push(builder, kMirOpRetVoid, NULL);
+        break;
+      }
+      MirInst* value = mir_lower_expr(builder, ast->ret.expr);
+      MirInst* inst = mir_builder_push(builder, kMirOpRet, NULL);
+      inst->ret = value;
+      break;
+    }
+    case kAstBlock: {
+      mir_lower_block(builder, ast);
+      break;
+    }
+    case kAstAssign: {
+      mir_lower_assign(builder, ast);
+      break;
+    }
+    case kAstWhile: {
+      mir_lower_while(builder, ast);
+      break;
+    }
+    case kAstFor: {
+      mir_lower_for(builder, ast);
+      break;
+    }
+    default: {
+      mir_lower_expr(builder, ast);
+      break;
+    }
+  }
+}
+
+// ========================================================================== //
+// MirFn
+// ========================================================================== //
+
+MirFn*
+mir_lower_fn(Ast* ast_fn)
+{
+  assrt(ast_fn->kind == kAstFn, make_str("Wrong ast kind"));
+  assrt(ast_fn->fn.checked,
+        make_str("Only checked functions can be lowered to MIR"));
+
+  MirFn* fn = alloc(sizeof(MirFn), kLnMinAlign);
+  memset(fn, 0, sizeof(MirFn));
+  fn->arena = make_arena(kMirArenaChunkSize);
+  fn->name = ast_fn->fn.name;
+  fn->ret_type = ast_fn->res_type;
+  fn->is_decl = ast_fn->fn.body == NULL;
+
+  MirBuilder builder = { .fn = fn };
+  mir_builder_grow(&builder);
+
+  // Entry block, which holds the values of the params
+  MirBlock* entry = NULL;
+  if (!fn->is_decl) {
+    entry = mir_builder_make_block(&builder);
+    mir_builder_place_block(&builder, entry);
+    mir_builder_seal(&builder, entry);
+    builder.block = entry;
+  }
+
+  // Params
+  fn->param_count = ast_fn->fn.params.len;
+  fn->params =
+    arena_alloc(&fn->arena, sizeof(MirInst*) * fn->param_count, 8);
+  for (u32 i = 0; i < fn->param_count; i++) {
+    Ast* ast_param = ast_list_get(&ast_fn->fn.params, i);
+    MirInst* param =
+      mir_builder_make_inst(&builder, kMirOpParam, ast_param->res_type);
+    param->param_index = i;
+    param->name = ast_param->param.name;
+    fn->params[i] = param;
+    if (entry) {
+      mir_builder_set(&builder, entry, ast_param, param);
+    }
+  }
+
+  // Body
+  if (!fn->is_decl) {
+    mir_lower_block(&builder, ast_fn->fn.body);
+
+    // Falling off the end is only valid for functions without return type
+    if (!mir_builder_is_terminated(&builder)) {
+      MirOp op = fn->ret_type == get_type_void() ? kMirOpRetVoid
+                                                 : kMirOpUnreachable;
+      mir_builder_push(&builder, op, NULL);
+    }
+  }
+
+  assrt(builder.incomplete_count == 0,
+        make_str("All blocks must be sealed after lowering"));
+  if (builder.phis) {
+    release(builder.phis);
+  }
+  if (builder.incomplete) {
+    release(builder.incomplete);
+  }
+  release(builder.values);
+  return fn;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_mir_fn(MirFn* fn)
+{
+  release_arena(&fn->arena);
+  release(fn);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mir_opt_fn(MirFn* fn)
+{
+  mir_pass_copy_prop(fn);
+  mir_pass_const_prop(fn);
+  mir_pass_dce(fn);
+}
+
+// ========================================================================== //
+// Passes
+// ========================================================================== //
+
+void
+mir_pass_copy_prop(MirFn* fn)
+{
+  for (MirBlock* block = fn->first_block; block; block = block->next) {
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      u32 op_count = mir_inst_operand_count(inst);
+      for (u32 i = 0; i < op_count; i++) {
+        MirInst** op = mir_inst_operand(inst, i);
+        *op = mir_resolve_copy(*op);
+      }
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Fold integer binop. Returns false if the result is not defined */
+static bool
+mir_fold_int(AstBinopKind kind, Type* type, u64 lhs, u64 rhs, u64* p_res)
+{
+  bool is_signed = type_is_signed(type);
+  switch (kind) {
+    case kAstBinopAdd: {
+      *p_res = lhs + rhs;
+      break;
+    }
+    case kAstBinopSub: {
+      *p_res = lhs - rhs;
+      break;
+    }
+    case kAstBinopMul: {
+      *p_res = lhs * rhs;
+      break;
+    }
+    case kAstBinopDiv:
+    case kAstBinopMod: {
+      if (rhs == 0) {
+        return false;
+      }
+      if (!is_signed) {
+        *p_res = kind == kAstBinopDiv ? lhs / rhs : lhs % rhs;
+        break;
+      }
+      u32 bits = type_prim(mir_elem_type(type))->size * 8;
+      s64 slhs = mir_int_sext(type, lhs);
+      s64 srhs = mir_int_sext(type, rhs);
+      s64 smin = mir_int_sext(type, 1ull << (bits - 1));
+      if (slhs == smin && srhs == -1) {
+        return false;
+      }
+      *p_res = (u64)(kind == kAstBinopDiv ? slhs / srhs : slhs % srhs);
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+  *p_res = mir_int_trunc(type, *p_res);
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Fold integer comparison */
+static bool
+mir_fold_int_cmp(AstBinopKind kind, Type* type, u64 lhs, u64 rhs)
+{
+  // Compare in the domain of the type, ordered as signed or unsigned
+  s64 order;
+  if (type_is_signed(type)) {
+    s64 slhs = mir_int_sext(type, lhs);
+    s64 srhs = mir_int_sext(type, rhs);
+    order = slhs < srhs ? -1 : slhs > srhs;
+  } else {
+    order = lhs < rhs ? -1 : lhs > rhs;
+  }
+  switch (kind) {
+    case kAstBinopEq: {
+      return order == 0;
+    }
+    case kAstBinopNe: {
+      return order != 0;
+    }
+    case kAstBinopLt: {
+      return order < 0;
+    }
+    case kAstBinopLe: {
+      return order <= 0;
+    }
+    case kAstBinopGt: {
+      return order > 0;
+    }
+    default: {
+      return order >= 0;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Fold float comparison. Comparisons with NaN are false, except for '!=' */
+static bool
+mir_fold_float_cmp(AstBinopKind kind, f64 lhs, f64 rhs)
+{
+  switch (kind) {
+    case kAstBinopEq: {
+      return lhs == rhs;
+    }
+    case kAstBinopNe: {
+      return lhs != rhs;
+    }
+    case kAstBinopLt: {
+      return lhs < rhs;
+    }
+    case kAstBinopLe: {
+      return lhs <= rhs;
+    }
+    case kAstBinopGt: {
+      return lhs > rhs;
+    }
+    default: {
+      return lhs >= rhs;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static f64
+mir_fold_float(AstBinopKind kind, Type* type, f64 lhs, f64 rhs)
+{
+  f64 res;
+  switch (kind) {
+    case kAstBinopAdd: {
+      res = lhs + rhs;
+      break;
+    }
+    case kAstBinopSub: {
+      res = lhs - rhs;
+      break;
+    }
+    case kAstBinopMul: {
+      res = lhs * rhs;
+      break;
+    }
+    case kAstBinopDiv: {
+      res = lhs / rhs;
+      break;
+    }
+    default: {
+      res = fmod(lhs, rhs);
+      break;
+    }
+  }
+
+  return mir_float_round(type, res);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mir_pass_const_prop(MirFn* fn)
+{
+  // Operands are defined before their uses, so chains fold in one pass
+  for (MirBlock* block = fn->first_block; block; block = block->next) {
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      if (inst->op != kMirOpBinop) {
+        continue;
+      }
+      MirInst* lhs = inst->binop.lhs;
+      MirInst* rhs = inst->binop.rhs;
+      if (lhs->op != kMirOpConst || rhs->op != kMirOpConst) {
+        continue;
+      }
+
+      // Comparisons are folded in the type of the operands
+      AstBinopKind kind = inst->binop.kind;
+      if (ast_binop_kind_is_cmp(kind)) {
+        bool res =
+          type_is_float(lhs->type)
+            ? mir_fold_float_cmp(
+                kind, lhs->constant.float_val, rhs->constant.float_val)
+            : mir_fold_int_cmp(
+                kind, lhs->type, lhs->constant.int_val, rhs->constant.int_val);
+        inst->op = kMirOpConst;
+        inst->constant.int_val = res;
+      } else if (type_is_float(inst->type)) {
+        f64 res = mir_fold_float(
+          kind, inst->type, lhs->constant.float_val, rhs->constant.float_val);
+        inst->op = kMirOpConst;
+        inst->constant.float_val = res;
+      } else if (type_is_int(inst->type)) {
+        u64 res;
+        if (!mir_fold_int(kind,
+                          inst->type,
+                          lhs->constant.int_val,
+                          rhs->constant.int_val,
+                          &res)) {
+          continue;
+        }
+        inst->op = kMirOpConst;
+        inst->constant.int_val = res;
+      }
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mir_pass_dce(MirFn* fn)
+{
+  // Count uses
+  for (MirBlock* block = fn->first_block; block; block = block->next) {
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      inst->use_count = 0;
+    }
+  }
+  for (MirBlock* block = fn->first_block; block; block = block->next) {
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      u32 op_count = mir_inst_operand_count(inst);
+      for (u32 i = 0; i < op_count; i++) {
+        (*mir_inst_operand(inst, i))->use_count++;
+      }
+    }
+  }
+
+  // Remove unused values. Walking backwards removes whole chains of dead
+  // values, the outer loop handles chains that cross blocks
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (MirBlock* block = fn->first_block; block; block = block->next) {
+      MirInst* inst = block->last;
+      while (inst) {
+        MirInst* prev = inst->prev;
+        bool has_effect = mir_inst_is_term(inst) ||
+                          inst->op == kMirOpStore || inst->op == kMirOpCall;
+        if (inst->use_count == 0 && !has_effect) {
+          u32 op_count = mir_inst_operand_count(inst);
+          for (u32 i = 0; i < op_count; i++) {
+            (*mir_inst_operand(inst, i))->use_count--;
+          }
+          mir_block_remove(block, inst);
+          changed = true;
+        }
+        inst = prev;
+      }
+    }
+  }
+}
+
+// ========================================================================== //
+// Dump
+// ========================================================================== //
+
+static void
+mir_value_dump(const MirInst* inst)
+{
+  Str type_str = type_to_str(inst->type);
+  if (inst->name != kAtomNone) {
+    StrSlice name = atom_str(inst->name);
+    printf("%%%u %.*s: %s",
+           inst->id,
+           str_slice_print(&name),
+           str_cstr(&type_str));
+  } else {
+    printf("%%%u: %s", inst->id, str_cstr(&type_str));
+  }
+  release_str(&type_str);
+}
+
+// -------------------------------------------------------------------------- //
+
+static const char*
+mir_binop_name(AstBinopKind kind)
+{
+  switch (kind) {
+    case kAstBinopAdd: {
+      return "add";
+    }
+    case kAstBinopSub: {
+      return "sub";
+    }
+    case kAstBinopMul: {
+      return "mul";
+    }
+    case kAstBinopDiv: {
+      return "div";
+    }
+    case kAstBinopMod: {
+      return "mod";
+    }
+    case kAstBinopEq: {
+      return "eq";
+    }
+    case kAstBinopNe: {
+      return "ne";
+    }
+    case kAstBinopLt: {
+      return "lt";
+    }
+    case kAstBinopLe: {
+      return "le";
+    }
+    case kAstBinopGt: {
+      return "gt";
+    }
+    case kAstBinopGe: {
+      return "ge";
+    }
+    default: {
+      panic(make_str("Invalid binop kind"));
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Dump loop info after the back edge */
+static void
+mir_loop_dump(const MirLoop* loop)
+{
+  printf(" ; loop bb%u", loop->header->id);
+  if (loop->trip_count > 0) {
+    printf(", trips %llu", (unsigned long long)loop->trip_count);
+  }
+  const AstLoopAttrs* attrs = &loop->attrs;
+  if (attrs->vectorize == kAstLoopHintEnable) {
+    printf(", vectorize(%u)", attrs->vectorize_width);
+  } else if (attrs->vectorize == kAstLoopHintDisable) {
+    printf(", novectorize");
+  }
+  if (attrs->unroll == kAstLoopHintEnable) {
+    printf(", unroll(%u)", attrs->unroll_count);
+  } else if (attrs->unroll == kAstLoopHintDisable) {
+    printf(", nounroll");
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+mir_inst_dump(const MirInst* inst)
+{
+  printf("  ");
+  if (inst->type) {
+    mir_value_dump(inst);
+    printf(" = ");
+  }
+  switch (inst->op) {
+    case kMirOpConst: {
+      if (type_is_float(inst->type)) {
+        printf("const %g\n", inst->constant.float_val);
+      } else if (type_is_signed(inst->type)) {
+        printf("const %lld\n",
+               (long long)mir_int_sext(inst->type, inst->constant.int_val));
+      } else if (type_is_int(inst->type)) {
+        printf("const %llu\n", (unsigned long long)inst->constant.int_val);
+      } else if (inst->type == get_type_bool()) {
+        printf("const %s\n", inst->constant.int_val ? "true" : "false");
+      } else {
+        printf("const \"%.*s\"\n", str_slice_print(&inst->constant.str_val));
+      }
+      break;
+    }
+    case kMirOpParam: {
+      printf("param %u\n", inst->param_index);
+      break;
+    }
+    case kMirOpBinop: {
+      printf("%s %%%u, %%%u\n",
+             mir_binop_name(inst->binop.kind),
+             inst->binop.lhs->id,
+             inst->binop.rhs->id);
+      break;
+    }
+    case kMirOpCopy: {
+      printf("copy %%%u\n", inst->copy->id);
+      break;
+    }
+    case kMirOpPhi: {
+      printf("phi");
+      for (u32 i = 0; i < inst->phi.count; i++) {
+        printf("%s [%%%u, bb%u]",
+               i > 0 ? "," : "",
+               inst->phi.values[i]->id,
+               inst->phi.block->preds[i]->id);
+      }
+      printf("\n");
+      break;
+    }
+    case kMirOpUndef: {
+      printf("undef\n");
+      break;
+    }
+    case kMirOpLoad: {
+      printf("load %%%u[%%%u]\n", inst->load.ptr->id, inst->load.index->id);
+      break;
+    }
+    case kMirOpStore: {
+      printf("store %%%u[%%%u], %%%u\n",
+             inst->store.ptr->id,
+             inst->store.index->id,
+             inst->store.value->id);
+      break;
+    }
+    case kMirOpCall: {
+      StrSlice name = atom_str(inst->call.fn);
+      printf("call %.*s(", str_slice_print(&name));
+      for (u32 i = 0; i < inst->call.count; i++) {
+        printf("%s%%%u", i > 0 ? ", " : "", inst->call.args[i]->id);
+      }
+      printf(")\n");
+      break;
+    }
+    case kMirOpBr: {
+      printf("br bb%u", inst->br.target->id);
+      if (inst->br.loop) {
+        mir_loop_dump(inst->br.loop);
+      }
+      printf("\n");
+      break;
+    }
+    case kMirOpCondBr: {
+      printf("br %%%u, bb%u, bb%u\n",
+             inst->cond_br.cond->id,
+             inst->cond_br.then_block->id,
+             inst->cond_br.else_block->id);
+      break;
+    }
+    case kMirOpRet: {
+      printf("ret %%%u\n", inst->ret->id);
+      break;
+    }
+    case kMirOpRetVoid: {
+      printf("ret\n");
+      break;
+    }
+    case kMirOpUnreachable: {
+      printf("unreachable\n");
+      break;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mir_fn_dump(const MirFn* fn)
+{
+  StrSlice name = atom_str(fn->name);
+  printf("fn %.*s(", str_slice_print(&name));
+  for (u32 i = 0; i < fn->param_count; i++) {
+    if (i > 0) {
+      printf(", ");
+    }
+    mir_value_dump(fn->params[i]);
+  }
+  Str ret_str = type_to_str(fn->ret_type);
+  printf(") -> %s", str_cstr(&ret_str));
+  release_str(&ret_str);
+  if (fn->is_decl) {
+    printf(";\n");
+    return;
+  }
+
+  printf(" {\n");
+  for (MirBlock* block = fn->first_block; block; block = block->next) {
+    printf("bb%u:", block->id);
+    for (u32 i = 0; i < block->pred_count; i++) {
+      printf("%s bb%u", i > 0 ? "," : " ; preds", block->preds[i]->id);
+    }
+    printf("\n");
+    for (MirInst* inst = block->first; inst; inst = inst->next) {
+      mir_inst_dump(inst);
+    }
+  }
+  printf("}\n");
+}
+
+// ========================================================================== //
+// MirModule
+// ========================================================================== //
+
+MirModule
+make_mir_module(Ast* ast_prog)
+{
+  assrt(ast_prog->kind == kAstProg, make_str("Wrong ast kind"));
+  AstList* funs = &ast_prog->prog.funs;
+  MirModule module = { .fns = NULL, .fn_count = funs->len };
+  if (funs->len > 0) {
+    module.fns = alloc(sizeof(MirFn*) * funs->len, kLnMinAlign);
+  }
+  for (u32 i = 0; i < funs->len; i++) {
+    module.fns[i] = mir_lower_fn(ast_list_get(funs, i));
+  }
+  return module;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_mir_module(MirModule* module)
+{
+  for (u32 i = 0; i < module->fn_count; i++) {
+    release_mir_fn(module->fns[i]);
+  }
+  if (module->fns) {
+    release(module->fns);
+  }
+  *module = (MirModule){ .fns = NULL, .fn_count = 0 };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mir_module_opt(MirModule* module)
+{
+  for (u32 i = 0; i < module->fn_count; i++) {
+    mir_opt_fn(module->fns[i]);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+mir_module_dump(const MirModule* module)
+{
+  printf("[MIR]\n");
+  for (u32 i = 0; i < module->fn_count; i++) {
+    mir_fn_dump(module->fns[i]);
+  }
+}
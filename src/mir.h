@@ -0,0 +1,325 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_MIR_H
+#define LN_MIR_H
+
+#include "common.h"
+#include "arena.h"
+#include "atom.h"
+#include "ast.h"
+#include "type.h"
+
+typedef struct MirInst MirInst;
+typedef struct MirBlock MirBlock;
+typedef struct MirLoop MirLoop;
+typedef struct MirFn MirFn;
+
+// ========================================================================== //
+// MirOp
+// ========================================================================== //
+
+/* MIR instruction kind */
+typedef enum MirOp
+{
+  /* Constant */
+  kMirOpConst,
+  /* Function parameter */
+  kMirOpParam,
+  /* Binary operation */
+  kMirOpBinop,
+  /* Copy of another value */
+  kMirOpCopy,
+  /* Value that depends on the predecessor that control came from */
+  kMirOpPhi,
+  /* Value that is read before being written */
+  kMirOpUndef,
+  /* Load element at index of pointer */
+  kMirOpLoad,
+  /* Store value to element at index of pointer */
+  kMirOpStore,
+  /* Call function */
+  kMirOpCall,
+  /* Branch to block */
+  kMirOpBr,
+  /* Branch to one of two blocks depending on condition */
+  kMirOpCondBr,
+  /* Return value */
+  kMirOpRet,
+  /* Return from function without return type */
+  kMirOpRetVoid,
+  /* End of block that is never reached */
+  kMirOpUnreachable,
+} MirOp;
+
+// ========================================================================== //
+// MirInst
+// ========================================================================== //
+
+/* MIR instruction. Every instruction that produces a value is the single
+ * definition of that value (SSA), so instructions are used directly as the
+ * operands of other instructions */
+typedef struct MirInst
+{
+  /* Kind */
+  MirOp op;
+  /* Value number, unique within the function */
+  u32 id;
+  /* Result type, NULL for instructions without result */
+  Type* type;
+  /* Name of the declaration that the value came from, or kAtomNone */
+  Atom name;
+  /* Number of uses. Only valid during passes */
+  u32 use_count;
+  /* Previous instruction in block */
+  MirInst* prev;
+  /* Next instruction in block */
+  MirInst* next;
+  union
+  {
+    /* Constant, the type decides which field is set. Vector constants have
+     * the same value in every lane */
+    union
+    {
+      u64 int_val;
+      f64 float_val;
+      StrSlice str_val;
+    } constant;
+    /* Param index */
+    u32 param_index;
+    /* Binop. 'no_wrap' is set when the operation cannot overflow */
+    struct
+    {
+      AstBinopKind kind;
+      MirInst* lhs;
+      MirInst* rhs;
+      bool no_wrap;
+    } binop;
+    /* Copied value */
+    MirInst* copy;
+    /* Phi, 'values[i]' is the value when coming from 'block->preds[i]' */
+    struct
+    {
+      MirBlock* block;
+      MirInst** values;
+      u32 count;
+    } phi;
+    /* Load */
+    struct
+    {
+      MirInst* ptr;
+      MirInst* index;
+    } load;
+    /* Store */
+    struct
+    {
+      MirInst* ptr;
+      MirInst* index;
+      MirInst* value;
+    } store;
+    /* Call of function by name. Calls of functions without return type
+     * have no result */
+    struct
+    {
+      Atom fn;
+      MirInst** args;
+      u32 count;
+    } call;
+    /* Branch. 'loop' is set on the back edge of a loop */
+    struct
+    {
+      MirBlock* target;
+      const MirLoop* loop;
+    } br;
+    /* Conditional branch */
+    struct
+    {
+      MirInst* cond;
+      MirBlock* then_block;
+      MirBlock* else_block;
+    } cond_br;
+    /* Returned value */
+    MirInst* ret;
+  };
+} MirInst;
+
+// -------------------------------------------------------------------------- //
+
+/* Returns whether instruction ends a block */
+bool
+mir_inst_is_term(const MirInst* inst);
+
+// ========================================================================== //
+// MirBlock
+// ========================================================================== //
+
+/* Basic block. Only the last instruction of a block may be a terminator */
+typedef struct MirBlock
+{
+  /* Block number, unique within the function */
+  u32 id;
+  /* First instruction */
+  MirInst* first;
+  /* Last instruction */
+  MirInst* last;
+  /* Next block in function */
+  MirBlock* next;
+  /* Predecessors, in the order of the operands of phis in the block */
+  MirBlock** preds;
+  /* Number of predecessors */
+  u32 pred_count;
+  /* Predecessor capacity */
+  u32 pred_cap;
+  /* Set when all predecessors are known. Only used during lowering */
+  bool sealed;
+} MirBlock;
+
+// ========================================================================== //
+// MirLoop
+// ========================================================================== //
+
+/* Loop in canonical form. The loop is entered from a single preheader that
+ * branches to the header, the header holds the phis of the loop and decides
+ * whether to run the body, and a single latch branches back to the header */
+typedef struct MirLoop
+{
+  /* Header */
+  MirBlock* header;
+  /* Latch, the block of the back edge */
+  MirBlock* latch;
+  /* Number of iterations, 0 if it is not known at compile time */
+  u64 trip_count;
+  /* Optimization hints */
+  AstLoopAttrs attrs;
+} MirLoop;
+
+// ========================================================================== //
+// MirFn
+// ========================================================================== //
+
+/* MIR function. All blocks and instructions are allocated from the arena of
+ * the function, so functions can be lowered and optimized independently */
+typedef struct MirFn
+{
+  /* Arena */
+  Arena arena;
+  /* Name */
+  Atom name;
+  /* Return type */
+  Type* ret_type;
+  /* Parameter values (kMirOpParam) */
+  MirInst** params;
+  /* Number of parameters */
+  u32 param_count;
+  /* First block (entry) */
+  MirBlock* first_block;
+  /* Last block */
+  MirBlock* last_block;
+  /* Number of values, all value numbers are less than this */
+  u32 value_count;
+  /* Number of blocks */
+  u32 block_count;
+  /* Set for functions that are only declared */
+  bool is_decl;
+} MirFn;
+
+// -------------------------------------------------------------------------- //
+
+/* Lower function (AstFn) that has passed semantic analysis */
+MirFn*
+mir_lower_fn(Ast* ast_fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Release function */
+void
+release_mir_fn(MirFn* fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Run all frontend optimizations on function */
+void
+mir_opt_fn(MirFn* fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Replace uses of copies with the copied value */
+void
+mir_pass_copy_prop(MirFn* fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Fold operations on constants */
+void
+mir_pass_const_prop(MirFn* fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Remove instructions whose values are never used. Stores, calls and
+ * terminators are always kept */
+void
+mir_pass_dce(MirFn* fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump function */
+void
+mir_fn_dump(const MirFn* fn);
+
+// ========================================================================== //
+// MirModule
+// ========================================================================== //
+
+/* MIR module, one per source file */
+typedef struct MirModule
+{
+  /* Functions */
+  MirFn** fns;
+  /* Number of functions */
+  u32 fn_count;
+} MirModule;
+
+// -------------------------------------------------------------------------- //
+
+/* Lower program (AstProg) that has passed semantic analysis */
+MirModule
+make_mir_module(Ast* ast_prog);
+
+// -------------------------------------------------------------------------- //
+
+/* Release module and all of its functions */
+void
+release_mir_module(MirModule* module);
+
+// -------------------------------------------------------------------------- //
+
+/* Run all frontend optimizations on every function in module */
+void
+mir_module_opt(MirModule* module);
+
+// -------------------------------------------------------------------------- //
+
+/* Dump module */
+void
+mir_module_dump(const MirModule* module);
+
+#endif // LN_MIR_H
@@ -76,6 +76,15 @@ parse_stmt(Parser* parser);
 static Ast*
 parse_expr(Parser* parser);
 
+static Ast*
+parse_expr_postfix(Parser* parser);
+
+static Ast*
+parse_expr_term(Parser* parser);
+
+static Ast*
+parse_expr_const(Parser* parser);
+
 static Ast*
 parse_type(Parser* parser);
 
@@ -90,7 +99,7 @@ parser_accept(Parser* parser, TokKind kind, bool skip_ws)
     parser_consume_whitespace(parser);
   }
   const Tok* tok = parser_peek(parser);
-  return tok->kind == kind;
+  return tok != NULL && tok->kind == kind;
 }
 
 // -------------------------------------------------------------------------- //
@@ -119,6 +128,22 @@ parser_accept_sym(Parser* parser, TokSymKind sym_kind, bool skip_whitespace)
 
 // -------------------------------------------------------------------------- //
 
+/* Check if the next two tokens are the symbols 'first' and 'second' without
+ * any whitespace between them, such as '<=' or '..' */
+static bool
+parser_accept_sym_pair(Parser* parser, TokSymKind first, TokSymKind second)
+{
+  if (!parser_accept_sym(parser, first, true)) {
+    return false;
+  }
+  TokIter ahead = parser->iter;
+  tok_iter_next(&ahead);
+  const Tok* tok = tok_iter_peek(&ahead);
+  return tok != NULL && tok_is_sym(tok, second);
+}
+
+// -------------------------------------------------------------------------- //
+
 LN_NORET void
 parse_ice(const Str* fmt, ...)
 {
@@ -146,15 +171,56 @@ parse_err(Parser* parser, const Span* span, const Str* expl, const Str* sugg)
   err_builder_set_pad_lines_before(&builder, 1);
   err_builder_set_pad_lines_after(&builder, 1);
   err_builder_set_err_num(&builder, kErrNumUnexpTok);
+  err_builder_set_sink(&builder, parser->errs);
   err_builder_emit(&builder);
-
-  // Store error
+  parser->err_count++;
 }
 
 // ========================================================================== //
 // Prog
 // ========================================================================== //
 
+/* Check if token starts a top-level construct */
+static bool
+parser_tok_is_item(const Tok* tok)
+{
+  return tok_is_kw(tok, kTokKwModule) || tok_is_kw(tok, kTokKwImport) ||
+         tok_is_kw(tok, kTokKwType) || tok_is_kw(tok, kTokKwFn) ||
+         tok_is_kw(tok, kTokKwEnum) || tok_is_kw(tok, kTokKwStruct) ||
+         tok_is_kw(tok, kTokKwTrait);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Skip tokens until the start of the next top-level construct, after one
+ * that could not be parsed */
+static void
+parser_skip_to_item(Parser* parser)
+{
+  const Tok* tok;
+  while ((tok = parser_peek(parser)) != NULL && !parser_tok_is_item(tok)) {
+    parser_next(parser, false);
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Report top-level construct that is not supported yet and skip past it */
+static void
+parse_unsupported(Parser* parser, const Str* expl)
+{
+  Span span_cur = parser_span_cur(parser);
+  parse_err(parser,
+            &span_cur,
+            expl,
+            &make_str("Only functions can be compiled for now, remove the "
+                      "construct"));
+  parser_next(parser, false);
+  parser_skip_to_item(parser);
+}
+
+// -------------------------------------------------------------------------- //
+
 static Ast*
 parse_prog(Parser* parser)
 {
@@ -165,34 +231,37 @@ parse_prog(Parser* parser)
   while ((tok = tok_iter_peek(&parser->iter)) != NULL) {
     // Module
     if (tok_is_kw(tok, kTokKwModule)) {
-      panic(make_str("Module declarations are not supported yet"));
+      parse_unsupported(
+        parser, &make_str("Module declarations are not supported yet"));
     }
     // Import
     else if (tok_is_kw(tok, kTokKwImport)) {
-      panic(make_str("Imports are not supported yet"));
+      parse_unsupported(parser, &make_str("Imports are not supported yet"));
     }
     // Type alias
     else if (tok_is_kw(tok, kTokKwType)) {
-      panic(make_str("Type alias are not supported yet"));
+      parse_unsupported(parser, &make_str("Type alias are not supported yet"));
     }
     // Function
     else if (tok_is_kw(tok, kTokKwFn)) {
       Ast* ast_fn = parse_fn(parser);
       if (ast_fn) {
         ast_prog_add_fn(ast_prog, ast_fn);
+      } else {
+        parser_skip_to_item(parser);
       }
     }
     // Enum
     else if (tok_is_kw(tok, kTokKwEnum)) {
-      panic(make_str("Enums are not supported yet"));
+      parse_unsupported(parser, &make_str("Enums are not supported yet"));
     }
     // Struct
     else if (tok_is_kw(tok, kTokKwStruct)) {
-      panic(make_str("Structs are not supported yet"));
+      parse_unsupported(parser, &make_str("Structs are not supported yet"));
     }
     // Trait
     else if (tok_is_kw(tok, kTokKwTrait)) {
-      panic(make_str("Traits are not supported yet"));
+      parse_unsupported(parser, &make_str("Traits are not supported yet"));
     }
     // Whitespace
     else if (tok->kind == kTokWhitespace) {
@@ -245,8 +314,43 @@ parse_fn_ret(Parser* parser)
 static Ast*
 parse_fn_param(Parser* parser)
 {
-  LN_UNUSED(parser);
-  return NULL;
+  // Name
+  if (!parser_accept(parser, kTokIdent, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected parameter name"),
+              &make_str("Parameters are declared as 'name: type'"));
+    return NULL;
+  }
+  const Tok* tok = parser_next(parser, false);
+  Span span_beg = tok->span;
+  Ast* ast_param = make_ast_param();
+  ast_param_set_name(ast_param, tok->atom);
+  ast_param->param.name_span = tok->span;
+
+  // ':'
+  if (!parser_accept_sym(parser, kTokSymColon, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected colon after parameter name"),
+              &make_str("Parameters must have an explicit type, declare them "
+                        "as 'name: type'"));
+    release_ast(ast_param);
+    return NULL;
+  }
+  parser_next(parser, false);
+
+  // Type
+  Ast* ast_type = parse_type(parser);
+  if (!ast_type) {
+    release_ast(ast_param);
+    return NULL;
+  }
+  ast_param_set_type(ast_param, ast_type);
+  ast_param->span = span_join(&span_beg, &ast_type->span);
+  return ast_param;
 }
 
 // -------------------------------------------------------------------------- //
@@ -271,15 +375,15 @@ parse_fn(Parser* parser)
     return NULL;
   }
   const Tok* tok = parser_next(parser, false);
-  StrSlice name_slice = span_slice(&tok->span, &parser->src->src);
-  Ast* ast = make_ast_fn(name_slice);
+  Ast* ast = make_ast_fn(tok->atom);
+  ast->fn.name_span = tok->span;
 
   // Expect '('
-  tok = parser_peek(parser);
   if (!parser_accept_sym(parser, kTokSymLeftParen, true)) {
+    Span span_cur = parser_span_cur(parser);
     parse_err(
       parser,
-      &tok->span,
+      &span_cur,
       &make_str(
         "Expected left parenthesis '(' at the start of the parameter list"),
       &make_str("Add a parenthesis to start the parameter list. Functions "
@@ -287,25 +391,37 @@ parse_fn(Parser* parser)
   }
   parser_next(parser, false);
 
-  // Param list
-  if (!parser_accept_sym(parser, kTokSymRightParen, true)) {
-    do {
+  // Param list, unless the source ends before it does
+  if (!parser_accept_sym(parser, kTokSymRightParen, true) &&
+      parser_peek(parser) != NULL) {
+    while (true) {
       Ast* ast_param = parse_fn_param(parser);
-      if (ast_param) {
-        ast_fn_add_param(ast, ast_param);
+      if (!ast_param) {
+        break;
       }
-    } while (!parser_accept_sym(parser, kTokSymComma, true));
+      ast_fn_add_param(ast, ast_param);
+
+      // ','
+      if (!parser_accept_sym(parser, kTokSymComma, true)) {
+        break;
+      }
+      parser_next(parser, false);
+    }
   }
 
   // Expect ')'
   if (!parser_accept_sym(parser, kTokSymRightParen, true)) {
-    tok = parser_peek(parser);
+    Span span_cur = parser_span_cur(parser);
     parse_err(
       parser,
-      &tok->span,
+      &span_cur,
       &make_str(
         "Expected right parenthesis ')' at the end of the parameter list"),
       &make_str("Add a parenthesis to end the parameter list"));
+    if (parser_peek(parser) == NULL) {
+      release_ast(ast);
+      return NULL;
+    }
   }
   parser_next(parser, false);
 
@@ -317,21 +433,32 @@ parse_fn(Parser* parser)
     }
   }
 
+  // Declaration of a function that is defined in another file
+  if (parser_accept_sym(parser, kTokSymSemicolon, true)) {
+    parser_next(parser, false);
+    Span end = parser_span_prev(parser);
+    ast->span = span_join(&beg, &end);
+    return ast;
+  }
+
   // Body
   if (!parser_accept_sym(parser, kTokSymLeftBrace, true)) {
-    tok = parser_peek(parser);
+    Span span_cur = parser_span_cur(parser);
     parse_err(parser,
-              &tok->span,
-              &make_str("Functions must be defined"),
-              &make_str("Functions cannot be just declared without a body, but "
-                        "must instead be defined at the same time. Add a body "
-                        "to the function to solve this problem"));
+              &span_cur,
+              &make_str("Expected a body or a semicolon after the function "
+                        "signature"),
+              &make_str("Add a body to define the function. A function that "
+                        "is defined in another file is declared by ending "
+                        "the signature with a semicolon"));
+    release_ast(ast);
+    return NULL;
   }
   Ast* ast_block = parse_block(parser);
   ast->fn.body = ast_block;
 
   // Done
-  Span end = parser_span_cur(parser);
+  Span end = parser_span_prev(parser);
   ast->span = span_join(&beg, &end);
   return ast;
 }
@@ -340,6 +467,38 @@ parse_fn(Parser* parser)
 // Block
 // ========================================================================== //
 
+/* Skip the rest of a statement that could not be parsed, so that the
+ * statements after it are parsed without reporting errors for the same
+ * mistake. The statement ends after a ';' or after a block that it opens,
+ * or before the '}' that ends the enclosing block */
+static void
+parser_skip_stmt(Parser* parser)
+{
+  u32 depth = 0;
+  const Tok* tok;
+  while ((tok = parser_peek(parser)) != NULL) {
+    if (tok_is_sym(tok, kTokSymRightBrace)) {
+      if (depth == 0) {
+        return;
+      }
+      depth--;
+      parser_next(parser, false);
+      if (depth == 0) {
+        return;
+      }
+      continue;
+    }
+    parser_next(parser, false);
+    if (tok_is_sym(tok, kTokSymLeftBrace)) {
+      depth++;
+    } else if (depth == 0 && tok_is_sym(tok, kTokSymSemicolon)) {
+      return;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
 static Ast*
 parse_block(Parser* parser)
 {
@@ -353,16 +512,11 @@ parse_block(Parser* parser)
   // Statements
   while (!parser_accept_sym(parser, kTokSymRightBrace, true) &&
          parser_peek(parser) != NULL) {
-    Span span_stmt_before = parser_span_cur(parser);
     Ast* ast_stmt = parse_stmt(parser);
     if (ast_stmt) {
       ast_block_add_stmt(ast_block, ast_stmt);
-    }
-
-    // TODO(Filip Björklund): Handle invalid stmt
-    Span span_stmt_after = parser_span_cur(parser);
-    if (span_eq(&span_stmt_before, &span_stmt_after)) {
-      panic(make_str("TMP: NO PROGRESS MADE"));
+    } else {
+      parser_skip_stmt(parser);
     }
   }
 
@@ -378,7 +532,7 @@ parse_block(Parser* parser)
   parser_next(parser, false);
 
   // End
-  Span span_end = parser_span_cur(parser);
+  Span span_end = parser_span_prev(parser);
   ast_block->span = span_join(&span_beg, &span_end);
   return ast_block;
 }
@@ -400,20 +554,27 @@ parse_stmt_let(Parser* parser)
 
   // Name
   if (!parser_accept(parser, kTokIdent, true)) {
-    const Tok* tok = parser_peek(parser);
+    Span span_cur = parser_span_cur(parser);
     parse_err(parser,
-              &tok->span,
+              &span_cur,
               &make_str("Expected identifier for let statement"),
               &make_str("Name the variable"));
+    release_ast(ast_let);
+    return NULL;
   }
   const Tok* tok = parser_next(parser, false);
-  ast_let_set_name(ast_let, tok->value);
+  ast_let_set_name(ast_let, tok->atom);
+  ast_let->let.name_span = tok->span;
 
   // Optional type ': <type>'
   if (parser_accept_sym(parser, kTokSymColon, true)) {
     parser_next(parser, false);
 
     Ast* ast_type = parse_type(parser);
+    if (!ast_type) {
+      release_ast(ast_let);
+      return NULL;
+    }
     ast_let_set_type(ast_let, ast_type);
   }
 
@@ -424,22 +585,40 @@ parse_stmt_let(Parser* parser)
   } else {
     // '='
     if (!parser_accept_sym(parser, kTokSymEqual, true)) {
-      tok = parser_peek(parser);
+      Span span_cur = parser_span_cur(parser);
       parse_err(
         parser,
-        &tok->span,
+        &span_cur,
         &make_str("Expected assignment operator in let-statement"),
         &make_str("If the variable is not supposed to have a default value "
                   "then end the statement with a semicolon instead"));
+      release_ast(ast_let);
+      return NULL;
     }
     parser_next(parser, false);
 
     // Expr
     Ast* ast_expr = parse_expr(parser);
+    if (!ast_expr) {
+      release_ast(ast_let);
+      return NULL;
+    }
     ast_let_set_assigned(ast_let, ast_expr);
+
+    // ';', which is not skipped when missing as it may end the block
+    if (!parser_accept_sym(parser, kTokSymSemicolon, true)) {
+      Span span_cur = parser_span_cur(parser);
+      parse_err(parser,
+                &span_cur,
+                &make_str("Expected semicolon at the end of a let statement"),
+                &make_str("Let statements are not expressions and must "
+                          "therefore be succeeded by a semicolon"));
+    } else {
+      parser_next(parser, false);
+    }
   }
 
-  Span span_end = parser_span_cur(parser);
+  Span span_end = parser_span_prev(parser);
   ast_let->span = span_join(&span_beg, &span_end);
   return ast_let;
 }
@@ -454,8 +633,15 @@ parse_stmt_ret(Parser* parser)
   Span span_beg = parser_span_cur(parser);
   parser_next(parser, false);
 
-  // Expr
-  Ast* ast_expr = parse_expr(parser);
+  // Expr, which is left out when returning from a function without a
+  // return type
+  Ast* ast_expr = NULL;
+  if (!parser_accept_sym(parser, kTokSymSemicolon, true)) {
+    ast_expr = parse_expr(parser);
+    if (!ast_expr) {
+      return NULL;
+    }
+  }
   Ast* ast_ret = make_ast_ret(ast_expr);
 
   // ';'
@@ -466,15 +652,361 @@ parse_stmt_ret(Parser* parser)
               &make_str("Expected semicolon at the end of a return statement"),
               &make_str("Return statements are not expressions and must "
                         "therefore be succeeded by a semicolon"));
+  } else {
+    parser_next(parser, false);
   }
-  parser_next(parser, false);
-  Span span_end = parser_span_cur(parser);
+  Span span_end = parser_span_prev(parser);
   ast_ret->span = span_join(&span_beg, &span_end);
   return ast_ret;
 }
 
 // -------------------------------------------------------------------------- //
 
+static Ast*
+parse_stmt_assign(Parser* parser)
+{
+  // Target
+  Span span_beg = parser_span_cur(parser);
+  Ast* ast_target = parse_expr_postfix(parser);
+  if (!ast_target) {
+    return NULL;
+  }
+  // Call whose result, if any, is discarded
+  if (ast_target->kind == kAstCall) {
+    if (!parser_accept_sym(parser, kTokSymSemicolon, true)) {
+      Span span_cur = parser_span_cur(parser);
+      parse_err(parser,
+                &span_cur,
+                &make_str("Expected semicolon after call"),
+                &make_str("Calls that are statements must be succeeded by a "
+                          "semicolon"));
+    } else {
+      parser_next(parser, false);
+    }
+    Span span_end = parser_span_prev(parser);
+    ast_target->span = span_join(&span_beg, &span_end);
+    return ast_target;
+  }
+  if (ast_target->kind != kAstVar && ast_target->kind != kAstIndex) {
+    parse_err(parser,
+              &ast_target->span,
+              &make_str("Expected variable or indexed pointer to assign to"),
+              &make_str("Only variables and indexed pointers such as 'p[i]' "
+                        "can be assigned to"));
+    release_ast(ast_target);
+    return NULL;
+  }
+
+  // '='
+  if (!parser_accept_sym(parser, kTokSymEqual, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected assignment operator after variable"),
+              &make_str("Assign to a variable with 'name = expr;'"));
+    release_ast(ast_target);
+    return NULL;
+  }
+  parser_next(parser, false);
+
+  // Expr
+  Ast* ast_expr = parse_expr(parser);
+  if (!ast_expr) {
+    release_ast(ast_target);
+    return NULL;
+  }
+  Ast* ast_assign = make_ast_assign(ast_target, ast_expr);
+
+  // ';'
+  if (!parser_accept_sym(parser, kTokSymSemicolon, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected semicolon at the end of an assignment"),
+              &make_str("Assignments are not expressions and must therefore "
+                        "be succeeded by a semicolon"));
+  } else {
+    parser_next(parser, false);
+  }
+  Span span_end = parser_span_prev(parser);
+  ast_assign->span = span_join(&span_beg, &span_end);
+  return ast_assign;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse the block that forms the body of a loop */
+static Ast*
+parse_loop_body(Parser* parser)
+{
+  if (!parser_accept_sym(parser, kTokSymLeftBrace, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected left brace '{' to start the loop body"),
+              &make_str("The body of a loop is always a block"));
+    return NULL;
+  }
+  return parse_block(parser);
+}
+
+// -------------------------------------------------------------------------- //
+
+static Ast*
+parse_stmt_while(Parser* parser)
+{
+  // 'while'
+  LN_PARSE_TOK_ASSERT_NEXT_KW("parse_stmt_while", kTokKwWhile);
+  Span span_beg = parser_span_cur(parser);
+  parser_next(parser, false);
+
+  // Condition
+  Ast* ast_cond = parse_expr(parser);
+  if (!ast_cond) {
+    return NULL;
+  }
+
+  // Body
+  Ast* ast_body = parse_loop_body(parser);
+  if (!ast_body) {
+    release_ast(ast_cond);
+    return NULL;
+  }
+
+  Ast* ast_while = make_ast_while(ast_cond, ast_body);
+  ast_while->span = span_join(&span_beg, &ast_body->span);
+  return ast_while;
+}
+
+// -------------------------------------------------------------------------- //
+
+static Ast*
+parse_stmt_for(Parser* parser)
+{
+  // 'for'
+  LN_PARSE_TOK_ASSERT_NEXT_KW("parse_stmt_for", kTokKwFor);
+  Span span_beg = parser_span_cur(parser);
+  parser_next(parser, false);
+
+  // Name
+  if (!parser_accept(parser, kTokIdent, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected name of loop variable after 'for'"),
+              &make_str("For loops are written as 'for i in from..to'"));
+    return NULL;
+  }
+  const Tok* tok = parser_next(parser, false);
+  Atom name = tok->atom;
+  Span name_span = tok->span;
+
+  // 'in'
+  if (!parser_accept_kw(parser, kTokKwIn, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected 'in' after the loop variable"),
+              &make_str("For loops are written as 'for i in from..to'"));
+    return NULL;
+  }
+  parser_next(parser, false);
+
+  // Range 'from..to'
+  Ast* ast_from = parse_expr_term(parser);
+  if (!ast_from) {
+    return NULL;
+  }
+  if (!parser_accept_sym_pair(parser, kTokSymPeriod, kTokSymPeriod)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected range operator '..' in for loop"),
+              &make_str("For loops iterate over a half-open range "
+                        "'from..to', where 'to' is not included"));
+    release_ast(ast_from);
+    return NULL;
+  }
+  parser_next(parser, false);
+  parser_next(parser, false);
+  Ast* ast_to = parse_expr_term(parser);
+  if (!ast_to) {
+    release_ast(ast_from);
+    return NULL;
+  }
+
+  // Body
+  Ast* ast_body = parse_loop_body(parser);
+  if (!ast_body) {
+    release_ast(ast_to);
+    release_ast(ast_from);
+    return NULL;
+  }
+
+  Ast* ast_for = make_ast_for(name, ast_from, ast_to, ast_body);
+  ast_for->for_loop.name_span = name_span;
+  ast_for->span = span_join(&span_beg, &ast_body->span);
+  return ast_for;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse a single loop attribute such as 'unroll' or 'vectorize(8)' */
+static bool
+parse_loop_attr(Parser* parser, AstLoopAttrs* attrs)
+{
+  if (!parser_accept(parser, kTokIdent, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected name of loop attribute"),
+              &make_str("Valid loop attributes are 'vectorize', "
+                        "'vectorize(width)', 'novectorize', 'unroll', "
+                        "'unroll(count)' and 'nounroll'"));
+    return false;
+  }
+  const Tok* tok = parser_next(parser, false);
+
+  // Name
+  u32* p_value = NULL;
+  if (str_slice_eq_str(&tok->value, &make_str("vectorize"))) {
+    attrs->vectorize = kAstLoopHintEnable;
+    p_value = &attrs->vectorize_width;
+  } else if (str_slice_eq_str(&tok->value, &make_str("novectorize"))) {
+    attrs->vectorize = kAstLoopHintDisable;
+  } else if (str_slice_eq_str(&tok->value, &make_str("unroll"))) {
+    attrs->unroll = kAstLoopHintEnable;
+    p_value = &attrs->unroll_count;
+  } else if (str_slice_eq_str(&tok->value, &make_str("nounroll"))) {
+    attrs->unroll = kAstLoopHintDisable;
+  } else {
+    parse_err(parser,
+              &tok->span,
+              &make_str("Unknown loop attribute"),
+              &make_str("Valid loop attributes are 'vectorize', "
+                        "'vectorize(width)', 'novectorize', 'unroll', "
+                        "'unroll(count)' and 'nounroll'"));
+    return false;
+  }
+
+  // Optional '(value)'
+  if (!p_value || !parser_accept_sym(parser, kTokSymLeftParen, true)) {
+    return true;
+  }
+  parser_next(parser, false);
+  if (!parser_accept(parser, kTokInt, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected integer argument to loop attribute"),
+              &make_str("Specify the vector width or unroll count as an "
+                        "integer constant"));
+    return false;
+  }
+  Ast* ast_num = parse_expr_const(parser);
+  u64 value = ast_const_to_u64(ast_num);
+  release_ast(ast_num);
+  if (value == 0 || value > UINT32_MAX) {
+    parse_err(parser,
+              &tok->span,
+              &make_str("Invalid argument to loop attribute"),
+              &make_str("The vector width and unroll count must be positive"));
+    return false;
+  }
+  *p_value = (u32)value;
+  if (!parser_accept_sym(parser, kTokSymRightParen, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected right parenthesis after attribute argument"),
+              &make_str("Add a parenthesis to close the argument"));
+    return false;
+  }
+  parser_next(parser, false);
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse a loop preceded by attributes, '#[attr, ...] for ...' */
+static Ast*
+parse_stmt_loop_attrs(Parser* parser)
+{
+  // '#['
+  LN_PARSE_TOK_ASSERT_NEXT_SYM("parse_stmt_loop_attrs", kTokSymHash);
+  Span span_beg = parser_span_cur(parser);
+  parser_next(parser, false);
+  if (!parser_accept_sym(parser, kTokSymLeftBracket, false)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected left bracket '[' after '#'"),
+              &make_str("Attributes are written as '#[attr, ...]'"));
+    return NULL;
+  }
+  parser_next(parser, false);
+
+  // Attributes
+  AstLoopAttrs attrs = { 0 };
+  bool valid = true;
+  while (valid) {
+    valid = parse_loop_attr(parser, &attrs);
+    if (!valid || !parser_accept_sym(parser, kTokSymComma, true)) {
+      break;
+    }
+    parser_next(parser, false);
+  }
+
+  // Skip past invalid attributes so that the loop is still parsed
+  const Tok* tok;
+  while (!valid && (tok = parser_peek(parser)) != NULL &&
+         !tok_is_sym(tok, kTokSymRightBracket) &&
+         !tok_is_sym(tok, kTokSymLeftBrace)) {
+    parser_next(parser, false);
+  }
+
+  // ']'
+  if (parser_accept_sym(parser, kTokSymRightBracket, true)) {
+    parser_next(parser, false);
+  } else if (valid) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected right bracket ']' to end attribute list"),
+              &make_str("Attributes are written as '#[attr, ...]'"));
+  }
+
+  // Loop
+  parser_consume_whitespace(parser);
+  tok = parser_peek(parser);
+  Ast* ast_loop = NULL;
+  if (tok && tok_is_kw(tok, kTokKwWhile)) {
+    ast_loop = parse_stmt_while(parser);
+    if (ast_loop) {
+      ast_loop->while_loop.attrs = attrs;
+    }
+  } else if (tok && tok_is_kw(tok, kTokKwFor)) {
+    ast_loop = parse_stmt_for(parser);
+    if (ast_loop) {
+      ast_loop->for_loop.attrs = attrs;
+    }
+  } else {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected loop after attributes"),
+              &make_str("Loop attributes can only be placed before 'while' "
+                        "and 'for' loops"));
+    return NULL;
+  }
+  if (ast_loop) {
+    ast_loop->span = span_join(&span_beg, &ast_loop->span);
+  }
+  return ast_loop;
+}
+
+// -------------------------------------------------------------------------- //
+
 static Ast*
 parse_stmt(Parser* parser)
 {
@@ -486,11 +1018,25 @@ parse_stmt(Parser* parser)
     return parse_stmt_let(parser);
   } else if (tok_is_kw(tok, kTokKwRet)) {
     return parse_stmt_ret(parser);
-  } else {
-    Ast* ast_expr = parse_expr(parser);
-    LN_UNUSED(ast_expr);
-    LN_UNREACHABLE();
+  } else if (tok_is_kw(tok, kTokKwWhile)) {
+    return parse_stmt_while(parser);
+  } else if (tok_is_kw(tok, kTokKwFor)) {
+    return parse_stmt_for(parser);
+  } else if (tok_is_sym(tok, kTokSymHash)) {
+    return parse_stmt_loop_attrs(parser);
+  } else if (tok_is_sym(tok, kTokSymLeftBrace)) {
+    return parse_block(parser);
+  } else if (parser_accept(parser, kTokIdent, false)) {
+    return parse_stmt_assign(parser);
   }
+
+  Span span_cur = parser_span_cur(parser);
+  parse_err(parser,
+            &span_cur,
+            &make_str("Expected a statement"),
+            &make_str("Statements are 'let' and 'ret' statements, loops, "
+                      "blocks, assignments and calls"));
+  return NULL;
 }
 
 // ========================================================================== //
@@ -500,8 +1046,29 @@ parse_stmt(Parser* parser)
 static Ast*
 parse_expr_paren(Parser* parser)
 {
-  LN_UNUSED(parser);
-  return NULL;
+  // '('
+  LN_PARSE_TOK_ASSERT_NEXT_SYM("parse_expr_paren", kTokSymLeftParen);
+  parser_next(parser, false);
+
+  // Expr
+  Ast* ast = parse_expr(parser);
+  if (!ast) {
+    return NULL;
+  }
+
+  // ')'
+  if (!parser_accept_sym(parser, kTokSymRightParen, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected right parenthesis ')' after expression"),
+              &make_str("Add a parenthesis to balance the left parenthesis "
+                        "that starts the expression"));
+    release_ast(ast);
+    return NULL;
+  }
+  parser_next(parser, false);
+  return ast;
 }
 
 // -------------------------------------------------------------------------- //
@@ -509,8 +1076,61 @@ parse_expr_paren(Parser* parser)
 static Ast*
 parse_expr_var(Parser* parser)
 {
-  LN_UNUSED(parser);
-  return NULL;
+  LN_PARSE_TOK_ASSERT_NEXT("parse_expr_var", kTokIdent);
+  const Tok* tok = parser_next(parser, false);
+  Ast* ast = make_ast_var(tok->atom);
+  ast->span = tok->span;
+  return ast;
+}
+
+// -------------------------------------------------------------------------- //
+
+static Ast*
+parse_expr_call(Parser* parser)
+{
+  // Name
+  LN_PARSE_TOK_ASSERT_NEXT("parse_expr_call", kTokIdent);
+  const Tok* tok = parser_next(parser, false);
+  Ast* ast = make_ast_call(tok->atom);
+  ast->call.name_span = tok->span;
+
+  // '('
+  LN_PARSE_TOK_ASSERT_NEXT_SYM("parse_expr_call", kTokSymLeftParen);
+  parser_next(parser, false);
+
+  // Args
+  if (!parser_accept_sym(parser, kTokSymRightParen, true)) {
+    while (true) {
+      Ast* ast_arg = parse_expr(parser);
+      if (!ast_arg) {
+        release_ast(ast);
+        return NULL;
+      }
+      ast_call_add_arg(ast, ast_arg);
+
+      // ','
+      if (!parser_accept_sym(parser, kTokSymComma, true)) {
+        break;
+      }
+      parser_next(parser, false);
+    }
+  }
+
+  // ')'
+  if (!parser_accept_sym(parser, kTokSymRightParen, true)) {
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Expected right parenthesis ')' after the arguments"),
+              &make_str("Separate the arguments with commas and end the list "
+                        "with a parenthesis"));
+    release_ast(ast);
+    return NULL;
+  }
+  parser_next(parser, false);
+  Span span_end = parser_span_prev(parser);
+  ast->span = span_join(&ast->call.name_span, &span_end);
+  return ast;
 }
 
 // -------------------------------------------------------------------------- //
@@ -532,7 +1152,7 @@ parse_expr_const(Parser* parser)
     kind = kAstConstInt;
   } else if (tok->kind == kTokFloat) {
     kind = kAstConstFloat;
-  } else if (tok->kind == kTokFloat) {
+  } else if (tok->kind == kTokStr) {
     kind = kAstConstStr;
   } else {
     LN_UNREACHABLE();
@@ -540,7 +1160,7 @@ parse_expr_const(Parser* parser)
 
   // Make const
   parser_next(parser, false);
-  Span span_end = parser_span_cur(parser);
+  Span span_end = parser_span_prev(parser);
   Ast* ast = make_ast_const(kind, tok->value);
   ast->span = span_join(&span_beg, &span_end);
   return ast;
@@ -553,21 +1173,30 @@ parse_expr_bottom(Parser* parser)
 {
   parser_consume_whitespace(parser);
 
-  const Tok* tok = parser_peek(parser);
-  if (tok->kind == kTokInt || tok->kind == kTokFloat || tok->kind == kTokStr) {
+  if (parser_accept(parser, kTokInt, false) ||
+      parser_accept(parser, kTokFloat, false) ||
+      parser_accept(parser, kTokStr, false)) {
     return parse_expr_const(parser);
-  } else if (tok->kind == kTokIdent) {
+  } else if (parser_accept(parser, kTokIdent, false)) {
+    // A name directly followed by '(' is a call
+    TokIter ahead = parser->iter;
+    tok_iter_next(&ahead);
+    const Tok* tok = tok_iter_peek(&ahead);
+    if (tok != NULL && tok_is_sym(tok, kTokSymLeftParen)) {
+      return parse_expr_call(parser);
+    }
     return parse_expr_var(parser);
-  } else if (tok_is_sym(tok, kTokSymLeftParen)) {
+  } else if (parser_accept_sym(parser, kTokSymLeftParen, false)) {
     return parse_expr_paren(parser);
-  } else {
-    parse_err(
-      parser,
-      &tok->span,
-      &make_str("expected identifier, literal or parenthesized expression"),
-      &make_str("TMP"));
   }
 
+  Span span_cur = parser_span_cur(parser);
+  parse_err(
+    parser,
+    &span_cur,
+    &make_str("Expected identifier, literal or parenthesized expression"),
+    &make_str("Complete the expression with a variable, a literal or an "
+              "expression in parentheses"));
   return NULL;
 }
 
@@ -589,8 +1218,35 @@ parse_expr_postfix(Parser* parser)
 
   // Parse expr before postfix
   Ast* ast = parse_expr_scope_op(parser);
+  if (!ast) {
+    return NULL;
+  }
 
-  // Parse prefix
+  // Index 'expr[index]'
+  while (parser_accept_sym(parser, kTokSymLeftBracket, true)) {
+    parser_next(parser, false);
+    Ast* ast_index = parse_expr(parser);
+    if (!ast_index) {
+      release_ast(ast);
+      return NULL;
+    }
+    if (!parser_accept_sym(parser, kTokSymRightBracket, true)) {
+      Span span_cur = parser_span_cur(parser);
+      parse_err(parser,
+                &span_cur,
+                &make_str("Expected right bracket ']' after index"),
+                &make_str("Indices are enclosed in a matching '[' and ']' "
+                          "pair. Make sure both are present"));
+      release_ast(ast_index);
+      release_ast(ast);
+      return NULL;
+    }
+    Span span_end = parser_span_cur(parser);
+    parser_next(parser, false);
+    Span span_beg = ast->span;
+    ast = make_ast_index(ast, ast_index);
+    ast->span = span_join(&span_beg, &span_end);
+  }
 
   return ast;
 }
@@ -634,10 +1290,19 @@ parse_expr_factor(Parser* parser)
     return NULL;
   }
 
-  // Terms while '*' or '/'
-  while (parser_accept_sym(parser, kTokSymMul, true) ||
-         parser_accept_sym(parser, kTokSymDiv, true)) {
-    const Tok* tok = parser_next(parser, false);
+  // Terms while '*', '/' or '%'
+  while (true) {
+    AstBinopKind kind;
+    if (parser_accept_sym(parser, kTokSymMul, true)) {
+      kind = kAstBinopMul;
+    } else if (parser_accept_sym(parser, kTokSymDiv, true)) {
+      kind = kAstBinopDiv;
+    } else if (parser_accept_sym(parser, kTokSymMod, true)) {
+      kind = kAstBinopMod;
+    } else {
+      break;
+    }
+    parser_next(parser, false);
 
     // Parse 'rhs'
     Ast* ast_rhs = parse_expr_prefix(parser);
@@ -647,19 +1312,11 @@ parse_expr_factor(Parser* parser)
     }
 
     // Create binop
-    if (tok_is_sym(tok, kTokSymMul)) {
-      Ast* ast_binop = make_ast_binop(kAstBinopMul);
-      ast_binop_set_lhs(ast_binop, ast_lhs);
-      ast_binop_set_rhs(ast_binop, ast_rhs);
-      ast_lhs = ast_binop;
-    } else if (tok_is_sym(tok, kTokSymDiv)) {
-      Ast* ast_binop = make_ast_binop(kAstBinopDiv);
-      ast_binop_set_lhs(ast_binop, ast_lhs);
-      ast_binop_set_rhs(ast_binop, ast_rhs);
-      ast_lhs = ast_binop;
-    } else {
-      panic(make_str("Unreachable"));
-    }
+    Ast* ast_binop = make_ast_binop(kind);
+    ast_binop_set_lhs(ast_binop, ast_lhs);
+    ast_binop_set_rhs(ast_binop, ast_rhs);
+    ast_binop->span = span_join(&ast_lhs->span, &ast_rhs->span);
+    ast_lhs = ast_binop;
   }
 
   return ast_lhs;
@@ -677,9 +1334,16 @@ parse_expr_term(Parser* parser)
   }
 
   // Terms while '+' or '-'
-  while (parser_accept_sym(parser, kTokSymAdd, true) ||
-         parser_accept_sym(parser, kTokSymSub, true)) {
-    const Tok* tok = parser_next(parser, false);
+  while (true) {
+    AstBinopKind kind;
+    if (parser_accept_sym(parser, kTokSymAdd, true)) {
+      kind = kAstBinopAdd;
+    } else if (parser_accept_sym(parser, kTokSymSub, true)) {
+      kind = kAstBinopSub;
+    } else {
+      break;
+    }
+    parser_next(parser, false);
 
     // Parse 'rhs'
     Ast* ast_rhs = parse_expr_factor(parser);
@@ -689,19 +1353,11 @@ parse_expr_term(Parser* parser)
     }
 
     // Create binop
-    if (tok_is_sym(tok, kTokSymAdd)) {
-      Ast* ast_binop = make_ast_binop(kAstBinopAdd);
-      ast_binop_set_lhs(ast_binop, ast_lhs);
-      ast_binop_set_rhs(ast_binop, ast_rhs);
-      ast_lhs = ast_binop;
-    } else if (tok_is_sym(tok, kTokSymSub)) {
-      Ast* ast_binop = make_ast_binop(kAstBinopSub);
-      ast_binop_set_lhs(ast_binop, ast_lhs);
-      ast_binop_set_rhs(ast_binop, ast_rhs);
-      ast_lhs = ast_binop;
-    } else {
-      panic(make_str("Unreachable"));
-    }
+    Ast* ast_binop = make_ast_binop(kind);
+    ast_binop_set_lhs(ast_binop, ast_lhs);
+    ast_binop_set_rhs(ast_binop, ast_rhs);
+    ast_binop->span = span_join(&ast_lhs->span, &ast_rhs->span);
+    ast_lhs = ast_binop;
   }
 
   return ast_lhs;
@@ -710,21 +1366,84 @@ parse_expr_term(Parser* parser)
 // -------------------------------------------------------------------------- //
 
 static Ast*
-parse_expr_match(Parser* parser)
+parse_expr_cmp(Parser* parser)
 {
-  panic(make_str("'parse_expr_match' is not implemented"));
-  LN_UNUSED(parser);
+  // Parse 'lhs'
+  Ast* ast_lhs = parse_expr_term(parser);
+  if (!ast_lhs) {
+    return NULL;
+  }
+
+  // Comparison operator, which are not associative
+  AstBinopKind kind;
+  u32 tok_count = 2;
+  if (parser_accept_sym_pair(parser, kTokSymEqual, kTokSymEqual)) {
+    kind = kAstBinopEq;
+  } else if (parser_accept_sym_pair(parser, kTokSymExcl, kTokSymEqual)) {
+    kind = kAstBinopNe;
+  } else if (parser_accept_sym_pair(parser, kTokSymLess, kTokSymEqual)) {
+    kind = kAstBinopLe;
+  } else if (parser_accept_sym_pair(parser, kTokSymGreater, kTokSymEqual)) {
+    kind = kAstBinopGe;
+  } else if (parser_accept_sym(parser, kTokSymLess, true)) {
+    kind = kAstBinopLt;
+    tok_count = 1;
+  } else if (parser_accept_sym(parser, kTokSymGreater, true)) {
+    kind = kAstBinopGt;
+    tok_count = 1;
+  } else {
+    return ast_lhs;
+  }
+  for (u32 i = 0; i < tok_count; i++) {
+    parser_next(parser, false);
+  }
+
+  // Parse 'rhs'
+  Ast* ast_rhs = parse_expr_term(parser);
+  if (!ast_rhs) {
+    release_ast(ast_lhs);
+    return NULL;
+  }
+
+  // Create binop
+  Ast* ast_binop = make_ast_binop(kind);
+  ast_binop_set_lhs(ast_binop, ast_lhs);
+  ast_binop_set_rhs(ast_binop, ast_rhs);
+  ast_binop->span = span_join(&ast_lhs->span, &ast_rhs->span);
+  return ast_binop;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Report expression that is not supported yet and skip its keyword */
+static Ast*
+parse_expr_unsupported(Parser* parser, const Str* expl)
+{
+  Span span_cur = parser_span_cur(parser);
+  parse_err(parser,
+            &span_cur,
+            expl,
+            &make_str("Use a loop or a separate function instead"));
+  parser_next(parser, false);
   return NULL;
 }
 
 // -------------------------------------------------------------------------- //
 
+static Ast*
+parse_expr_match(Parser* parser)
+{
+  return parse_expr_unsupported(
+    parser, &make_str("'match' expressions are not supported yet"));
+}
+
+// -------------------------------------------------------------------------- //
+
 static Ast*
 parse_expr_if(Parser* parser)
 {
-  panic(make_str("'parse_expr_if' is not implemented"));
-  LN_UNUSED(parser);
-  return NULL;
+  return parse_expr_unsupported(
+    parser, &make_str("'if' expressions are not supported yet"));
 }
 
 // -------------------------------------------------------------------------- //
@@ -736,14 +1455,23 @@ parse_expr(Parser* parser)
   const Tok* tok = parser_peek(parser);
 
   // Match expr type
-  if (str_slice_eq_str(&tok->value, &make_str("if"))) {
+  if (!tok) {
+    return parse_expr_bottom(parser);
+  } else if (str_slice_eq_str(&tok->value, &make_str("if"))) {
     return parse_expr_if(parser);
   } else if (str_slice_eq_str(&tok->value, &make_str("match"))) {
     return parse_expr_match(parser);
   } else if (tok_is_sym(tok, kTokSymLeftBrace)) {
-    return parse_block(parser);
+    // Parse the block to skip past it
+    Span span_cur = parser_span_cur(parser);
+    parse_err(parser,
+              &span_cur,
+              &make_str("Block expressions are not supported yet"),
+              &make_str("Blocks can only be used as statements"));
+    release_ast(parse_block(parser));
+    return NULL;
   } else {
-    return parse_expr_term(parser);
+    return parse_expr_cmp(parser);
   }
 }
 
@@ -765,6 +1493,9 @@ parse_type_array(Parser* parser)
 
   // Elem type
   Type* elem_type = parse_type_aux(parser);
+  if (!elem_type) {
+    return NULL;
+  }
 
   // ';'
   u64 len = kTypeArrayUnknownLen;
@@ -796,6 +1527,7 @@ parse_type_array(Parser* parser)
               &make_str("Expected right bracket to end array type"),
               &make_str("Array types are enclosed in a matching '[' and ']' "
                         "pair. Make sure both are present"));
+    return NULL;
   }
   parser_next(parser, false);
 
@@ -812,10 +1544,9 @@ parse_type_aux(Parser* parser)
   Type* type = NULL;
   if (parser_accept_sym(parser, kTokSymLeftBracket, false)) {
     type = parse_type_array(parser);
-  } else { // Basic
-    const Tok* tok = parser_peek(parser);
+  } else if (parser_accept(parser, kTokIdent, false)) { // Basic
+    const Tok* tok = parser_next(parser, false);
     type = get_type_from_name(&tok->value);
-    parser_next(parser, false);
   }
 
   // Could not parse type
@@ -841,9 +1572,14 @@ parse_type(Parser* parser)
   Span span_beg = parser_span_cur(parser);
   Type* type = parse_type_aux(parser);
   if (!type) {
-    panic(make_str("TEMP"));
+    parse_err(parser,
+              &span_beg,
+              &make_str("Expected a type"),
+              &make_str("Types are named, such as 's32' and 'f32x4', or are "
+                        "arrays '[type; len]' and pointers 'type*'"));
+    return NULL;
   }
-  Span span_end = parser_span_cur(parser);
+  Span span_end = parser_span_prev(parser);
   Ast* ast_type = make_ast_type(type);
   ast_type->span = span_join(&span_beg, &span_end);
   return ast_type;
@@ -882,7 +1618,11 @@ parser_next(Parser* parser, bool skip_leading_whitespace)
     }
     return NULL;
   } else {
-    return tok_iter_next(&parser->iter);
+    const Tok* tok = tok_iter_next(&parser->iter);
+    if (tok && tok->kind != kTokWhitespace) {
+      parser->span_prev = tok->span;
+    }
+    return tok;
   }
 }
 
@@ -923,6 +1663,14 @@ parser_span_cur(const Parser* parser)
 
 // -------------------------------------------------------------------------- //
 
+Span
+parser_span_prev(const Parser* parser)
+{
+  return parser->span_prev;
+}
+
+// -------------------------------------------------------------------------- //
+
 Ast*
 parser_parse(Parser* parser)
 {
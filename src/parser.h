@@ -47,6 +47,12 @@ typedef struct Parser
   const Src* src;
   /* Token iterator */
   TokIter iter;
+  /* Span of the last consumed token that is not whitespace */
+  Span span_prev;
+  /* Number of reported errors */
+  u32 err_count;
+  /* Sink for errors, NULL to print them */
+  ErrList* errs;
 } Parser;
 
 // -------------------------------------------------------------------------- //
@@ -82,6 +88,13 @@ parser_span_cur(const Parser* parser);
 
 // -------------------------------------------------------------------------- //
 
+/* Span of the last consumed token that is not whitespace, which is where the
+ * node that was just parsed ends */
+Span
+parser_span_prev(const Parser* parser);
+
+// -------------------------------------------------------------------------- //
+
 Ast*
 parser_parse(Parser* parser);
 
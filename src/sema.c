@@ -0,0 +1,788 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sema.h"
+#include "err.h"
+
+// ========================================================================== //
+// Funs
+// ========================================================================== //
+
+static Type*
+sema_check_expr(Sema* sema, Ast* ast, Type* expected);
+
+static void
+sema_check_stmt(Sema* sema, Ast* ast);
+
+static void
+sema_check_block(Sema* sema, Ast* ast);
+
+// ========================================================================== //
+// Util
+// ========================================================================== //
+
+/* Report semantic error at span with suggestion for solving */
+static void
+sema_err(Sema* sema,
+         const Span* span,
+         ErrNum num,
+         const Str* expl,
+         const Str* sugg)
+{
+  ErrBuilder builder = make_err_builder(sema->src);
+  err_builder_set_desc(&builder, expl);
+  err_builder_set_msg(&builder, expl);
+  err_builder_set_sugg(&builder, sugg);
+  err_builder_set_span(&builder, span);
+  err_builder_set_lines_after(&builder, 1);
+  err_builder_set_pad_lines_before(&builder, 1);
+  err_builder_set_pad_lines_after(&builder, 1);
+  err_builder_set_err_num(&builder, num);
+  err_builder_set_sink(&builder, sema->errs);
+  err_builder_emit(&builder);
+  sema->err_count++;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Report mismatch between expected and found type */
+static void
+sema_err_mismatch(Sema* sema, const Span* span, Type* expected, Type* found)
+{
+  Str expected_str = type_to_str(expected);
+  Str found_str = type_to_str(found);
+  Str expl =
+    str_format(make_str("Mismatched types, expected '%s' but found '%s'"),
+               str_cstr(&expected_str),
+               str_cstr(&found_str));
+  sema_err(sema,
+           span,
+           kErrNumTypeMismatch,
+           &expl,
+           &make_str("Values are never implicitly converted, make sure that "
+                     "both types are the same"));
+  release_str(&expl);
+  release_str(&found_str);
+  release_str(&expected_str);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Number literals take their type from the context */
+static bool
+sema_is_num_literal(Ast* ast)
+{
+  return ast->kind == kAstConst && ast->constant.kind != kAstConstStr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the return type of function (AstFn) from its signature, which is
+ * known before the function is checked */
+static Type*
+sema_fn_ret_type(Ast* ast_fn)
+{
+  return ast_fn->fn.ret ? ast_fn->fn.ret->type.type : get_type_void();
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the type of parameter 'index' of function (AstFn) */
+static Type*
+sema_fn_param_type(Ast* ast_fn, u32 index)
+{
+  return ast_list_get(&ast_fn->fn.params, index)->param.type->type.type;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns whether two functions (AstFn) have the same signature */
+static bool
+sema_fn_sig_eq(Ast* lhs, Ast* rhs)
+{
+  if (lhs->fn.params.len != rhs->fn.params.len ||
+      sema_fn_ret_type(lhs) != sema_fn_ret_type(rhs)) {
+    return false;
+  }
+  for (u32 i = 0; i < lhs->fn.params.len; i++) {
+    if (sema_fn_param_type(lhs, i) != sema_fn_param_type(rhs, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ========================================================================== //
+// Expr
+// ========================================================================== //
+
+/* Report an integer literal that does not fit in its type */
+static void
+sema_check_int_range(Sema* sema, Ast* ast, Type* type)
+{
+  Type* elem_type = type_is_vector(type) ? type->vector.type : type;
+  const TypePrim* prim = type_prim(elem_type);
+  u32 bits = prim->size * 8;
+  u64 max = prim->is_signed ? (1ull << (bits - 1)) - 1
+                            : bits >= 64 ? ~0ull : (1ull << bits) - 1;
+  errno = 0;
+  u64 value = ast_const_to_u64(ast);
+  if (value <= max && errno != ERANGE) {
+    return;
+  }
+
+  Str type_str = type_to_str(elem_type);
+  Str lit_str = str_slice_to_string(&ast->constant.value);
+  Str expl = str_format(make_str("Literal '%s' does not fit in type '%s'"),
+                        str_cstr(&lit_str),
+                        str_cstr(&type_str));
+  Str sugg =
+    prim->is_signed
+      ? str_format(make_str("The range of '%s' is %lld to %llu"),
+                   str_cstr(&type_str),
+                   -(long long)max - 1,
+                   (unsigned long long)max)
+      : str_format(make_str("The range of '%s' is 0 to %llu"),
+                   str_cstr(&type_str),
+                   (unsigned long long)max);
+  sema_err(sema, &ast->span, kErrNumLitRange, &expl, &sugg);
+  release_str(&sugg);
+  release_str(&expl);
+  release_str(&lit_str);
+  release_str(&type_str);
+}
+
+// -------------------------------------------------------------------------- //
+
+static Type*
+sema_check_const(Sema* sema, Ast* ast, Type* expected)
+{
+  Type* type;
+  if (ast->constant.kind == kAstConstStr) {
+    type = get_type_ptr(get_type_char());
+  } else if (ast->constant.kind == kAstConstFloat) {
+    bool fits = expected && type_is_float(expected);
+    type = fits ? expected : get_type_f64();
+  } else {
+    bool fits = expected && (type_is_int(expected) || type_is_float(expected));
+    type = fits ? expected : get_type_s32();
+    if (type_is_int(type)) {
+      sema_check_int_range(sema, ast, type);
+    }
+  }
+
+  ast->res_type = type;
+  return type;
+}
+
+// -------------------------------------------------------------------------- //
+
+static Type*
+sema_check_var(Sema* sema, Ast* ast)
+{
+  Ast* ast_decl = sym_tab_lookup(&sema->syms, ast->var.name);
+  if (!ast_decl) {
+    StrSlice name = atom_str(ast->var.name);
+    Str expl = str_format(make_str("Cannot find value '%.*s' in this scope"),
+                          str_slice_print(&name));
+    sema_err(sema,
+             &ast->span,
+             kErrNumUndefIdent,
+             &expl,
+             &make_str("Variables must be declared with 'let' before they "
+                       "are used"));
+    release_str(&expl);
+    return NULL;
+  }
+  if (ast_decl->kind == kAstFn) {
+    StrSlice name = atom_str(ast->var.name);
+    Str expl = str_format(make_str("Function '%.*s' is not a value"),
+                          str_slice_print(&name));
+    sema_err(sema,
+             &ast->span,
+             kErrNumInvalidOp,
+             &expl,
+             &make_str("Call the function with '(...)' to use its result"));
+    release_str(&expl);
+    return NULL;
+  }
+
+  ast->var.decl = ast_decl;
+  ast->res_type = ast_decl->res_type;
+  return ast->res_type;
+}
+
+// -------------------------------------------------------------------------- //
+
+static Type*
+sema_check_call(Sema* sema, Ast* ast)
+{
+  StrSlice name = atom_str(ast->call.name);
+  Ast* ast_fn = sym_tab_lookup(&sema->syms, ast->call.name);
+  if (!ast_fn) {
+    Str expl = str_format(make_str("Cannot find function '%.*s'"),
+                          str_slice_print(&name));
+    sema_err(sema,
+             &ast->call.name_span,
+             kErrNumUndefIdent,
+             &expl,
+             &make_str("Functions that are defined in another file must be "
+                       "declared with 'fn name(params) -> type;'"));
+    release_str(&expl);
+    return NULL;
+  }
+  if (ast_fn->kind != kAstFn) {
+    Str expl = str_format(make_str("'%.*s' is not a function"),
+                          str_slice_print(&name));
+    sema_err(sema,
+             &ast->call.name_span,
+             kErrNumInvalidOp,
+             &expl,
+             &make_str("Only functions can be called. A variable with the "
+                       "same name hides the function"));
+    release_str(&expl);
+    return NULL;
+  }
+
+  // Arguments take the types of the parameters
+  AstList* args = &ast->call.args;
+  u32 param_count = ast_fn->fn.params.len;
+  if (args->len != param_count) {
+    Str expl = str_format(
+      make_str("Function '%.*s' takes %u argument%s but %u %s given"),
+      str_slice_print(&name),
+      param_count,
+      param_count == 1 ? "" : "s",
+      args->len,
+      args->len == 1 ? "was" : "were");
+    sema_err(sema,
+             &ast->span,
+             kErrNumArgCount,
+             &expl,
+             &make_str("Pass one argument for each parameter"));
+    release_str(&expl);
+    return NULL;
+  }
+  bool valid = true;
+  for (u32 i = 0; i < args->len; i++) {
+    Ast* ast_arg = ast_list_get(args, i);
+    Type* param_type = sema_fn_param_type(ast_fn, i);
+    Type* arg_type = sema_check_expr(sema, ast_arg, param_type);
+    if (!arg_type) {
+      valid = false;
+    } else if (arg_type != param_type) {
+      sema_err_mismatch(sema, &ast_arg->span, param_type, arg_type);
+      valid = false;
+    }
+  }
+  if (!valid) {
+    return NULL;
+  }
+
+  ast->call.decl = ast_fn;
+  ast->res_type = sema_fn_ret_type(ast_fn);
+  return ast->res_type;
+}
+
+// -------------------------------------------------------------------------- //
+
+static Type*
+sema_check_binop(Sema* sema, Ast* ast, Type* expected)
+{
+  Ast* ast_lhs = ast->binop.lhs;
+  Ast* ast_rhs = ast->binop.rhs;
+
+  // The expected type does not apply to the operands of a comparison
+  bool is_cmp = ast_binop_kind_is_cmp(ast->binop.kind);
+  if (is_cmp) {
+    expected = NULL;
+  }
+
+  // A literal operand takes the type of the other operand
+  Type* lhs_type;
+  Type* rhs_type;
+  if (sema_is_num_literal(ast_lhs) && !sema_is_num_literal(ast_rhs)) {
+    rhs_type = sema_check_expr(sema, ast_rhs, expected);
+    lhs_type = sema_check_expr(sema, ast_lhs, rhs_type);
+  } else {
+    lhs_type = sema_check_expr(sema, ast_lhs, expected);
+    rhs_type = sema_check_expr(sema, ast_rhs, lhs_type);
+  }
+  if (!lhs_type || !rhs_type) {
+    return NULL;
+  }
+
+  // Comparisons of scalars result in a 'bool'
+  if (is_cmp && type_is_vector(lhs_type)) {
+    Str type_str = type_to_str(lhs_type);
+    Str expl = str_format(make_str("Comparison is not supported for type '%s'"),
+                          str_cstr(&type_str));
+    sema_err(sema,
+             &ast->span,
+             kErrNumInvalidOp,
+             &expl,
+             &make_str("Comparison operators can only be used with integer "
+                       "and float operands"));
+    release_str(&expl);
+    release_str(&type_str);
+    return NULL;
+  }
+
+  // Check operands
+  if (!type_is_int(lhs_type) && !type_is_float(lhs_type)) {
+    Str type_str = type_to_str(lhs_type);
+    Str expl = str_format(
+      make_str("Arithmetic is not supported for type '%s'"),
+      str_cstr(&type_str));
+    sema_err(sema,
+             &ast->span,
+             kErrNumInvalidOp,
+             &expl,
+             &make_str("Arithmetic operators can only be used with integer, "
+                       "float and vector operands"));
+    release_str(&expl);
+    release_str(&type_str);
+    return NULL;
+  }
+  if (lhs_type != rhs_type) {
+    sema_err_mismatch(sema, &ast_rhs->span, lhs_type, rhs_type);
+    return NULL;
+  }
+
+  ast->res_type = is_cmp ? get_type_bool() : lhs_type;
+  return ast->res_type;
+}
+
+// -------------------------------------------------------------------------- //
+
+static Type*
+sema_check_index(Sema* sema, Ast* ast)
+{
+  Type* base_type = sema_check_expr(sema, ast->index.base, NULL);
+  Type* index_type = sema_check_expr(sema, ast->index.index, NULL);
+  if (!base_type || !index_type) {
+    return NULL;
+  }
+
+  // Only pointers can be indexed
+  if (base_type->kind != kTypePtr) {
+    Str type_str = type_to_str(base_type);
+    Str expl = str_format(make_str("Cannot index into a value of type '%s'"),
+                          str_cstr(&type_str));
+    sema_err(sema,
+             &ast->index.base->span,
+             kErrNumInvalidOp,
+             &expl,
+             &make_str("Only pointers can be indexed"));
+    release_str(&expl);
+    release_str(&type_str);
+    return NULL;
+  }
+  if (!type_is_int(index_type) || type_is_vector(index_type)) {
+    Str type_str = type_to_str(index_type);
+    Str expl = str_format(make_str("Cannot index with a value of type '%s'"),
+                          str_cstr(&type_str));
+    sema_err(sema,
+             &ast->index.index->span,
+             kErrNumTypeMismatch,
+             &expl,
+             &make_str("Indices must be integers"));
+    release_str(&expl);
+    release_str(&type_str);
+    return NULL;
+  }
+
+  ast->res_type = base_type->pointer.type;
+  return ast->res_type;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Check expression. 'expected' is the type required by the context, or NULL
+ * if the context does not constrain the type. Returns NULL on error */
+static Type*
+sema_check_expr(Sema* sema, Ast* ast, Type* expected)
+{
+  switch (ast->kind) {
+    case kAstConst: {
+      return sema_check_const(sema, ast, expected);
+    }
+    case kAstVar: {
+      return sema_check_var(sema, ast);
+    }
+    case kAstBinop: {
+      return sema_check_binop(sema, ast, expected);
+    }
+    case kAstIndex: {
+      return sema_check_index(sema, ast);
+    }
+    case kAstCall: {
+      return sema_check_call(sema, ast);
+    }
+    default: {
+      panic(make_str("Invalid expression kind (%u)"), ast->kind);
+    }
+  }
+}
+
+// ========================================================================== //
+// Stmt
+// ========================================================================== //
+
+static void
+sema_check_let(Sema* sema, Ast* ast)
+{
+  Type* decl_type = ast->let.type ? ast->let.type->type.type : NULL;
+  Type* type = decl_type;
+
+  // Infer from assigned value when no type is given
+  if (ast->let.expr) {
+    Type* expr_type = sema_check_expr(sema, ast->let.expr, decl_type);
+    if (expr_type == get_type_void()) {
+      sema_err(sema,
+               &ast->let.expr->span,
+               kErrNumTypeMismatch,
+               &make_str("Function without return type has no value"),
+               &make_str("Call the function as a statement instead"));
+      expr_type = NULL;
+    }
+    if (!decl_type) {
+      type = expr_type;
+    } else if (expr_type && expr_type != decl_type) {
+      sema_err_mismatch(sema, &ast->let.expr->span, decl_type, expr_type);
+    }
+  } else if (!decl_type) {
+    StrSlice name = atom_str(ast->let.name);
+    Str expl = str_format(make_str("Cannot infer the type of '%.*s'"),
+                          str_slice_print(&name));
+    sema_err(sema,
+             &ast->span,
+             kErrNumNoTypeInfer,
+             &expl,
+             &make_str("Either give the variable a type or assign a value to "
+                       "it"));
+    release_str(&expl);
+  }
+  ast->res_type = type;
+
+  // Declared after the value so that it cannot refer to itself
+  sym_tab_declare(&sema->syms, ast->let.name, ast);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sema_check_ret(Sema* sema, Ast* ast)
+{
+  // 'ret;'
+  if (!ast->ret.expr) {
+    if (sema->ret_type != get_type_void()) {
+      sema_err(sema,
+               &ast->span,
+               kErrNumTypeMismatch,
+               &make_str("Expected a value to return"),
+               &make_str("Return a value of the return type of the "
+                         "function"));
+    }
+    ast->res_type = get_type_void();
+    return;
+  }
+
+  if (sema->ret_type == get_type_void()) {
+    sema_err(sema,
+             &ast->span,
+             kErrNumTypeMismatch,
+             &make_str("Cannot return a value from a function without a "
+                       "return type"),
+             &make_str("Add a return type to the function"));
+    return;
+  }
+
+  Type* type = sema_check_expr(sema, ast->ret.expr, sema->ret_type);
+  if (type && type != sema->ret_type) {
+    sema_err_mismatch(sema, &ast->ret.expr->span, sema->ret_type, type);
+  }
+  ast->res_type = sema->ret_type;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sema_check_assign(Sema* sema, Ast* ast)
+{
+  Ast* ast_target = ast->assign.target;
+  Type* type = sema_check_expr(sema, ast_target, NULL);
+  if (!type) {
+    return;
+  }
+
+  // Loop variables are only changed by the loop itself
+  if (ast_target->kind == kAstVar && ast_target->var.decl->kind == kAstFor) {
+    StrSlice name = atom_str(ast_target->var.name);
+    Str expl = str_format(make_str("Cannot assign to loop variable '%.*s'"),
+                          str_slice_print(&name));
+    sema_err(sema,
+             &ast_target->span,
+             kErrNumAssignImmut,
+             &expl,
+             &make_str("Declare a new variable with 'let' and assign to that "
+                       "instead"));
+    release_str(&expl);
+    return;
+  }
+
+  Type* expr_type = sema_check_expr(sema, ast->assign.expr, type);
+  if (expr_type && expr_type != type) {
+    sema_err_mismatch(sema, &ast->assign.expr->span, type, expr_type);
+  }
+  ast->res_type = type;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sema_check_while(Sema* sema, Ast* ast)
+{
+  Ast* ast_cond = ast->while_loop.cond;
+  Type* type = sema_check_expr(sema, ast_cond, get_type_bool());
+  if (type && type != get_type_bool()) {
+    sema_err_mismatch(sema, &ast_cond->span, get_type_bool(), type);
+  }
+  sema_check_block(sema, ast->while_loop.body);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sema_check_for(Sema* sema, Ast* ast)
+{
+  Ast* ast_from = ast->for_loop.from;
+  Ast* ast_to = ast->for_loop.to;
+
+  // A literal bound takes the type of the other bound
+  Type* from_type;
+  Type* to_type;
+  if (sema_is_num_literal(ast_from) && !sema_is_num_literal(ast_to)) {
+    to_type = sema_check_expr(sema, ast_to, NULL);
+    from_type = sema_check_expr(sema, ast_from, to_type);
+  } else {
+    from_type = sema_check_expr(sema, ast_from, NULL);
+    to_type = sema_check_expr(sema, ast_to, from_type);
+  }
+
+  // Bounds must be integers of the same type
+  Type* type = from_type;
+  if (from_type && (!type_is_int(from_type) || type_is_vector(from_type))) {
+    Str type_str = type_to_str(from_type);
+    Str expl = str_format(make_str("Cannot iterate over a range of '%s'"),
+                          str_cstr(&type_str));
+    sema_err(sema,
+             &ast_from->span,
+             kErrNumTypeMismatch,
+             &expl,
+             &make_str("The bounds of a for loop must be integers"));
+    release_str(&expl);
+    release_str(&type_str);
+    type = NULL;
+  } else if (from_type && to_type && from_type != to_type) {
+    sema_err_mismatch(sema, &ast_to->span, from_type, to_type);
+    type = NULL;
+  }
+  ast->res_type = type;
+
+  // Loop variable is only visible in the body
+  sym_tab_push_scope(&sema->syms);
+  sym_tab_declare(&sema->syms, ast->for_loop.name, ast);
+  sema_check_block(sema, ast->for_loop.body);
+  sym_tab_pop_scope(&sema->syms);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sema_check_block(Sema* sema, Ast* ast)
+{
+  sym_tab_push_scope(&sema->syms);
+  for (u32 i = 0; i < ast->block.stmts.len; i++) {
+    sema_check_stmt(sema, ast_list_get(&ast->block.stmts, i));
+  }
+  sym_tab_pop_scope(&sema->syms);
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sema_check_stmt(Sema* sema, Ast* ast)
+{
+  switch (ast->kind) {
+    case kAstLet: {
+      sema_check_let(sema, ast);
+      break;
+    }
+    case kAstRet: {
+      sema_check_ret(sema, ast);
+      break;
+    }
+    case kAstBlock: {
+      sema_check_block(sema, ast);
+      break;
+    }
+    case kAstAssign: {
+      sema_check_assign(sema, ast);
+      break;
+    }
+    case kAstWhile: {
+      sema_check_while(sema, ast);
+      break;
+    }
+    case kAstFor: {
+      sema_check_for(sema, ast);
+      break;
+    }
+    default: {
+      sema_check_expr(sema, ast, NULL);
+      break;
+    }
+  }
+}
+
+// ========================================================================== //
+// Sema
+// ========================================================================== //
+
+Sema
+make_sema(const Src* src)
+{
+  return (Sema){ .src = src,
+                 .syms = make_sym_tab(),
+                 .ret_type = NULL,
+                 .err_count = 0,
+                 .errs = NULL };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_sema(Sema* sema)
+{
+  // Declarations are owned by the ast
+  release_sym_tab(&sema->syms);
+}
+
+// -------------------------------------------------------------------------- //
+
+SemaErr
+sema_check_fn(Sema* sema, Ast* ast_fn)
+{
+  assrt(ast_fn->kind == kAstFn, make_str("Wrong ast kind"));
+  if (ast_fn->fn.checked) {
+    return kSemaNoErr;
+  }
+  u32 err_count = sema->err_count;
+
+  // Params
+  sym_tab_push_scope(&sema->syms);
+  for (u32 i = 0; i < ast_fn->fn.params.len; i++) {
+    Ast* ast_param = ast_list_get(&ast_fn->fn.params, i);
+    ast_param->res_type = ast_param->param.type->type.type;
+    sym_tab_declare(&sema->syms, ast_param->param.name, ast_param);
+  }
+
+  // Body
+  sema->ret_type =
+    ast_fn->fn.ret ? ast_fn->fn.ret->type.type : get_type_void();
+  ast_fn->res_type = sema->ret_type;
+  if (ast_fn->fn.body) {
+    sema_check_block(sema, ast_fn->fn.body);
+  }
+  sym_tab_pop_scope(&sema->syms);
+  sema->ret_type = NULL;
+
+  // Only successfully checked functions are skipped the next time
+  ast_fn->fn.checked = sema->err_count == err_count;
+  return ast_fn->fn.checked ? kSemaNoErr : kSemaErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+SemaErr
+sema_declare_prog(Sema* sema, Ast* ast_prog)
+{
+  assrt(ast_prog->kind == kAstProg, make_str("Wrong ast kind"));
+  u32 err_count = sema->err_count;
+  sym_tab_push_scope(&sema->syms);
+  for (u32 i = 0; i < ast_prog->prog.funs.len; i++) {
+    Ast* ast_fn = ast_list_get(&ast_prog->prog.funs, i);
+    Ast* ast_prev = sym_tab_lookup(&sema->syms, ast_fn->fn.name);
+    if (!ast_prev) {
+      sym_tab_declare(&sema->syms, ast_fn->fn.name, ast_fn);
+      continue;
+    }
+
+    // A function can be declared any number of times, but only defined once
+    StrSlice name = atom_str(ast_fn->fn.name);
+    if (ast_prev->fn.body && ast_fn->fn.body) {
+      Str expl = str_format(make_str("Function '%.*s' is defined twice"),
+                            str_slice_print(&name));
+      sema_err(sema,
+               &ast_fn->fn.name_span,
+               kErrNumRedef,
+               &expl,
+               &make_str("Rename or remove one of the definitions"));
+      release_str(&expl);
+    } else if (!sema_fn_sig_eq(ast_prev, ast_fn)) {
+      Str expl = str_format(
+        make_str("Function '%.*s' is declared with another signature"),
+        str_slice_print(&name));
+      sema_err(sema,
+               &ast_fn->fn.name_span,
+               kErrNumRedef,
+               &expl,
+               &make_str("All declarations of a function must have the same "
+                         "parameter and return types"));
+      release_str(&expl);
+    } else if (ast_fn->fn.body) {
+      sym_tab_declare(&sema->syms, ast_fn->fn.name, ast_fn);
+    }
+  }
+  return sema->err_count == err_count ? kSemaNoErr : kSemaErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+SemaErr
+sema_check_prog(Sema* sema, Ast* ast_prog)
+{
+  SemaErr err = sema_declare_prog(sema, ast_prog);
+  for (u32 i = 0; i < ast_prog->prog.funs.len; i++) {
+    Ast* ast_fn = ast_list_get(&ast_prog->prog.funs, i);
+    if (sema_check_fn(sema, ast_fn) != kSemaNoErr) {
+      err = kSemaErr;
+    }
+  }
+  sym_tab_pop_scope(&sema->syms);
+  return err;
+}
@@ -0,0 +1,101 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_SEMA_H
+#define LN_SEMA_H
+
+#include "common.h"
+#include "ast.h"
+#include "err.h"
+#include "src.h"
+#include "sym.h"
+
+// ========================================================================== //
+// SemaErr
+// ========================================================================== //
+
+/* Semantic analysis errors */
+typedef enum SemaErr
+{
+  /* No error */
+  kSemaNoErr,
+  /* One or more errors were reported */
+  kSemaErr,
+} SemaErr;
+
+// ========================================================================== //
+// Sema
+// ========================================================================== //
+
+/* Semantic analysis context. A context only touches the function that it is
+ * checking, which means that different functions can be checked in parallel
+ * with one context each */
+typedef struct Sema
+{
+  /* Source that is being checked */
+  const Src* src;
+  /* Declarations in scope (AstFn, AstLet, AstParam and AstFor) */
+  SymTab syms;
+  /* Return type of the function being checked */
+  Type* ret_type;
+  /* Number of reported errors */
+  u32 err_count;
+  /* Sink for errors, NULL to print them */
+  ErrList* errs;
+} Sema;
+
+// -------------------------------------------------------------------------- //
+
+/* Make semantic analysis context */
+Sema
+make_sema(const Src* src);
+
+// -------------------------------------------------------------------------- //
+
+/* Release semantic analysis context */
+void
+release_sema(Sema* sema);
+
+// -------------------------------------------------------------------------- //
+
+/* Open the scope of a program (AstProg) and declare its functions in it, so
+ * that calls resolve to them in any order. Reports functions that are
+ * defined twice or declared with different signatures */
+SemaErr
+sema_declare_prog(Sema* sema, Ast* ast_prog);
+
+// -------------------------------------------------------------------------- //
+
+/* Check a function (AstFn). Resolves the type of every expression and
+ * declaration and stores it in 'res_type' of the nodes. Functions that have
+ * already been checked are skipped. Calls resolve to the functions in the
+ * scope from 'sema_declare_prog' */
+SemaErr
+sema_check_fn(Sema* sema, Ast* ast_fn);
+
+// -------------------------------------------------------------------------- //
+
+/* Check all functions in a program (AstProg) */
+SemaErr
+sema_check_prog(Sema* sema, Ast* ast_prog);
+
+#endif // LN_SEMA_H
@@ -89,6 +89,17 @@ unicode_encode(char* buf, u32 off, u32 code_point, u32* p_width)
   return alfUTF8Encode((AlfChar8*)buf, off, code_point, p_width);
 }
 
+// -------------------------------------------------------------------------- //
+
+u32
+unicode_utf16_units(u8 byte)
+{
+  if ((byte & 0xC0) == 0x80) {
+    return 0;
+  }
+  return byte >= 0xF0 ? 2 : 1;
+}
+
 // ========================================================================== //
 // Str
 // ========================================================================== //
@@ -97,7 +108,7 @@ unicode_encode(char* buf, u32 off, u32 code_point, u32* p_width)
 
 // -------------------------------------------------------------------------- //
 
-static char s_str_fmt_buf[kStrFmtBufSize];
+static _Thread_local char s_str_fmt_buf[kStrFmtBufSize];
 
 // -------------------------------------------------------------------------- //
 
@@ -111,7 +122,7 @@ make_str_copy(const char* str)
   }
   buf[size] = 0;
   memcpy(buf, str, size);
-  return (Str){ .buf = buf, .size = size, .len = cstr_len(str) };
+  return (Str){ .buf = buf, .size = size, .len = kStrLenUnknown };
 }
 
 // -------------------------------------------------------------------------- //
@@ -138,6 +149,17 @@ str_null()
 
 // -------------------------------------------------------------------------- //
 
+u32
+str_len(const Str* str)
+{
+  if (str->len != kStrLenUnknown) {
+    return str->len;
+  }
+  return str->buf ? cstr_len((const char*)str->buf) : 0;
+}
+
+// -------------------------------------------------------------------------- //
+
 Str
 str_format(Str fmt, ...)
 {
@@ -291,7 +313,7 @@ str_slice_to_string(const StrSlice* slice)
   }
   buf[size] = 0;
   memcpy(buf, slice->ptr, size);
-  return (Str){ .buf = buf, .size = size, .len = cstr_len((char*)buf) };
+  return (Str){ .buf = buf, .size = size, .len = kStrLenUnknown };
 }
 
 // -------------------------------------------------------------------------- //
@@ -65,6 +65,14 @@ unicode_width(u32 code_point);
 bool
 unicode_encode(char* buf, u32 off, u32 code_point, u32* p_width);
 
+// -------------------------------------------------------------------------- //
+
+/* Returns the number of UTF-16 code units that a byte of UTF-8 text adds. The
+ * lead byte of a character outside the BMP adds two and continuation bytes
+ * add none */
+u32
+unicode_utf16_units(u8 byte);
+
 // ========================================================================== //
 // Str
 // ========================================================================== //
@@ -76,14 +84,31 @@ typedef struct Str
   u8* buf;
   /* Size in bytes */
   u32 size;
-  /* Len in characters */
+  /* Len in characters, kStrLenUnknown until computed. Use 'str_len' */
   u32 len;
 } Str;
 
 // -------------------------------------------------------------------------- //
 
-#define make_str(str)                                                          \
-  (Str) { .buf = (u8*)str, .size = cstr_size(str), .len = cstr_len(str) }
+/* Marks the length of a string as not yet computed */
+#define kStrLenUnknown 0xFFFFFFFF
+
+// -------------------------------------------------------------------------- //
+
+/* Make string from string literal. The size is computed at compile time and
+ * the length on demand, so this does not touch the string at all. Use
+ * 'make_str_cstr' for strings that are not literals */
+#define make_str(lit)                                                          \
+  (Str)                                                                        \
+  {                                                                            \
+    .buf = (u8*)("" lit ""), .size = sizeof(lit) - 1, .len = kStrLenUnknown    \
+  }
+
+// -------------------------------------------------------------------------- //
+
+/* Make string from c-str. The length is computed on demand */
+#define make_str_cstr(str)                                                     \
+  (Str) { .buf = (u8*)str, .size = cstr_size(str), .len = kStrLenUnknown }
 
 // -------------------------------------------------------------------------- //
 
@@ -102,6 +127,12 @@ str_null();
 
 // -------------------------------------------------------------------------- //
 
+/* Returns length of string in characters */
+u32
+str_len(const Str* str);
+
+// -------------------------------------------------------------------------- //
+
 Str
 str_format(Str fmt, ...);
 
@@ -0,0 +1,181 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <string.h>
+
+#include "sym.h"
+
+// ========================================================================== //
+// Util
+// ========================================================================== //
+
+#define kSymNone 0xFFFFFFFF
+
+// -------------------------------------------------------------------------- //
+
+static u32
+sym_tab_hash(Atom atom)
+{
+  return atom * 2654435761u;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the map slot of atom, or the empty slot where it would go */
+static u32
+sym_tab_slot(const SymTab* tab, Atom atom)
+{
+  u32 mask = tab->map_cap - 1;
+  u32 pos = sym_tab_hash(atom) & mask;
+  while (tab->map[pos].atom != kAtomNone && tab->map[pos].atom != atom) {
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+sym_tab_grow_map(SymTab* tab)
+{
+  u32 old_cap = tab->map_cap;
+  SymSlot* old_map = tab->map;
+
+  tab->map_cap = old_cap ? old_cap * 2 : 64;
+  tab->map = alloc(sizeof(SymSlot) * tab->map_cap, kLnMinAlign);
+  memset(tab->map, 0, sizeof(SymSlot) * tab->map_cap);
+  for (u32 i = 0; i < old_cap; i++) {
+    if (old_map[i].atom != kAtomNone) {
+      tab->map[sym_tab_slot(tab, old_map[i].atom)] = old_map[i];
+    }
+  }
+  if (old_map) {
+    release(old_map);
+  }
+}
+
+// ========================================================================== //
+// SymTab
+// ========================================================================== //
+
+SymTab
+make_sym_tab()
+{
+  SymTab tab = { 0 };
+  sym_tab_grow_map(&tab);
+  return tab;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+release_sym_tab(SymTab* tab)
+{
+  if (tab->syms) {
+    release(tab->syms);
+  }
+  if (tab->scopes) {
+    release(tab->scopes);
+  }
+  release(tab->map);
+  *tab = (SymTab){ 0 };
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+sym_tab_push_scope(SymTab* tab)
+{
+  if (tab->scope_count >= tab->scope_cap) {
+    u32 cap = tab->scope_cap ? tab->scope_cap * 2 : 8;
+    u32* scopes = alloc(sizeof(u32) * cap, kLnMinAlign);
+    if (tab->scopes) {
+      memcpy(scopes, tab->scopes, sizeof(u32) * tab->scope_count);
+      release(tab->scopes);
+    }
+    tab->scopes = scopes;
+    tab->scope_cap = cap;
+  }
+  tab->scopes[tab->scope_count++] = tab->sym_count;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+sym_tab_pop_scope(SymTab* tab)
+{
+  assrt(tab->scope_count > 0, make_str("No scope to pop"));
+  u32 beg = tab->scopes[--tab->scope_count];
+  while (tab->sym_count > beg) {
+    Sym* sym = &tab->syms[--tab->sym_count];
+    tab->map[sym_tab_slot(tab, sym->atom)].sym = sym->shadowed;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+sym_tab_declare(SymTab* tab, Atom atom, Ast* decl)
+{
+  assrt(tab->scope_count > 0, make_str("Declaration outside of scope"));
+  assrt(atom != kAtomNone, make_str("Cannot declare invalid atom"));
+
+  // Symbol
+  if (tab->sym_count >= tab->sym_cap) {
+    u32 cap = tab->sym_cap ? tab->sym_cap * 2 : 32;
+    Sym* syms = alloc(sizeof(Sym) * cap, kLnMinAlign);
+    if (tab->syms) {
+      memcpy(syms, tab->syms, sizeof(Sym) * tab->sym_count);
+      release(tab->syms);
+    }
+    tab->syms = syms;
+    tab->sym_cap = cap;
+  }
+
+  // Map. Slots are never removed, unused names map to kSymNone
+  if ((tab->map_count + 1) * 2 > tab->map_cap) {
+    sym_tab_grow_map(tab);
+  }
+  u32 slot = sym_tab_slot(tab, atom);
+  if (tab->map[slot].atom == kAtomNone) {
+    tab->map[slot].atom = atom;
+    tab->map[slot].sym = kSymNone;
+    tab->map_count++;
+  }
+
+  u32 index = tab->sym_count++;
+  tab->syms[index] =
+    (Sym){ .atom = atom, .decl = decl, .shadowed = tab->map[slot].sym };
+  tab->map[slot].sym = index;
+}
+
+// -------------------------------------------------------------------------- //
+
+Ast*
+sym_tab_lookup(const SymTab* tab, Atom atom)
+{
+  u32 slot = sym_tab_slot(tab, atom);
+  if (tab->map[slot].atom == kAtomNone || tab->map[slot].sym == kSymNone) {
+    return NULL;
+  }
+  return tab->syms[tab->map[slot].sym].decl;
+}
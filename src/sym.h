@@ -0,0 +1,120 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LN_SYM_H
+#define LN_SYM_H
+
+#include "common.h"
+#include "atom.h"
+
+typedef struct Ast Ast;
+
+// ========================================================================== //
+// SymTab
+// ========================================================================== //
+
+/* Symbol in a symbol table */
+typedef struct Sym
+{
+  /* Name */
+  Atom atom;
+  /* Declaration */
+  Ast* decl;
+  /* Index of the symbol that this symbol shadows */
+  u32 shadowed;
+} Sym;
+
+// -------------------------------------------------------------------------- //
+
+/* Slot in symbol table map */
+typedef struct SymSlot
+{
+  /* Name */
+  Atom atom;
+  /* Index of innermost symbol with name */
+  u32 sym;
+} SymSlot;
+
+// -------------------------------------------------------------------------- //
+
+/* Scoped symbol table keyed by atom. Every name maps to the innermost symbol
+ * that declares it, and symbols remember what they shadow so that closing a
+ * scope restores the outer declarations */
+typedef struct SymTab
+{
+  /* Symbols, innermost scope last */
+  Sym* syms;
+  /* Number of symbols */
+  u32 sym_count;
+  /* Symbol capacity */
+  u32 sym_cap;
+  /* Symbol count at the start of each open scope */
+  u32* scopes;
+  /* Number of open scopes */
+  u32 scope_count;
+  /* Scope capacity */
+  u32 scope_cap;
+  /* Hash map from atom to innermost symbol index */
+  SymSlot* map;
+  /* Map capacity (power of two) */
+  u32 map_cap;
+  /* Number of used map slots */
+  u32 map_count;
+} SymTab;
+
+// -------------------------------------------------------------------------- //
+
+/* Make empty symbol table */
+SymTab
+make_sym_tab();
+
+// -------------------------------------------------------------------------- //
+
+/* Release symbol table */
+void
+release_sym_tab(SymTab* tab);
+
+// -------------------------------------------------------------------------- //
+
+/* Open a scope */
+void
+sym_tab_push_scope(SymTab* tab);
+
+// -------------------------------------------------------------------------- //
+
+/* Close the innermost scope, removing all symbols declared in it */
+void
+sym_tab_pop_scope(SymTab* tab);
+
+// -------------------------------------------------------------------------- //
+
+/* Declare symbol in the innermost scope */
+void
+sym_tab_declare(SymTab* tab, Atom atom, Ast* decl);
+
+// -------------------------------------------------------------------------- //
+
+/* Lookup innermost declaration of atom. Returns NULL if not declared */
+Ast*
+sym_tab_lookup(const SymTab* tab, Atom atom);
+
+#endif // LN_SYM_H
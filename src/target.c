@@ -21,6 +21,9 @@
 // SOFTWARE.
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
 
 #include "target.h"
 #include "str.h"
@@ -30,47 +33,210 @@
 // Target
 // ========================================================================== //
 
+/* Named target with the CPU and features to use when none are given */
+typedef struct TargetPreset
+{
+  /* Name */
+  const char* name;
+  /* Triple */
+  const char* triple;
+  /* Default CPU */
+  const char* cpu;
+  /* Default features */
+  const char* features;
+  /* ABI, empty for the default of the triple */
+  const char* abi;
+} TargetPreset;
+
+// -------------------------------------------------------------------------- //
+
+/* Target presets, any other target name is parsed as a triple */
+static const TargetPreset s_target_presets[] = {
+  { "x86_64-linux", "x86_64-unknown-linux-gnu", "x86-64", "", "" },
+  { "x86-win32", "i686-pc-windows-msvc", "pentium4", "", "" },
+  { "x86_64-win32", "x86_64-pc-windows-msvc", "x86-64", "", "" },
+  { "aarch64-linux", "aarch64-unknown-linux-gnu", "generic", "+neon", "" },
+  { "aarch64-ios", "arm64-apple-ios", "cyclone", "", "" },
+  { "riscv64",
+    "riscv64-unknown-linux-gnu",
+    "generic-rv64",
+    "+m,+a,+f,+d,+c",
+    "lp64d" },
+  { "wasm32", "wasm32-unknown-unknown", "generic", "", "" },
+};
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the preset with name, or NULL */
+static const TargetPreset*
+target_match_preset(const Str* target_name)
+{
+  u32 count = sizeof(s_target_presets) / sizeof(s_target_presets[0]);
+  for (u32 i = 0; i < count; i++) {
+    if (str_eq(target_name, &make_str_cstr(s_target_presets[i].name))) {
+      return &s_target_presets[i];
+    }
+  }
+  return NULL;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the triple of the target name. An empty name is the host, other
+ * names are either a preset or a triple such as 'armv7-unknown-linux' */
 static LLVMTripleRef
-target_match_triple(const Str* target_name)
+target_match_triple(const Str* target_name, const TargetPreset* preset)
 {
-  if (target_name->len == 0) { // Native
+  if (target_name->size == 0) { // Native
     return LLVMGetDefaultTriple();
-  } else if (str_eq(target_name, &make_str("x86-win32"))) {
-    return LLVMGetTripleFromArchVendorOs(
-      LLVMx86ArchType, LLVMUnknownVendorType, LLVMWin32OSType);
-  } else if (str_eq(target_name, &make_str("x86_64-win32"))) {
-    return LLVMGetTripleFromArchVendorOs(
-      LLVMx86_64ArchType, LLVMUnknownVendorType, LLVMWin32OSType);
-  } else if (str_eq(target_name, &make_str("aarch64-ios"))) {
-    return LLVMGetTripleFromArchVendorOs(
-      LLVMAarch64ArchType, LLVMAppleVendorType, LLVMIOSOSType);
+  } else if (preset) {
+    return LLVMGetTripleFromTargetTriple(preset->triple);
   }
-  return NULL;
+  return LLVMGetTripleFromTargetTriple(str_cstr(target_name));
 }
 
 // -------------------------------------------------------------------------- //
 
-TargetErr
-make_target(const Str* target_name, Target* p_target)
+static LLVMCodeGenOptLevel
+target_codegen_level(TargetOptLevel opt_level)
+{
+  switch (opt_level) {
+    case kTargetOpt0: {
+      return LLVMCodeGenLevelNone;
+    }
+    case kTargetOpt1: {
+      return LLVMCodeGenLevelLess;
+    }
+    case kTargetOpt3: {
+      return LLVMCodeGenLevelAggressive;
+    }
+    default: {
+      return LLVMCodeGenLevelDefault;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns 'features' followed by the features of options, separated by a
+ * comma so that the features of options take precedence */
+static char*
+target_join_features(const char* features, const TargetOpts* opts)
+{
+  u32 size = cstr_size(features);
+  if (opts->features.size == 0) {
+    return cstr_copy(features);
+  } else if (size == 0) {
+    return cstr_copy(str_cstr(&opts->features));
+  }
+  u32 opts_size = opts->features.size;
+  char* joined = alloc(size + opts_size + 2, kLnMinAlign);
+  memcpy(joined, features, size);
+  joined[size] = ',';
+  memcpy(joined + size + 1, str_cstr(&opts->features), opts_size);
+  joined[size + opts_size + 1] = 0;
+  return joined;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Resolve CPU and features from options. Without a CPU the defaults of the
+ * preset are used. The host CPU and its features are used for 'native'.
+ * Explicit features are appended to the default or detected ones so that
+ * they override them */
+static TargetErr
+target_match_cpu(const TargetOpts* opts,
+                 const TargetPreset* preset,
+                 char** p_cpu,
+                 char** p_features)
+{
+  if (opts->cpu.size == 0) {
+    *p_cpu = cstr_copy(preset ? preset->cpu : "generic");
+    *p_features = target_join_features(preset ? preset->features : "", opts);
+    return kTargetNoErr;
+  }
+  if (!str_eq(&opts->cpu, &make_str("native"))) {
+    *p_cpu = cstr_copy(str_cstr(&opts->cpu));
+    *p_features = target_join_features("", opts);
+    return kTargetNoErr;
+  }
+
+  // The host CPU is only meaningful when compiling for the host
+  if (opts->name.size > 0) {
+    return kTargetInvCpu;
+  }
+  char* host_cpu = LLVMGetHostCPUName();
+  char* host_features = LLVMGetHostCPUFeatures();
+  *p_cpu = cstr_copy(host_cpu);
+  *p_features = target_join_features(host_features, opts);
+  LLVMDisposeMessage(host_features);
+  LLVMDisposeMessage(host_cpu);
+  return kTargetNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Target resolved from options, before the machine is created */
+typedef struct TargetResolved
+{
+  LLVMTripleRef triple;
+  LLVMTargetRef llvm_target;
+  char* cpu;
+  char* features;
+  const char* abi;
+} TargetResolved;
+
+// -------------------------------------------------------------------------- //
+
+/* Resolve triple, CPU and features from options */
+static TargetErr
+target_resolve(const TargetOpts* opts, TargetResolved* p_resolved)
 {
   // Match name with triple
-  LLVMTripleRef triple = target_match_triple(target_name);
+  const TargetPreset* preset = target_match_preset(&opts->name);
+  LLVMTripleRef triple = target_match_triple(&opts->name, preset);
 
   // Get target
-  char* error;
+  char* error = NULL;
   LLVMTargetRef llvm_target;
   bool success = !LLVMTripleGetTarget(triple, &llvm_target, &error);
   if (!success) {
+    LLVMDisposeMessage(error);
+    LLVMDisposeTriple(triple);
     return kTargetInvTarget;
   }
 
+  // CPU and features
+  char* cpu;
+  char* features;
+  TargetErr err = target_match_cpu(opts, preset, &cpu, &features);
+  if (err != kTargetNoErr) {
+    LLVMDisposeTriple(triple);
+    return err;
+  }
+
+  *p_resolved = (TargetResolved){ .triple = triple,
+                                  .llvm_target = llvm_target,
+                                  .cpu = cpu,
+                                  .features = features,
+                                  .abi = preset ? preset->abi : "" };
+  return kTargetNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Create target machine from resolved target, which the target then owns */
+static Target
+target_create(const TargetOpts* opts, const TargetResolved* resolved)
+{
   // Create target machine
   LLVMTargetMachineRef target_machine =
-    LLVMCreateTargetMachineFromTriple(llvm_target,
-                                      triple,
-                                      "generic",
-                                      "",
-                                      LLVMCodeGenLevelDefault,
+    LLVMCreateTargetMachineFromTriple(resolved->llvm_target,
+                                      resolved->triple,
+                                      resolved->cpu,
+                                      resolved->features,
+                                      resolved->abi,
+                                      target_codegen_level(opts->opt_level),
                                       LLVMRelocDefault,
                                       LLVMCodeModelDefault);
 
@@ -79,10 +245,30 @@ make_target(const Str* target_name, Target* p_target)
 
   // Setup machine
   Target target;
-  target.triple = triple;
+  target.triple = resolved->triple;
   target.machine = target_machine;
   target.data_layout = target_layout;
-  *p_target = target;
+  target.cpu = resolved->cpu;
+  target.features = resolved->features;
+  target.abi = resolved->abi;
+  target.opt_level = opts->opt_level;
+  target.pgo_gen = opts->pgo_gen;
+  target.pgo_use =
+    opts->pgo_use.size > 0 ? cstr_copy(str_cstr(&opts->pgo_use)) : NULL;
+  return target;
+}
+
+// -------------------------------------------------------------------------- //
+
+TargetErr
+make_target(const TargetOpts* opts, Target* p_target)
+{
+  TargetResolved resolved;
+  TargetErr err = target_resolve(opts, &resolved);
+  if (err != kTargetNoErr) {
+    return err;
+  }
+  *p_target = target_create(opts, &resolved);
   return kTargetNoErr;
 }
 
@@ -91,6 +277,11 @@ make_target(const Str* target_name, Target* p_target)
 void
 release_target(Target* target)
 {
+  if (target->pgo_use) {
+    release(target->pgo_use);
+  }
+  release(target->features);
+  release(target->cpu);
   LLVMDisposeTargetData(target->data_layout);
   LLVMDisposeTargetMachine(target->machine);
   LLVMDisposeTriple(target->triple);
@@ -112,4 +303,126 @@ target_get_type_alignof(const Target* target, Type* type)
 {
   LLVMTypeRef llvm_type = to_llvm_type(type);
   return LLVMABIAlignmentOfType(target->data_layout, llvm_type);
-}
\ No newline at end of file
+}
+
+// ========================================================================== //
+// TargetRegistry
+// ========================================================================== //
+
+/* Registered target. The target is the first member so that the entry can
+ * be found from the target */
+typedef struct TargetEntry
+{
+  /* Target */
+  Target target;
+  /* Whether the target is acquired */
+  bool in_use;
+  /* Next entry */
+  struct TargetEntry* next;
+} TargetEntry;
+
+// -------------------------------------------------------------------------- //
+
+/* Lock for the registry */
+static pthread_mutex_t s_target_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Registered targets */
+static TargetEntry* s_target_entries = NULL;
+
+// -------------------------------------------------------------------------- //
+
+static bool
+target_cstr_eq(const char* a, const char* b)
+{
+  return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns whether target was created from options that resolved to
+ * 'resolved' */
+static bool
+target_matches(const Target* target,
+               const TargetOpts* opts,
+               const TargetResolved* resolved)
+{
+  const char* pgo_use =
+    opts->pgo_use.size > 0 ? str_cstr(&opts->pgo_use) : NULL;
+  return target->opt_level == opts->opt_level &&
+         target->pgo_gen == opts->pgo_gen &&
+         target_cstr_eq(target->pgo_use, pgo_use) &&
+         target_cstr_eq(target->cpu, resolved->cpu) &&
+         target_cstr_eq(target->features, resolved->features) &&
+         target_cstr_eq(target->abi, resolved->abi) &&
+         target_cstr_eq(LLVMTripleGetTriple(target->triple),
+                        LLVMTripleGetTriple(resolved->triple));
+}
+
+// -------------------------------------------------------------------------- //
+
+TargetErr
+target_registry_acquire(const TargetOpts* opts, Target** p_target)
+{
+  TargetResolved resolved;
+  TargetErr err = target_resolve(opts, &resolved);
+  if (err != kTargetNoErr) {
+    return err;
+  }
+
+  // Reuse a free target
+  mutex_lock(&s_target_lock);
+  for (TargetEntry* entry = s_target_entries; entry; entry = entry->next) {
+    if (!entry->in_use && target_matches(&entry->target, opts, &resolved)) {
+      entry->in_use = true;
+      mutex_unlock(&s_target_lock);
+      release(resolved.features);
+      release(resolved.cpu);
+      LLVMDisposeTriple(resolved.triple);
+      *p_target = &entry->target;
+      return kTargetNoErr;
+    }
+  }
+  mutex_unlock(&s_target_lock);
+
+  // Create the target outside of the lock, it is the expensive part
+  TargetEntry* entry = alloc(sizeof(TargetEntry), kLnMinAlign);
+  entry->target = target_create(opts, &resolved);
+  entry->in_use = true;
+  mutex_lock(&s_target_lock);
+  entry->next = s_target_entries;
+  s_target_entries = entry;
+  mutex_unlock(&s_target_lock);
+  *p_target = &entry->target;
+  return kTargetNoErr;
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+target_registry_release(Target* target)
+{
+  TargetEntry* entry = (TargetEntry*)target;
+  assrt(entry->in_use, make_str("Released target must be acquired"));
+  mutex_lock(&s_target_lock);
+  entry->in_use = false;
+  mutex_unlock(&s_target_lock);
+}
+
+// -------------------------------------------------------------------------- //
+
+void
+target_registry_cleanup()
+{
+  mutex_lock(&s_target_lock);
+  TargetEntry* entry = s_target_entries;
+  while (entry) {
+    TargetEntry* next = entry->next;
+    assrt(!entry->in_use,
+          make_str("Targets must be released before registry cleanup"));
+    release_target(&entry->target);
+    release(entry);
+    entry = next;
+  }
+  s_target_entries = NULL;
+  mutex_unlock(&s_target_lock);
+}
@@ -25,6 +25,7 @@
 
 #include "llvm_c_ext.h"
 #include "common.h"
+#include "str.h"
 
 // ========================================================================== //
 // TargetErr
@@ -35,9 +36,51 @@ typedef enum TargetErr
   /* No error */
   kTargetNoErr,
   /* Invalid target */
-  kTargetInvTarget
+  kTargetInvTarget,
+  /* Invalid CPU */
+  kTargetInvCpu,
 } TargetErr;
 
+// ========================================================================== //
+// TargetOptLevel
+// ========================================================================== //
+
+/* Optimization level */
+typedef enum TargetOptLevel
+{
+  /* -O0 */
+  kTargetOpt0,
+  /* -O1 */
+  kTargetOpt1,
+  /* -O2 */
+  kTargetOpt2,
+  /* -O3 */
+  kTargetOpt3,
+  /* -Os, optimize for size */
+  kTargetOptSize,
+} TargetOptLevel;
+
+// ========================================================================== //
+// TargetOpts
+// ========================================================================== //
+
+/* Options for creating a target */
+typedef struct TargetOpts
+{
+  /* Target name, empty for native */
+  Str name;
+  /* CPU name, empty for generic and 'native' for the host CPU */
+  Str cpu;
+  /* Comma-separated features, for example '+avx2,-fma' */
+  Str features;
+  /* Optimization level */
+  TargetOptLevel opt_level;
+  /* Instrument code to generate a profile */
+  bool pgo_gen;
+  /* Path of profile to optimize with, empty for none */
+  Str pgo_use;
+} TargetOpts;
+
 // ========================================================================== //
 // Target
 // ========================================================================== //
@@ -51,12 +94,24 @@ typedef struct Target
   LLVMTargetMachineRef machine;
   /* Data layout */
   LLVMTargetDataRef data_layout;
+  /* CPU name */
+  char* cpu;
+  /* Features */
+  char* features;
+  /* ABI, empty for the default of the triple */
+  const char* abi;
+  /* Optimization level */
+  TargetOptLevel opt_level;
+  /* Instrument code to generate a profile */
+  bool pgo_gen;
+  /* Path of profile to optimize with, NULL for none */
+  char* pgo_use;
 } Target;
 
 // -------------------------------------------------------------------------- //
 
 TargetErr
-make_target(const Str* target_name, Target* p_target);
+make_target(const TargetOpts* opts, Target* p_target);
 
 // -------------------------------------------------------------------------- //
 
@@ -73,4 +128,27 @@ target_get_type_sizeof(const Target* target, Type* type);
 u64
 target_get_type_alignof(const Target* target, Type* type);
 
+// ========================================================================== //
+// TargetRegistry
+// ========================================================================== //
+
+/* Acquire a target for options from the process-wide registry. Targets are
+ * keyed by triple, CPU, features and optimization settings. A target is
+ * only used by one thread at a time, so a new one is created when all
+ * matching targets are acquired */
+TargetErr
+target_registry_acquire(const TargetOpts* opts, Target** p_target);
+
+// -------------------------------------------------------------------------- //
+
+/* Return target to the registry so that it can be reused */
+void
+target_registry_release(Target* target);
+
+// -------------------------------------------------------------------------- //
+
+/* Release all targets of the registry */
+void
+target_registry_cleanup();
+
 #endif // LN_TARGET_H
\ No newline at end of file
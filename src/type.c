@@ -22,6 +22,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "type.h"
 #include "str.h"
@@ -30,29 +31,25 @@
 // TypeList
 // ========================================================================== //
 
+/* List of derived types. Types are allocated individually so that pointers to
+ * them stay valid when the list grows */
 typedef struct TypeList
 {
-  Type* buf;
+  Type** buf;
   u32 len;
   u32 cap;
 } TypeList;
 
 // -------------------------------------------------------------------------- //
 
-static TypeList
-make_type_list()
-{
-  u32 cap = 16;
-  Type* buf = alloc(sizeof(Type) * cap, kLnMinAlign);
-  return (TypeList){ .buf = buf, .len = 0, .cap = cap };
-}
-
-// -------------------------------------------------------------------------- //
-
 static void
 release_type_list(TypeList* list)
 {
+  for (u32 i = 0; i < list->len; i++) {
+    release(list->buf[i]);
+  }
   release(list->buf);
+  *list = (TypeList){ .buf = NULL, .len = 0, .cap = 0 };
 }
 
 // -------------------------------------------------------------------------- //
@@ -63,9 +60,11 @@ type_list_reserve(TypeList* list, u32 cap)
   if (list->cap > cap) {
     return;
   }
-  Type* buf = alloc(sizeof(Type) * cap, kLnMinAlign);
-  memcpy(buf, list->buf, sizeof(Type) * list->len);
-  release(list->buf);
+  Type** buf = alloc(sizeof(Type*) * cap, kLnMinAlign);
+  if (list->buf) {
+    memcpy(buf, list->buf, sizeof(Type*) * list->len);
+    release(list->buf);
+  }
   list->buf = buf;
   list->cap = cap;
 }
@@ -76,7 +75,7 @@ static Type*
 type_list_get(const TypeList* list, u32 index)
 {
   assrt(index < list->len, make_str("TypeList index out of bounds"));
-  return &list->buf[index];
+  return list->buf[index];
 }
 // -------------------------------------------------------------------------- //
 
@@ -84,93 +83,101 @@ static Type*
 type_list_append(TypeList* list, const Type* type)
 {
   if (list->len >= list->cap) {
-    type_list_reserve(list, list->cap * 2);
+    type_list_reserve(list, list->cap ? list->cap * 2 : 16);
   }
-  memcpy(list->buf + list->len++, type, sizeof(Type));
-  return type_list_get(list, list->len - 1);
+  Type* stored = alloc(sizeof(Type), kLnMinAlign);
+  memcpy(stored, type, sizeof(Type));
+  list->buf[list->len++] = stored;
+  return stored;
 }
 
 // ========================================================================== //
-// Types
+// Primitives
 // ========================================================================== //
 
-static TypeList s_type_list;
+#define LN_TYPE_PRIM(knd, nam, sz, sgn, cls)                                   \
+  [knd] = { .kind = knd,                                                       \
+            .name = nam,                                                       \
+            .name_size = sizeof(nam) - 1,                                      \
+            .size = sz,                                                        \
+            .is_signed = sgn,                                                  \
+            .llvm_class = cls }
+
+/* Primitive type table, indexed by kind */
+static const TypePrim s_type_prims[kTypePrimCount] = {
+  LN_TYPE_PRIM(kTypeVoid, "void", 0, false, kTypePrimClassVoid),
+  LN_TYPE_PRIM(kTypeChar, "char", 1, false, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeBool, "bool", 1, false, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeU8, "u8", 1, false, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeS8, "s8", 1, true, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeU16, "u16", 2, false, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeS16, "s16", 2, true, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeU32, "u32", 4, false, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeS32, "s32", 4, true, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeU64, "u64", 8, false, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeS64, "s64", 8, true, kTypePrimClassInt),
+  LN_TYPE_PRIM(kTypeF32, "f32", 4, true, kTypePrimClassFloat),
+  LN_TYPE_PRIM(kTypeF64, "f64", 8, true, kTypePrimClassFloat),
+};
+
+#undef LN_TYPE_PRIM
 
 // -------------------------------------------------------------------------- //
 
-static Type* s_type_void;
+/* Primitive type objects, indexed by kind */
+static Type s_type_prim_objs[kTypePrimCount] = {
+  [kTypeVoid] = { .kind = kTypeVoid }, [kTypeChar] = { .kind = kTypeChar },
+  [kTypeBool] = { .kind = kTypeBool }, [kTypeU8] = { .kind = kTypeU8 },
+  [kTypeS8] = { .kind = kTypeS8 },     [kTypeU16] = { .kind = kTypeU16 },
+  [kTypeS16] = { .kind = kTypeS16 },   [kTypeU32] = { .kind = kTypeU32 },
+  [kTypeS32] = { .kind = kTypeS32 },   [kTypeU64] = { .kind = kTypeU64 },
+  [kTypeS64] = { .kind = kTypeS64 },   [kTypeF32] = { .kind = kTypeF32 },
+  [kTypeF64] = { .kind = kTypeF64 },
+};
 
-static Type* s_type_char;
-static Type* s_type_bool;
+// -------------------------------------------------------------------------- //
 
-static Type* s_type_u8;
-static Type* s_type_s8;
-static Type* s_type_u16;
-static Type* s_type_s16;
-static Type* s_type_u32;
-static Type* s_type_s32;
-static Type* s_type_u64;
-static Type* s_type_s64;
+const TypePrim*
+type_prim(Type* type)
+{
+  assrt(type_is_primitive(type), make_str("Type is not a primitive"));
+  return &s_type_prims[type->kind];
+}
 
-static Type* s_type_f32;
-static Type* s_type_f64;
+// ========================================================================== //
+// Types
+// ========================================================================== //
+
+/* Derived (non-primitive) types */
+static TypeList s_type_list;
+
+// -------------------------------------------------------------------------- //
+
+/* Guards the derived type list, types are looked up from worker threads */
+static pthread_mutex_t s_type_lock = PTHREAD_MUTEX_INITIALIZER;
 
 // -------------------------------------------------------------------------- //
 
-#define LN_TYPE_LIST_ADD(store, type_kind)                                     \
-  type = (Type){ .kind = type_kind };                                          \
-  store = type_list_append(&s_type_list, &type);
+static bool s_types_initialized;
+
+// -------------------------------------------------------------------------- //
 
 void
 types_init()
 {
-  assrt(s_type_list.buf == NULL,
-        make_str("Types can only be initialized once"));
-  s_type_list = make_type_list();
-
-  Type type;
-  LN_TYPE_LIST_ADD(s_type_void, kTypeVoid);
-  LN_TYPE_LIST_ADD(s_type_char, kTypeChar);
-  LN_TYPE_LIST_ADD(s_type_bool, kTypeBool);
-  LN_TYPE_LIST_ADD(s_type_u8, kTypeU8);
-  LN_TYPE_LIST_ADD(s_type_s8, kTypeS16);
-  LN_TYPE_LIST_ADD(s_type_u16, kTypeU16);
-  LN_TYPE_LIST_ADD(s_type_s16, kTypeS16);
-  LN_TYPE_LIST_ADD(s_type_u32, kTypeU32);
-  LN_TYPE_LIST_ADD(s_type_s32, kTypeS32);
-  LN_TYPE_LIST_ADD(s_type_u64, kTypeU64);
-  LN_TYPE_LIST_ADD(s_type_s64, kTypeS64);
-  LN_TYPE_LIST_ADD(s_type_f32, kTypeF32);
-  LN_TYPE_LIST_ADD(s_type_f64, kTypeF64);
+  assrt(!s_types_initialized, make_str("Types can only be initialized once"));
+  s_types_initialized = true;
+  s_type_list = (TypeList){ .buf = NULL, .len = 0, .cap = 0 };
 }
 
-#undef LN_TYPE_LIST_ADD
-
 // -------------------------------------------------------------------------- //
 
-#define LN_TYPE_TO_STR_BASIC(knd, name)                                        \
-  do {                                                                         \
-    if (type->kind == knd) {                                                   \
-      return make_str_copy(name);                                              \
-    }                                                                          \
-  } while (0)
-
 Str
 type_to_str(Type* type)
 {
-  LN_TYPE_TO_STR_BASIC(kTypeVoid, "void");
-  LN_TYPE_TO_STR_BASIC(kTypeChar, "char");
-  LN_TYPE_TO_STR_BASIC(kTypeBool, "bool");
-  LN_TYPE_TO_STR_BASIC(kTypeU8, "u8");
-  LN_TYPE_TO_STR_BASIC(kTypeS8, "s8");
-  LN_TYPE_TO_STR_BASIC(kTypeU16, "u16");
-  LN_TYPE_TO_STR_BASIC(kTypeS16, "s16");
-  LN_TYPE_TO_STR_BASIC(kTypeU32, "u32");
-  LN_TYPE_TO_STR_BASIC(kTypeS32, "s32");
-  LN_TYPE_TO_STR_BASIC(kTypeU64, "u64");
-  LN_TYPE_TO_STR_BASIC(kTypeS64, "s64");
-  LN_TYPE_TO_STR_BASIC(kTypeF32, "f32");
-  LN_TYPE_TO_STR_BASIC(kTypeF64, "f64");
+  if (type_is_primitive(type)) {
+    return make_str_copy(s_type_prims[type->kind].name);
+  }
 
   if (type->kind == kTypeArray) {
     Str elem_str = type_to_str(type->array.type);
@@ -188,6 +195,12 @@ type_to_str(Type* type)
     Str ptr_str = str_format(make_str("%s*"), str_cstr(&ptee_str));
     release_str(&ptee_str);
     return ptr_str;
+  } else if (type->kind == kTypeVector) {
+    Str elem_str = type_to_str(type->vector.type);
+    Str vec_str =
+      str_format(make_str("%sx%u"), str_cstr(&elem_str), type->vector.len);
+    release_str(&elem_str);
+    return vec_str;
   } else if (type->kind == kTypeStruct) {
     LN_NOT_IMPL();
   } else if (type->kind == kTypeEnum) {
@@ -199,14 +212,12 @@ type_to_str(Type* type)
   return make_str_copy("Unknown");
 }
 
-#undef LN_TYPE_TO_STR_BASIC
-
 // -------------------------------------------------------------------------- //
 
 void
 types_cleanup()
 {
-  assrt(s_type_list.buf != NULL,
+  assrt(s_types_initialized,
         make_str("Cannot cleanup types without first initializing them"));
   for (u32 i = 0; i < s_type_list.len; i++) {
     Type* type = type_list_get(&s_type_list, i);
@@ -215,6 +226,7 @@ types_cleanup()
     }
   }
   release_type_list(&s_type_list);
+  s_types_initialized = false;
 }
 
 // -------------------------------------------------------------------------- //
@@ -222,59 +234,164 @@ types_cleanup()
 bool
 type_is_primitive(Type* type)
 {
-  return type->kind == kTypeVoid || type->kind == kTypeChar ||
-         type->kind == kTypeBool || type->kind == kTypeU8 ||
-         type->kind == kTypeS8 || type->kind == kTypeU16 ||
-         type->kind == kTypeS16 || type->kind == kTypeU32 ||
-         type->kind == kTypeS32 || type->kind == kTypeU64 ||
-         type->kind == kTypeS64 || type->kind == kTypeF32 ||
-         type->kind == kTypeF64;
+  return type->kind < kTypePrimCount;
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+type_is_int(Type* type)
+{
+  if (type->kind == kTypeVector) {
+    return type_is_int(type->vector.type);
+  }
+  return type->kind >= kTypeU8 && type->kind <= kTypeS64;
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+type_is_float(Type* type)
+{
+  if (type->kind == kTypeVector) {
+    return type_is_float(type->vector.type);
+  }
+  return type_is_primitive(type) &&
+         s_type_prims[type->kind].llvm_class == kTypePrimClassFloat;
 }
 
 // -------------------------------------------------------------------------- //
 
-#define LN_TYPE_FROM_NAME_CASE(val, typ)                                       \
-  if (str_slice_eq_str(name, &make_str(val))) {                                \
-    return typ;                                                                \
+bool
+type_is_signed(Type* type)
+{
+  if (type->kind == kTypeVector) {
+    return type_is_signed(type->vector.type);
   }
+  return type_is_int(type) && s_type_prims[type->kind].is_signed;
+}
+
+// -------------------------------------------------------------------------- //
+
+bool
+type_is_vector(Type* type)
+{
+  return type->kind == kTypeVector;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Parse vector type names on the form '<elem>x<lanes>', for example 'f32x4'.
+ * Returns NULL if the name is not a valid vector type name */
+static Type*
+get_type_vector_from_name(const StrSlice* name)
+{
+  // Find the lane separator
+  u32 sep = name->count;
+  for (u32 i = name->count; i > 0; i--) {
+    if (name->ptr[i - 1] == 'x') {
+      sep = i - 1;
+      break;
+    }
+  }
+  if (sep == 0 || sep + 1 >= name->count) {
+    return NULL;
+  }
+
+  // Lane count
+  u32 len = 0;
+  for (u32 i = sep + 1; i < name->count; i++) {
+    u8 c = name->ptr[i];
+    if (c < '0' || c > '9' || len > kTypeVectorMaxLen) {
+      return NULL;
+    }
+    len = len * 10 + (c - '0');
+  }
+  if (len < 2 || len > kTypeVectorMaxLen || (len & (len - 1)) != 0) {
+    return NULL;
+  }
+
+  // Element type
+  StrSlice elem_name = { .ptr = name->ptr, .count = sep };
+  Type* elem_type = get_type_from_name(&elem_name);
+  if (!elem_type || elem_type->kind == kTypeVector ||
+      (!type_is_int(elem_type) && !type_is_float(elem_type))) {
+    return NULL;
+  }
+  return get_type_vector(elem_type, len);
+}
+
+// -------------------------------------------------------------------------- //
 
 Type*
 get_type_from_name(const StrSlice* name)
 {
-  LN_TYPE_FROM_NAME_CASE("void", get_type_void());
-  LN_TYPE_FROM_NAME_CASE("char", get_type_char());
-  LN_TYPE_FROM_NAME_CASE("bool", get_type_bool());
-  LN_TYPE_FROM_NAME_CASE("u8", get_type_u8());
-  LN_TYPE_FROM_NAME_CASE("s8", get_type_s8());
-  LN_TYPE_FROM_NAME_CASE("u16", get_type_u16());
-  LN_TYPE_FROM_NAME_CASE("s16", get_type_s16());
-  LN_TYPE_FROM_NAME_CASE("u32", get_type_u32());
-  LN_TYPE_FROM_NAME_CASE("s32", get_type_s32());
-  LN_TYPE_FROM_NAME_CASE("u64", get_type_u64());
-  LN_TYPE_FROM_NAME_CASE("s64", get_type_s64());
-  LN_TYPE_FROM_NAME_CASE("f32", get_type_f32());
-  LN_TYPE_FROM_NAME_CASE("f64", get_type_f64());
-  return NULL;
+  for (u32 i = 0; i < kTypePrimCount; i++) {
+    const TypePrim* prim = &s_type_prims[i];
+    if (prim->name_size == name->count &&
+        memcmp(prim->name, name->ptr, name->count) == 0) {
+      return &s_type_prim_objs[i];
+    }
+  }
+  return get_type_vector_from_name(name);
 }
 
-#undef LN_TYPE_FROM_NAME_CASE
+// -------------------------------------------------------------------------- //
+
+static bool
+type_derived_eq(const Type* type0, const Type* type1)
+{
+  if (type0->kind != type1->kind) {
+    return false;
+  }
+  switch (type0->kind) {
+    case kTypeArray: {
+      return type0->array.type == type1->array.type &&
+             type0->array.len == type1->array.len;
+    }
+    case kTypePtr: {
+      return type0->pointer.type == type1->pointer.type;
+    }
+    case kTypeVector: {
+      return type0->vector.type == type1->vector.type &&
+             type0->vector.len == type1->vector.len;
+    }
+    default: {
+      return false;
+    }
+  }
+}
 
 // -------------------------------------------------------------------------- //
 
-Type*
-get_type_array(Type* elem_type, u64 len)
+/* Returns the registered derived type equal to 'type', registering it if it
+ * does not exist yet */
+static Type*
+type_intern(const Type* type)
 {
-  for (u32 i = 0; i < s_type_list.len; i++) {
+  mutex_lock(&s_type_lock);
+  Type* found = NULL;
+  for (u32 i = 0; i < s_type_list.len && !found; i++) {
     Type* other = type_list_get(&s_type_list, i);
-    if (other->kind == kTypeArray && other->array.type == elem_type &&
-        other->array.len == len) {
-      return other;
+    if (type_derived_eq(other, type)) {
+      found = other;
     }
   }
+  if (!found) {
+    found = type_list_append(&s_type_list, type);
+  }
+  mutex_unlock(&s_type_lock);
+  return found;
+}
+
+// -------------------------------------------------------------------------- //
 
+Type*
+get_type_array(Type* elem_type, u64 len)
+{
   Type type =
     (Type){ .kind = kTypeArray, .array = { .type = elem_type, .len = len } };
-  return type_list_append(&s_type_list, &type);
+  return type_intern(&type);
 }
 
 // -------------------------------------------------------------------------- //
@@ -282,15 +399,24 @@ get_type_array(Type* elem_type, u64 len)
 Type*
 get_type_ptr(Type* pointee_type)
 {
-  for (u32 i = 0; i < s_type_list.len; i++) {
-    Type* other = type_list_get(&s_type_list, i);
-    if (other->kind == kTypePtr && other->pointer.type == pointee_type) {
-      return other;
-    }
-  }
-
   Type type = (Type){ .kind = kTypePtr, .pointer = { .type = pointee_type } };
-  return type_list_append(&s_type_list, &type);
+  return type_intern(&type);
+}
+
+// -------------------------------------------------------------------------- //
+
+Type*
+get_type_vector(Type* elem_type, u32 len)
+{
+  assrt(type_is_int(elem_type) || type_is_float(elem_type),
+        make_str("Vector element type must be an integer or float type"));
+  assrt(len > 1 && len <= kTypeVectorMaxLen,
+        make_str("Invalid vector lane count (%u)"),
+        len);
+
+  Type type =
+    (Type){ .kind = kTypeVector, .vector = { .type = elem_type, .len = len } };
+  return type_intern(&type);
 }
 
 // -------------------------------------------------------------------------- //
@@ -298,7 +424,7 @@ get_type_ptr(Type* pointee_type)
 Type*
 get_type_void()
 {
-  return s_type_void;
+  return &s_type_prim_objs[kTypeVoid];
 }
 
 // -------------------------------------------------------------------------- //
@@ -306,7 +432,7 @@ get_type_void()
 Type*
 get_type_char()
 {
-  return s_type_char;
+  return &s_type_prim_objs[kTypeChar];
 }
 
 // -------------------------------------------------------------------------- //
@@ -314,7 +440,7 @@ get_type_char()
 Type*
 get_type_bool()
 {
-  return s_type_bool;
+  return &s_type_prim_objs[kTypeBool];
 }
 
 // -------------------------------------------------------------------------- //
@@ -322,7 +448,7 @@ get_type_bool()
 Type*
 get_type_u8()
 {
-  return s_type_u8;
+  return &s_type_prim_objs[kTypeU8];
 }
 
 // -------------------------------------------------------------------------- //
@@ -330,7 +456,7 @@ get_type_u8()
 Type*
 get_type_s8()
 {
-  return s_type_s8;
+  return &s_type_prim_objs[kTypeS8];
 }
 
 // -------------------------------------------------------------------------- //
@@ -338,7 +464,7 @@ get_type_s8()
 Type*
 get_type_u16()
 {
-  return s_type_u16;
+  return &s_type_prim_objs[kTypeU16];
 }
 
 // -------------------------------------------------------------------------- //
@@ -346,7 +472,7 @@ get_type_u16()
 Type*
 get_type_s16()
 {
-  return s_type_s16;
+  return &s_type_prim_objs[kTypeS16];
 }
 
 // -------------------------------------------------------------------------- //
@@ -354,7 +480,7 @@ get_type_s16()
 Type*
 get_type_u32()
 {
-  return s_type_u32;
+  return &s_type_prim_objs[kTypeU32];
 }
 
 // -------------------------------------------------------------------------- //
@@ -362,7 +488,7 @@ get_type_u32()
 Type*
 get_type_s32()
 {
-  return s_type_s32;
+  return &s_type_prim_objs[kTypeS32];
 }
 
 // -------------------------------------------------------------------------- //
@@ -370,7 +496,7 @@ get_type_s32()
 Type*
 get_type_u64()
 {
-  return s_type_u64;
+  return &s_type_prim_objs[kTypeU64];
 }
 
 // -------------------------------------------------------------------------- //
@@ -378,7 +504,7 @@ get_type_u64()
 Type*
 get_type_s64()
 {
-  return s_type_s64;
+  return &s_type_prim_objs[kTypeS64];
 }
 
 // -------------------------------------------------------------------------- //
@@ -386,7 +512,7 @@ get_type_s64()
 Type*
 get_type_f32()
 {
-  return s_type_f32;
+  return &s_type_prim_objs[kTypeF32];
 }
 
 // -------------------------------------------------------------------------- //
@@ -394,5 +520,5 @@ get_type_f32()
 Type*
 get_type_f64()
 {
-  return s_type_f64;
+  return &s_type_prim_objs[kTypeF64];
 }
\ No newline at end of file
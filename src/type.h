@@ -51,11 +51,48 @@ typedef enum TypeKind
 
   kTypeArray,
   kTypePtr,
+  kTypeVector,
   kTypeStruct,
   kTypeEnum,
   kTypeTrait,
 } TypeKind;
 
+// -------------------------------------------------------------------------- //
+
+/* Number of primitive type kinds. Primitives are the first kinds in TypeKind */
+#define kTypePrimCount (kTypeF64 + 1)
+
+// ========================================================================== //
+// TypePrim
+// ========================================================================== //
+
+/* Class of the LLVM type that a primitive maps to */
+typedef enum TypePrimClass
+{
+  kTypePrimClassVoid,
+  kTypePrimClassInt,
+  kTypePrimClassFloat,
+} TypePrimClass;
+
+// -------------------------------------------------------------------------- //
+
+/* Primitive type description */
+typedef struct TypePrim
+{
+  /* Kind */
+  TypeKind kind;
+  /* Name */
+  const char* name;
+  /* Size of name in bytes */
+  u32 name_size;
+  /* Size in bytes */
+  u32 size;
+  /* Signedness */
+  bool is_signed;
+  /* LLVM type class. The LLVM type width is given by 'size' */
+  TypePrimClass llvm_class;
+} TypePrim;
+
 // ========================================================================== //
 // Type
 // ========================================================================== //
@@ -64,6 +101,10 @@ typedef enum TypeKind
 
 // -------------------------------------------------------------------------- //
 
+#define kTypeVectorMaxLen 64
+
+// -------------------------------------------------------------------------- //
+
 /* Type data union */
 typedef struct Type
 {
@@ -85,6 +126,13 @@ typedef struct Type
       struct Type* type;
     } pointer;
     struct
+    {
+      /* Element type */
+      struct Type* type;
+      /* Number of lanes */
+      u32 len;
+    } vector;
+    struct
     {
       u32 tmp;
     } strct;
@@ -123,7 +171,37 @@ type_is_primitive(Type* type);
 
 // -------------------------------------------------------------------------- //
 
-/* Returns a primitive type from the name */
+/* Returns the description of a primitive type */
+const TypePrim*
+type_prim(Type* type);
+
+// -------------------------------------------------------------------------- //
+
+/* Checks if type is an integer type (or vector of integers) */
+bool
+type_is_int(Type* type);
+
+// -------------------------------------------------------------------------- //
+
+/* Checks if type is a floating-point type (or vector of floats) */
+bool
+type_is_float(Type* type);
+
+// -------------------------------------------------------------------------- //
+
+/* Checks if type is a signed integer type (or vector of signed integers) */
+bool
+type_is_signed(Type* type);
+
+// -------------------------------------------------------------------------- //
+
+/* Checks if type is a fixed-width vector type */
+bool
+type_is_vector(Type* type);
+
+// -------------------------------------------------------------------------- //
+
+/* Returns a primitive or vector type from the name */
 Type*
 get_type_from_name(const StrSlice* name);
 
@@ -141,6 +219,12 @@ get_type_ptr(Type* pointee_type);
 
 // -------------------------------------------------------------------------- //
 
+/* Gets a fixed-width vector type. Elements must be integers or floats */
+Type*
+get_type_vector(Type* elem_type, u32 len);
+
+// -------------------------------------------------------------------------- //
+
 /* Gets 'void' type */
 Type*
 get_type_void();
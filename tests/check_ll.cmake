@@ -0,0 +1,64 @@
+## ========================================================================== ##
+## LLVM IR check
+## ========================================================================== ##
+
+# Compiles INPUT to LLVM IR with the arguments of the 'args:' lines in CHECK.
+# The 'match:' patterns must then be found in the IR in the order they are
+# given and no 'not:' pattern may be found anywhere. Patterns are CMake
+# regular expressions and paths in the arguments are relative to INPUT.
+# Every codegen unit is checked, in the order of the units
+
+file(STRINGS ${CHECK} LINES)
+set(ARGS "")
+set(MATCHES "")
+set(NOTS "")
+foreach(LINE ${LINES})
+    if (LINE MATCHES "^args: (.*)$")
+        separate_arguments(LINE_ARGS UNIX_COMMAND "${CMAKE_MATCH_1}")
+        list(APPEND ARGS ${LINE_ARGS})
+    elseif (LINE MATCHES "^match: (.*)$")
+        list(APPEND MATCHES "${CMAKE_MATCH_1}")
+    elseif (LINE MATCHES "^not: (.*)$")
+        list(APPEND NOTS "${CMAKE_MATCH_1}")
+    elseif (NOT LINE STREQUAL "")
+        message(FATAL_ERROR "Invalid line in ${CHECK}: ${LINE}")
+    endif ()
+endforeach()
+
+# Compile
+file(REMOVE_RECURSE ${OUTPUT})
+file(MAKE_DIRECTORY ${OUTPUT})
+get_filename_component(INPUT_DIR ${INPUT} DIRECTORY)
+execute_process(COMMAND ${LNC} ${ARGS} --emit=ll -o ${OUTPUT}/out.ll ${INPUT}
+        WORKING_DIRECTORY ${INPUT_DIR}
+        RESULT_VARIABLE RESULT
+        OUTPUT_VARIABLE LOG
+        ERROR_VARIABLE LOG)
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "Compilation failed (${RESULT}):\n${LOG}")
+endif ()
+file(GLOB UNITS ${OUTPUT}/out*.ll)
+list(SORT UNITS)
+set(IR "")
+foreach(UNIT ${UNITS})
+    file(READ ${UNIT} UNIT_IR)
+    string(APPEND IR "${UNIT_IR}")
+endforeach()
+
+# Check
+set(REST "${IR}")
+foreach(PATTERN ${MATCHES})
+    string(REGEX MATCH "${PATTERN}" FOUND "${REST}")
+    if (FOUND STREQUAL "")
+        message(FATAL_ERROR "Pattern '${PATTERN}' not found in:\n${REST}")
+    endif ()
+    string(FIND "${REST}" "${FOUND}" POS)
+    string(LENGTH "${FOUND}" LEN)
+    math(EXPR POS "${POS} + ${LEN}")
+    string(SUBSTRING "${REST}" ${POS} -1 REST)
+endforeach()
+foreach(PATTERN ${NOTS})
+    if ("${IR}" MATCHES "${PATTERN}")
+        message(FATAL_ERROR "Pattern '${PATTERN}' found in:\n${IR}")
+    endif ()
+endforeach()
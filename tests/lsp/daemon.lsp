@@ -0,0 +1,25 @@
+# A server that listens keeps serving its other clients while one of them
+# sends half-typed code and then disconnects
+@ 0
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///ok.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    let x = 3;\n    ret x;\n}\n"}}}
+< "diagnostics":[]
+@ 1
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///typing.ln","languageId":"lingon","version":1,"text":"fn main("}}}
+< Expected right parenthesis ')' at the end of the parameter list
+> {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///typing.ln","version":2},"contentChanges":[{"text":"fn main() -> s32 {\n    ret 1 +"}]}}
+< Expected identifier, literal or parenthesized expression
+> {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///typing.ln","version":3},"contentChanges":[{"text":"fn main() -> s32 {\n    let x = 3\n"}]}}
+< Expected semicolon at the end of a let statement
+> {"jsonrpc":"2.0","id":2,"method":"shutdown"}
+< "id":2,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
+@ 0
+> {"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///ok.ln"},"position":{"line":2,"character":8}}}
+< "id":2,"result":{"contents":
+@ 2
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
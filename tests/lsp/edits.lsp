@@ -0,0 +1,30 @@
+# Incremental edits: several ranges in one change, ranges across line breaks,
+# UTF-16 columns behind a character outside the BMP, and enough churn to
+# compact the pieces of the document
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///edits.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    let s = \"😀\"; let b = 2;\n    let a = 1;\n    ret a;\n}\n"}}}
+< "version":1,"diagnostics":[]
+# Rename 'b' behind the emoji, which is two UTF-16 units, rename 'a' and
+# replace the range from its value up to 'ret' with new lines
+> {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edits.ln","version":2},"contentChanges":[{"range":{"start":{"line":1,"character":22},"end":{"line":1,"character":23}},"text":"bee"},{"range":{"start":{"line":2,"character":8},"end":{"line":2,"character":9}},"text":"abc"},{"range":{"start":{"line":2,"character":14},"end":{"line":3,"character":7}},"text":"40 + bee;\n    let z = abc;\n    ret"},{"range":{"start":{"line":4,"character":8},"end":{"line":4,"character":9}},"text":"z"}]}}
+< "version":2,"diagnostics":[]
+> {"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///edits.ln"},"position":{"line":1,"character":23}}}
+< "id":2,"result":{"contents":{"kind":"plaintext","value":"let bee: s32"},"range":{"start":{"line":1,"character":18},"end":{"line":1,"character":30}}}
+> {"jsonrpc":"2.0","id":3,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///edits.ln"},"position":{"line":3,"character":8}}}
+< "id":3,"result":{"contents":{"kind":"plaintext","value":"let z: s32"},"range":{"start":{"line":3,"character":4},"end":{"line":3,"character":16}}}
+> {"jsonrpc":"2.0","id":4,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///edits.ln"},"position":{"line":4,"character":8}}}
+< "id":4,"result":{"contents":{"kind":"plaintext","value":"z: s32"},"range":{"start":{"line":4,"character":8},"end":{"line":4,"character":9}}}
+# Insert lines behind the emoji and remove them again, 400 times in one
+# change. The removed text then outgrows the compaction slack
+= Content-Length: 151824\r\n\r\n{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edits.ln","version":3},"contentChanges":[
++ 400 {"range":{"start":{"line":1,"character":17},"end":{"line":1,"character":17}},"text":"\\n                                                                                                                                                                                                        "},{"range":{"start":{"line":1,"character":17},"end":{"line":2,"character":200}},"text":""},
+= {"range":{"start":{"line":1,"character":28},"end":{"line":1,"character":29}},"text":"q"}]}}
+< "version":3,"diagnostics":[{"range":{"start":{"line":1,"character":28},"end":{"line":1,"character":29}},"severity":1,"code":2,"source":"lnc","message":"Cannot find value 'q' in this scope
+> {"jsonrpc":"2.0","id":5,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///edits.ln"},"position":{"line":1,"character":28}}}
+< "id":5,"result":{"contents":{"kind":"plaintext","value":"q"},"range":{"start":{"line":1,"character":28},"end":{"line":1,"character":29}}}
+> {"jsonrpc":"2.0","id":6,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///edits.ln"},"position":{"line":2,"character":20}}}
+< "id":6,"result":{"contents":{"kind":"plaintext","value":"bee"},"range":{"start":{"line":2,"character":19},"end":{"line":2,"character":22}}}
+> {"jsonrpc":"2.0","id":7,"method":"shutdown"}
+< "id":7,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
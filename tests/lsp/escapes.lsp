@@ -0,0 +1,15 @@
+# JSON escapes in strings are decoded: quotes, backslashes, line breaks,
+# and \u escapes, including a surrogate pair. The URI is echoed back as
+# UTF-8 and positions behind the decoded characters count UTF-16 units
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///esc/a\"b\\c\u00e9\ud83d\ude00.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    let s = \"\u00e9\ud83d\ude00 \\\" \\\\\"; ret q;\n}\n"}}}
+< {"uri":"file:///esc/a\"b\\cé😀.ln","version":1,"diagnostics":[{"range":{"start":{"line":1,"character":29},"end":{"line":1,"character":30}},"severity":1,"code":2,"source":"lnc","message":"Cannot find value 'q' in this scope\n
+# The URI is decoded in place, before and after the other members
+> {"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///esc/a\"b\\c\u00e9\ud83d\ude00.ln"},"position":{"line":1,"character":29}}}
+< "id":2,"result":{"contents":{"kind":"plaintext","value":"q"},"range":{"start":{"line":1,"character":29},"end":{"line":1,"character":30}}}
+> {"jsonrpc":"2.0","id":3,"method":"textDocument/hover","params":{"position":{"line":1,"character":5},"textDocument":{"uri":"file:///esc/a\"b\\c\u00e9\ud83d\ude00.ln"}}}
+< "id":3,"result":{"contents":{"kind":"plaintext","value":"let s: char*"},"range":{"start":{"line":1,"character":4},"end":{"line":1,"character":24}}}
+> {"jsonrpc":"2.0","id":4,"method":"shutdown"}
+< "id":4,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
@@ -0,0 +1,35 @@
+# Frames are parsed however the bytes are split between reads: byte by
+# byte, split in the header or the content, several in one read, and
+# wrapped around the end of the receive buffer
+- Content-Length: 58\r\n\r\n{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+# Header split inside the name, between CR and LF, and before the content
+= Content-Le
+= ngth: 45\r
+= \n
+= \r\n
+= {"jsonrpc":"2.0","id":2,"method":"$/unknown"}
+< "id":2,"error":{"code":-32601
+# Content split
+= Content-Length: 45\r\n\r\n{"jsonrpc":"
+= 2.0","id":3,"method":"$/unknown"}
+< "id":3,"error":{"code":-32601
+# Three frames in one write
+= Content-Length: 45\r\n\r\n{"jsonrpc":"2.0","id":4,"method":"$/unknown"}Content-Length: 45\r\nContent-Type: application/vscode-jsonrpc; charset=utf-8\r\n\r\n{"jsonrpc":"2.0","id":5,"method":"$/unknown"}Content-Length: 45\r\n\r\n{"jsonrpc":"2.0","id":6,"method":"$/unknown"}
+< "id":4,"error":{"code":-32601
+< "id":5,"error":{"code":-32601
+< "id":6,"error":{"code":-32601
+# Each write ends inside a content, so the buffer is never emptied and
+# its start does not move back to the front. The writes fit in a pipe
+# atomically and leave 144 bytes at the end of the buffer, so the document
+# wraps around
+= Content-Length: 32\r\n\r\n{"jsonrpc":"2.0","
++ 75 method":"$/x"}Content-Length: 32\r\n\r\n{"jsonrpc":"2.0","
++ 75 method":"$/x"}Content-Length: 32\r\n\r\n{"jsonrpc":"2.0","
++ 75 method":"$/x"}Content-Length: 32\r\n\r\n{"jsonrpc":"2.0","
++ 75 method":"$/x"}Content-Length: 32\r\n\r\n{"jsonrpc":"2.0","
+= method":"$/x"}Content-Length: 183\r\n\r\n{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///wrap.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\\n    let x = 3\\n}\\n"}}}
+< "uri":"file:///wrap.ln","version":1,"diagnostics":[{"range":{"start":{"line":2,"character":0},"end":{"line":2,"character":1}}
+> {"jsonrpc":"2.0","id":7,"method":"shutdown"}
+< "id":7,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
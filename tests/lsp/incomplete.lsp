@@ -0,0 +1,17 @@
+# Half-typed code is reported through diagnostics and the server keeps
+# running, both for documents that are analyzed and for queries against them
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///let.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    let x = 3\n}\n"}}}
+< Expected semicolon at the end of a let statement
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///ret.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    ret 1 +\n}\n"}}}
+< Expected identifier, literal or parenthesized expression
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///fn.ln","languageId":"lingon","version":1,"text":"fn main("}}}
+< Expected right parenthesis ')' at the end of the parameter list
+> {"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///let.ln"},"position":{"line":1,"character":8}}}
+< "id":2,
+> {"jsonrpc":"2.0","id":3,"method":"textDocument/documentSymbol","params":{"textDocument":{"uri":"file:///fn.ln"}}}
+< "id":3,"result":[]
+> {"jsonrpc":"2.0","id":4,"method":"shutdown"}
+< "id":4,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
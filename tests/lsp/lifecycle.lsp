@@ -0,0 +1,10 @@
+# Requests for unknown methods are answered with an error, 'shutdown' with a
+# null result and 'exit' stops the server
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"initialized","params":{}}
+> {"jsonrpc":"2.0","id":2,"method":"workspace/symbol","params":{"query":""}}
+< "id":2,"error":{"code":-32601,
+> {"jsonrpc":"2.0","id":"three","method":"shutdown"}
+< "id":"three","result":null}
+> {"jsonrpc":"2.0","method":"exit"}
@@ -0,0 +1,13 @@
+# Declarations span from their first to their last token, without the
+# whitespace that follows, and symbols select the name of the declaration
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///ranges.ln","languageId":"lingon","version":1,"text":"fn add(a: s32, b: s32) -> s32 {\n    let x = a + b;\n    ret x;\n}\n"}}}
+< "diagnostics":[]
+> {"jsonrpc":"2.0","id":2,"method":"textDocument/definition","params":{"textDocument":{"uri":"file:///ranges.ln"},"position":{"line":2,"character":8}}}
+< "id":2,"result":{"uri":"file:///ranges.ln","range":{"start":{"line":1,"character":4},"end":{"line":1,"character":18}}}
+> {"jsonrpc":"2.0","id":3,"method":"textDocument/documentSymbol","params":{"textDocument":{"uri":"file:///ranges.ln"}}}
+< "id":3,"result":[{"name":"add","kind":12,"range":{"start":{"line":0,"character":0},"end":{"line":3,"character":1}},"selectionRange":{"start":{"line":0,"character":3},"end":{"line":0,"character":6}},"children":[{"name":"a","kind":13,"range":{"start":{"line":0,"character":7},"end":{"line":0,"character":13}},"selectionRange":{"start":{"line":0,"character":7},"end":{"line":0,"character":8}}},{"name":"b","kind":13,"range":{"start":{"line":0,"character":15},"end":{"line":0,"character":21}},"selectionRange":{"start":{"line":0,"character":15},"end":{"line":0,"character":16}}},{"name":"x","kind":13,"range":{"start":{"line":1,"character":4},"end":{"line":1,"character":18}},"selectionRange":{"start":{"line":1,"character":8},"end":{"line":1,"character":9}}}]}]
+> {"jsonrpc":"2.0","id":4,"method":"shutdown"}
+< "id":4,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
@@ -0,0 +1,18 @@
+# A worker that panics while analyzing a document reports an internal error
+# and the server keeps answering, also for later analyses of the same text
+! --dbg-lsp-panic
+> {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+< "id":1,"result":{"capabilities":
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///a.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    let dbg_lsp_panic = 1;\n    ret dbg_lsp_panic;\n}\n"}}}
+< "uri":"file:///a.ln","version":1,"diagnostics":[{"range":{"start":{"line":0,"character":0},"end":{"line":0,"character":0}},"severity":1,"code":0,"source":"lnc","message":"Internal compiler error
+> {"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///a.ln"},"position":{"line":2,"character":8}}}
+< "id":2,"result":null}
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///b.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    let dbg_lsp_panic = 1;\n    ret dbg_lsp_panic;\n}\n"}}}
+< "uri":"file:///b.ln","version":1,"diagnostics":[{"range":{"start":{"line":0,"character":0},"end":{"line":0,"character":0}},"severity":1,"code":0,"source":"lnc","message":"Internal compiler error
+> {"jsonrpc":"2.0","id":3,"method":"textDocument/documentSymbol","params":{"textDocument":{"uri":"file:///b.ln"}}}
+< "id":3,
+> {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///c.ln","languageId":"lingon","version":1,"text":"fn main() -> s32 {\n    ret 0;\n}\n"}}}
+< "uri":"file:///c.ln","version":1,"diagnostics":[]
+> {"jsonrpc":"2.0","id":4,"method":"shutdown"}
+< "id":4,"result":null}
+> {"jsonrpc":"2.0","method":"exit"}
@@ -0,0 +1,554 @@
+// MIT License
+//
+// Copyright (c) 2019 Filip Björklund
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Drives the LSP server of 'lnc' with a script and checks the messages it
+// sends back. Every line of the script is one of
+//
+//   > <json>    Send a message
+//   < <text>    Wait for a message that contains the text. Messages received
+//               before it are skipped
+//   @ <n>       Talk as client n (0-7) from here on, connecting it first if
+//               needed
+//   ! <arg>     Pass an argument to the server, wherever the line is
+//   = <bytes>   Send raw bytes in one write. The escapes '\r', '\n' and '\\'
+//               are replaced, so a JSON string escape is written as '\\n'.
+//               Frames can then be split anywhere or sent several at once
+//   - <bytes>   Send raw bytes, one byte per write
+//   + <n> <bytes>
+//               Send raw bytes repeated n times in one write
+//   # <text>    Comment
+//
+// Scripts without '@' run 'lnc --lsp stdio' and the server must then exit with
+// status 0 after the script, so they end with 'shutdown' and 'exit'. Scripts
+// with '@' run 'lnc --lsp tcp-listen', which serves every client, and the
+// server must still be running after the script.
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// ========================================================================== //
+// Macros
+// ========================================================================== //
+
+/* Milliseconds to wait for a message or for the server to exit */
+#define kLspTestTimeoutMs 10000
+
+/* Maximum number of clients of a script */
+#define kLspTestMaxClients 8
+
+/* Maximum number of arguments of the server */
+#define kLspTestMaxArgs 16
+
+/* Microseconds to pause after each raw write, so that the server reads the
+ * writes separately */
+#define kLspTestRawPauseUs 2000
+
+// ========================================================================== //
+// Conn
+// ========================================================================== //
+
+/* Connection of a client and the messages received through it */
+typedef struct Conn
+{
+  /* Descriptors to send to and receive from, -1 if not connected */
+  int in_fd;
+  int out_fd;
+  /* Received bytes that are not yet split into messages */
+  char* buf;
+  size_t size;
+  size_t cap;
+} Conn;
+
+// -------------------------------------------------------------------------- //
+
+/* Frame and send message */
+static bool
+conn_send(Conn* conn, const char* msg)
+{
+  size_t size = strlen(msg);
+  char header[64];
+  int header_size =
+    snprintf(header, sizeof(header), "Content-Length: %zu\r\n\r\n", size);
+  return write(conn->in_fd, header, header_size) == header_size &&
+         write(conn->in_fd, msg, size) == (ssize_t)size;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Replace the escapes of raw bytes in place. Returns the new size */
+static size_t
+raw_unescape(char* bytes)
+{
+  size_t size = 0;
+  for (const char* cur = bytes; *cur; cur++) {
+    char c = *cur;
+    if (c == '\\' && cur[1]) {
+      cur++;
+      c = *cur == 'r' ? '\r' : *cur == 'n' ? '\n' : *cur;
+    }
+    bytes[size++] = c;
+  }
+  return size;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Send raw bytes 'count' times in one write, or byte by byte if 'bytewise' */
+static bool
+conn_send_raw(Conn* conn, const char* bytes, int count, bool bytewise)
+{
+  size_t size = strlen(bytes);
+  if (count <= 0 || size == 0) {
+    return false;
+  }
+  char* buf = malloc(size * (size_t)count);
+  for (int i = 0; i < count; i++) {
+    memcpy(buf + size * (size_t)i, bytes, size);
+  }
+  size *= (size_t)count;
+
+  size_t chunk = bytewise ? 1 : size;
+  bool success = true;
+  for (size_t off = 0; success && off < size; off += chunk) {
+    success = write(conn->in_fd, buf + off, chunk) == (ssize_t)chunk;
+    usleep(kLspTestRawPauseUs);
+  }
+  free(buf);
+  return success;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Remove the first complete message from the received bytes. Returns NULL if
+ * there is none */
+static char*
+conn_take_msg(Conn* conn)
+{
+  const char* sep = memmem(conn->buf, conn->size, "\r\n\r\n", 4);
+  if (!sep) {
+    return NULL;
+  }
+  size_t header_size = (size_t)(sep - conn->buf) + 4;
+  const char* len_str = memmem(conn->buf, header_size, "Content-Length:", 15);
+  if (!len_str) {
+    return NULL;
+  }
+  size_t len = strtoul(len_str + 15, NULL, 10);
+  if (conn->size < header_size + len) {
+    return NULL;
+  }
+  char* msg = malloc(len + 1);
+  memcpy(msg, conn->buf + header_size, len);
+  msg[len] = 0;
+  conn->size -= header_size + len;
+  memmove(conn->buf, conn->buf + header_size + len, conn->size);
+  return msg;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the milliseconds that are left until 'deadline' */
+static int
+time_left(const struct timespec* deadline)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+               (deadline->tv_nsec - now.tv_nsec) / 1000000;
+  return ms > 0 ? (int)ms : 0;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Wait for a message that contains 'text'. Returns false on timeout or if the
+ * server stops sending */
+static bool
+conn_expect(Conn* conn, const char* text)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += kLspTestTimeoutMs / 1000;
+  while (true) {
+    char* msg;
+    while ((msg = conn_take_msg(conn)) != NULL) {
+      bool found = strstr(msg, text) != NULL;
+      free(msg);
+      if (found) {
+        return true;
+      }
+    }
+
+    // Read more
+    struct pollfd poll_fd = { .fd = conn->out_fd, .events = POLLIN };
+    if (poll(&poll_fd, 1, time_left(&deadline)) <= 0) {
+      return false;
+    }
+    if (conn->cap - conn->size < 4096) {
+      conn->cap = conn->cap ? conn->cap * 2 : 65536;
+      conn->buf = realloc(conn->buf, conn->cap);
+    }
+    ssize_t result =
+      read(conn->out_fd, conn->buf + conn->size, conn->cap - conn->size);
+    if (result <= 0) {
+      return false;
+    }
+    conn->size += (size_t)result;
+  }
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Connect to a server that listens on the loopback address. The server may
+ * still be starting, so this retries until the timeout */
+static bool
+conn_connect(Conn* conn, uint16_t port)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET,
+                              .sin_port = htons(port),
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += kLspTestTimeoutMs / 1000;
+  while (time_left(&deadline) > 0) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+      return false;
+    }
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+      conn->in_fd = sock;
+      conn->out_fd = sock;
+      return true;
+    }
+    close(sock);
+    usleep(10000);
+  }
+  return false;
+}
+
+// -------------------------------------------------------------------------- //
+
+static void
+conn_close(Conn* conn)
+{
+  if (conn->in_fd != -1) {
+    close(conn->in_fd);
+  }
+  if (conn->out_fd != -1 && conn->out_fd != conn->in_fd) {
+    close(conn->out_fd);
+  }
+  free(conn->buf);
+  *conn = (Conn){ .in_fd = -1, .out_fd = -1 };
+}
+
+// ========================================================================== //
+// Server
+// ========================================================================== //
+
+/* Server process and the connections of its clients */
+typedef struct Server
+{
+  /* Process */
+  pid_t pid;
+  /* Port that a 'tcp-listen' server listens on, 0 for a 'stdio' server */
+  uint16_t port;
+  /* Clients. A 'stdio' server has only the first */
+  Conn conns[kLspTestMaxClients];
+} Server;
+
+// -------------------------------------------------------------------------- //
+
+/* Returns a port on the loopback address that is free at the moment */
+static uint16_t
+server_free_port()
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock == -1) {
+    return 0;
+  }
+  struct sockaddr_in addr = { .sin_family = AF_INET,
+                              .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t size = sizeof(addr);
+  uint16_t port = 0;
+  if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+      getsockname(sock, (struct sockaddr*)&addr, &size) == 0) {
+    port = ntohs(addr.sin_port);
+  }
+  close(sock);
+  return port;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Start 'lnc --lsp stdio', or 'lnc --lsp tcp-listen' if 'listen' is set,
+ * with extra arguments after the transport */
+static bool
+server_start(Server* server,
+             const char* lnc,
+             char** args,
+             int arg_count,
+             bool listen)
+{
+  *server = (Server){ 0 };
+  for (int i = 0; i < kLspTestMaxClients; i++) {
+    server->conns[i] = (Conn){ .in_fd = -1, .out_fd = -1 };
+  }
+
+  // Arguments
+  char port[8];
+  char* argv[6 + kLspTestMaxArgs] = { (char*)lnc, "--lsp" };
+  int argc = 2;
+  if (listen) {
+    server->port = server_free_port();
+    if (server->port == 0) {
+      return false;
+    }
+    snprintf(port, sizeof(port), "%u", (unsigned)server->port);
+    argv[argc++] = "tcp-listen";
+    argv[argc++] = "127.0.0.1";
+    argv[argc++] = port;
+  } else {
+    argv[argc++] = "stdio";
+  }
+  for (int i = 0; i < arg_count; i++) {
+    argv[argc++] = args[i];
+  }
+  argv[argc] = NULL;
+
+  // A server that listens is reached through sockets, otherwise through the
+  // standard streams
+  int in_pipe[2] = { -1, -1 };
+  int out_pipe[2] = { -1, -1 };
+  if (!listen && (pipe(in_pipe) == -1 || pipe(out_pipe) == -1)) {
+    return false;
+  }
+  pid_t pid = fork();
+  if (pid == -1) {
+    return false;
+  }
+  if (pid == 0) {
+    if (!listen) {
+      dup2(in_pipe[0], STDIN_FILENO);
+      dup2(out_pipe[1], STDOUT_FILENO);
+      close(in_pipe[1]);
+      close(out_pipe[0]);
+    }
+    execv(lnc, argv);
+    _exit(127);
+  }
+  server->pid = pid;
+  if (!listen) {
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    server->conns[0].in_fd = in_pipe[1];
+    server->conns[0].out_fd = out_pipe[0];
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Returns the connection of a client, connecting it to a 'tcp-listen' server
+ * on first use. Returns NULL if that fails */
+static Conn*
+server_conn(Server* server, int client)
+{
+  if (client < 0 || client >= kLspTestMaxClients) {
+    return NULL;
+  }
+  Conn* conn = &server->conns[client];
+  if (conn->in_fd == -1 && !conn_connect(conn, server->port)) {
+    return NULL;
+  }
+  return conn;
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Wait for the server to exit. Returns its exit status, or -1 if it did not
+ * exit in time or was killed by a signal */
+static int
+server_wait(Server* server)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += kLspTestTimeoutMs / 1000;
+  int status;
+  while (waitpid(server->pid, &status, WNOHANG) == 0) {
+    if (time_left(&deadline) == 0) {
+      kill(server->pid, SIGKILL);
+      waitpid(server->pid, &status, 0);
+      fprintf(stderr, "Server did not exit\n");
+      return -1;
+    }
+    usleep(10000);
+  }
+  if (WIFSIGNALED(status)) {
+    fprintf(stderr, "Server was killed by signal %d\n", WTERMSIG(status));
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+// -------------------------------------------------------------------------- //
+
+/* Stop a 'tcp-listen' server. Returns false if it was no longer running */
+static bool
+server_stop(Server* server)
+{
+  int status;
+  bool running = waitpid(server->pid, &status, WNOHANG) == 0;
+  if (running) {
+    kill(server->pid, SIGKILL);
+    waitpid(server->pid, &status, 0);
+  } else if (WIFSIGNALED(status)) {
+    fprintf(stderr, "Server was killed by signal %d\n", WTERMSIG(status));
+  } else {
+    fprintf(stderr, "Server exited with status %d\n", WEXITSTATUS(status));
+  }
+  return running;
+}
+
+// ========================================================================== //
+// Main
+// ========================================================================== //
+
+/* Read what the server needs before the script runs: whether it has
+ * clients, which needs a 'tcp-listen' server, and the arguments to pass. The
+ * arguments are owned by the caller */
+static bool
+script_prescan(FILE* script, char** args, int* p_arg_count, bool* p_listen)
+{
+  char line[8192];
+  *p_arg_count = 0;
+  *p_listen = false;
+  while (fgets(line, sizeof(line), script)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] == '@') {
+      *p_listen = true;
+    } else if (line[0] == '!' && line[1] == ' ') {
+      if (*p_arg_count == kLspTestMaxArgs) {
+        return false;
+      }
+      args[(*p_arg_count)++] = strdup(line + 2);
+    }
+  }
+  rewind(script);
+  return true;
+}
+// -------------------------------------------------------------------------- //
+
+int
+main(int argc, char** argv)
+{
+  if (argc != 3) {
+    fprintf(stderr, "Usage: lsp_test <lnc> <script>\n");
+    return 2;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  FILE* script = fopen(argv[2], "r");
+  if (!script) {
+    fprintf(stderr, "Failed to open script '%s'\n", argv[2]);
+    return 2;
+  }
+  char* args[kLspTestMaxArgs];
+  int arg_count;
+  bool listen;
+  if (!script_prescan(script, args, &arg_count, &listen)) {
+    fprintf(stderr, "Too many server arguments in '%s'\n", argv[2]);
+    return 2;
+  }
+  Server server;
+  bool started = server_start(&server, argv[1], args, arg_count, listen);
+  for (int i = 0; i < arg_count; i++) {
+    free(args[i]);
+  }
+  if (!started) {
+    fprintf(stderr, "Failed to start '%s'\n", argv[1]);
+    return 2;
+  }
+
+  // Run script
+  bool success = true;
+  char line[8192];
+  unsigned line_num = 0;
+  Conn* conn = listen ? NULL : &server.conns[0];
+  while (success && fgets(line, sizeof(line), script)) {
+    line_num++;
+    line[strcspn(line, "\r\n")] = 0;
+    char* arg = line[0] && line[1] == ' ' ? line + 2 : line + strlen(line);
+    if (line[0] == '@') {
+      conn = server_conn(&server, atoi(arg));
+      success = conn != NULL;
+    } else if (line[0] == '>') {
+      success = conn && conn_send(conn, arg);
+    } else if (line[0] == '<') {
+      success = conn && conn_expect(conn, arg);
+    } else if (line[0] == '=' || line[0] == '-') {
+      arg[raw_unescape(arg)] = 0;
+      success = conn && conn_send_raw(conn, arg, 1, line[0] == '-');
+    } else if (line[0] == '+') {
+      char* bytes;
+      long count = strtol(arg, &bytes, 10);
+      if (*bytes == ' ') {
+        bytes++;
+      }
+      bytes[raw_unescape(bytes)] = 0;
+      success = conn && conn_send_raw(conn, bytes, (int)count, false);
+    } else {
+      continue;
+    }
+    if (!success) {
+      fprintf(stderr, "Line %u failed: %s\n", line_num, line);
+    }
+  }
+  fclose(script);
+
+  // A server that listens must outlive its clients, others must exit cleanly
+  bool clean = true;
+  if (listen) {
+    clean = server_stop(&server);
+  } else {
+    close(server.conns[0].in_fd);
+    server.conns[0].in_fd = -1;
+    int status = server_wait(&server);
+    if (status != 0) {
+      fprintf(stderr, "Server exited with status %d\n", status);
+      clean = false;
+    }
+  }
+  for (int i = 0; i < kLspTestMaxClients; i++) {
+    conn_close(&server.conns[i]);
+  }
+  return success && clean ? 0 : 1;
+}